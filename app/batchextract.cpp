@@ -39,12 +39,48 @@
 #include <KWidgetJobTracker>
 
 #include <QDir>
+#include <QFile>
 #include <QFileInfo>
 #include <QPointer>
+#include <QStorageInfo>
+#include <QThread>
 #include <QTimer>
 
+/**
+ * @return Whether @p path is on a rotational disk, where extracting several
+ * archives at once would only make the disk seek back and forth.
+ */
+static bool isOnRotationalDisk(const QString &path)
+{
+#ifdef Q_OS_LINUX
+    const QString device = QFileInfo(QString::fromLocal8Bit(QStorageInfo(path).device())).fileName();
+    if (device.isEmpty()) {
+        return false;
+    }
+
+    // Partitions have no queue of their own, it belongs to the parent device.
+    const QString blockDevice = QFileInfo(QStringLiteral("/sys/class/block/") + device).canonicalFilePath();
+    QFile rotational(blockDevice + QLatin1String("/queue/rotational"));
+    if (!rotational.exists()) {
+        rotational.setFileName(QFileInfo(blockDevice).path() + QLatin1String("/queue/rotational"));
+    }
+
+    if (!rotational.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    return rotational.readAll().trimmed() == "1";
+#else
+    Q_UNUSED(path)
+    return false;
+#endif
+}
+
 BatchExtract::BatchExtract(QObject* parent)
     : KCompositeJob(parent),
+      m_initialJobCount(0),
+      m_finishedJobCount(0),
+      m_maxConcurrentJobs(0),
       m_autoSubfolder(false),
       m_preservePaths(true),
       m_openDestinationAfterExtraction(false),
@@ -86,7 +122,19 @@ bool BatchExtract::doKill()
         return false;
     }
 
-    return subjobs().first()->kill();
+    // Queued jobs have not been started, so they can be dropped.
+    foreach (KJob *job, m_pendingJobs) {
+        removeSubjob(job);
+        job->deleteLater();
+    }
+    m_pendingJobs.clear();
+
+    bool killed = true;
+    foreach (KJob *job, subjobs()) {
+        killed = job->kill() && killed;
+    }
+
+    return killed;
 }
 
 void BatchExtract::slotUserQuery(Kerfuffle::Query *query)
@@ -123,17 +171,28 @@ void BatchExtract::slotStartJob()
     KIO::getJobTracker()->registerJob(this);
     m_registered = true;
 
+    m_initialJobCount = subjobs().size();
+    m_pendingJobs = subjobs().toVector();
+
+    const int maxJobs = maxConcurrentJobs();
+    qCDebug(ARK) << "Starting" << qMin(maxJobs, m_initialJobCount) << "of" << m_initialJobCount << "jobs";
+
+    for (int i = 0; i < maxJobs && !m_pendingJobs.isEmpty(); ++i) {
+        startNextJob();
+    }
+}
+
+void BatchExtract::startNextJob()
+{
+    KJob *job = m_pendingJobs.takeFirst();
+
     emit description(this,
                      i18n("Extracting Files"),
-                     qMakePair(i18n("Source archive"), m_fileNames.value(subjobs().at(0)).first),
-                     qMakePair(i18n("Destination"), m_fileNames.value(subjobs().at(0)).second)
+                     qMakePair(i18n("Source archive"), m_fileNames.value(job).first),
+                     qMakePair(i18n("Destination"), m_fileNames.value(job).second)
                     );
 
-    m_initialJobCount = subjobs().size();
-
-    qCDebug(ARK) << "Starting first job";
-
-    subjobs().at(0)->start();
+    job->start();
 }
 
 void BatchExtract::showFailedFiles()
@@ -145,28 +204,39 @@ void BatchExtract::showFailedFiles()
 
 void BatchExtract::slotResult(KJob *job)
 {
-    // TODO: The user must be informed about which file caused the error, and that the other files
-    //       in the queue will not be extracted.
-    if (job->error()) {
-        qCDebug(ARK) << "There was en error:" << job->error() << ", errorText:" << job->errorString();
-
-        setErrorText(job->errorString());
-        setError(job->error());
+    removeSubjob(job);
+    m_jobPercents.remove(job);
+    ++m_finishedJobCount;
 
-        removeSubjob(job);
+    if (job->error() == KJob::KilledJobError) {
+        qCDebug(ARK) << "Extraction of" << m_fileNames.value(job).first << "was killed, stopping the other jobs";
 
-        if (job->error() != KJob::KilledJobError) {
-            KMessageBox::error(Q_NULLPTR, job->errorString().isEmpty() ?
-                                     i18n("There was an error during extraction.") : job->errorString());
-        }
+        setError(job->error());
+        setErrorText(job->errorString());
 
+        doKill();
         emitResult();
         return;
     }
 
-    removeSubjob(job);
+    // A failed archive doesn't stop the extraction of the others,
+    // the failures are listed by showFailedFiles() at the end.
+    if (job->error()) {
+        qCDebug(ARK) << "There was en error:" << job->error() << ", errorText:" << job->errorString();
+
+        const QString fileName = QFileInfo(m_fileNames.value(job).first).fileName();
+        m_failedFiles.append(job->errorString().isEmpty() ?
+                             fileName :
+                             i18nc("@item:inlistbox archive name and extraction error", "%1: %2", fileName, job->errorString()));
+
+        setError(job->error());
+        setErrorText(job->errorString());
+    }
 
-    if (!hasSubjobs()) {
+    if (!m_pendingJobs.isEmpty()) {
+        qCDebug(ARK) << "Starting the next job";
+        startNextJob();
+    } else if (!hasSubjobs()) {
         if (openDestinationAfterExtraction()) {
             QUrl destination(destinationFolder());
             destination.setPath(QDir::cleanPath(destination.path()));
@@ -175,23 +245,20 @@ void BatchExtract::slotResult(KJob *job)
 
         qCDebug(ARK) << "Finished, emitting the result";
         emitResult();
-    } else {
-        qCDebug(ARK) << "Starting the next job";
-        emit description(this,
-                         i18n("Extracting Files"),
-                         qMakePair(i18n("Source archive"), m_fileNames.value(subjobs().at(0)).first),
-                         qMakePair(i18n("Destination"), m_fileNames.value(subjobs().at(0)).second)
-                        );
-        subjobs().at(0)->start();
     }
 }
 
 void BatchExtract::forwardProgress(KJob *job, unsigned long percent)
 {
-    Q_UNUSED(job)
-    auto jobPart = static_cast<ulong>(100 / m_initialJobCount);
-    auto remainingJobs = static_cast<ulong>(m_initialJobCount - subjobs().size());
-    setPercent(jobPart * remainingJobs + percent / static_cast<ulong>(m_initialJobCount));
+    m_jobPercents[job] = percent;
+
+    // Finished jobs count as 100%, running ones with their own percentage.
+    unsigned long total = static_cast<ulong>(m_finishedJobCount) * 100;
+    foreach (unsigned long jobPercent, m_jobPercents) {
+        total += jobPercent;
+    }
+
+    setPercent(total / static_cast<ulong>(m_initialJobCount));
 }
 
 void BatchExtract::addInput(const QUrl& url)
@@ -216,6 +283,19 @@ bool BatchExtract::preservePaths() const
     return m_preservePaths;
 }
 
+int BatchExtract::maxConcurrentJobs() const
+{
+    if (m_maxConcurrentJobs > 0) {
+        return m_maxConcurrentJobs;
+    }
+
+    if (isOnRotationalDisk(destinationFolder())) {
+        return 1;
+    }
+
+    return qMax(1, QThread::idealThreadCount());
+}
+
 QString BatchExtract::destinationFolder() const
 {
     if (m_destinationFolder.isEmpty()) {
@@ -227,8 +307,9 @@ QString BatchExtract::destinationFolder() const
 
 void BatchExtract::setDestinationFolder(const QString& folder)
 {
+    // The jobs may run at the same time as others changing the current directory.
     if (QFileInfo(folder).isDir()) {
-        m_destinationFolder = folder;
+        m_destinationFolder = QFileInfo(folder).absoluteFilePath();
     }
 }
 
@@ -242,6 +323,11 @@ void BatchExtract::setPreservePaths(bool value)
     m_preservePaths = value;
 }
 
+void BatchExtract::setMaxConcurrentJobs(int count)
+{
+    m_maxConcurrentJobs = qMax(0, count);
+}
+
 bool BatchExtract::showExtractDialog()
 {
     QPointer<Kerfuffle::ExtractionDialog> dialog =
@@ -257,8 +343,7 @@ bool BatchExtract::showExtractDialog()
     dialog.data()->setPreservePaths(preservePaths());
 
     // Only one archive, we need a LoadJob to get the single-folder and subfolder properties.
-    // TODO: find a better way (e.g. let the dialog handle everything), otherwise we list
-    // the archive twice (once here and once in the following BatchExtractJob).
+    // The following BatchExtractJob doesn't list the archive again.
     Kerfuffle::LoadJob *loadJob = Q_NULLPTR;
     if (m_inputs.size() == 1) {
         loadJob = Kerfuffle::Archive::load(m_inputs.at(0).toLocalFile(), this);
@@ -31,6 +31,7 @@
 
 #include <KCompositeJob>
 
+#include <QHash>
 #include <QMap>
 #include <QVector>
 
@@ -181,6 +182,23 @@ public:
      */
     void setPreservePaths(bool value);
 
+    /**
+     * Returns how many archives may be extracted at the same time.
+     *
+     * @return The value set with setMaxConcurrentJobs() or, if none has been
+     *         set, a default depending on the number of CPUs and on whether
+     *         the destination folder is on a rotational disk.
+     */
+    int maxConcurrentJobs() const;
+
+    /**
+     * Sets how many archives may be extracted at the same time.
+     *
+     * @param count The maximum number of running extraction jobs. Values
+     *              lower than 1 restore the default.
+     */
+    void setMaxConcurrentJobs(int count);
+
 private slots:
     /**
      * Updates the percentage of the job that has been completed.
@@ -194,9 +212,10 @@ private slots:
     void showFailedFiles();
 
     /**
-     * Shows an error message if the current job hasn't finished
-     * successfully, and advances to the next extraction job if
-     * there are more.
+     * Records the archive of @p job as failed if it hasn't finished
+     * successfully, and starts the next queued extraction job if
+     * there are more. If @p job has been killed, all the other jobs
+     * are killed as well.
      */
     void slotResult(KJob *job) Q_DECL_OVERRIDE;
 
@@ -208,13 +227,23 @@ private slots:
     /**
      * Does the real work for start() and extracts all scheduled files.
      *
-     * Each extraction job is started after the last one finishes.
-     * The jobs are executed in the order they were added via addInput().
+     * Up to maxConcurrentJobs() extraction jobs run at the same time,
+     * the others are queued. The jobs are started in the order they were
+     * added via addInput().
      */
     void slotStartJob();
 
 private:
+    /**
+     * Starts the next queued extraction job.
+     */
+    void startNextJob();
+
     int m_initialJobCount;
+    int m_finishedJobCount;
+    int m_maxConcurrentJobs;
+    QVector<KJob*> m_pendingJobs;
+    QHash<KJob*, unsigned long> m_jobPercents;
     QMap<KJob*, QPair<QString, QString> > m_fileNames;
     bool m_autoSubfolder;
 
@@ -165,6 +165,10 @@ int main(int argc, char **argv)
     parser.addOption(QCommandLineOption(QStringList() << QStringLiteral("a") << QStringLiteral("autosubfolder"),
                                         i18n("Archive contents will be read, and if detected to not be a single folder archive, a subfolder with the name of the archive will be created.")));
 
+    parser.addOption(QCommandLineOption(QStringList() << QStringLiteral("j") << QStringLiteral("jobs"),
+                                        i18n("Maximum number of archives to extract at the same time in batch mode. Defaults to the number of CPUs, or to one if the destination is on a rotational disk."),
+                                        QStringLiteral("number")));
+
     aboutData.setupCommandLine(&parser);
 
     KAboutData::setApplicationData(aboutData);
@@ -261,6 +265,11 @@ int main(int argc, char **argv)
                 batchJob->setDestinationFolder(parser.value(QStringLiteral("destination")));
             }
 
+            if (parser.isSet(QStringLiteral("jobs"))) {
+                qCDebug(ARK) << "Setting maximum number of concurrent jobs to" << parser.value(QStringLiteral("jobs"));
+                batchJob->setMaxConcurrentJobs(parser.value(QStringLiteral("jobs")).toInt());
+            }
+
             if (parser.isSet(QStringLiteral("opendestination"))) {
                 qCDebug(ARK) << "Setting opendestination";
                 batchJob->setOpenDestinationAfterExtraction(true);
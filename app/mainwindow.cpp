@@ -315,6 +315,12 @@ void MainWindow::newArchive()
         if (!dialog.data()->encryptionMethod().isEmpty()) {
             m_openArgs.metaData()[QStringLiteral("encryptionMethod")] = dialog.data()->encryptionMethod();
         }
+        if (dialog.data()->threadCount() > 0) {
+            m_openArgs.metaData()[QStringLiteral("threadCount")] = QString::number(dialog.data()->threadCount());
+        }
+        if (dialog.data()->isLongDistanceMatchingEnabled()) {
+            m_openArgs.metaData()[QStringLiteral("longDistanceMatching")] = QStringLiteral("true");
+        }
 
         m_openArgs.metaData()[QStringLiteral("encryptionPassword")] = password;
 
@@ -328,6 +334,8 @@ void MainWindow::newArchive()
         m_openArgs.metaData().remove(QStringLiteral("createNewArchive"));
         m_openArgs.metaData().remove(QStringLiteral("fixedMimeType"));
         m_openArgs.metaData().remove(QStringLiteral("compressionLevel"));
+        m_openArgs.metaData().remove(QStringLiteral("threadCount"));
+        m_openArgs.metaData().remove(QStringLiteral("longDistanceMatching"));
         m_openArgs.metaData().remove(QStringLiteral("encryptionPassword"));
         m_openArgs.metaData().remove(QStringLiteral("encryptHeader"));
     }
@@ -35,6 +35,8 @@ class BatchExtractTest : public QObject
 private Q_SLOTS:
     void testBatchExtraction_data();
     void testBatchExtraction();
+    void testConcurrentExtraction();
+    void testAutoSubfolderPermissions();
 };
 
 QTEST_GUILESS_MAIN(BatchExtractTest)
@@ -107,4 +109,66 @@ void BatchExtractTest::testBatchExtraction()
     QCOMPARE(extractedEntriesCount, expectedExtractedEntriesCount);
 }
 
+void BatchExtractTest::testConcurrentExtraction()
+{
+    auto batchJob = new BatchExtract(this);
+    batchJob->addInput(QUrl::fromUserInput(QFINDTESTDATA("../kerfuffle/data/simplearchive.tar.gz")));
+    batchJob->addInput(QUrl::fromUserInput(QFINDTESTDATA("../kerfuffle/data/one_toplevel_folder.zip")));
+    batchJob->addInput(QUrl::fromUserInput(QFINDTESTDATA("data/simple%archive.tar.gz")));
+    batchJob->setAutoSubfolder(true);
+    batchJob->setMaxConcurrentJobs(2);
+    QCOMPARE(batchJob->maxConcurrentJobs(), 2);
+
+    QTemporaryDir destDir;
+    if (!destDir.isValid()) {
+        QSKIP("Could not create a temporary directory for extraction. Skipping test.", SkipSingle);
+    }
+
+    batchJob->setDestinationFolder(destDir.path());
+
+    QEventLoop eventLoop(this);
+    connect(batchJob, &KJob::result, &eventLoop, &QEventLoop::quit);
+    batchJob->start();
+    eventLoop.exec(); // krazy:exclude=crashy
+
+    // Each archive is extracted to its own folder, as in testBatchExtraction().
+    int extractedEntriesCount = 0;
+    QDirIterator dirIt(destDir.path(), QDir::AllEntries | QDir::Hidden | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+    while (dirIt.hasNext()) {
+        extractedEntriesCount++;
+        dirIt.next();
+    }
+
+    QCOMPARE(extractedEntriesCount, 5 + 9 + 5);
+}
+
+void BatchExtractTest::testAutoSubfolderPermissions()
+{
+    // The archive is staged in a temporary folder before its subfolder is created.
+    auto batchJob = new BatchExtract(this);
+    batchJob->addInput(QUrl::fromUserInput(QFINDTESTDATA("../kerfuffle/data/simplearchive.tar.gz")));
+    batchJob->setAutoSubfolder(true);
+
+    QTemporaryDir destDir;
+    if (!destDir.isValid()) {
+        QSKIP("Could not create a temporary directory for extraction. Skipping test.", SkipSingle);
+    }
+
+    batchJob->setDestinationFolder(destDir.path());
+
+    QEventLoop eventLoop(this);
+    connect(batchJob, &KJob::result, &eventLoop, &QEventLoop::quit);
+    batchJob->start();
+    eventLoop.exec(); // krazy:exclude=crashy
+
+    const QFileInfoList entries = QDir(destDir.path()).entryInfoList(QDir::AllEntries | QDir::Hidden | QDir::NoDotAndDotDot);
+    QCOMPARE(entries.size(), 1);
+    QVERIFY(entries.first().isDir());
+
+    // The subfolder has the same permissions as any new folder, not the
+    // owner-only ones of the staging folder.
+    QVERIFY(QDir(destDir.path()).mkdir(QStringLiteral("reference")));
+    QCOMPARE(entries.first().permissions(), QFileInfo(destDir.path() + QStringLiteral("/reference")).permissions());
+}
+
 #include "batchextracttest.moc"
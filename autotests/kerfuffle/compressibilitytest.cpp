@@ -0,0 +1,78 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "compressibility.h"
+
+#include <QTest>
+
+using namespace Kerfuffle;
+
+class CompressibilityTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+
+    void testIsIncompressible_data();
+    void testIsIncompressible();
+};
+
+QTEST_GUILESS_MAIN(CompressibilityTest)
+
+void CompressibilityTest::testIsIncompressible_data()
+{
+    QTest::addColumn<QString>("fileName");
+    QTest::addColumn<QByteArray>("head");
+    QTest::addColumn<bool>("expectedIncompressible");
+
+    const QByteArray text = QByteArray("Lorem ipsum dolor sit amet, consectetur adipiscing elit. ").repeated(100);
+
+    // A xorshift generator, so that the data is the same on every run.
+    QByteArray random(8192, Qt::Uninitialized);
+    quint32 state = 2463534242u;
+    for (int i = 0; i < random.size(); ++i) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        random[i] = static_cast<char>(state >> 24);
+    }
+
+    QTest::newRow("text") << QStringLiteral("file.txt") << text << false;
+    QTest::newRow("random data") << QStringLiteral("file.bin") << random << true;
+    QTest::newRow("random data, too short") << QStringLiteral("file.bin") << random.left(1024) << false;
+    QTest::newRow("jpeg image") << QStringLiteral("photo.jpg") << text << true;
+    QTest::newRow("zip archive") << QStringLiteral("archive.zip") << QByteArray() << true;
+    QTest::newRow("video") << QStringLiteral("movie.mp4") << QByteArray() << true;
+    QTest::newRow("empty file") << QStringLiteral("empty") << QByteArray() << false;
+}
+
+void CompressibilityTest::testIsIncompressible()
+{
+    QFETCH(QString, fileName);
+    QFETCH(QByteArray, head);
+    QFETCH(bool, expectedIncompressible);
+
+    QCOMPARE(isIncompressible(fileName, head), expectedIncompressible);
+}
+
+#include "compressibilitytest.moc"
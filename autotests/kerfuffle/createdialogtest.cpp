@@ -32,6 +32,7 @@
 #include <QComboBox>
 #include <QLineEdit>
 #include <QMimeDatabase>
+#include <QSpinBox>
 #include <QTest>
 
 using namespace Kerfuffle;
@@ -46,6 +47,7 @@ private Q_SLOTS:
     void testEncryption_data();
     void testEncryption();
     void testHeaderEncryptionTooltip();
+    void testZstdOptions();
 
 private:
     PluginManager m_pluginManager;
@@ -210,6 +212,31 @@ void CreateDialogTest::testHeaderEncryptionTooltip()
     QVERIFY(encryptHeaderCheckBox->toolTip().isEmpty());
 }
 
+void CreateDialogTest::testZstdOptions()
+{
+    if (!m_pluginManager.supportedWriteMimeTypes().contains(QStringLiteral("application/x-zstd-compressed-tar"))) {
+        QSKIP("tar.zst format not available in CreateDialog, skipping test.", SkipSingle);
+    }
+
+    CreateDialog *dialog = new CreateDialog(Q_NULLPTR, QString(), QUrl());
+
+    auto threadsSpinBox = dialog->findChild<QSpinBox*>(QStringLiteral("threadsSpinBox"));
+    auto longDistanceCheckBox = dialog->findChild<QCheckBox*>(QStringLiteral("longDistanceCheckBox"));
+    QVERIFY(threadsSpinBox);
+    QVERIFY(longDistanceCheckBox);
+
+    QVERIFY(dialog->setMimeType(QStringLiteral("application/x-zstd-compressed-tar")));
+    threadsSpinBox->setValue(2);
+    longDistanceCheckBox->setChecked(true);
+    QCOMPARE(dialog->threadCount(), 2);
+    QVERIFY(dialog->isLongDistanceMatchingEnabled());
+
+    // The other formats ignore the options.
+    QVERIFY(dialog->setMimeType(QStringLiteral("application/x-compressed-tar")));
+    QCOMPARE(dialog->threadCount(), 0);
+    QVERIFY(!dialog->isLongDistanceMatchingEnabled());
+}
+
 QTEST_MAIN(CreateDialogTest)
 
 #include "createdialogtest.moc"
@@ -0,0 +1,90 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "entryselection.h"
+
+#include <QTest>
+
+using namespace Kerfuffle;
+
+class EntrySelectionTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+
+    void testIndexOf_data();
+    void testIndexOf();
+    void testMatchesFolderContents();
+};
+
+QTEST_GUILESS_MAIN(EntrySelectionTest)
+
+void EntrySelectionTest::testIndexOf_data()
+{
+    QTest::addColumn<QStringList>("selectedPaths");
+    QTest::addColumn<QString>("path");
+    QTest::addColumn<int>("expectedIndex");
+    QTest::addColumn<bool>("expectedFolderPrefixes");
+
+    const QStringList files = {QStringLiteral("a.txt"), QStringLiteral("dir1/b.txt"), QStringLiteral("dir1/")};
+    QTest::newRow("selected file") << files << QStringLiteral("dir1/b.txt") << 1 << false;
+    QTest::newRow("selected folder") << files << QStringLiteral("dir1/") << 2 << false;
+    QTest::newRow("unselected file in folder with selected contents") << files << QStringLiteral("dir1/c.txt") << -1 << false;
+    QTest::newRow("unselected file") << files << QStringLiteral("b.txt") << -1 << false;
+
+    const QStringList folders = {QStringLiteral("a.txt"), QStringLiteral("dir1/"), QStringLiteral("dir1/dir2/"), QStringLiteral("dir3/")};
+    QTest::newRow("file in selected folder") << folders << QStringLiteral("dir3/b.txt") << 3 << true;
+    QTest::newRow("file in selected subfolder") << folders << QStringLiteral("dir1/dir2/dir4/b.txt") << 2 << true;
+    QTest::newRow("file next to selected subfolder") << folders << QStringLiteral("dir1/b.txt") << -1 << true;
+    QTest::newRow("folder prefix is not a path prefix") << folders << QStringLiteral("dir3.txt") << -1 << true;
+
+    const QStringList duplicates = {QStringLiteral("a.txt"), QStringLiteral("a.txt")};
+    QTest::newRow("first duplicate wins") << duplicates << QStringLiteral("a.txt") << 0 << false;
+}
+
+void EntrySelectionTest::testIndexOf()
+{
+    QFETCH(QStringList, selectedPaths);
+    QFETCH(QString, path);
+    QFETCH(int, expectedIndex);
+    QFETCH(bool, expectedFolderPrefixes);
+
+    const EntrySelection selection(selectedPaths);
+    QCOMPARE(selection.indexOf(path), expectedIndex);
+    QCOMPARE(selection.contains(path), expectedIndex != -1);
+    QCOMPARE(selection.hasFolderPrefixes(), expectedFolderPrefixes);
+}
+
+void EntrySelectionTest::testMatchesFolderContents()
+{
+    const EntrySelection selection({QStringLiteral("a.txt"), QStringLiteral("dir1/"), QStringLiteral("dir1/dir2/"), QStringLiteral("dir3/")});
+
+    QVERIFY(!selection.matchesFolderContents(QStringLiteral("a.txt")));
+    QVERIFY(!selection.matchesFolderContents(QStringLiteral("dir1/")));
+    QVERIFY(selection.matchesFolderContents(QStringLiteral("dir1/dir2/")));
+    QVERIFY(selection.matchesFolderContents(QStringLiteral("dir3/")));
+    QVERIFY(!selection.matchesFolderContents(QStringLiteral("dir4/")));
+}
+
+#include "entryselectiontest.moc"
@@ -26,12 +26,16 @@
 
 #include "archive_kerfuffle.h"
 #include "jobs.h"
+#include "pluginmanager.h"
 #include "testhelper.h"
 
+#include <QBuffer>
 #include <QDirIterator>
 #include <QStandardPaths>
 #include <QTest>
 
+#include <utime.h>
+
 using namespace Kerfuffle;
 
 class ExtractTest : public QObject
@@ -41,10 +45,50 @@ class ExtractTest : public QObject
 private Q_SLOTS:
     void testExtraction_data();
     void testExtraction();
+    void testExtractStoredData();
+    void testExtractSmallFiles();
+    void testTestArchive_data();
+    void testTestArchive();
+    void testEntryDevice();
+
+private:
+    /**
+     * Creates an archive of @p mimeType at @p archivePath with @p entries,
+     * whose paths are relative to @p workDir.
+     * @return Whether a plugin could create the archive.
+     */
+    bool createArchive(const QString &archivePath, const QString &mimeType, const QString &workDir, const QVector<Archive::Entry*> &entries);
+
+    /**
+     * Loads the archive at @p archivePath.
+     * @return The archive, to be deleted by the caller, or null if no plugin could load it.
+     */
+    Archive *loadArchive(const QString &archivePath);
+
+    /**
+     * Loads the archive at @p archivePath and extracts all of it to @p destinationDir.
+     * @return Whether the extraction succeeded.
+     */
+    bool extractAll(const QString &archivePath, const QString &destinationDir);
 };
 
 QTEST_GUILESS_MAIN(ExtractTest)
 
+// Data that doesn't compress, generated by a xorshift generator so that it
+// is the same on every run.
+static QByteArray randomData(int size)
+{
+    QByteArray data(size, Qt::Uninitialized);
+    quint32 state = 2463534242u;
+    for (int i = 0; i < data.size(); ++i) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        data[i] = static_cast<char>(state >> 24);
+    }
+    return data;
+}
+
 void ExtractTest::testExtraction_data()
 {
     QTest::addColumn<QString>("archivePath");
@@ -60,6 +104,10 @@ void ExtractTest::testExtraction_data()
     ExtractionOptions dragAndDropOptions;
     dragAndDropOptions.setDragAndDropEnabled(true);
 
+    ExtractionOptions optionsPreallocateAndSync;
+    optionsPreallocateAndSync.setPreallocateFiles(true);
+    optionsPreallocateAndSync.setSyncMode(ExtractionOptions::SyncEachFile);
+
     QString archivePath = QFINDTESTDATA("data/simplearchive.tar.gz");
     QTest::newRow("extract the whole simplearchive.tar.gz")
             << archivePath
@@ -67,6 +115,13 @@ void ExtractTest::testExtraction_data()
             << optionsPreservePaths
             << 4;
 
+    archivePath = QFINDTESTDATA("data/simplearchive.tar.gz");
+    QTest::newRow("extract the whole simplearchive.tar.gz, preallocated and synced")
+            << archivePath
+            << QVector<Archive::Entry*>()
+            << optionsPreallocateAndSync
+            << 4;
+
     archivePath = QFINDTESTDATA("data/simplearchive.tar.gz");
     QTest::newRow("extract selected entries from a tar.gz, without paths")
             << archivePath
@@ -330,6 +385,28 @@ void ExtractTest::testExtraction_data()
         qDebug() << "lz4 executable not found in path. Skipping lz4 test.";
     }
 
+    // Only run test for zstd-compressed tar if libarchive supports zstd.
+    if (PluginManager().supportedMimeTypes().contains(QStringLiteral("application/x-zstd-compressed-tar"))) {
+        archivePath = QFINDTESTDATA("data/simplearchive.tar.zst");
+        QTest::newRow("extract selected entries from a zstd-compressed tarball without path")
+                << archivePath
+                << QVector<Archive::Entry*> {
+                       new Archive::Entry(this, QStringLiteral("file3.txt"), QString()),
+                       new Archive::Entry(this, QStringLiteral("dir2/file22.txt"), QString())
+                   }
+                << optionsNoPaths
+                << 2;
+
+        archivePath = QFINDTESTDATA("data/simplearchive.tar.zst");
+        QTest::newRow("extract all entries from a zstd-compressed tarball with path")
+                << archivePath
+                << QVector<Archive::Entry*>()
+                << optionsPreservePaths
+                << 7;
+    } else {
+        qDebug() << "zstd-compressed tar not supported. Skipping zstd test.";
+    }
+
     archivePath = QFINDTESTDATA("data/simplearchive.xar");
     QTest::newRow("extract selected entries from a xar archive without path")
             << archivePath
@@ -395,6 +472,13 @@ void ExtractTest::testExtraction_data()
                }
             << dragAndDropOptions
             << 2;
+
+    archivePath = QFINDTESTDATA("data/archive-dotdot.tar");
+    QTest::newRow("extract a tar with an entry outside of the destination")
+            << archivePath
+            << QVector<Archive::Entry*>()
+            << optionsPreservePaths
+            << 1;
 }
 
 void ExtractTest::testExtraction()
@@ -412,14 +496,18 @@ void ExtractTest::testExtraction()
         QSKIP("Could not find a plugin to handle the archive. Skipping test.", SkipSingle);
     }
 
-    QTemporaryDir destDir;
-    if (!destDir.isValid()) {
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid()) {
         QSKIP("Could not create a temporary directory for extraction. Skipping test.", SkipSingle);
     }
 
+    // Entries written outside of the destination end up next to it.
+    const QString destPath = tempDir.path() + QStringLiteral("/destination");
+    QVERIFY(QDir(tempDir.path()).mkdir(QStringLiteral("destination")));
+
     QFETCH(QVector<Archive::Entry*>, entriesToExtract);
     QFETCH(ExtractionOptions, extractionOptions);
-    auto extractionJob = archive->extractFiles(entriesToExtract, destDir.path(), extractionOptions);
+    auto extractionJob = archive->extractFiles(entriesToExtract, destPath, extractionOptions);
     QVERIFY(extractionJob);
     extractionJob->setAutoDelete(false);
 
@@ -428,17 +516,283 @@ void ExtractTest::testExtraction()
     QFETCH(int, expectedExtractedEntriesCount);
     int extractedEntriesCount = 0;
 
-    QDirIterator dirIt(destDir.path(), QDir::AllEntries | QDir::Hidden | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+    QDirIterator dirIt(destPath, QDir::AllEntries | QDir::Hidden | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
     while (dirIt.hasNext()) {
         extractedEntriesCount++;
         dirIt.next();
     }
 
     QCOMPARE(extractedEntriesCount, expectedExtractedEntriesCount);
+    QCOMPARE(QDir(tempDir.path()).entryList(QDir::AllEntries | QDir::Hidden | QDir::NoDotAndDotDot),
+             QStringList {QStringLiteral("destination")});
+
+    loadJob->deleteLater();
+    extractionJob->deleteLater();
+    archive->deleteLater();
+}
+
+void ExtractTest::testExtractStoredData()
+{
+    // The data of big files in uncompressed tar archives is copied straight
+    // from the archive file, unless the system doesn't support it.
+    QTemporaryDir sourceDir;
+    QTemporaryDir destDir;
+    if (!sourceDir.isValid() || !destDir.isValid()) {
+        QSKIP("Could not create temporary directories. Skipping test.", SkipSingle);
+    }
+
+    const QByteArray data = randomData(3 * 1024 * 1024 + 123);
+
+    QFile sourceFile(sourceDir.path() + QLatin1String("/big.bin"));
+    QVERIFY(sourceFile.open(QIODevice::WriteOnly));
+    QCOMPARE(sourceFile.write(data), qint64(data.size()));
+    sourceFile.close();
+
+    const QString archivePath = sourceDir.path() + QLatin1String("/stored.tar");
+    if (!createArchive(archivePath, QStringLiteral("application/x-tar"), sourceDir.path(),
+                       {new Archive::Entry(this, QStringLiteral("big.bin"))})) {
+        QSKIP("Could not find a plugin to handle the archive. Skipping test.", SkipSingle);
+    }
+
+    QVERIFY(extractAll(archivePath, destDir.path()));
+
+    QFile extractedFile(destDir.path() + QLatin1String("/big.bin"));
+    QVERIFY(extractedFile.open(QIODevice::ReadOnly));
+    QVERIFY(extractedFile.readAll() == data);
+}
+
+void ExtractTest::testExtractSmallFiles()
+{
+    // Small files may be written in batches, more than one batch here.
+    QTemporaryDir sourceDir;
+    QTemporaryDir destDir;
+    if (!sourceDir.isValid() || !destDir.isValid()) {
+        QSKIP("Could not create temporary directories. Skipping test.", SkipSingle);
+    }
+
+    const int fileCount = 150;
+    const time_t modificationTime = 1000000000;
+    QVERIFY(QDir(sourceDir.path()).mkdir(QStringLiteral("files")));
+    for (int i = 0; i < fileCount; ++i) {
+        QFile sourceFile(sourceDir.path() + QStringLiteral("/files/file%1.txt").arg(i));
+        QVERIFY(sourceFile.open(QIODevice::WriteOnly));
+        sourceFile.write(QByteArray::number(i).repeated(i));
+        sourceFile.close();
+        if (i == 1) {
+            QVERIFY(sourceFile.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner));
+        }
+
+        struct utimbuf times;
+        times.actime = modificationTime;
+        times.modtime = modificationTime;
+        QCOMPARE(utime(QFile::encodeName(sourceFile.fileName()).constData(), &times), 0);
+    }
+
+    const QString archivePath = sourceDir.path() + QLatin1String("/small.tar.gz");
+    if (!createArchive(archivePath, QStringLiteral("application/x-compressed-tar"), sourceDir.path(),
+                       {new Archive::Entry(this, QStringLiteral("files/"))})) {
+        QSKIP("Could not find a plugin to handle the archive. Skipping test.", SkipSingle);
+    }
+
+    QVERIFY(extractAll(archivePath, destDir.path()));
+
+    for (int i = 0; i < fileCount; ++i) {
+        QFile extractedFile(destDir.path() + QStringLiteral("/files/file%1.txt").arg(i));
+        QVERIFY(extractedFile.open(QIODevice::ReadOnly));
+        QCOMPARE(extractedFile.readAll(), QByteArray::number(i).repeated(i));
+        QCOMPARE(QFileInfo(extractedFile).lastModified().toTime_t(), uint(modificationTime));
+    }
 
+    const QFile::Permissions permissions = QFile::permissions(destDir.path() + QLatin1String("/files/file1.txt"));
+    QVERIFY(!(permissions & (QFileDevice::ReadGroup | QFileDevice::ReadOther)));
+}
+
+void ExtractTest::testTestArchive_data()
+{
+    QTest::addColumn<QString>("archivePath");
+    QTest::addColumn<bool>("corruptTrailer");
+    QTest::addColumn<bool>("expectedTestSuccess");
+
+    QTest::newRow("simplearchive.tar.gz")
+            << QFINDTESTDATA("data/simplearchive.tar.gz")
+            << false
+            << true;
+
+    QTest::newRow("simplearchive.tar.bz2")
+            << QFINDTESTDATA("data/simplearchive.tar.bz2")
+            << false
+            << true;
+
+    QTest::newRow("simplearchive.tar.xz")
+            << QFINDTESTDATA("data/simplearchive.tar.xz")
+            << false
+            << true;
+
+    QTest::newRow("simplearchive.tar.gz, wrong CRC")
+            << QFINDTESTDATA("data/simplearchive.tar.gz")
+            << true
+            << false;
+
+    // Plain compressed files are tested by the singlefile plugins.
+    QTest::newRow("textfile1.txt.gz")
+            << QFINDTESTDATA("data/textfile1.txt.gz")
+            << false
+            << true;
+
+    QTest::newRow("textfile1.txt.xz")
+            << QFINDTESTDATA("data/textfile1.txt.xz")
+            << false
+            << true;
+
+    QTest::newRow("textfile1.txt.gz, wrong CRC")
+            << QFINDTESTDATA("data/textfile1.txt.gz")
+            << true
+            << false;
+}
+
+void ExtractTest::testTestArchive()
+{
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid()) {
+        QSKIP("Could not create a temporary directory. Skipping test.", SkipSingle);
+    }
+
+    QFETCH(QString, archivePath);
+    const QString copyPath = tempDir.path() + QLatin1Char('/') + QFileInfo(archivePath).fileName();
+    QVERIFY(QFile::copy(archivePath, copyPath));
+
+    // The gzip trailer (CRC-32 and size) comes after the end of the tar
+    // archive, so only a test reading up to the end of the file notices.
+    QFETCH(bool, corruptTrailer);
+    if (corruptTrailer) {
+        QFile copy(copyPath);
+        QVERIFY(copy.open(QIODevice::ReadWrite));
+        QVERIFY(copy.seek(copy.size() - 8));
+        const char crcByte = copy.peek(1).at(0);
+        QCOMPARE(copy.write(QByteArray(1, ~crcByte)), qint64(1));
+        copy.close();
+    }
+
+    Archive *archive = loadArchive(copyPath);
+    if (!archive) {
+        QSKIP("Could not find a plugin to handle the archive. Skipping test.", SkipSingle);
+    }
+
+    auto testJob = archive->testArchive();
+    QVERIFY(testJob);
+    testJob->setAutoDelete(false);
+
+    TestHelper::startAndWaitForResult(testJob);
+
+    QFETCH(bool, expectedTestSuccess);
+    QCOMPARE(testJob->testSucceeded(), expectedTestSuccess);
+
+    testJob->deleteLater();
+    archive->deleteLater();
+}
+
+void ExtractTest::testEntryDevice()
+{
+    // More data than the device decompresses ahead of the reader.
+    QTemporaryDir sourceDir;
+    if (!sourceDir.isValid()) {
+        QSKIP("Could not create a temporary directory. Skipping test.", SkipSingle);
+    }
+
+    const QByteArray data = randomData(3 * 1024 * 1024 + 123);
+    QFile sourceFile(sourceDir.path() + QLatin1String("/big.bin"));
+    QVERIFY(sourceFile.open(QIODevice::WriteOnly));
+    QCOMPARE(sourceFile.write(data), qint64(data.size()));
+    sourceFile.close();
+
+    const QString archivePath = sourceDir.path() + QLatin1String("/streamed.tar.gz");
+    if (!createArchive(archivePath, QStringLiteral("application/x-compressed-tar"), sourceDir.path(),
+                       {new Archive::Entry(this, QStringLiteral("big.bin"))})) {
+        QSKIP("Could not find a plugin to handle the archive. Skipping test.", SkipSingle);
+    }
+
+    Archive *archive = loadArchive(archivePath);
+    QVERIFY(archive);
+
+    Archive::Entry entry(Q_NULLPTR, QStringLiteral("big.bin"));
+    QIODevice *device = archive->entryDevice(&entry);
+    if (!device) {
+        archive->deleteLater();
+        QSKIP("The plugin can't stream entries. Skipping test.", SkipSingle);
+    }
+
+    // Read up to the end, asking atEnd() as the viewer does.
+    QByteArray streamed;
+    while (!device->atEnd()) {
+        if (device->bytesAvailable() == 0) {
+            device->waitForReadyRead(1000);
+        }
+        streamed += device->readAll();
+    }
+
+    QCOMPARE(streamed.size(), data.size());
+    QVERIFY(streamed == data);
+    delete device;
+
+    // The streamed entry has been stored in the preview cache.
+    device = archive->entryDevice(&entry);
+    QVERIFY(device);
+    QVERIFY(qobject_cast<QBuffer*>(device));
+    QVERIFY(device->readAll() == data);
+
+    delete device;
+    archive->deleteLater();
+}
+
+bool ExtractTest::createArchive(const QString &archivePath, const QString &mimeType, const QString &workDir, const QVector<Archive::Entry*> &entries)
+{
+    Archive *archive = Archive::createEmpty(archivePath, mimeType, this);
+    if (!archive || !archive->isValid()) {
+        delete archive;
+        return false;
+    }
+
+    CompressionOptions compressionOptions;
+    compressionOptions.setGlobalWorkDir(workDir);
+    AddJob *addJob = archive->addFiles(entries, Q_NULLPTR, compressionOptions);
+    TestHelper::startAndWaitForResult(addJob);
+
+    archive->deleteLater();
+    return true;
+}
+
+Archive *ExtractTest::loadArchive(const QString &archivePath)
+{
+    auto loadJob = Archive::load(archivePath, this);
+    loadJob->setAutoDelete(false);
+    TestHelper::startAndWaitForResult(loadJob);
+
+    Archive *archive = loadJob->archive();
     loadJob->deleteLater();
+
+    if (archive && !archive->isValid()) {
+        archive->deleteLater();
+        return Q_NULLPTR;
+    }
+
+    return archive;
+}
+
+bool ExtractTest::extractAll(const QString &archivePath, const QString &destinationDir)
+{
+    Archive *archive = loadArchive(archivePath);
+    if (!archive) {
+        return false;
+    }
+
+    auto extractionJob = archive->extractFiles(QVector<Archive::Entry*>(), destinationDir);
+    extractionJob->setAutoDelete(false);
+    TestHelper::startAndWaitForResult(extractionJob);
+    const bool isSuccessful = (extractionJob->error() == KJob::NoError);
+
     extractionJob->deleteLater();
     archive->deleteLater();
+    return isSuccessful;
 }
 
 #include "extracttest.moc"
@@ -0,0 +1,134 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "filemanifest.h"
+
+#include <algorithm>
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+using namespace Kerfuffle;
+
+class FileManifestTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+
+    void testScan();
+    void testSkipSpecialFiles();
+};
+
+QTEST_GUILESS_MAIN(FileManifestTest)
+
+static void createFile(const QString &path, int size)
+{
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QCOMPARE(file.write(QByteArray(size, 'a')), qint64(size));
+}
+
+void FileManifestTest::testScan()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+
+    const QDir dir(tempDir.path());
+    QVERIFY(dir.mkpath(QStringLiteral("root/dir1/dir2")));
+    QVERIFY(dir.mkpath(QStringLiteral("root/dir3")));
+    createFile(dir.filePath(QStringLiteral("root/a.txt")), 10);
+    createFile(dir.filePath(QStringLiteral("root/dir1/b.txt")), 20);
+    createFile(dir.filePath(QStringLiteral("root/dir1/dir2/c.txt")), 30);
+    createFile(dir.filePath(QStringLiteral("root/dir3/d.txt")), 40);
+    createFile(dir.filePath(QStringLiteral("e.txt")), 50);
+
+    const QString rootPath = dir.filePath(QStringLiteral("root/"));
+    const QString filePath = dir.filePath(QStringLiteral("e.txt"));
+    const FileManifest manifest = FileManifest::scan({rootPath, filePath});
+
+    QCOMPARE(manifest.count(), 9);
+    QCOMPARE(manifest.totalSize(), qint64(150));
+
+    const QVector<FileManifest::Item> items = manifest.items();
+    QStringList paths;
+    foreach (const FileManifest::Item &item, items) {
+        paths << item.path;
+        QCOMPARE(item.isDir, item.path.endsWith(QLatin1Char('/')));
+    }
+
+    // The scanned paths are kept as they are, in their order.
+    QCOMPARE(paths.first(), rootPath);
+    QCOMPARE(paths.last(), filePath);
+
+    // Each folder is followed by its contents.
+    for (int i = 0; i < paths.size(); ++i) {
+        const QString &path = paths.at(i);
+        if (!path.endsWith(QLatin1Char('/')) || path == rootPath) {
+            continue;
+        }
+        const int contentsCount = std::count_if(paths.constBegin(), paths.constEnd(), [&](const QString &other) {
+            return other != path && other.startsWith(path);
+        });
+        QVERIFY(contentsCount > 0);
+        for (int j = i + 1; j <= i + contentsCount; ++j) {
+            QVERIFY2(paths.at(j).startsWith(path), qPrintable(paths.at(j)));
+        }
+    }
+
+    QVERIFY(paths.contains(rootPath + QStringLiteral("dir1/dir2/c.txt")));
+}
+
+void FileManifestTest::testSkipSpecialFiles()
+{
+#ifdef Q_OS_UNIX
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+
+    const QDir dir(tempDir.path());
+    QVERIFY(dir.mkpath(QStringLiteral("root")));
+    createFile(dir.filePath(QStringLiteral("root/a.txt")), 10);
+    QVERIFY(QFile::link(QStringLiteral("missing.txt"), dir.filePath(QStringLiteral("root/link"))));
+    QCOMPARE(mkfifo(QFile::encodeName(dir.filePath(QStringLiteral("root/fifo"))).constData(), 0600), 0);
+
+    const QString rootPath = dir.filePath(QStringLiteral("root/"));
+    const FileManifest manifest = FileManifest::scan({rootPath});
+
+    // Reading a FIFO would block, while symlinks are archived as such.
+    QStringList paths;
+    foreach (const FileManifest::Item &item, manifest.items()) {
+        paths << item.path;
+    }
+    paths.sort();
+    QCOMPARE(paths, QStringList({rootPath, rootPath + QStringLiteral("a.txt"), rootPath + QStringLiteral("link")}));
+#else
+    QSKIP("FIFOs are only created on Unix.", SkipSingle);
+#endif
+}
+
+#include "filemanifesttest.moc"
@@ -26,11 +26,13 @@
 
 #include "jsonarchiveinterface.h"
 #include "jobs.h"
+#include "previewcache.h"
 
 #include <KPluginMetaData>
 
 #include <QDebug>
 #include <QEventLoop>
+#include <QFile>
 #include <QTest>
 
 using namespace Kerfuffle;
@@ -53,7 +55,10 @@ private Q_SLOTS:
 
     // ExtractJob-related tests
     void testExtractJobAccessors();
+    void testExtractJobFreeSpace();
     void testTempExtractJob();
+    void testMultipleTempExtractJob();
+    void testPreviewCache();
 
     // DeleteJob-related tests
     void testRemoveEntries_data();
@@ -247,6 +252,33 @@ void JobsTest::testExtractJobAccessors()
     delete job;
 }
 
+void JobsTest::testExtractJobFreeSpace()
+{
+    QTemporaryDir destination;
+    QVERIFY(destination.isValid());
+
+    JSONArchiveInterface *iface = createArchiveInterface(QFINDTESTDATA("data/archive001.json"));
+
+    ExtractionOptions options;
+    options.setPreallocateFiles(true);
+
+    // No file system has that much free space.
+    ExtractJob *job = new ExtractJob(QVector<Archive::Entry*>(), destination.path(), options, iface);
+    job->setUnpackedSize(Q_UINT64_C(1) << 62);
+    job->setAutoDelete(false);
+    startAndWaitForResult(job);
+    QVERIFY(job->error() != KJob::NoError);
+    delete job;
+
+    // Without listing the archive, as in batch extractions, the size is
+    // unknown and left to the preallocation of each file.
+    job = new ExtractJob(QVector<Archive::Entry*>(), destination.path(), options, iface);
+    job->setAutoDelete(false);
+    startAndWaitForResult(job);
+    QCOMPARE(job->error(), int(KJob::NoError));
+    delete job;
+}
+
 void JobsTest::testTempExtractJob()
 {
     JSONArchiveInterface *iface = createArchiveInterface(QFINDTESTDATA("data/archive-malicious.json"));
@@ -269,6 +301,59 @@ void JobsTest::testTempExtractJob()
     delete job;
 }
 
+void JobsTest::testMultipleTempExtractJob()
+{
+    JSONArchiveInterface *iface = createArchiveInterface(QFINDTESTDATA("data/archive-malicious.json"));
+    OpenJob *job = new OpenJob({new Archive::Entry(this, QStringLiteral("anotherDir/../../file.txt")),
+                                new Archive::Entry(this, QStringLiteral("a.txt"))}, false, iface);
+
+    const QString tempDirPath = job->tempDir()->path();
+    QCOMPARE(job->validatedFilePaths().size(), 2);
+    QCOMPARE(job->validatedFilePath(), job->validatedFilePaths().at(0));
+    QVERIFY(job->validatedFilePaths().at(0).endsWith(QLatin1String("anotherDir/file.txt")));
+    QCOMPARE(job->validatedFilePaths().at(1), tempDirPath + QLatin1String("/a.txt"));
+
+    job->setAutoDelete(false);
+    startAndWaitForResult(job);
+
+    delete job->tempDir();
+    QVERIFY(!QFileInfo::exists(tempDirPath));
+
+    delete job;
+}
+
+void JobsTest::testPreviewCache()
+{
+    JSONArchiveInterface *iface = createArchiveInterface(QFINDTESTDATA("data/archive001.json"));
+    Archive::Entry *cachedEntry = new Archive::Entry(this, QStringLiteral("a.txt"));
+    Archive::Entry *uncachedEntry = new Archive::Entry(this, QStringLiteral("b.txt"));
+    const QByteArray data("cached data");
+
+    QTemporaryDir extractedDir;
+    const QString extractedPath = extractedDir.path() + QLatin1String("/a.txt");
+    QFile extractedFile(extractedPath);
+    QVERIFY(extractedFile.open(QIODevice::WriteOnly));
+    extractedFile.write(data);
+    extractedFile.close();
+
+    PreviewCache cache;
+    cache.insert(iface->filename(), cachedEntry, extractedPath);
+
+    // The JSON interface doesn't extract anything, so only the cached entry ends up on disk.
+    PreviewJob *job = new PreviewJob({cachedEntry, uncachedEntry}, false, iface);
+    job->setPreviewCache(&cache);
+    job->setAutoDelete(false);
+    startAndWaitForResult(job);
+
+    QFile restoredFile(job->validatedFilePaths().at(0));
+    QVERIFY(restoredFile.open(QIODevice::ReadOnly));
+    QCOMPARE(restoredFile.readAll(), data);
+    QVERIFY(!QFileInfo::exists(job->validatedFilePaths().at(1)));
+
+    delete job->tempDir();
+    delete job;
+}
+
 void JobsTest::testRemoveEntries_data()
 {
     QTest::addColumn<QString>("jsonArchive");
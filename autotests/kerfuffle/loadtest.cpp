@@ -26,9 +26,11 @@
 
 #include "archive_kerfuffle.h"
 #include "jobs.h"
+#include "pluginmanager.h"
 #include "testhelper.h"
 
 #include <QStandardPaths>
+#include <QTemporaryDir>
 #include <QTest>
 
 using namespace Kerfuffle;
@@ -40,6 +42,8 @@ class LoadTest : public QObject
 private Q_SLOTS:
     void testProperties_data();
     void testProperties();
+    void testNestedArchive();
+    void testNestedArchiveStreamed();
 };
 
 QTEST_GUILESS_MAIN(LoadTest)
@@ -160,6 +164,17 @@ void LoadTest::testProperties_data()
         qDebug() << "lz4 executable not found in path. Skipping lz4 test.";
     }
 
+    // Only run test for zstd-compressed tar if libarchive supports zstd.
+    if (PluginManager().supportedMimeTypes().contains(QStringLiteral("application/x-zstd-compressed-tar"))) {
+        QTest::newRow("zstd-compressed tarball")
+                << QFINDTESTDATA("data/simplearchive.tar.zst")
+                << QStringLiteral("simplearchive")
+                << false << false << false << false << false << 0 << Archive::Unencrypted
+                << QStringLiteral("simplearchive");
+    } else {
+        qDebug() << "zstd-compressed tar not supported. Skipping zstd test.";
+    }
+
     QTest::newRow("xar archive")
             << QFINDTESTDATA("data/simplearchive.xar")
             << QStringLiteral("simplearchive")
@@ -255,4 +270,138 @@ void LoadTest::testProperties()
 }
 
 
+void LoadTest::testNestedArchive()
+{
+    QVector<Archive::Entry*> entries;
+    auto collectEntry = [&entries](Archive::Entry *entry) {
+        entries << entry;
+    };
+
+    auto loadJob = Archive::load(QFINDTESTDATA("data/nested-archive.tar"), this);
+    loadJob->setAutoDelete(false);
+    connect(loadJob, &Job::newEntry, this, collectEntry);
+    TestHelper::startAndWaitForResult(loadJob);
+
+    Archive *container = loadJob->archive();
+    if (!container->isValid()) {
+        QSKIP("Could not find a plugin to handle the archive. Skipping test.", SkipSingle);
+    }
+
+    Archive::Entry *nestedEntry = Q_NULLPTR;
+    foreach (Archive::Entry *entry, entries) {
+        if (entry->fullPath() == QLatin1String("simplearchive.tar.gz")) {
+            nestedEntry = entry;
+        }
+    }
+    QVERIFY(nestedEntry);
+
+    Archive *nestedArchive = Archive::createNested(container, nestedEntry, this);
+    if (!nestedArchive->isValid()) {
+        QSKIP("Could not find a plugin to read nested archives. Skipping test.", SkipSingle);
+    }
+    QVERIFY(nestedArchive->isReadOnly());
+    QCOMPARE(nestedArchive->packedSize(), nestedEntry->size());
+
+    entries.clear();
+    auto nestedLoadJob = new LoadJob(nestedArchive);
+    nestedLoadJob->setAutoDelete(false);
+    connect(nestedLoadJob, &Job::newEntry, this, collectEntry);
+    TestHelper::startAndWaitForResult(nestedLoadJob);
+    QVERIFY(!nestedLoadJob->error());
+
+    QStringList nestedPaths;
+    foreach (const Archive::Entry *entry, entries) {
+        nestedPaths << entry->fullPath();
+    }
+    nestedPaths.sort();
+    QCOMPARE(nestedPaths, QStringList({QStringLiteral("a.txt"),
+                                       QStringLiteral("aDir/"),
+                                       QStringLiteral("aDir/b.txt"),
+                                       QStringLiteral("c.txt")}));
+
+    delete nestedLoadJob;
+    delete nestedArchive;
+    delete loadJob;
+    delete container;
+}
+
+void LoadTest::testNestedArchiveStreamed()
+{
+    // The nested archive is much bigger than what the container's entry
+    // device decompresses ahead, so it is read in many rounds and the
+    // decompression often finishes while the reader waits for data.
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid()) {
+        QSKIP("Could not create a temporary directory. Skipping test.", SkipSingle);
+    }
+
+    QByteArray data(3 * 1024 * 1024, Qt::Uninitialized);
+    quint32 state = 2463534242u;
+    for (int i = 0; i < data.size(); ++i) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        data[i] = static_cast<char>(state >> 24);
+    }
+    QFile sourceFile(tempDir.path() + QLatin1String("/big.bin"));
+    QVERIFY(sourceFile.open(QIODevice::WriteOnly));
+    QCOMPARE(sourceFile.write(data), qint64(data.size()));
+    sourceFile.close();
+
+    CompressionOptions compressionOptions;
+    compressionOptions.setGlobalWorkDir(tempDir.path());
+
+    const QString nestedPath = tempDir.path() + QLatin1String("/nested.tar.gz");
+    Archive *nested = Archive::createEmpty(nestedPath, QStringLiteral("application/x-compressed-tar"), this);
+    QVERIFY(nested);
+    if (!nested->isValid()) {
+        QSKIP("Could not find a plugin to handle the archive. Skipping test.", SkipSingle);
+    }
+    TestHelper::startAndWaitForResult(nested->addFiles({new Archive::Entry(this, QStringLiteral("big.bin"))}, Q_NULLPTR, compressionOptions));
+    delete nested;
+
+    const QString containerPath = tempDir.path() + QLatin1String("/container.tar");
+    Archive *container = Archive::createEmpty(containerPath, QStringLiteral("application/x-tar"), this);
+    QVERIFY(container && container->isValid());
+    TestHelper::startAndWaitForResult(container->addFiles({new Archive::Entry(this, QStringLiteral("nested.tar.gz"))}, Q_NULLPTR, compressionOptions));
+    delete container;
+
+    QVector<Archive::Entry*> entries;
+    auto collectEntry = [&entries](Archive::Entry *entry) {
+        entries << entry;
+    };
+
+    auto loadJob = Archive::load(containerPath, this);
+    loadJob->setAutoDelete(false);
+    connect(loadJob, &Job::newEntry, this, collectEntry);
+    TestHelper::startAndWaitForResult(loadJob);
+    container = loadJob->archive();
+    QVERIFY(container->isValid());
+    QCOMPARE(entries.size(), 1);
+    Archive::Entry *nestedEntry = entries.first();
+
+    for (int i = 0; i < 3; ++i) {
+        Archive *nestedArchive = Archive::createNested(container, nestedEntry, this);
+        if (!nestedArchive->isValid()) {
+            QSKIP("Could not find a plugin to read nested archives. Skipping test.", SkipSingle);
+        }
+
+        entries.clear();
+        auto nestedLoadJob = new LoadJob(nestedArchive);
+        nestedLoadJob->setAutoDelete(false);
+        connect(nestedLoadJob, &Job::newEntry, this, collectEntry);
+        TestHelper::startAndWaitForResult(nestedLoadJob);
+        QVERIFY(!nestedLoadJob->error());
+        QCOMPARE(entries.size(), 1);
+        QCOMPARE(entries.first()->fullPath(), QStringLiteral("big.bin"));
+        QCOMPARE(entries.first()->size(), qulonglong(data.size()));
+
+        delete nestedLoadJob;
+        delete nestedArchive;
+    }
+
+    delete loadJob;
+    delete container;
+}
+
 #include "loadtest.moc"
@@ -29,6 +29,7 @@
 #include "jobs.h"
 #include "testhelper.h"
 
+#include <QDateTime>
 #include <QFile>
 #include <QSignalSpy>
 #include <QTest>
@@ -238,6 +239,77 @@ void Cli7zTest::testList()
     plugin->deleteLater();
 }
 
+void Cli7zTest::testListTimestamps_data()
+{
+    QTest::addColumn<QString>("modified");
+    // Invalid if the timestamp is rejected.
+    QTest::addColumn<QDateTime>("expectedTimestamp");
+    QTest::addColumn<int>("expectedNsecs");
+
+    // 7z prints local times.
+    QTest::newRow("winter") << QStringLiteral("2016-01-17 11:26:19")
+                            << QDateTime(QDate(2016, 1, 17), QTime(11, 26, 19)) << 0;
+    QTest::newRow("summer") << QStringLiteral("2016-07-17 11:26:19")
+                            << QDateTime(QDate(2016, 7, 17), QTime(11, 26, 19)) << 0;
+    QTest::newRow("leap day") << QStringLiteral("2016-02-29 00:00:00")
+                              << QDateTime(QDate(2016, 2, 29), QTime(0, 0, 0)) << 0;
+    QTest::newRow("fractional seconds") << QStringLiteral("2021-03-04 05:06:07.1234567")
+                                        << QDateTime(QDate(2021, 3, 4), QTime(5, 6, 7, 123)) << 123456700;
+    QTest::newRow("invalid date") << QStringLiteral("2015-02-29 00:00:00") << QDateTime() << 0;
+    QTest::newRow("invalid time") << QStringLiteral("2015-02-28 24:00:00") << QDateTime() << 0;
+    QTest::newRow("too short") << QStringLiteral("2015-02-28") << QDateTime() << 0;
+}
+
+void Cli7zTest::testListTimestamps()
+{
+    qRegisterMetaType<Archive::Entry*>("Archive::Entry*");
+    CliPlugin *plugin = new CliPlugin(this, {QStringLiteral("dummy.7z"),
+                                             QVariant::fromValue(m_plugin->metaData())});
+    QSignalSpy signalSpyEntry(plugin, &CliPlugin::entry);
+
+    // The listing header, up to the first entry.
+    QFile outputText(QFINDTESTDATA("data/archive-with-symlink-1602.txt"));
+    QVERIFY(outputText.open(QIODevice::ReadOnly));
+    QTextStream outputStream(&outputText);
+    forever {
+        QVERIFY(!outputStream.atEnd());
+        const QString line(outputStream.readLine());
+        QVERIFY(plugin->readListLine(line));
+        if (line == QLatin1String("----------")) {
+            break;
+        }
+    }
+
+    QFETCH(QString, modified);
+    const QStringList lines = {
+        QStringLiteral("Path = file.txt"),
+        QStringLiteral("Size = 32"),
+        QStringLiteral("Packed Size = 0"),
+        QStringLiteral("Modified = ") + modified,
+        QStringLiteral("Attributes = A_ -rw-r--r--"),
+        QStringLiteral("CRC = 9DE1D9C4"),
+        QStringLiteral("Encrypted = -"),
+        QStringLiteral("Method = LZMA2:12"),
+        QStringLiteral("Block = 0")
+    };
+    foreach (const QString &line, lines) {
+        QVERIFY(plugin->readListLine(line));
+    }
+
+    QCOMPARE(signalSpyEntry.count(), 1);
+    Archive::Entry *entry = signalSpyEntry.at(0).at(0).value<Archive::Entry*>();
+
+    QFETCH(QDateTime, expectedTimestamp);
+    QCOMPARE(entry->hasTimestamp(), expectedTimestamp.isValid());
+    if (expectedTimestamp.isValid()) {
+        QCOMPARE(entry->timestamp(), expectedTimestamp);
+        QFETCH(int, expectedNsecs);
+        QCOMPARE(entry->timestampNsecs(), expectedNsecs);
+    }
+
+    plugin->deleteLater();
+}
+
 void Cli7zTest::testListArgs_data()
 {
     QTest::addColumn<QString>("archiveName");
@@ -475,3 +547,56 @@ void Cli7zTest::testExtractArgs()
     plugin->deleteLater();
 }
 
+void Cli7zTest::testExtractToStdoutArgs_data()
+{
+    QTest::addColumn<QString>("archiveName");
+    QTest::addColumn<QString>("file");
+    QTest::addColumn<QString>("password");
+    QTest::addColumn<QStringList>("expectedArgs");
+
+    QTest::newRow("encrypted")
+            << QStringLiteral("/tmp/foo.7z")
+            << QStringLiteral("aDir/textfile2.txt")
+            << QStringLiteral("1234")
+            << QStringList {
+                   QStringLiteral("x"),
+                   QStringLiteral("-so"),
+                   QStringLiteral("-p1234"),
+                   QStringLiteral("/tmp/foo.7z"),
+                   QStringLiteral("aDir/textfile2.txt"),
+               };
+
+    QTest::newRow("unencrypted")
+            << QStringLiteral("/tmp/foo.7z")
+            << QStringLiteral("c.txt")
+            << QString()
+            << QStringList {
+                   QStringLiteral("x"),
+                   QStringLiteral("-so"),
+                   QStringLiteral("/tmp/foo.7z"),
+                   QStringLiteral("c.txt"),
+               };
+}
+
+void Cli7zTest::testExtractToStdoutArgs()
+{
+    if (!m_plugin->isValid()) {
+        QSKIP("cli7z plugin not available. Skipping test.", SkipSingle);
+    }
+
+    QFETCH(QString, archiveName);
+    CliPlugin *plugin = new CliPlugin(this, {QVariant(archiveName),
+                                             QVariant::fromValue(m_plugin->metaData())});
+    QVERIFY(plugin);
+
+    QFETCH(QString, file);
+    QFETCH(QString, password);
+
+    const auto replacedArgs = plugin->cliProperties()->extractToStdoutArgs(archiveName, file, password);
+
+    QFETCH(QStringList, expectedArgs);
+    QCOMPARE(replacedArgs, expectedArgs);
+
+    plugin->deleteLater();
+}
+
@@ -40,12 +40,16 @@ private Q_SLOTS:
     void testArchive();
     void testList_data();
     void testList();
+    void testListTimestamps_data();
+    void testListTimestamps();
     void testListArgs_data();
     void testListArgs();
     void testAddArgs_data();
     void testAddArgs();
     void testExtractArgs_data();
     void testExtractArgs();
+    void testExtractToStdoutArgs_data();
+    void testExtractToStdoutArgs();
 
 private:
     PluginManager m_pluginManger;
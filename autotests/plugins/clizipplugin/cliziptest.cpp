@@ -25,7 +25,16 @@
 
 #include "cliziptest.h"
 #include "cliplugin.h"
-
+#include "filemanifest.h"
+#ifdef HAVE_ZLIB
+#include "zipwriter.h"
+#endif
+
+#include <QDir>
+#include <QProcess>
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <QTemporaryDir>
 #include <QTest>
 
 QTEST_GUILESS_MAIN(CliZipTest)
@@ -231,3 +240,101 @@ void CliZipTest::testExtractArgs()
 
     plugin->deleteLater();
 }
+
+void CliZipTest::testZipWriter_data()
+{
+    QTest::addColumn<int>("compressionLevel");
+    QTest::addColumn<QString>("destination");
+
+    QTest::newRow("default level") << -1 << QString();
+    QTest::newRow("stored") << 0 << QString();
+    QTest::newRow("maximum level, into a folder") << 9 << QStringLiteral("sub/");
+}
+
+void CliZipTest::testZipWriter()
+{
+#ifndef HAVE_ZLIB
+    QSKIP("The zip writer is not available. Skipping test.", SkipSingle);
+#else
+    QTemporaryDir sourceDir;
+    QVERIFY(QDir(sourceDir.path()).mkpath(QStringLiteral("dir/empty")));
+
+    QFile textFile(sourceDir.path() + QLatin1String("/dir/text.txt"));
+    QVERIFY(textFile.open(QIODevice::WriteOnly));
+    textFile.write(QByteArray("ark ").repeated(1000));
+    textFile.close();
+
+    QFile emptyFile(sourceDir.path() + QLatin1String("/empty.txt"));
+    QVERIFY(emptyFile.open(QIODevice::WriteOnly));
+    emptyFile.close();
+
+    // Big enough to be compressed into a spill file.
+    QFile bigFile(sourceDir.path() + QLatin1String("/big.bin"));
+    QVERIFY(bigFile.open(QIODevice::WriteOnly));
+    QByteArray block(64 * 1024, Qt::Uninitialized);
+    for (int i = 0; i < 96; ++i) {
+        for (int j = 0; j < block.size(); ++j) {
+            block[j] = static_cast<char>((i * 31 + j * 7) % 251);
+        }
+        bigFile.write(block);
+    }
+    bigFile.close();
+
+    const QString oldWorkingDir = QDir::currentPath();
+    QDir::setCurrent(sourceDir.path());
+    const FileManifest manifest = FileManifest::scan({QStringLiteral("dir/"), QStringLiteral("empty.txt"), QStringLiteral("big.bin")});
+    QDir::setCurrent(oldWorkingDir);
+    QCOMPARE(manifest.count(), 5);
+
+    QFETCH(int, compressionLevel);
+    QFETCH(QString, destination);
+
+    // The archive must not depend on the scheduling of the compressors.
+    QTemporaryDir archiveDir;
+    QByteArray previousArchive;
+    for (int i = 0; i < 2; ++i) {
+        const QString archiveName = archiveDir.path() + QStringLiteral("/test%1.zip").arg(i);
+
+        QDir::setCurrent(sourceDir.path());
+        ZipWriter writer(archiveName, manifest.items(), destination);
+        QDir::setCurrent(oldWorkingDir);
+
+        writer.setCompressionLevel(compressionLevel);
+        QSignalSpy spy(&writer, &ZipWriter::finished);
+        writer.start();
+        QVERIFY(spy.wait());
+        QVERIFY(spy.at(0).at(0).toBool());
+
+        QFile archive(archiveName);
+        QVERIFY(archive.open(QIODevice::ReadOnly));
+        const QByteArray data = archive.readAll();
+        if (i > 0) {
+            QCOMPARE(data, previousArchive);
+        }
+        previousArchive = data;
+    }
+
+    const QString unzipPath = QStandardPaths::findExecutable(QStringLiteral("unzip"));
+    if (unzipPath.isEmpty()) {
+        QSKIP("unzip executable not found. Skipping the check of the archive.", SkipSingle);
+    }
+
+    const QString archiveName = archiveDir.path() + QLatin1String("/test0.zip");
+
+    QProcess test;
+    test.start(unzipPath, {QStringLiteral("-tq"), archiveName});
+    QVERIFY(test.waitForFinished());
+    QCOMPARE(test.exitCode(), 0);
+
+    QProcess list;
+    list.start(unzipPath, {QStringLiteral("-Z1"), archiveName});
+    QVERIFY(list.waitForFinished());
+    QStringList entries = QString::fromUtf8(list.readAllStandardOutput()).split(QLatin1Char('\n'), QString::SkipEmptyParts);
+    entries.sort();
+    QCOMPARE(entries, QStringList({destination + QLatin1String("big.bin"),
+                                   destination + QLatin1String("dir/"),
+                                   destination + QLatin1String("dir/empty/"),
+                                   destination + QLatin1String("dir/text.txt"),
+                                   destination + QLatin1String("empty.txt")}));
+#endif
+}
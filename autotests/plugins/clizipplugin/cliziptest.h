@@ -42,6 +42,8 @@ private Q_SLOTS:
     void testAddArgs();
     void testExtractArgs_data();
     void testExtractArgs();
+    void testZipWriter_data();
+    void testZipWriter();
 
 private:
     PluginManager m_pluginManger;
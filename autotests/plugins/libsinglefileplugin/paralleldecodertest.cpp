@@ -0,0 +1,188 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "paralleldecoder.h"
+
+#include <QBuffer>
+#include <QTest>
+
+#include <zlib.h>
+#ifdef HAVE_LIBLZMA
+#include <lzma.h>
+#endif
+
+class ParallelDecoderTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+
+    void testDecode_data();
+    void testDecode();
+    void testVerify_data();
+    void testVerify();
+    void testDecodedSize();
+};
+
+QTEST_GUILESS_MAIN(ParallelDecoderTest)
+
+static QByteArray gzipMember(const QByteArray &data, int level)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, level, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return QByteArray();
+    }
+
+    QByteArray member(static_cast<int>(deflateBound(&stream, data.size())), Qt::Uninitialized);
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.constData()));
+    stream.avail_in = data.size();
+    stream.next_out = reinterpret_cast<Bytef*>(member.data());
+    stream.avail_out = member.size();
+
+    const int ret = deflate(&stream, Z_FINISH);
+    member.resize(member.size() - stream.avail_out);
+    deflateEnd(&stream);
+
+    return (ret == Z_STREAM_END) ? member : QByteArray();
+}
+
+// Splits @p data into members of @p memberSize bytes.
+static QByteArray gzipMembers(const QByteArray &data, int memberSize, int level)
+{
+    QByteArray file;
+    for (int offset = 0; offset < data.size(); offset += memberSize) {
+        file += gzipMember(data.mid(offset, memberSize), level);
+    }
+    return file;
+}
+
+#ifdef HAVE_LIBLZMA
+static QByteArray xzStream(const QByteArray &data)
+{
+    QByteArray stream(static_cast<int>(lzma_stream_buffer_bound(data.size())), Qt::Uninitialized);
+    size_t size = 0;
+    if (lzma_easy_buffer_encode(LZMA_PRESET_DEFAULT, LZMA_CHECK_CRC64, Q_NULLPTR,
+                                reinterpret_cast<const uint8_t*>(data.constData()), data.size(),
+                                reinterpret_cast<uint8_t*>(stream.data()), &size, stream.size()) != LZMA_OK) {
+        return QByteArray();
+    }
+    stream.resize(static_cast<int>(size));
+    return stream;
+}
+#endif
+
+void ParallelDecoderTest::testDecode_data()
+{
+    QTest::addColumn<QByteArray>("compressed");
+    QTest::addColumn<bool>("expectedSuccess");
+    QTest::addColumn<QByteArray>("expectedData");
+
+    const QByteArray text = QByteArray("Lorem ipsum dolor sit amet, consectetur adipiscing elit. ").repeated(1000);
+
+    // A xorshift generator, so that the data is the same on every run.
+    QByteArray random(12 * 1024 * 1024, Qt::Uninitialized);
+    quint32 state = 2463534242u;
+    for (int i = 0; i < random.size(); ++i) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        random[i] = static_cast<char>(state >> 24);
+    }
+
+    // Stored deflate blocks contain the data verbatim, so the gzip signature
+    // shows up inside the members.
+    const QByteArray signatures = QByteArray("\x1f\x8b\x08\x00", 4).append(random.left(60)).repeated(200000);
+
+    const QByteArray members = gzipMembers(random, 1024 * 1024, Z_NO_COMPRESSION);
+
+    QTest::newRow("single member") << gzipMember(text, Z_DEFAULT_COMPRESSION) << true << text;
+    QTest::newRow("several members") << members << true << random;
+    QTest::newRow("signatures inside members")
+        << gzipMembers(signatures, 3 * 1024 * 1024, Z_NO_COMPRESSION) << true << signatures;
+    QTest::newRow("trailing garbage") << QByteArray(members).append("garbage") << true << random;
+    QTest::newRow("truncated") << members.left(members.size() - 100) << false << QByteArray();
+
+    // The CRC-32 of the last member comes just before its 4 bytes of size.
+    QByteArray wrongCrc = members;
+    wrongCrc[wrongCrc.size() - 8] = static_cast<char>(~wrongCrc.at(wrongCrc.size() - 8));
+    QTest::newRow("wrong CRC") << wrongCrc << false << QByteArray();
+}
+
+void ParallelDecoderTest::testDecode()
+{
+    QFETCH(QByteArray, compressed);
+    QFETCH(bool, expectedSuccess);
+    QFETCH(QByteArray, expectedData);
+
+    ParallelDecoder decoder(reinterpret_cast<const uchar*>(compressed.constData()), compressed.size());
+    QVERIFY(decoder.isSupported());
+
+    QBuffer output;
+    QVERIFY(output.open(QIODevice::WriteOnly));
+
+    QCOMPARE(decoder.decode(&output), expectedSuccess);
+    if (expectedSuccess) {
+        QCOMPARE(output.data().size(), expectedData.size());
+        QVERIFY(output.data() == expectedData);
+    }
+}
+
+void ParallelDecoderTest::testVerify_data()
+{
+    testDecode_data();
+}
+
+void ParallelDecoderTest::testVerify()
+{
+    QFETCH(QByteArray, compressed);
+    QFETCH(bool, expectedSuccess);
+
+    ParallelDecoder decoder(reinterpret_cast<const uchar*>(compressed.constData()), compressed.size());
+    QVERIFY(decoder.isSupported());
+
+    QCOMPARE(decoder.verify(), expectedSuccess);
+}
+
+void ParallelDecoderTest::testDecodedSize()
+{
+    const QByteArray text = QByteArray("Lorem ipsum dolor sit amet, consectetur adipiscing elit. ").repeated(1000);
+
+    // gzip doesn't record the size.
+    const QByteArray gzip = gzipMember(text, Z_DEFAULT_COMPRESSION);
+    ParallelDecoder gzipDecoder(reinterpret_cast<const uchar*>(gzip.constData()), gzip.size());
+    QCOMPARE(gzipDecoder.decodedSize(), qint64(-1));
+
+#ifdef HAVE_LIBLZMA
+    // Two streams with stream padding between them.
+    const QByteArray xz = xzStream(text) + QByteArray(8, '\0') + xzStream(text.left(100));
+    ParallelDecoder xzDecoder(reinterpret_cast<const uchar*>(xz.constData()), xz.size());
+    QVERIFY(xzDecoder.isSupported());
+    QCOMPARE(xzDecoder.decodedSize(), qint64(text.size() + 100));
+
+    ParallelDecoder truncatedDecoder(reinterpret_cast<const uchar*>(xz.constData()), xz.size() - 1);
+    QCOMPARE(truncatedDecoder.decodedSize(), qint64(-1));
+#endif
+}
+
+#include "paralleldecodertest.moc"
@@ -0,0 +1,135 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "paralleldecoder.h"
+#include "parallelencoder.h"
+
+#include <QBuffer>
+#include <QTest>
+
+#include <zlib.h>
+
+class ParallelEncoderTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+
+    void testGzip_data();
+    void testGzip();
+};
+
+QTEST_GUILESS_MAIN(ParallelEncoderTest)
+
+// Decodes @p data with zlib alone, which requires a single gzip member.
+static QByteArray gunzip(const QByteArray &data)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) {
+        return QByteArray();
+    }
+
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.constData()));
+    stream.avail_in = data.size();
+
+    QByteArray result;
+    QByteArray buffer(64 * 1024, Qt::Uninitialized);
+    int ret;
+    do {
+        stream.next_out = reinterpret_cast<Bytef*>(buffer.data());
+        stream.avail_out = buffer.size();
+        ret = inflate(&stream, Z_NO_FLUSH);
+        result.append(buffer.constData(), buffer.size() - stream.avail_out);
+    } while (ret == Z_OK);
+
+    const bool isComplete = (ret == Z_STREAM_END && stream.avail_in == 0);
+    inflateEnd(&stream);
+
+    return isComplete ? result : QByteArray("invalid");
+}
+
+void ParallelEncoderTest::testGzip_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<int>("compressionLevel");
+    QTest::addColumn<int>("threadCount");
+
+    const QByteArray text = QByteArray("Lorem ipsum dolor sit amet, consectetur adipiscing elit. ").repeated(50000);
+
+    // A xorshift generator, so that the data is the same on every run.
+    QByteArray random(3 * 1024 * 1024 + 17, Qt::Uninitialized);
+    quint32 state = 2463534242u;
+    for (int i = 0; i < random.size(); ++i) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        random[i] = static_cast<char>(state >> 24);
+    }
+
+    QTest::newRow("empty") << QByteArray() << -1 << 4;
+    QTest::newRow("short text") << QByteArray("Hello world") << -1 << 4;
+    QTest::newRow("text, one thread") << text << -1 << 1;
+    QTest::newRow("text, four threads") << text << -1 << 4;
+    QTest::newRow("text, fastest") << text << 1 << 4;
+    QTest::newRow("text, best") << text << 9 << 4;
+    QTest::newRow("random data") << random << -1 << 4;
+}
+
+void ParallelEncoderTest::testGzip()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(int, compressionLevel);
+    QFETCH(int, threadCount);
+
+    QBuffer input(&data);
+    QVERIFY(input.open(QIODevice::ReadOnly));
+
+    QBuffer output;
+    QVERIFY(output.open(QIODevice::WriteOnly));
+
+    ParallelEncoder encoder(ParallelEncoder::Gzip);
+    encoder.setCompressionLevel(compressionLevel);
+    encoder.setThreadCount(threadCount);
+    encoder.setFileName(QStringLiteral("file.txt"));
+    QVERIFY(encoder.encode(&input, &output));
+
+    const QByteArray compressed = output.data();
+
+    // The original name is stored in the header.
+    QVERIFY(compressed.size() > 10);
+    QCOMPARE(static_cast<int>(compressed.at(3)), 0x08);
+    QCOMPARE(compressed.mid(10, 9), QByteArray("file.txt", 9));
+
+    QVERIFY(gunzip(compressed) == data);
+
+    ParallelDecoder decoder(reinterpret_cast<const uchar*>(compressed.constData()), compressed.size());
+    QVERIFY(decoder.isSupported());
+
+    QBuffer decoded;
+    QVERIFY(decoded.open(QIODevice::WriteOnly));
+    QVERIFY(decoder.decode(&decoded));
+    QVERIFY(decoded.data() == data);
+}
+
+#include "parallelencodertest.moc"
@@ -110,6 +110,8 @@ bool AddToArchive::showAddDialog()
         m_options.setCompressionMethod(dialog.data()->compressionMethod());
         m_options.setEncryptionMethod(dialog.data()->encryptionMethod());
         m_options.setVolumeSize(dialog.data()->volumeSize());
+        m_options.setThreadCount(dialog.data()->threadCount());
+        m_options.setLongDistanceMatchingEnabled(dialog.data()->isLongDistanceMatchingEnabled());
     }
 
     delete dialog.data();
@@ -32,6 +32,7 @@
 #include "jobs.h"
 #include "mimetypes.h"
 #include "pluginmanager.h"
+#include "previewcache.h"
 
 #include <KLocalizedString>
 #include <KPluginFactory>
@@ -103,10 +104,41 @@ Archive *Archive::create(const QString &fileName, Plugin *plugin, QObject *paren
     return new Archive(iface, !plugin->isReadWrite(), parent);
 }
 
+Archive *Archive::createNested(Archive *container, const Archive::Entry *entry, QObject *parent)
+{
+    Q_ASSERT(container->isValid());
+
+    // The container's data is streamed, so nobody could enter its password.
+    if ((entry->isPasswordProtected() || container->encryptionType() != Unencrypted) && container->password().isEmpty()) {
+        return new Archive(FailedPlugin, parent);
+    }
+
+    const QString fileName = container->fileName() + QLatin1Char('/') + entry->fullPath(NoTrailingSlash);
+    const QMimeType mimeType = QMimeDatabase().mimeTypeForFile(entry->name(), QMimeDatabase::MatchExtension);
+    qCDebug(ARK) << "Going to create nested archive" << fileName << "of type" << mimeType.name();
+
+    PluginManager pluginManager;
+    foreach (Plugin *plugin, pluginManager.preferredPluginsFor(mimeType)) {
+        Archive *archive = create(fileName, plugin, parent);
+        if (archive->isValid() && archive->m_iface->canReadNestedArchives()) {
+            Archive::Entry *containerEntry = new Archive::Entry(archive);
+            containerEntry->copyMetaData(entry);
+            archive->m_iface->setContainer(container->m_iface, containerEntry);
+            // Changes would have to be written back into the container.
+            archive->m_isReadOnly = true;
+            return archive;
+        }
+        delete archive;
+    }
+
+    qCWarning(ARK) << "No plugin can read the nested archive" << fileName;
+    return new Archive(NoPlugin, parent);
+}
+
 BatchExtractJob *Archive::batchExtract(const QString &fileName, const QString &destination, bool autoSubfolder, bool preservePaths, QObject *parent)
 {
-    auto loadJob = load(fileName, parent);
-    auto batchJob = new BatchExtractJob(loadJob, destination, autoSubfolder, preservePaths);
+    auto archive = create(fileName, parent);
+    auto batchJob = new BatchExtractJob(archive, destination, autoSubfolder, preservePaths);
 
     return batchJob;
 }
@@ -360,6 +392,10 @@ qulonglong Archive::unpackedSize() const
 
 qulonglong Archive::packedSize() const
 {
+    if (isValid() && m_iface->containerEntry()) {
+        return m_iface->containerEntry()->size();
+    }
+
     return isValid() ? static_cast<qulonglong>(QFileInfo(fileName()).size()) : 0;
 }
 
@@ -465,39 +501,84 @@ ExtractJob* Archive::extractFiles(const QVector<Archive::Entry*> &files, const Q
     }
 
     ExtractJob *newJob = new ExtractJob(files, destinationDir, newOptions, m_iface);
+    newJob->setUnpackedSize(unpackedSize());
     return newJob;
 }
 
 PreviewJob *Archive::preview(Archive::Entry *entry)
+{
+    return preview(QVector<Archive::Entry*> {entry});
+}
+
+OpenJob *Archive::open(Archive::Entry *entry)
+{
+    return open(QVector<Archive::Entry*> {entry});
+}
+
+OpenWithJob *Archive::openWith(Archive::Entry *entry)
+{
+    return openWith(QVector<Archive::Entry*> {entry});
+}
+
+PreviewJob *Archive::preview(const QVector<Archive::Entry*> &entries)
 {
     if (!isValid()) {
         return Q_NULLPTR;
     }
 
-    PreviewJob *job = new PreviewJob(entry, (encryptionType() != Unencrypted), m_iface);
+    if (!m_previewCache) {
+        m_previewCache.reset(new PreviewCache);
+    }
+
+    PreviewJob *job = new PreviewJob(entries, (encryptionType() != Unencrypted), m_iface);
+    job->setPreviewCache(m_previewCache.data());
     return job;
 }
 
-OpenJob *Archive::open(Archive::Entry *entry)
+OpenJob *Archive::open(const QVector<Archive::Entry*> &entries)
 {
     if (!isValid()) {
         return Q_NULLPTR;
     }
 
-    OpenJob *job = new OpenJob(entry, (encryptionType() != Unencrypted), m_iface);
+    OpenJob *job = new OpenJob(entries, (encryptionType() != Unencrypted), m_iface);
     return job;
 }
 
-OpenWithJob *Archive::openWith(Archive::Entry *entry)
+OpenWithJob *Archive::openWith(const QVector<Archive::Entry*> &entries)
 {
     if (!isValid()) {
         return Q_NULLPTR;
     }
 
-    OpenWithJob *job = new OpenWithJob(entry, (encryptionType() != Unencrypted), m_iface);
+    OpenWithJob *job = new OpenWithJob(entries, (encryptionType() != Unencrypted), m_iface);
     return job;
 }
 
+QIODevice *Archive::entryDevice(Archive::Entry *entry)
+{
+    if (!isValid()) {
+        return Q_NULLPTR;
+    }
+
+    // Only extraction jobs can ask for a password.
+    if ((entry->isPasswordProtected() || encryptionType() != Unencrypted) && password().isEmpty()) {
+        return Q_NULLPTR;
+    }
+
+    if (!m_previewCache) {
+        m_previewCache.reset(new PreviewCache);
+    }
+
+    QIODevice *device = m_previewCache->device(fileName(), entry);
+    if (device) {
+        return device;
+    }
+
+    device = m_iface->entryDevice(entry);
+    return device ? PreviewCache::cachingDevice(m_previewCache, fileName(), entry, device) : Q_NULLPTR;
+}
+
 void Archive::encrypt(const QString &password, bool encryptHeader)
 {
     if (!isValid()) {
@@ -36,8 +36,11 @@
 
 #include <QHash>
 #include <QMimeType>
+#include <QSharedPointer>
 #include <QVariant>
 
+class QIODevice;
+
 namespace Kerfuffle
 {
 class LoadJob;
@@ -53,6 +56,7 @@ class TestJob;
 class OpenJob;
 class OpenWithJob;
 class Plugin;
+class PreviewCache;
 class PreviewJob;
 class Query;
 class ReadOnlyArchiveInterface;
@@ -165,6 +169,15 @@ public:
      */
     static LoadJob* load(const QString &fileName, Plugin *plugin, QObject *parent = Q_NULLPTR);
 
+    /**
+     * @return The archive stored as @p entry in @p container, which is read
+     * through the container instead of being extracted first. The archive is
+     * read-only and keeps its own copy of @p entry. It is invalid if no
+     * plugin can read a nested archive of its type.
+     * @param parent The parent for the archive.
+     */
+    static Archive *createNested(Archive *container, const Archive::Entry *entry, QObject *parent = Q_NULLPTR);
+
     ~Archive();
 
     ArchiveError error() const;
@@ -209,6 +222,22 @@ public:
     OpenJob* open(Archive::Entry *entry);
     OpenWithJob* openWith(Archive::Entry *entry);
 
+    /**
+     * Same as above, but for several @p entries extracted together in one pass.
+     */
+    PreviewJob* preview(const QVector<Archive::Entry*> &entries);
+    OpenJob* open(const QVector<Archive::Entry*> &entries);
+    OpenWithJob* openWith(const QVector<Archive::Entry*> &entries);
+
+    /**
+     * @return A device streaming the contents of @p entry, or Q_NULLPTR if
+     * the entry can't be streamed and must be extracted by a job instead.
+     * Entries previewed before are read from the preview cache, and the
+     * streamed ones are added to it.
+     * @see ReadOnlyArchiveInterface::entryDevice()
+     */
+    QIODevice *entryDevice(Archive::Entry *entry);
+
     /**
      * @param password The password to encrypt the archive with.
      * @param encryptHeader Whether to encrypt also the list of files.
@@ -246,6 +275,12 @@ private:
     QMimeType m_mimeType;
     QStringList m_compressionMethods;
     QStringList m_encryptionMethods;
+
+    /**
+     * Shared by the preview jobs and the entry devices of this archive,
+     * created by the first one. The devices may outlive the archive.
+     */
+    QSharedPointer<PreviewCache> m_previewCache;
 };
 
 } // namespace Kerfuffle
@@ -25,7 +25,15 @@
 
 #include "archiveentry.h"
 
+#include <limits>
+
 namespace Kerfuffle {
+
+// Stored in place of the seconds when the entry has no timestamp.
+static const qint64 s_noTimestamp = std::numeric_limits<qint64>::min();
+// Stored in place of the offset from UTC when the timestamp is in local time.
+static const int s_localTimeOffset = std::numeric_limits<int>::min();
+
 Archive::Entry::Entry(QObject *parent, const QString &fullPath, const QString &rootNode)
     : QObject(parent)
     , rootNode(rootNode)
@@ -33,8 +41,12 @@ Archive::Entry::Entry(QObject *parent, const QString &fullPath, const QString &r
     , m_parent(qobject_cast<Entry*>(parent))
     , m_size(0)
     , m_compressedSize(0)
+    , m_timestampSecs(s_noTimestamp)
+    , m_timestampNsecs(0)
+    , m_timestampOffset(s_localTimeOffset)
     , m_isDirectory(false)
     , m_isPasswordProtected(false)
+    , m_isNestedArchive(false)
 {
     if (!fullPath.isEmpty())
         setFullPath(fullPath);
@@ -46,49 +58,51 @@ Archive::Entry::~Entry()
 
 void Archive::Entry::copyMetaData(const Archive::Entry *sourceEntry)
 {
-    setProperty("fullPath", sourceEntry->property("fullPath"));
-    setProperty("permissions", sourceEntry->property("permissions"));
-    setProperty("owner", sourceEntry->property("owner"));
-    setProperty("group", sourceEntry->property("group"));
-    setProperty("size", sourceEntry->property("size"));
-    setProperty("compressedSize", sourceEntry->property("compressedSize"));
-    setProperty("link", sourceEntry->property("link"));
-    setProperty("ratio", sourceEntry->property("ratio"));
-    setProperty("CRC", sourceEntry->property("CRC"));
-    setProperty("method", sourceEntry->property("method"));
-    setProperty("version", sourceEntry->property("version"));
-    setProperty("timestamp", sourceEntry->property("timestamp").toDateTime());
-    setProperty("isDirectory", sourceEntry->property("isDirectory"));
-    setProperty("isPasswordProtected", sourceEntry->property("isPasswordProtected"));
+    setFullPath(sourceEntry->fullPath());
+    m_permissions = sourceEntry->m_permissions;
+    m_owner = sourceEntry->m_owner;
+    m_group = sourceEntry->m_group;
+    m_size = sourceEntry->m_size;
+    m_compressedSize = sourceEntry->m_compressedSize;
+    m_link = sourceEntry->m_link;
+    m_ratio = sourceEntry->m_ratio;
+    m_CRC = sourceEntry->m_CRC;
+    m_method = sourceEntry->m_method;
+    m_version = sourceEntry->m_version;
+    m_timestampSecs = sourceEntry->m_timestampSecs;
+    m_timestampNsecs = sourceEntry->m_timestampNsecs;
+    m_timestampOffset = sourceEntry->m_timestampOffset;
+    m_isDirectory = sourceEntry->m_isDirectory;
+    m_isPasswordProtected = sourceEntry->m_isPasswordProtected;
 }
 
 QVector<Archive::Entry*> Archive::Entry::entries()
 {
-    Q_ASSERT(isDir());
+    Q_ASSERT(isDir() || isNestedArchive());
     return m_entries;
 }
 
 const QVector<Archive::Entry*> Archive::Entry::entries() const {
-    Q_ASSERT(isDir());
+    Q_ASSERT(isDir() || isNestedArchive());
     return m_entries;
 }
 
 void Archive::Entry::setEntryAt(int index, Entry *value)
 {
-    Q_ASSERT(isDir());
+    Q_ASSERT(isDir() || isNestedArchive());
     Q_ASSERT(index < m_entries.count());
     m_entries[index] = value;
 }
 
 void Archive::Entry::appendEntry(Entry *entry)
 {
-    Q_ASSERT(isDir());
+    Q_ASSERT(isDir() || isNestedArchive());
     m_entries.append(entry);
 }
 
 void Archive::Entry::removeEntryAt(int index)
 {
-    Q_ASSERT(isDir());
+    Q_ASSERT(isDir() || isNestedArchive());
     Q_ASSERT(index < m_entries.count());
     m_entries.remove(index);
 }
@@ -134,6 +148,185 @@ bool Archive::Entry::isDir() const
     return m_isDirectory;
 }
 
+void Archive::Entry::setIsNestedArchive(bool isNestedArchive)
+{
+    m_isNestedArchive = isNestedArchive;
+}
+
+bool Archive::Entry::isNestedArchive() const
+{
+    return m_isNestedArchive;
+}
+
+void Archive::Entry::setPermissions(const QString &permissions)
+{
+    m_permissions = permissions;
+}
+
+QString Archive::Entry::permissions() const
+{
+    return m_permissions;
+}
+
+void Archive::Entry::setOwner(const QString &owner)
+{
+    m_owner = owner;
+}
+
+QString Archive::Entry::owner() const
+{
+    return m_owner;
+}
+
+void Archive::Entry::setGroup(const QString &group)
+{
+    m_group = group;
+}
+
+QString Archive::Entry::group() const
+{
+    return m_group;
+}
+
+void Archive::Entry::setSize(qulonglong size)
+{
+    m_size = size;
+}
+
+qulonglong Archive::Entry::size() const
+{
+    return m_size;
+}
+
+void Archive::Entry::setCompressedSize(qulonglong compressedSize)
+{
+    m_compressedSize = compressedSize;
+}
+
+qulonglong Archive::Entry::compressedSize() const
+{
+    return m_compressedSize;
+}
+
+void Archive::Entry::setLink(const QString &link)
+{
+    m_link = link;
+}
+
+QString Archive::Entry::link() const
+{
+    return m_link;
+}
+
+void Archive::Entry::setRatio(const QString &ratio)
+{
+    m_ratio = ratio;
+}
+
+QString Archive::Entry::ratio() const
+{
+    return m_ratio;
+}
+
+void Archive::Entry::setCrc(const QString &crc)
+{
+    m_CRC = crc;
+}
+
+QString Archive::Entry::crc() const
+{
+    return m_CRC;
+}
+
+void Archive::Entry::setMethod(const QString &method)
+{
+    m_method = method;
+}
+
+QString Archive::Entry::method() const
+{
+    return m_method;
+}
+
+void Archive::Entry::setVersion(const QString &version)
+{
+    m_version = version;
+}
+
+QString Archive::Entry::version() const
+{
+    return m_version;
+}
+
+void Archive::Entry::setTimestamp(const QDateTime &timestamp)
+{
+    if (!timestamp.isValid()) {
+        m_timestampSecs = s_noTimestamp;
+        m_timestampNsecs = 0;
+        m_timestampOffset = s_localTimeOffset;
+        return;
+    }
+
+    const qint64 msecs = timestamp.toMSecsSinceEpoch();
+    qint64 secs = msecs / 1000;
+    int remainder = msecs % 1000;
+    if (remainder < 0) {
+        secs--;
+        remainder += 1000;
+    }
+    setTimestamp(secs, remainder * 1000000);
+
+    if (timestamp.timeSpec() == Qt::OffsetFromUTC) {
+        m_timestampOffset = timestamp.offsetFromUtc();
+    }
+}
+
+void Archive::Entry::setTimestamp(qint64 secsSinceEpoch, int nsecs)
+{
+    Q_ASSERT(nsecs >= 0 && nsecs < 1000000000);
+    m_timestampSecs = secsSinceEpoch;
+    m_timestampNsecs = nsecs;
+    m_timestampOffset = s_localTimeOffset;
+}
+
+QDateTime Archive::Entry::timestamp() const
+{
+    if (!hasTimestamp()) {
+        return QDateTime();
+    }
+
+    const qint64 msecs = m_timestampSecs * 1000 + m_timestampNsecs / 1000000;
+    if (m_timestampOffset != s_localTimeOffset) {
+        return QDateTime::fromMSecsSinceEpoch(msecs, Qt::OffsetFromUTC, m_timestampOffset);
+    }
+    return QDateTime::fromMSecsSinceEpoch(msecs);
+}
+
+bool Archive::Entry::hasTimestamp() const
+{
+    return m_timestampSecs != s_noTimestamp;
+}
+
+qint64 Archive::Entry::timestampSecs() const
+{
+    return m_timestampSecs;
+}
+
+int Archive::Entry::timestampNsecs() const
+{
+    return m_timestampNsecs;
+}
+
+void Archive::Entry::setIsPasswordProtected(bool isPasswordProtected)
+{
+    m_isPasswordProtected = isPasswordProtected;
+}
+
+bool Archive::Entry::isPasswordProtected() const
+{
+    return m_isPasswordProtected;
+}
+
 int Archive::Entry::row() const
 {
     if (getParent()) {
@@ -162,7 +355,7 @@ Archive::Entry *Archive::Entry::findByPath(const QStringList &pieces, int index)
     if (index == pieces.count() - 1) {
         return next;
     }
-    if (next && next->isDir()) {
+    if (next && (next->isDir() || next->isNestedArchive())) {
         return next->findByPath(pieces, index + 1);
     }
     return Q_NULLPTR;
@@ -191,7 +384,7 @@ bool Archive::Entry::operator==(const Archive::Entry &right) const
 
 QDebug operator<<(QDebug d, const Kerfuffle::Archive::Entry &entry)
 {
-    d.nospace() << "Entry(" << entry.property("fullPath");
+    d.nospace() << "Entry(" << entry.fullPath();
     if (!entry.rootNode.isEmpty()) {
         d.nospace() << "," << entry.rootNode;
     }
@@ -201,7 +394,7 @@ QDebug operator<<(QDebug d, const Kerfuffle::Archive::Entry &entry)
 
 QDebug operator<<(QDebug d, const Kerfuffle::Archive::Entry *entry)
 {
-    d.nospace() << "Entry(" << entry->property("fullPath");
+    d.nospace() << "Entry(" << entry->fullPath();
     if (!entry->rootNode.isEmpty()) {
         d.nospace() << "," << entry->rootNode;
     }
@@ -52,22 +52,26 @@ class Archive::Entry : public QObject
      *
      * Please notice that not all archive formats support all the properties
      * below, so set those that are available.
+     *
+     * The properties are only kept for compatibility (e.g. to access a
+     * column by name): plugins and other per-entry code should use the
+     * typed accessors, which avoid the meta-object lookup and the QVariant.
      */
-    Q_PROPERTY(QString fullPath MEMBER m_fullPath WRITE setFullPath)
+    Q_PROPERTY(QString fullPath READ fullPath WRITE setFullPath)
     Q_PROPERTY(QString name READ name)
-    Q_PROPERTY(QString permissions MEMBER m_permissions)
-    Q_PROPERTY(QString owner MEMBER m_owner)
-    Q_PROPERTY(QString group MEMBER m_group)
-    Q_PROPERTY(qulonglong size MEMBER m_size)
-    Q_PROPERTY(qulonglong compressedSize MEMBER m_compressedSize)
-    Q_PROPERTY(QString link MEMBER m_link)
-    Q_PROPERTY(QString ratio MEMBER m_ratio)
-    Q_PROPERTY(QString CRC MEMBER m_CRC)
-    Q_PROPERTY(QString method MEMBER m_method)
-    Q_PROPERTY(QString version MEMBER m_version)
-    Q_PROPERTY(QDateTime timestamp MEMBER m_timestamp)
-    Q_PROPERTY(bool isDirectory MEMBER m_isDirectory WRITE setIsDirectory)
-    Q_PROPERTY(bool isPasswordProtected MEMBER m_isPasswordProtected)
+    Q_PROPERTY(QString permissions READ permissions WRITE setPermissions)
+    Q_PROPERTY(QString owner READ owner WRITE setOwner)
+    Q_PROPERTY(QString group READ group WRITE setGroup)
+    Q_PROPERTY(qulonglong size READ size WRITE setSize)
+    Q_PROPERTY(qulonglong compressedSize READ compressedSize WRITE setCompressedSize)
+    Q_PROPERTY(QString link READ link WRITE setLink)
+    Q_PROPERTY(QString ratio READ ratio WRITE setRatio)
+    Q_PROPERTY(QString CRC READ crc WRITE setCrc)
+    Q_PROPERTY(QString method READ method WRITE setMethod)
+    Q_PROPERTY(QString version READ version WRITE setVersion)
+    Q_PROPERTY(QDateTime timestamp READ timestamp WRITE setTimestamp)
+    Q_PROPERTY(bool isDirectory READ isDir WRITE setIsDirectory)
+    Q_PROPERTY(bool isPasswordProtected READ isPasswordProtected WRITE setIsPasswordProtected)
 
 public:
 
@@ -88,6 +92,52 @@ public:
     QString name() const;
     void setIsDirectory(const bool isDirectory);
     bool isDir() const;
+
+    /**
+     * Marks the entry as an archive whose own entries have been listed as
+     * its children, so that it can be browsed like a directory.
+     */
+    void setIsNestedArchive(bool isNestedArchive);
+    bool isNestedArchive() const;
+    void setPermissions(const QString &permissions);
+    QString permissions() const;
+    void setOwner(const QString &owner);
+    QString owner() const;
+    void setGroup(const QString &group);
+    QString group() const;
+    void setSize(qulonglong size);
+    qulonglong size() const;
+    void setCompressedSize(qulonglong compressedSize);
+    qulonglong compressedSize() const;
+    void setLink(const QString &link);
+    QString link() const;
+    void setRatio(const QString &ratio);
+    QString ratio() const;
+    void setCrc(const QString &crc);
+    QString crc() const;
+    void setMethod(const QString &method);
+    QString method() const;
+    void setVersion(const QString &version);
+    QString version() const;
+    void setTimestamp(const QDateTime &timestamp);
+
+    /**
+     * Sets the timestamp as @p secsSinceEpoch seconds and @p nsecs nanoseconds
+     * since 1970-01-01T00:00:00 UTC, without building a QDateTime.
+     */
+    void setTimestamp(qint64 secsSinceEpoch, int nsecs = 0);
+
+    /**
+     * @return The timestamp as a QDateTime, which is built on each call.
+     * It is in local time unless a QDateTime with an offset from UTC was set,
+     * and it is invalid if no timestamp has been set.
+     */
+    QDateTime timestamp() const;
+    bool hasTimestamp() const;
+    qint64 timestampSecs() const;
+    int timestampNsecs() const;
+    void setIsPasswordProtected(bool isPasswordProtected);
+    bool isPasswordProtected() const;
     int row() const;
     Entry *find(const QString &name) const;
     Entry *findByPath(const QStringList & pieces, int index = 0) const;
@@ -120,9 +170,12 @@ private:
     QString m_CRC;
     QString m_method;
     QString m_version;
-    QDateTime m_timestamp;
+    qint64 m_timestampSecs;
+    int m_timestampNsecs;
+    int m_timestampOffset;
     bool m_isDirectory;
     bool m_isPasswordProtected;
+    bool m_isNestedArchive;
 };
 
 QDebug KERFUFFLE_EXPORT operator<<(QDebug d, const Kerfuffle::Archive::Entry &entry);
@@ -267,6 +267,38 @@ bool ReadOnlyArchiveInterface::hasBatchExtractionProgress() const
     return false;
 }
 
+QIODevice *ReadOnlyArchiveInterface::entryDevice(const Archive::Entry *entry)
+{
+    Q_UNUSED(entry)
+    return Q_NULLPTR;
+}
+
+bool ReadOnlyArchiveInterface::canReadNestedArchives() const
+{
+    return false;
+}
+
+void ReadOnlyArchiveInterface::setContainer(ReadOnlyArchiveInterface *container, const Archive::Entry *entry)
+{
+    Q_ASSERT(canReadNestedArchives());
+    m_container = container;
+    m_containerEntry = entry;
+}
+
+const Archive::Entry *ReadOnlyArchiveInterface::containerEntry() const
+{
+    return m_containerEntry;
+}
+
+QIODevice *ReadOnlyArchiveInterface::createContainerEntryDevice() const
+{
+    if (!m_container) {
+        return Q_NULLPTR;
+    }
+
+    return m_container->entryDevice(m_containerEntry);
+}
+
 bool ReadWriteArchiveInterface::isReadOnly() const
 {
     // We set corrupt archives to read-only to avoid add/delete actions, that
@@ -288,6 +320,16 @@ uint ReadOnlyArchiveInterface::numberOfEntries() const
     return m_numberOfEntries;
 }
 
+void ReadWriteArchiveInterface::setFileManifest(const FileManifest &manifest)
+{
+    m_fileManifest = manifest;
+}
+
+FileManifest ReadWriteArchiveInterface::fileManifest() const
+{
+    return m_fileManifest;
+}
+
 void ReadWriteArchiveInterface::onEntryRemoved(const QString &path)
 {
     Q_UNUSED(path)
@@ -32,7 +32,9 @@
 #include "archive_kerfuffle.h"
 #include "kerfuffle_export.h"
 #include "archiveentry.h"
+#include "filemanifest.h"
 
+#include <QIODevice>
 #include <QObject>
 #include <QStringList>
 #include <QString>
@@ -95,6 +97,8 @@ public:
      * Globally recognized extraction options:
      * @li PreservePaths - preserve file paths (extract flat if false)
      * @li RootNode - node in the archive which will correspond to the @arg destinationDirectory
+     * A folder in @p files none of whose children are in @p files stands for
+     * the folder and all of its contents (see EntrySelection).
      * When subclassing, you can block as long as you need (unless you called setWaitForFinishedSignal(true)).
      * @returns whether the listing succeeded.
      * @note If returning false, make sure to emit the error() signal beforewards to notify
@@ -163,6 +167,43 @@ public:
      */
     virtual bool hasBatchExtractionProgress() const;
 
+    /**
+     * Creates a sequential device streaming the decompressed contents of
+     * @p entry, so that it can be read without extracting it to disk first.
+     *
+     * The device is already opened for reading and belongs to the caller.
+     * It must be read from the thread which created it, where it emits
+     * readyRead() whenever new data is available: the entry is decompressed
+     * in the background, so this may be called from the GUI thread even while
+     * a job is running on the interface.
+     *
+     * The default implementation returns Q_NULLPTR, meaning that the entry
+     * can only be read through an extraction job.
+     */
+    virtual QIODevice *entryDevice(const Archive::Entry *entry);
+
+    /**
+     * @return Whether the interface can read an archive nested in another
+     * one, see setContainer(). The default implementation returns false.
+     */
+    virtual bool canReadNestedArchives() const;
+
+    /**
+     * Makes the interface read the archive from the data of @p entry of the
+     * @p container archive instead of from filename(), so that an archive
+     * stored in another one can be browsed without extracting it first.
+     *
+     * Must only be called if canReadNestedArchives() returns true. The
+     * interface doesn't take ownership of @p container nor of @p entry.
+     */
+    void setContainer(ReadOnlyArchiveInterface *container, const Archive::Entry *entry);
+
+    /**
+     * @return The entry of the container archive this archive is stored in,
+     * or Q_NULLPTR if it's a plain file.
+     */
+    const Archive::Entry *containerEntry() const;
+
 signals:
     void cancelled();
     void error(const QString &message, const QString &details = QString());
@@ -189,6 +230,14 @@ protected:
 
     void setCorrupt(bool isCorrupt);
     bool isCorrupt() const;
+
+    /**
+     * @return A new device streaming the data of containerEntry(), or
+     * Q_NULLPTR if it can't be read. Each device can only be read once, so
+     * every operation on a nested archive needs to create its own.
+     */
+    QIODevice *createContainerEntryDevice() const;
+
     QString m_comment;
     int m_numberOfVolumes;
     uint m_numberOfEntries;
@@ -202,6 +251,8 @@ private:
     bool m_isHeaderEncryptionEnabled;
     bool m_isCorrupt;
     bool m_isMultiVolume;
+    ReadOnlyArchiveInterface *m_container = Q_NULLPTR;
+    const Archive::Entry *m_containerEntry = Q_NULLPTR;
 
 private slots:
     void onEntry(Archive::Entry *archiveEntry);
@@ -223,14 +274,39 @@ public:
     virtual bool addFiles(const QVector<Archive::Entry*> &files, const Archive::Entry *destination, const CompressionOptions& options, uint numberOfEntriesToAdd = 0) = 0;
     virtual bool moveFiles(const QVector<Archive::Entry*> &files, Archive::Entry *destination, const CompressionOptions& options) = 0;
     virtual bool copyFiles(const QVector<Archive::Entry*> &files, Archive::Entry *destination, const CompressionOptions& options) = 0;
+    /**
+     * Deletes @p files from the archive. As in extractFiles(), a folder none
+     * of whose children are in @p files is deleted together with its contents.
+     */
     virtual bool deleteFiles(const QVector<Archive::Entry*> &files) = 0;
     virtual bool addComment(const QString &comment) = 0;
 
+    /**
+     * Sets the already scanned files for the next addFiles(), so that the
+     * folders among the added files are not walked again by the plugin.
+     */
+    void setFileManifest(const FileManifest &manifest);
+
+    /**
+     * @return The manifest set by setFileManifest(). If it is empty, the
+     * plugin scans the files passed to addFiles() by itself.
+     */
+    FileManifest fileManifest() const;
+
 signals:
     void entryRemoved(const QString &path);
 
+    /**
+     * Emitted by addFiles() after each file with the total size of the
+     * regular files written so far, to match FileManifest::totalSize().
+     */
+    void bytesProcessed(qulonglong bytes);
+
 private slots:
     void onEntryRemoved(const QString &path);
+
+private:
+    FileManifest m_fileManifest;
 };
 
 } // namespace Kerfuffle
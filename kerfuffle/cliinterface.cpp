@@ -29,11 +29,11 @@
 
 #include "cliinterface.h"
 #include "ark_debug.h"
+#include "entryselection.h"
 #include "queries.h"
 
-#ifdef Q_OS_WIN
-# include <KProcess>
-#else
+#include <KProcess>
+#ifndef Q_OS_WIN
 # include <KPtyDevice>
 # include <KPtyProcess>
 #endif
@@ -50,15 +50,20 @@
 #include <QMimeDatabase>
 #include <QProcess>
 #include <QRegularExpression>
+#include <QSet>
 #include <QStandardPaths>
 #include <QTemporaryDir>
 #include <QTemporaryFile>
 #include <QThread>
 #include <QTimer>
-#include <QUrl>
 
 namespace Kerfuffle
 {
+
+// Processes without a pty are never waiting for input, so their listing output
+// is handled in chunks of at least this size instead of on every readyRead().
+static const qint64 s_pipeReadBufferSize = 256 * 1024;
+
 CliInterface::CliInterface(QObject *parent, const QVariantList & args)
     : ReadWriteArchiveInterface(parent, args)
 {
@@ -110,21 +115,22 @@ bool CliInterface::extractFiles(const QVector<Archive::Entry*> &files, const QSt
 
 
 
-    if (!m_cliProps->property("passwordSwitch").toString().isEmpty() && options.encryptedArchiveHint() && password().isEmpty()) {
+    if (!m_cliProps->property("passwordSwitch").toStringList().isEmpty() && options.encryptedArchiveHint() && password().isEmpty()) {
         qCDebug(ARK) << "Password hint enabled, querying user";
         if (!passwordQuery()) {
             return false;
         }
     }
 
-    QUrl destDir = QUrl(destinationDirectory);
-    QDir::setCurrent(destDir.adjusted(QUrl::RemoveScheme).url());
+    // The archiver is run in the destination directory without changing the
+    // current directory, which is shared by all jobs running at the same time.
+    m_extractWorkingDir = QDir(destinationDirectory).absolutePath();
 
     const bool useTmpExtractDir = options.isDragAndDropEnabled() || options.alwaysUseTempDir();
 
     if (useTmpExtractDir) {
-        // Create an hidden temp folder in the current directory.
-        m_extractTempDir.reset(new QTemporaryDir(QStringLiteral(".%1-").arg(QCoreApplication::applicationName())));
+        // Create an hidden temp folder in the destination directory.
+        m_extractTempDir.reset(new QTemporaryDir(m_extractWorkingDir + QStringLiteral("/.%1-").arg(QCoreApplication::applicationName())));
 
         qCDebug(ARK) << "Using temporary extraction dir:" << m_extractTempDir->path();
         if (!m_extractTempDir->isValid()) {
@@ -132,9 +138,7 @@ bool CliInterface::extractFiles(const QVector<Archive::Entry*> &files, const QSt
             emit finished(false);
             return false;
         }
-        m_oldWorkingDir = QDir::currentPath();
-        destDir = QUrl(m_extractTempDir->path());
-        QDir::setCurrent(destDir.adjusted(QUrl::RemoveScheme).url());
+        m_extractWorkingDir = m_extractTempDir->path();
     }
 
     return runProcess(m_cliProps->property("extractProgram").toString(),
@@ -193,7 +197,7 @@ bool CliInterface::addFiles(const QVector<Archive::Entry*> &files, const Archive
         filesToPass = files;
     }
 
-    if (!m_cliProps->property("passwordSwitch").toString().isEmpty() && options.encryptedArchiveHint() && password().isEmpty()) {
+    if (!m_cliProps->property("passwordSwitch").toStringList().isEmpty() && options.encryptedArchiveHint() && password().isEmpty()) {
         qCDebug(ARK) << "Password hint enabled, querying user";
         if (!passwordQuery()) {
             return false;
@@ -239,6 +243,9 @@ bool CliInterface::copyFiles(const QVector<Archive::Entry*> &files, Archive::Ent
     m_passedOptions = options;
     m_numberOfEntries = 0;
 
+    beginSession();
+    setNewCopiedFiles(files, destination);
+
     m_subOperation = Extract;
     connect(this, &CliInterface::finished, this, &CliInterface::continueCopying);
 
@@ -255,6 +262,41 @@ bool CliInterface::deleteFiles(const QVector<Archive::Entry*> &files)
                       m_cliProps->deleteArgs(filename(), files, password()));
 }
 
+QIODevice *CliInterface::entryDevice(const Archive::Entry *entry)
+{
+    if (m_cliProps->property("extractToStdoutSwitch").toStringList().isEmpty()) {
+        return Q_NULLPTR;
+    }
+
+    const QString programPath = QStandardPaths::findExecutable(m_cliProps->property("extractProgram").toString());
+    if (programPath.isEmpty()) {
+        return Q_NULLPTR;
+    }
+
+    const QStringList arguments = m_cliProps->extractToStdoutArgs(filename(),
+                                                                  escapeFileName(entry->fullPath(NoTrailingSlash)),
+                                                                  password());
+    qCDebug(ARK) << "Streaming entry with" << programPath << arguments;
+
+    // Nobody can answer a prompt of this process, so it gets no stdin. Its
+    // stderr is discarded, so that only the entry's data is read.
+    KProcess *process = new KProcess;
+    process->setOutputChannelMode(KProcess::SeparateChannels);
+    process->setStandardErrorFile(QProcess::nullDevice());
+    process->setNextOpenMode(QIODevice::ReadOnly);
+    process->setProgram(programPath, arguments);
+    process->start();
+
+    if (!process->waitForStarted()) {
+        qCWarning(ARK) << "Failed to start" << programPath;
+        delete process;
+        return Q_NULLPTR;
+    }
+    process->closeWriteChannel();
+
+    return process;
+}
+
 bool CliInterface::testArchive()
 {
     resetParsing();
@@ -274,18 +316,30 @@ bool CliInterface::runProcess(const QString& programName, const QStringList& arg
         return false;
     }
 
-    qCDebug(ARK) << "Executing" << programPath << arguments << "within directory" << QDir::currentPath();
+    const QString workingDirectory = (m_operationMode == Extract) ? m_extractWorkingDir : QDir::currentPath();
+    qCDebug(ARK) << "Executing" << programPath << arguments << "within directory" << workingDirectory;
+
+    m_isInteractiveProcess = needsPty();
 
 #ifdef Q_OS_WIN
     m_process = new KProcess;
 #else
-    m_process = new KPtyProcess;
-    m_process->setPtyChannels(KPtyProcess::StdinChannel);
+    if (m_isInteractiveProcess) {
+        KPtyProcess *ptyProcess = new KPtyProcess;
+        ptyProcess->setPtyChannels(KPtyProcess::StdinChannel);
+        m_process = ptyProcess;
+    } else {
+        // Allocating a pty is a waste of time if nobody is going to answer any prompt.
+        m_process = new KProcess;
+    }
 #endif
 
     m_process->setOutputChannelMode(KProcess::MergedChannels);
     m_process->setNextOpenMode(QIODevice::ReadWrite | QIODevice::Unbuffered | QIODevice::Text);
     m_process->setProgram(programPath, arguments);
+    // Keep track of where the process runs, as the current directory may be
+    // changed by another job before it has finished.
+    m_process->setWorkingDirectory(workingDirectory);
 
     connect(m_process, &QProcess::readyReadStandardOutput, this, [=]() {
         readStdout();
@@ -293,15 +347,20 @@ bool CliInterface::runProcess(const QString& programName, const QStringList& arg
 
     if (m_operationMode == Extract) {
         // Extraction jobs need a dedicated post-processing function.
-        connect(m_process, static_cast<void (KPtyProcess::*)(int, QProcess::ExitStatus)>(&KPtyProcess::finished), this, &CliInterface::extractProcessFinished);
+        connect(m_process, static_cast<void (KProcess::*)(int, QProcess::ExitStatus)>(&KProcess::finished), this, &CliInterface::extractProcessFinished);
     } else {
-        connect(m_process, static_cast<void (KPtyProcess::*)(int, QProcess::ExitStatus)>(&KPtyProcess::finished), this, &CliInterface::processFinished);
+        connect(m_process, static_cast<void (KProcess::*)(int, QProcess::ExitStatus)>(&KProcess::finished), this, &CliInterface::processFinished);
     }
 
     m_stdOutData.clear();
 
     m_process->start();
 
+    if (!m_isInteractiveProcess) {
+        // Make sure an unexpected prompt fails instead of waiting forever for an answer.
+        m_process->closeWriteChannel();
+    }
+
     return true;
 }
 
@@ -324,18 +383,33 @@ void CliInterface::processFinished(int exitCode, QProcess::ExitStatus exitStatus
         return;
     }
 
+    if (m_operationMode == List && m_listOnPty) {
+        if (!m_isInteractiveProcess) {
+            qCDebug(ARK) << "The archive needs a password, listing it again with a pty";
+            resetParsing();
+            m_numberOfEntries = 0;
+            runProcess(m_cliProps->property("listProgram").toString(), m_cliProps->listArgs(filename(), password()));
+            return;
+        }
+        m_listOnPty = false;
+    }
+
     if (m_operationMode == Delete || m_operationMode == Move) {
         QStringList removedFullPaths = entryFullPaths(m_removedFiles);
         foreach (const QString &fullPath, removedFullPaths) {
             emit entryRemoved(fullPath);
         }
+    }
+
+    // Within a session the resulting entries are already known, so we don't need to list the archive again.
+    if (m_operationMode == Move || (m_operationMode == Add && m_sessionActive)) {
         foreach (Archive::Entry *e, m_newMovedFiles) {
             emit entry(e);
         }
         m_newMovedFiles.clear();
     }
 
-    if (m_operationMode == Add && !isMultiVolume()) {
+    if (m_operationMode == Add && !isMultiVolume() && !m_sessionActive) {
         list();
     } else if (m_operationMode == List && isCorrupt()) {
         Kerfuffle::LoadCorruptQuery query(filename());
@@ -391,7 +465,7 @@ void CliInterface::extractProcessFinished(int exitCode, QProcess::ExitStatus exi
         }
 
         if (!m_extractionOptions.isDragAndDropEnabled()) {
-            if (!moveToDestination(QDir::current(), QDir(m_extractDestDir), m_extractionOptions.preservePaths())) {
+            if (!moveToDestination(QDir(m_extractTempDir->path()), QDir(m_extractDestDir), m_extractionOptions.preservePaths())) {
                 emit error(i18ncp("@info",
                                   "Could not move the extracted file to the destination directory.",
                                   "Could not move the extracted files to the destination directory.",
@@ -453,13 +527,47 @@ bool CliInterface::moveDroppedFilesToDest(const QVector<Archive::Entry*> &files,
     QDir finalDestDir(finalDest);
     qCDebug(ARK) << "Setting final dir to" << finalDest;
 
+    // The current directory may have been changed meanwhile by another job.
+    const QDir extractDir(m_extractTempDir->path());
+
     bool overwriteAll = false;
     bool skipAll = false;
 
+    // A folder may stand for its whole contents, which then are not among
+    // the files: take them from the extracted folder instead.
+    const EntrySelection selection(entryFullPaths(files));
+    typedef QPair<QString, QString> PathAndRootNode;
+    QVector<PathAndRootNode> extractedPaths;
+    QSet<QString> knownPaths;
     foreach (const Archive::Entry *file, files) {
+        if (knownPaths.contains(file->fullPath())) {
+            continue;
+        }
+        knownPaths.insert(file->fullPath());
+        extractedPaths << qMakePair(file->fullPath(), file->rootNode);
+
+        if (selection.matchesFolderContents(file->fullPath())) {
+            QDirIterator it(extractDir.absolutePath() + QLatin1Char('/') + file->fullPath(),
+                            QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot,
+                            QDirIterator::Subdirectories);
+            while (it.hasNext()) {
+                it.next();
+                QString path = extractDir.relativeFilePath(it.filePath());
+                if (it.fileInfo().isDir() && !it.fileInfo().isSymLink()) {
+                    path += QLatin1Char('/');
+                }
+                if (!knownPaths.contains(path)) {
+                    knownPaths.insert(path);
+                    extractedPaths << qMakePair(path, file->rootNode);
+                }
+            }
+        }
+    }
+
+    foreach (const PathAndRootNode &file, extractedPaths) {
 
-        QFileInfo relEntry(file->fullPath().remove(file->rootNode));
-        QFileInfo absSourceEntry(QDir::current().absolutePath() + QLatin1Char('/') + file->fullPath());
+        QFileInfo relEntry(QString(file.first).remove(file.second));
+        QFileInfo absSourceEntry(extractDir.absolutePath() + QLatin1Char('/') + file.first);
         QFileInfo absDestEntry(finalDestDir.path() + QLatin1Char('/') + relEntry.filePath());
 
         if (absSourceEntry.isDir()) {
@@ -534,10 +642,7 @@ bool CliInterface::isEmptyDir(const QDir &dir)
 
 void CliInterface::cleanUpExtracting()
 {
-    if (!m_oldWorkingDir.isEmpty()) {
-        QDir::setCurrent(m_oldWorkingDir);
-    }
-
+    m_extractWorkingDir.clear();
     m_extractTempDir.reset();
 }
 
@@ -672,11 +777,38 @@ void CliInterface::setNewMovedFiles(const QVector<Archive::Entry*> &entries, con
     }
 }
 
+void CliInterface::setNewCopiedFiles(const QVector<Archive::Entry*> &entries, const Archive::Entry *destination)
+{
+    m_newMovedFiles.clear();
+    QMap<QString, const Archive::Entry*> entryMap;
+    foreach (const Archive::Entry* entry, entries) {
+        entryMap.insert(entry->fullPath(), entry);
+    }
+
+    // The keys of the map are sorted just like entryPathsFromDestination() sorts its input.
+    const QStringList newPaths = entryPathsFromDestination(entryMap.keys(), destination, 0);
+    int i = 0;
+    foreach (const Archive::Entry* entry, entryMap) {
+        Archive::Entry *newEntry = new Archive::Entry(Q_NULLPTR);
+        newEntry->copyMetaData(entry);
+        newEntry->setFullPath(newPaths.at(i++));
+        m_newMovedFiles << newEntry;
+    }
+}
+
 QStringList CliInterface::extractFilesList(const QVector<Archive::Entry*> &entries) const
 {
+    // Folders standing for their whole contents need a wildcard if the
+    // program doesn't recurse into them by itself.
+    const QString folderWildcard = m_cliProps->property("folderWildcard").toString();
+    const EntrySelection selection(folderWildcard.isEmpty() ? QStringList() : entryFullPaths(entries));
+
     QStringList filesList;
     foreach (const Archive::Entry *e, entries) {
         filesList << escapeFileName(e->fullPath(NoTrailingSlash));
+        if (selection.matchesFolderContents(e->fullPath())) {
+            filesList << escapeFileName(e->fullPath()) + folderWildcard;
+        }
     }
 
     return filesList;
@@ -726,6 +858,46 @@ void CliInterface::cleanUp()
     QDir::setCurrent(m_oldWorkingDir);
     m_tempWorkingDir.reset();
     m_tempAddDir.reset();
+
+    // Entries not emitted because the session failed.
+    qDeleteAll(m_newMovedFiles);
+    m_newMovedFiles.clear();
+    m_sessionActive = false;
+}
+
+void CliInterface::beginSession()
+{
+    m_sessionActive = true;
+}
+
+bool CliInterface::needsPty() const
+{
+    switch (m_operationMode) {
+    case Add:
+    case Delete:
+    case Move:
+    case Comment:
+        // The password, if any, is already known at this point and passed with the passwordSwitch.
+        return false;
+    case List:
+        // Big listings are much faster over pipes. Only archives with
+        // encrypted headers make the archiver prompt for a password: it
+        // fails on the closed stdin and the archive is listed again with a pty.
+        return m_listOnPty;
+    case Test:
+        // A password prompt is reported as an error anyway, and the closed
+        // stdin makes the archiver fail instead of waiting for an answer.
+        return false;
+    case Extract:
+        // Sessions and temporary extraction directories are empty, so no file can already exist:
+        // the only possible prompt is the password one.
+        if (!m_sessionActive && !m_extractionOptions.alwaysUseTempDir() && !m_extractionOptions.isDragAndDropEnabled()) {
+            return true;
+        }
+        return password().isEmpty() && (m_sessionActive || m_extractionOptions.encryptedArchiveHint());
+    default:
+        return true;
+    }
 }
 
 void CliInterface::readStdout(bool handleAll)
@@ -743,6 +915,21 @@ void CliInterface::readStdout(bool handleAll)
 
     Q_ASSERT(m_process);
 
+    if (!m_isInteractiveProcess) {
+        // No need to look for prompts in the last line: just handle all the complete lines at once.
+        // Listings are buffered further, the other operations need their progress lines in time.
+        if (!handleAll && m_operationMode == List && m_process->bytesAvailable() < s_pipeReadBufferSize) {
+            return;
+        }
+
+        m_stdOutData += m_process->readAllStandardOutput();
+
+        QList<QByteArray> lines = m_stdOutData.split('\n');
+        m_stdOutData = handleAll ? QByteArray() : lines.takeLast();
+        handleLines(lines);
+        return;
+    }
+
     if (!m_process->bytesAvailable()) {
         //if process has no more data, we can just bail out
         return;
@@ -797,6 +984,11 @@ void CliInterface::readStdout(bool handleAll)
         m_stdOutData = lines.takeLast();
     }
 
+    handleLines(lines);
+}
+
+void CliInterface::handleLines(const QList<QByteArray> &lines)
+{
     foreach(const QByteArray& line, lines) {
         if (!line.isEmpty() || (m_listEmptyLines && m_operationMode == List)) {
             if (!handleLine(QString::fromLocal8Bit(line))) {
@@ -877,9 +1069,19 @@ bool CliInterface::handleLine(const QString& line)
     }
 
     if (m_operationMode == List) {
+        // The rest of the output of a listing which will be run again with a pty.
+        if (m_listOnPty && !m_isInteractiveProcess) {
+            return true;
+        }
+
         if (m_cliProps->isPasswordPrompt(line)) {
             qCDebug(ARK) << "Found a password prompt";
 
+            if (!m_isInteractiveProcess) {
+                m_listOnPty = true;
+                return true;
+            }
+
             Kerfuffle::PasswordNeededQuery query(filename());
             query.execute();
 
@@ -953,7 +1155,7 @@ bool CliInterface::handleFileExistsMessage(const QString& line)
         return false;
     }
 
-    Kerfuffle::OverwriteQuery query(QDir::current().path() + QLatin1Char( '/' ) + m_storedFileName);
+    Kerfuffle::OverwriteQuery query(m_process->workingDirectory() + QLatin1Char( '/' ) + m_storedFileName);
     query.setNoRenameMode(true);
     query.execute();
 
@@ -1029,11 +1231,15 @@ void CliInterface::writeToProcess(const QByteArray& data)
 
     qCDebug(ARK) << "Writing" << data << "to the process";
 
-#ifdef Q_OS_WIN
-    m_process->write(data);
-#else
-    m_process->pty()->write(data);
+#ifndef Q_OS_WIN
+    KPtyProcess *ptyProcess = qobject_cast<KPtyProcess*>(m_process);
+    if (ptyProcess) {
+        ptyProcess->pty()->write(data);
+        return;
+    }
 #endif
+
+    m_process->write(data);
 }
 
 bool CliInterface::addComment(const QString &comment)
@@ -1083,7 +1289,7 @@ CliProperties *CliInterface::cliProperties() const
 void CliInterface::onEntry(Archive::Entry *archiveEntry)
 {
     if (archiveEntry->compressedSizeIsSet) {
-        m_listedSize += archiveEntry->property("compressedSize").toULongLong();
+        m_listedSize += archiveEntry->compressedSize();
         if (m_listedSize <= m_archiveSizeOnDisk) {
             emit progress(float(m_listedSize)/float(m_archiveSizeOnDisk));
         } else {
@@ -67,6 +67,7 @@ public:
     virtual bool deleteFiles(const QVector<Archive::Entry*> &files) Q_DECL_OVERRIDE;
     virtual bool addComment(const QString &comment) Q_DECL_OVERRIDE;
     virtual bool testArchive() Q_DECL_OVERRIDE;
+    virtual QIODevice *entryDevice(const Archive::Entry *entry) Q_DECL_OVERRIDE;
 
     virtual void resetParsing() = 0;
     virtual bool readListLine(const QString &line) = 0;
@@ -93,6 +94,11 @@ public:
      */
     void setNewMovedFiles(const QVector<Archive::Entry*> &entries, const Archive::Entry *destination, int entriesWithoutChildren);
 
+    /**
+     * Same as setNewMovedFiles(), but for entries copied into the @p destination folder.
+     */
+    void setNewCopiedFiles(const QVector<Archive::Entry*> &entries, const Archive::Entry *destination);
+
     /**
      * @return The list of selected files to extract.
      */
@@ -137,6 +143,23 @@ protected:
 
     void cleanUp();
 
+    /**
+     * Starts a session, i.e. a composite operation (such as copying or moving
+     * entries) implemented by several archiver invocations in a row.
+     *
+     * Within a session the archive is not listed again after adding files:
+     * the entries set by setNewMovedFiles() or setNewCopiedFiles() are emitted
+     * as soon as the last step has finished. The session is ended by cleanUp().
+     */
+    void beginSession();
+
+    /**
+     * @return Whether the process for the current operation may prompt the user,
+     * e.g. for a password or for what to do with an already existing file.
+     * Only such processes are run with a pseudo-terminal.
+     */
+    virtual bool needsPty() const;
+
     CliProperties *m_cliProps = Q_NULLPTR;
     QString m_oldWorkingDir;
     QScopedPointer<QTemporaryDir> m_tempWorkingDir;
@@ -147,13 +170,25 @@ protected:
     Archive::Entry *m_passedDestination = Q_NULLPTR;
     CompressionOptions m_passedOptions;
 
-#ifdef Q_OS_WIN
+    /**
+     * Either a KPtyProcess or a plain KProcess, depending on needsPty().
+     */
     KProcess *m_process = Q_NULLPTR;
-#else
-    KPtyProcess *m_process = Q_NULLPTR;
-#endif
 
     bool m_abortingOperation = false;
+    bool m_sessionActive = false;
+
+    /**
+     * Whether the running process may prompt the user. Otherwise it has no pty
+     * and its output is read through a big buffer.
+     */
+    bool m_isInteractiveProcess = true;
+
+    /**
+     * Set when a listing run over pipes has found a password prompt, which
+     * nobody can answer there: the archive is listed again with a pty.
+     */
+    bool m_listOnPty = false;
 
 protected slots:
     virtual void readStdout(bool handleAll = false);
@@ -162,6 +197,12 @@ private:
 
     bool handleFileExistsMessage(const QString& filename);
 
+    /**
+     * Calls handleLine() for each of the complete output @p lines, killing the
+     * process if one of them is a fatal error.
+     */
+    void handleLines(const QList<QByteArray> &lines);
+
     /**
      * Returns a list of path pairs which will be supplied to rn command.
      * <src_file_1> <dest_file_1> [ <src_file_2> <dest_file_2> ... ]
@@ -174,7 +215,7 @@ private:
 
     /**
      * Wrapper around KProcess::write() or KPtyDevice::write(), depending on
-     * the platform.
+     * whether the process has a pseudo-terminal.
      */
     void writeToProcess(const QByteArray& data);
 
@@ -211,6 +252,12 @@ private:
 
     ExtractionOptions m_extractionOptions;
     QString m_extractDestDir;
+
+    /**
+     * Directory the archiver is run in when extracting: the destination
+     * directory or the temporary directory within it.
+     */
+    QString m_extractWorkingDir;
     QScopedPointer<QTemporaryDir> m_extractTempDir;
     QScopedPointer<QTemporaryFile> m_commentTempFile;
     QVector<Archive::Entry*> m_extractedFiles;
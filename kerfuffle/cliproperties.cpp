@@ -28,6 +28,7 @@
 #include "cliproperties.h"
 #include "ark_debug.h"
 #include "archiveformat.h"
+#include "entryselection.h"
 #include "pluginmanager.h"
 
 namespace Kerfuffle
@@ -92,8 +93,15 @@ QStringList CliProperties::deleteArgs(const QString &archive, const QVector<Arch
         args << substitutePasswordSwitch(password);
     }
     args << archive;
+
+    // Folders standing for their whole contents need a wildcard if the
+    // program doesn't recurse into them by itself.
+    const EntrySelection selection(m_folderWildcard.isEmpty() ? QStringList() : ReadOnlyArchiveInterface::entryFullPaths(files));
     foreach (const Archive::Entry *e, files) {
         args << e->fullPath(NoTrailingSlash);
+        if (selection.matchesFolderContents(e->fullPath())) {
+            args << e->fullPath() + m_folderWildcard;
+        }
     }
 
     args.removeAll(QString());
@@ -120,6 +128,21 @@ QStringList CliProperties::extractArgs(const QString &archive, const QStringList
     return args;
 }
 
+QStringList CliProperties::extractToStdoutArgs(const QString &archive, const QString &file, const QString &password)
+{
+    Q_ASSERT(!m_extractToStdoutSwitch.isEmpty());
+
+    QStringList args = m_extractToStdoutSwitch;
+    if (!password.isEmpty()) {
+        args << substitutePasswordSwitch(password);
+    }
+    args << archive;
+    args << file;
+
+    args.removeAll(QString());
+    return args;
+}
+
 QStringList CliProperties::listArgs(const QString &archive, const QString &password)
 {
     QStringList args;
@@ -51,6 +51,7 @@ class KERFUFFLE_EXPORT CliProperties: public QObject
     Q_PROPERTY(QString deleteSwitch MEMBER m_deleteSwitch)
     Q_PROPERTY(QStringList extractSwitch MEMBER m_extractSwitch)
     Q_PROPERTY(QStringList extractSwitchNoPreserve MEMBER m_extractSwitchNoPreserve)
+    Q_PROPERTY(QStringList extractToStdoutSwitch MEMBER m_extractToStdoutSwitch)
     Q_PROPERTY(QStringList listSwitch MEMBER m_listSwitch)
     Q_PROPERTY(QString moveSwitch MEMBER m_moveSwitch)
     Q_PROPERTY(QStringList testSwitch MEMBER m_testSwitch)
@@ -61,6 +62,7 @@ class KERFUFFLE_EXPORT CliProperties: public QObject
     Q_PROPERTY(QHash<QString,QVariant> compressionMethodSwitch MEMBER m_compressionMethodSwitch)
     Q_PROPERTY(QHash<QString,QVariant> encryptionMethodSwitch MEMBER m_encryptionMethodSwitch)
     Q_PROPERTY(QString multiVolumeSwitch MEMBER m_multiVolumeSwitch)
+    Q_PROPERTY(QString folderWildcard MEMBER m_folderWildcard)
 
     Q_PROPERTY(QStringList passwordPromptPatterns MEMBER m_passwordPromptPatterns)
     Q_PROPERTY(QStringList wrongPasswordPatterns MEMBER m_wrongPasswordPatterns)
@@ -89,6 +91,7 @@ public:
     QStringList commentArgs(const QString &archive, const QString &commentfile);
     QStringList deleteArgs(const QString &archive, const QVector<Archive::Entry*> &files, const QString &password);
     QStringList extractArgs(const QString &archive, const QStringList &files, bool preservePaths, const QString &password);
+    QStringList extractToStdoutArgs(const QString &archive, const QString &file, const QString &password);
     QStringList listArgs(const QString &archive, const QString &password);
     QStringList moveArgs(const QString &archive, const QVector<Archive::Entry *> &entries, Archive::Entry *destination, const QString &password);
     QStringList testArgs(const QString &archive, const QString &password);
@@ -121,6 +124,7 @@ private:
     QString m_deleteSwitch;
     QStringList m_extractSwitch;
     QStringList m_extractSwitchNoPreserve;
+    QStringList m_extractToStdoutSwitch;
     QStringList m_listSwitch;
     QString m_moveSwitch;
     QStringList m_testSwitch;
@@ -131,6 +135,7 @@ private:
     QHash<QString,QVariant> m_compressionMethodSwitch;
     QHash<QString,QVariant> m_encryptionMethodSwitch;
     QString m_multiVolumeSwitch;
+    QString m_folderWildcard;
 
     QStringList m_passwordPromptPatterns;
     QStringList m_wrongPasswordPatterns;
@@ -0,0 +1,118 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "compressibility.h"
+
+#include <QMimeDatabase>
+
+#include <cmath>
+
+namespace Kerfuffle
+{
+
+static const int SampleSize = 4096;
+
+// Random data measures about 7.95 bits per byte in a sample of 4 KiB.
+// Deflate hardly gains 1% on such data.
+static const double MinimumEntropy = 7.9;
+
+// Formats whose data is compressed already. The types inheriting from them,
+// e.g. the many formats based on zip, are matched as well.
+static const char *const CompressedMimeTypes[] = {
+    "application/gzip",
+    "application/ogg",
+    "application/vnd.debian.binary-package",
+    "application/vnd.rar",
+    "application/x-7z-compressed",
+    "application/x-bzip",
+    "application/x-compress",
+    "application/x-lz4",
+    "application/x-lzip",
+    "application/x-lzma",
+    "application/x-rar",
+    "application/x-rpm",
+    "application/x-xz",
+    "application/zip",
+    "application/zstd",
+    "audio/aac",
+    "audio/flac",
+    "audio/mp4",
+    "audio/mpeg",
+    "image/gif",
+    "image/jp2",
+    "image/jpeg",
+    "image/png",
+    "image/webp"
+};
+
+static bool isCompressedMimeType(const QMimeType &mimeType)
+{
+    if (mimeType.name().startsWith(QLatin1String("video/"))) {
+        return true;
+    }
+
+    for (const char *name : CompressedMimeTypes) {
+        if (mimeType.inherits(QLatin1String(name))) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static double entropy(const char *data, int size)
+{
+    int counts[256] = {0};
+    for (int i = 0; i < size; ++i) {
+        counts[static_cast<uchar>(data[i])]++;
+    }
+
+    double bits = 0;
+    for (int count : counts) {
+        if (count > 0) {
+            const double probability = double(count) / size;
+            bits -= probability * std::log2(probability);
+        }
+    }
+
+    return bits;
+}
+
+bool isIncompressible(const QString &fileName, const QByteArray &head)
+{
+    QMimeDatabase db;
+    if (isCompressedMimeType(db.mimeTypeForFile(fileName, QMimeDatabase::MatchExtension))) {
+        return true;
+    }
+
+    // Small files are quickly compressed anyway.
+    if (head.size() < SampleSize) {
+        return false;
+    }
+
+    return entropy(head.constData(), SampleSize) >= MinimumEntropy;
+}
+
+}
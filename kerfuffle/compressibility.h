@@ -0,0 +1,47 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef COMPRESSIBILITY_H
+#define COMPRESSIBILITY_H
+
+#include "kerfuffle_export.h"
+
+#include <QByteArray>
+#include <QString>
+
+namespace Kerfuffle
+{
+    /**
+     * Guesses whether compressing a file would be a waste of time, because
+     * its data is already compressed or looks random.
+     *
+     * The file is recognized by the MIME type of @p fileName, such as JPEG
+     * images, videos or archives, or else by the entropy of @p head, the
+     * first bytes of the file. At least 4 KiB are needed for the latter.
+     */
+    KERFUFFLE_EXPORT bool isIncompressible(const QString &fileName, const QByteArray &head);
+}
+
+#endif // COMPRESSIBILITY_H
@@ -59,6 +59,9 @@ CompressionOptionsWidget::CompressionOptionsWidget(QWidget *parent,
         volumeSizeSpinbox->setValue(static_cast<double>(m_opts.volumeSize()) / 1024);
     }
 
+    threadsSpinBox->setValue(m_opts.threadCount());
+    longDistanceCheckBox->setChecked(m_opts.isLongDistanceMatchingEnabled());
+
     warningMsgWidget->setWordWrap(true);
 }
 
@@ -72,6 +75,8 @@ CompressionOptions CompressionOptionsWidget::commpressionOptions() const
     if (!compMethodComboBox->currentText().isEmpty()) {
         opts.setCompressionMethod(compMethodComboBox->currentText());
     }
+    opts.setThreadCount(threadCount());
+    opts.setLongDistanceMatchingEnabled(isLongDistanceMatchingEnabled());
 
     return opts;
 }
@@ -100,6 +105,16 @@ ulong CompressionOptionsWidget::volumeSize() const
     }
 }
 
+int CompressionOptionsWidget::threadCount() const
+{
+    return threadsSpinBox->isEnabled() ? threadsSpinBox->value() : 0;
+}
+
+bool CompressionOptionsWidget::isLongDistanceMatchingEnabled() const
+{
+    return longDistanceCheckBox->isEnabled() && longDistanceCheckBox->isChecked();
+}
+
 void CompressionOptionsWidget::setEncryptionVisible(bool visible)
 {
     collapsibleEncryption->setVisible(visible);
@@ -206,7 +221,22 @@ void CompressionOptionsWidget::updateWidgets()
             compMethodComboBox->setCurrentText(archiveFormat.defaultCompressionMethod());
         }
     }
-    collapsibleCompression->setEnabled(compLevelSlider->isEnabled() || compMethodComboBox->isEnabled());
+
+    // Only the zstd compressor can be told how many threads and how much
+    // memory to use.
+    const bool isZstd = m_mimetype.inherits(QStringLiteral("application/zstd")) ||
+                        m_mimetype.inherits(QStringLiteral("application/x-zstd-compressed-tar"));
+    lblThreads->setEnabled(isZstd);
+    threadsSpinBox->setEnabled(isZstd);
+    longDistanceCheckBox->setEnabled(isZstd);
+    if (isZstd) {
+        threadsSpinBox->setToolTip(QString());
+    } else {
+        threadsSpinBox->setToolTip(i18n("It is not possible to set the number of threads for the %1 format.",
+                                        m_mimetype.comment()));
+    }
+
+    collapsibleCompression->setEnabled(compLevelSlider->isEnabled() || compMethodComboBox->isEnabled() || isZstd);
 
     if (archiveFormat.supportsMultiVolume()) {
         collapsibleMultiVolume->setEnabled(true);
@@ -48,6 +48,8 @@ public:
     QString compressionMethod() const;
     QString encryptionMethod() const;
     ulong volumeSize() const;
+    int threadCount() const;
+    bool isLongDistanceMatchingEnabled() const;
     QString password() const;
     CompressionOptions commpressionOptions() const;
     bool isEncryptionAvailable() const;
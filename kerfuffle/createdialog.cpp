@@ -167,6 +167,16 @@ ulong CreateDialog::volumeSize() const
     return m_ui->optionsWidget->volumeSize();
 }
 
+int CreateDialog::threadCount() const
+{
+    return m_ui->optionsWidget->threadCount();
+}
+
+bool CreateDialog::isLongDistanceMatchingEnabled() const
+{
+    return m_ui->optionsWidget->isLongDistanceMatchingEnabled();
+}
+
 QString CreateDialog::password() const
 {
     return m_ui->optionsWidget->password();
@@ -62,6 +62,8 @@ public:
     QString compressionMethod() const;
     QString encryptionMethod() const;
     ulong volumeSize() const;
+    int threadCount() const;
+    bool isLongDistanceMatchingEnabled() const;
 
     /**
      * @return Whether the user can encrypt the new archive.
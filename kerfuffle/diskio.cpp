@@ -0,0 +1,91 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "diskio.h"
+
+#include <QFile>
+
+#include <errno.h>
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Kerfuffle
+{
+
+bool preallocateFile(int fd, qint64 size)
+{
+    if (size <= 0) {
+        return true;
+    }
+
+#ifdef Q_OS_LINUX
+    // Unlike posix_fallocate(), fallocate() doesn't fall back to writing
+    // zeros where it isn't supported, which would double the writes.
+    if (fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, size) == 0) {
+        return true;
+    }
+    return errno != ENOSPC && errno != EFBIG;
+#else
+    Q_UNUSED(fd)
+    return true;
+#endif
+}
+
+bool syncFileSystem(const QString &path)
+{
+#ifdef Q_OS_LINUX
+    const int fd = open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+
+    const bool success = (syncfs(fd) == 0);
+    const int error = errno;
+    close(fd);
+    errno = error;
+    return success;
+#elif defined(Q_OS_UNIX)
+    Q_UNUSED(path)
+    sync();
+    return true;
+#else
+    Q_UNUSED(path)
+    return true;
+#endif
+}
+
+bool syncFile(int fd)
+{
+#ifdef Q_OS_UNIX
+    return fsync(fd) == 0;
+#else
+    Q_UNUSED(fd)
+    return true;
+#endif
+}
+
+}
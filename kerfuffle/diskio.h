@@ -0,0 +1,61 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DISKIO_H
+#define DISKIO_H
+
+#include "kerfuffle_export.h"
+
+#include <QString>
+
+namespace Kerfuffle
+{
+    /**
+     * Allocates the disk space for the first @p size bytes of the file open
+     * as @p fd, without changing its size. Filesystems which can't do it
+     * are ignored.
+     *
+     * @return false if there isn't enough space, with errno set.
+     */
+    KERFUFFLE_EXPORT bool preallocateFile(int fd, qint64 size);
+
+    /**
+     * Flushes to disk the data written to the filesystem which contains
+     * @p path. Where syncfs() isn't available, all filesystems are synced.
+     *
+     * @return Whether the data has been written, otherwise errno is set.
+     */
+    KERFUFFLE_EXPORT bool syncFileSystem(const QString &path);
+
+    /**
+     * Flushes to disk the data written to the file open as @p fd. Platforms
+     * without fsync() are ignored.
+     *
+     * @return Whether the data has been written, otherwise errno is set.
+     */
+    KERFUFFLE_EXPORT bool syncFile(int fd);
+}
+
+#endif // DISKIO_H
@@ -0,0 +1,117 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "entryselection.h"
+
+#include <QSet>
+
+namespace Kerfuffle
+{
+
+EntrySelection::EntrySelection()
+{
+}
+
+EntrySelection::EntrySelection(const QStringList &paths)
+{
+    m_indexes.reserve(paths.size());
+
+    // Collect all the folders containing a selected path. Walking up stops at
+    // the first folder already known, so each folder is visited only once.
+    QSet<QString> parentFolders;
+    for (int i = 0; i < paths.size(); ++i) {
+        const QString &path = paths.at(i);
+        if (!m_indexes.contains(path)) {
+            m_indexes.insert(path, i);
+        }
+
+        int slash = path.lastIndexOf(QLatin1Char('/'), -2);
+        while (slash > 0) {
+            const QString parent = path.left(slash + 1);
+            if (parentFolders.contains(parent)) {
+                break;
+            }
+            parentFolders.insert(parent);
+            slash = path.lastIndexOf(QLatin1Char('/'), slash - 1);
+        }
+    }
+
+    for (auto it = m_indexes.constBegin(); it != m_indexes.constEnd(); ++it) {
+        if (it.key().endsWith(QLatin1Char('/')) && !parentFolders.contains(it.key())) {
+            m_folderPrefixes.insert(it.key(), it.value());
+        }
+    }
+}
+
+bool EntrySelection::isEmpty() const
+{
+    return m_indexes.isEmpty();
+}
+
+int EntrySelection::count() const
+{
+    return m_indexes.size();
+}
+
+int EntrySelection::indexOf(const QString &path) const
+{
+    const auto it = m_indexes.constFind(path);
+    if (it != m_indexes.constEnd()) {
+        return it.value();
+    }
+
+    if (m_folderPrefixes.isEmpty()) {
+        return -1;
+    }
+
+    // Look for the innermost selected folder containing the path.
+    int slash = path.lastIndexOf(QLatin1Char('/'), -2);
+    while (slash > 0) {
+        const auto prefix = m_folderPrefixes.constFind(path.left(slash + 1));
+        if (prefix != m_folderPrefixes.constEnd()) {
+            return prefix.value();
+        }
+        slash = path.lastIndexOf(QLatin1Char('/'), slash - 1);
+    }
+
+    return -1;
+}
+
+bool EntrySelection::contains(const QString &path) const
+{
+    return indexOf(path) != -1;
+}
+
+bool EntrySelection::matchesFolderContents(const QString &folder) const
+{
+    return m_folderPrefixes.contains(folder);
+}
+
+bool EntrySelection::hasFolderPrefixes() const
+{
+    return !m_folderPrefixes.isEmpty();
+}
+
+}
@@ -0,0 +1,93 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ENTRYSELECTION_H
+#define ENTRYSELECTION_H
+
+#include "kerfuffle_export.h"
+
+#include <QHash>
+#include <QStringList>
+
+namespace Kerfuffle
+{
+
+/**
+ * A set of selected archive paths, meant to be matched against every entry
+ * of an archive while it is being read.
+ *
+ * Lookups are hashed, so matching a whole archive against the selection costs
+ * O(entries) no matter how many paths are selected.
+ *
+ * A selected folder (i.e. a path with a trailing slash) whose contents are not
+ * selected themselves also matches everything below it. If any path below the
+ * folder is selected, only the explicitly selected paths match. This way a
+ * whole subtree can be selected by its folder alone, without listing all of
+ * its entries.
+ */
+class KERFUFFLE_EXPORT EntrySelection
+{
+public:
+
+    EntrySelection();
+    explicit EntrySelection(const QStringList &paths);
+
+    bool isEmpty() const;
+
+    /**
+     * @return The number of selected paths.
+     */
+    int count() const;
+
+    /**
+     * @return The index in the selected paths of the path matching @p path:
+     * either @p path itself or the innermost selected folder containing it.
+     * If nothing matches, -1 is returned.
+     */
+    int indexOf(const QString &path) const;
+
+    bool contains(const QString &path) const;
+
+    /**
+     * @return Whether @p folder is a selected folder that also matches its
+     * contents, i.e. none of the paths below it is selected.
+     */
+    bool matchesFolderContents(const QString &folder) const;
+
+    /**
+     * @return Whether some selected folder matches its contents too. If not,
+     * an archive can be read only until all the selected paths have been found.
+     */
+    bool hasFolderPrefixes() const;
+
+private:
+
+    QHash<QString, int> m_indexes;
+    QHash<QString, int> m_folderPrefixes;
+};
+
+}
+
+#endif // ENTRYSELECTION_H
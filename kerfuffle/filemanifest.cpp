@@ -0,0 +1,228 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "filemanifest.h"
+#include "ark_debug.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QtConcurrentMap>
+
+#ifdef Q_OS_UNIX
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Kerfuffle
+{
+
+typedef QVector<FileManifest::Item> Items;
+
+static bool lstatPath(const QString &path, struct stat *st)
+{
+#ifdef Q_OS_UNIX
+    return lstat(QFile::encodeName(path).constData(), st) == 0;
+#else
+    return ::stat(QFile::encodeName(path).constData(), st) == 0;
+#endif
+}
+
+static FileManifest::Item makeItem(const QString &path, const struct stat &st)
+{
+    FileManifest::Item item;
+    item.path = path;
+    item.isDir = ((st.st_mode & S_IFMT) == S_IFDIR);
+#ifdef Q_OS_UNIX
+    item.isSymLink = S_ISLNK(st.st_mode);
+#else
+    item.isSymLink = false;
+#endif
+    item.stat = st;
+
+    if (item.isDir) {
+        item.path += QLatin1Char('/');
+    }
+
+    return item;
+}
+
+/**
+ * @return The readable entries of @p folder, without descending into subfolders.
+ */
+static Items readFolder(const QString &folder)
+{
+    Items items;
+
+#ifdef Q_OS_UNIX
+    // Each entry is stat'ed relative to the open folder, so that its path
+    // is not resolved again for every entry.
+    DIR *dir = opendir(QFile::encodeName(folder).constData());
+    if (!dir) {
+        qCWarning(ARK) << "Could not read folder" << folder;
+        return items;
+    }
+
+    const int dirFd = dirfd(dir);
+    while (struct dirent *entry = readdir(dir)) {
+        if (qstrcmp(entry->d_name, ".") == 0 || qstrcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+
+        struct stat st;
+        if (fstatat(dirFd, entry->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            continue;
+        }
+
+        // FIFOs, sockets and device nodes are not archived: reading
+        // them could block forever or never end.
+        if (!S_ISREG(st.st_mode) && !S_ISDIR(st.st_mode) && !S_ISLNK(st.st_mode)) {
+            continue;
+        }
+
+        // Like QDir::Readable, skip what cannot be read anyway.
+        if (!S_ISLNK(st.st_mode) && faccessat(dirFd, entry->d_name, R_OK, 0) != 0) {
+            continue;
+        }
+
+        items.append(makeItem(folder + QLatin1Char('/') + QFile::decodeName(entry->d_name), st));
+    }
+
+    closedir(dir);
+#else
+    const QStringList names = QDir(folder).entryList(QDir::AllEntries | QDir::Readable | QDir::Hidden | QDir::NoDotAndDotDot);
+    foreach (const QString &name, names) {
+        const QString path = folder + QLatin1Char('/') + name;
+        struct stat st;
+        if (lstatPath(path, &st)) {
+            items.append(makeItem(path, st));
+        }
+    }
+#endif
+
+    return items;
+}
+
+/**
+ * @return The contents of @p folder, each subfolder followed by its own contents.
+ */
+static Items scanFolder(const QString &folder)
+{
+    Items items;
+
+    foreach (const FileManifest::Item &item, readFolder(folder)) {
+        items.append(item);
+        if (item.isDir) {
+            items += scanFolder(item.path.left(item.path.size() - 1));
+        }
+    }
+
+    return items;
+}
+
+FileManifest::FileManifest()
+    : m_totalSize(0)
+{
+}
+
+FileManifest FileManifest::scan(const QStringList &paths)
+{
+    FileManifest manifest;
+
+    foreach (const QString &path, paths) {
+        struct stat st;
+        if (!lstatPath(path, &st)) {
+            qCWarning(ARK) << "Could not stat" << path;
+            continue;
+        }
+
+        Item item = makeItem(path, st);
+        item.path = path;
+        item.isDir = QFileInfo(path).isDir();
+        manifest.m_items.append(item);
+
+        if (!item.isDir) {
+            continue;
+        }
+
+        // The subfolders are scanned in parallel, then the contents of each
+        // of them are put back right after it.
+        QString folder = path;
+        if (folder.endsWith(QLatin1Char('/'))) {
+            folder.chop(1);
+        }
+
+        const Items children = readFolder(folder);
+        QStringList subfolders;
+        foreach (const Item &child, children) {
+            if (child.isDir) {
+                subfolders.append(child.path.left(child.path.size() - 1));
+            }
+        }
+
+        const QVector<Items> subfolderContents = QtConcurrent::blockingMapped<QVector<Items> >(subfolders, scanFolder);
+
+        int subfolderIndex = 0;
+        foreach (const Item &child, children) {
+            manifest.m_items.append(child);
+            if (child.isDir) {
+                manifest.m_items += subfolderContents.at(subfolderIndex++);
+            }
+        }
+    }
+
+    foreach (const Item &item, manifest.m_items) {
+        if ((item.stat.st_mode & S_IFMT) == S_IFREG) {
+            manifest.m_totalSize += item.stat.st_size;
+        }
+    }
+
+    qCDebug(ARK) << "Scanned" << manifest.count() << "files," << manifest.m_totalSize << "bytes";
+
+    return manifest;
+}
+
+bool FileManifest::isEmpty() const
+{
+    return m_items.isEmpty();
+}
+
+int FileManifest::count() const
+{
+    return m_items.size();
+}
+
+qint64 FileManifest::totalSize() const
+{
+    return m_totalSize;
+}
+
+QVector<FileManifest::Item> FileManifest::items() const
+{
+    return m_items;
+}
+
+} // namespace Kerfuffle
@@ -0,0 +1,104 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FILEMANIFEST_H
+#define FILEMANIFEST_H
+
+#include "kerfuffle_export.h"
+
+#include <QStringList>
+#include <QVector>
+
+#include <sys/stat.h>
+
+namespace Kerfuffle
+{
+
+/**
+ * An immutable list of the files to be added to an archive, together with
+ * their stat data.
+ *
+ * The given paths are walked only once, the subfolders of each of them in
+ * parallel. AddJob takes the totals from the manifest and the plugins write
+ * the files it lists, so that no folder is read and no file is stat'ed twice.
+ *
+ * The items are in the order of the given paths, each folder being followed
+ * by its contents.
+ */
+class KERFUFFLE_EXPORT FileManifest
+{
+public:
+
+    struct Item
+    {
+        /**
+         * The path of the file: either one of the scanned paths, or a path
+         * below one of them. Paths of folders found below the scanned paths
+         * end with a slash.
+         */
+        QString path;
+
+        /**
+         * Whether the file is a folder. For a scanned path symlinks are
+         * followed, as its contents are scanned as well.
+         */
+        bool isDir;
+
+        bool isSymLink;
+
+        /**
+         * The lstat() data of the file.
+         */
+        struct stat stat;
+    };
+
+    FileManifest();
+
+    /**
+     * Scans @p paths and the contents of the folders among them. Relative
+     * paths are resolved against the current directory.
+     */
+    static FileManifest scan(const QStringList &paths);
+
+    bool isEmpty() const;
+    int count() const;
+
+    /**
+     * @return The sum of the sizes of all the regular files.
+     */
+    qint64 totalSize() const;
+
+    QVector<Item> items() const;
+
+private:
+    QVector<Item> m_items;
+    qint64 m_totalSize;
+};
+
+} // namespace Kerfuffle
+
+Q_DECLARE_TYPEINFO(Kerfuffle::FileManifest::Item, Q_MOVABLE_TYPE);
+
+#endif // FILEMANIFEST_H
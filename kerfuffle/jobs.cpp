@@ -29,11 +29,14 @@
 #include "jobs.h"
 #include "archiveentry.h"
 #include "ark_debug.h"
+#include "previewcache.h"
+#include "settings.h"
 
+#include <QCoreApplication>
 #include <QDir>
-#include <QDirIterator>
 #include <QFileInfo>
 #include <QRegularExpression>
+#include <QStorageInfo>
 #include <QThread>
 #include <QTimer>
 #include <QUrl>
@@ -308,8 +311,8 @@ bool LoadJob::isSingleFolderArchive() const
 
 void LoadJob::onNewEntry(const Archive::Entry *entry)
 {
-    m_extractedFilesSize += entry->property("size").toLongLong();
-    m_isPasswordProtected |= entry->property("isPasswordProtected").toBool();
+    m_extractedFilesSize += entry->size();
+    m_isPasswordProtected |= entry->isPasswordProtected();
 
     if (entry->isDir()) {
         m_dirCount++;
@@ -343,9 +346,8 @@ QString LoadJob::subfolderName() const
     return m_subfolderName;
 }
 
-BatchExtractJob::BatchExtractJob(LoadJob *loadJob, const QString &destination, bool autoSubfolder, bool preservePaths)
-    : Job(loadJob->archive())
-    , m_loadJob(loadJob)
+BatchExtractJob::BatchExtractJob(Archive *archive, const QString &destination, bool autoSubfolder, bool preservePaths)
+    : Job(archive)
     , m_destination(destination)
     , m_autoSubfolder(autoSubfolder)
     , m_preservePaths(preservePaths)
@@ -355,95 +357,190 @@ BatchExtractJob::BatchExtractJob(LoadJob *loadJob, const QString &destination, b
 
 void BatchExtractJob::doWork()
 {
-    connect(m_loadJob, &KJob::result, this, &BatchExtractJob::slotLoadingFinished);
-    if (archiveInterface()->hasBatchExtractionProgress()) {
-        // progress() will be actually emitted by the LoadJob, but the archiveInterface() is the same.
-        connect(archiveInterface(), &ReadOnlyArchiveInterface::progress, this, &BatchExtractJob::slotLoadingProgress);
-    }
-
-    // Forward LoadJob's signals.
-    connect(m_loadJob, &Kerfuffle::Job::newEntry, this, &BatchExtractJob::newEntry);
-    connect(m_loadJob, &Kerfuffle::Job::userQuery, this, &BatchExtractJob::userQuery);
-    m_loadJob->start();
+    // The ExtractJob must be created from the thread of this job.
+    QMetaObject::invokeMethod(this, "slotStartExtraction", Qt::QueuedConnection);
 }
 
 bool BatchExtractJob::doKill()
 {
-    if (m_step == Loading) {
-        return m_loadJob->kill();
+    // The extraction may not have been started yet.
+    if (!m_extractJob) {
+        m_killed = true;
+        return true;
     }
 
     return m_extractJob->kill();
 }
 
-void BatchExtractJob::slotLoadingProgress(double progress)
+void BatchExtractJob::slotStartExtraction()
 {
-    // Progress from LoadJob counts only for 50% of the BatchExtractJob's duration.
-    m_lastPercentage = static_cast<unsigned long>(50.0*progress);
-    setPercent(m_lastPercentage);
+    if (m_killed) {
+        return;
+    }
+
+    QString extractionDestination = m_destination;
+
+    // Whether a subfolder is needed is known only once the top-level entries
+    // have been extracted. Staging them on the destination filesystem makes
+    // the final move a cheap rename.
+    if (m_autoSubfolder) {
+        m_stagingDir.reset(new QTemporaryDir(QDir(m_destination).absoluteFilePath(QStringLiteral(".%1-").arg(QCoreApplication::applicationName()))));
+        if (!m_stagingDir->isValid()) {
+            onError(xi18nc("@info", "Could not create a temporary folder in <filename>%1</filename>.", m_destination), QString());
+            onFinished(false);
+            return;
+        }
+        extractionDestination = m_stagingDir->path();
+        qCDebug(ARK) << "Extracting to staging folder" << extractionDestination;
+    }
+
+    Kerfuffle::ExtractionOptions options;
+    options.setPreservePaths(m_preservePaths);
+    options.setPreallocateFiles(ArkSettings::preallocateExtractedFiles());
+    options.setSyncMode(static_cast<Kerfuffle::ExtractionOptions::SyncMode>(ArkSettings::syncExtractedFiles()));
+
+    m_extractJob = archive()->extractFiles({}, extractionDestination, options);
+    if (!m_extractJob) {
+        onFinished(false);
+        return;
+    }
+
+    connect(m_extractJob, &KJob::result, this, &BatchExtractJob::slotExtractionFinished);
+    connect(m_extractJob, &Kerfuffle::Job::userQuery, this, &BatchExtractJob::userQuery);
+    if (archiveInterface()->hasBatchExtractionProgress()) {
+        connect(archiveInterface(), &ReadOnlyArchiveInterface::progress, this, &BatchExtractJob::slotExtractProgress);
+    }
+    m_extractJob->start();
 }
 
 void BatchExtractJob::slotExtractProgress(double progress)
 {
-    // The 2nd 50% of the BatchExtractJob's duration comes from the ExtractJob.
-    setPercent(m_lastPercentage + static_cast<unsigned long>(50.0*progress));
+    setPercent(static_cast<unsigned long>(100.0*progress));
 }
 
-void BatchExtractJob::slotLoadingFinished(KJob *job)
+void BatchExtractJob::slotExtractionFinished(KJob *job)
 {
     if (job->error()) {
-        // Forward errors as well.
-        onError(job->errorString(), QString());
-        onFinished(false);
+        setError(job->error());
+        setErrorText(job->errorText());
+        emitResult();
         return;
     }
 
-    // Now we can start extraction.
-    setupDestination();
+    if (m_stagingDir && !moveStagedFiles()) {
+        if (!error()) {
+            setError(KJob::UserDefinedError);
+            setErrorText(xi18nc("@info", "Could not move the extracted files to <filename>%1</filename>.", m_destination));
+        }
+    }
+
+    // Don't leave the staging folder behind until this job is deleted.
+    m_stagingDir.reset();
 
-    Kerfuffle::ExtractionOptions options;
-    options.setPreservePaths(m_preservePaths);
+    emitResult();
+}
+
+bool BatchExtractJob::moveStagedFiles()
+{
+    const QDir destinationDir(m_destination);
+    const QFileInfoList topLevelEntries = QDir(m_stagingDir->path()).entryInfoList(QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot);
+    if (topLevelEntries.isEmpty()) {
+        return true;
+    }
+
+    const QFileInfo firstEntry = topLevelEntries.first();
+    const bool isSingleFolder = (topLevelEntries.size() == 1 && firstEntry.isDir() && !firstEntry.isSymLink());
+    const bool isSingleFolderRPM = (isSingleFolder && archive()->mimeType().name() == QLatin1String("application/x-rpm"));
+
+    if (isSingleFolder && !isSingleFolderRPM) {
+        qCDebug(ARK) << "Detected single folder archive, moving" << firstEntry.fileName() << "to" << m_destination;
+        return mergeInto(firstEntry.absoluteFilePath(), destinationDir.absoluteFilePath(firstEntry.fileName()));
+    }
+
+    QString subfolderName = isSingleFolder ? firstEntry.fileName() : archive()->completeBaseName();
+
+    // Special case for single folder RPM archives.
+    // We don't want the autodetected folder to have a meaningless "usr" name.
+    if (isSingleFolderRPM && subfolderName == QStringLiteral("usr")) {
+        qCDebug(ARK) << "Detected single folder RPM archive. Using archive basename as subfolder name";
+        subfolderName = QFileInfo(archive()->fileName()).completeBaseName();
+    }
+
+    if (destinationDir.exists(subfolderName)) {
+        subfolderName = KIO::suggestName(QUrl::fromUserInput(m_destination, QString(), QUrl::AssumeLocalFile), subfolderName);
+    }
+
+    // The staging folder is only accessible to the user, so the subfolder is
+    // created with the usual permissions and the entries are moved into it.
+    const QString subfolderPath = destinationDir.absoluteFilePath(subfolderName);
+    if (!destinationDir.mkdir(subfolderName)) {
+        qCWarning(ARK) << "Could not create" << subfolderPath;
+        return false;
+    }
 
-    m_extractJob = archive()->extractFiles({}, m_destination, options);
-    if (m_extractJob) {
-        connect(m_extractJob, &KJob::result, this, &BatchExtractJob::emitResult);
-        connect(m_extractJob, &Kerfuffle::Job::userQuery, this, &BatchExtractJob::userQuery);
-        if (archiveInterface()->hasBatchExtractionProgress()) {
-            // The LoadJob is done, change slot and start setting the percentage from m_lastPercentage on.
-            disconnect(archiveInterface(), &ReadOnlyArchiveInterface::progress, this, &BatchExtractJob::slotLoadingProgress);
-            connect(archiveInterface(), &ReadOnlyArchiveInterface::progress, this, &BatchExtractJob::slotExtractProgress);
+    m_destination = subfolderPath;
+
+    foreach (const QFileInfo &entry, topLevelEntries) {
+        const QString entryPath = subfolderPath + QLatin1Char('/') + entry.fileName();
+        if (!QDir().rename(entry.absoluteFilePath(), entryPath)) {
+            qCWarning(ARK) << "Could not rename" << entry.absoluteFilePath() << "to" << entryPath;
+            return false;
         }
-        m_step = Extracting;
-        m_extractJob->start();
-    } else {
-        emitResult();
     }
+
+    return true;
 }
 
-void BatchExtractJob::setupDestination()
+bool BatchExtractJob::mergeInto(const QString &source, const QString &destination)
 {
-    const bool isSingleFolderRPM = (archive()->isSingleFolder() &&
-                                   (archive()->mimeType().name() == QLatin1String("application/x-rpm")));
+    const QFileInfo sourceInfo(source);
+    const QFileInfo destinationInfo(destination);
 
-    if (m_autoSubfolder && (!archive()->isSingleFolder() || isSingleFolderRPM)) {
-        const QDir d(m_destination);
-        QString subfolderName = archive()->subfolderName();
+    if (!destinationInfo.exists() && !destinationInfo.isSymLink()) {
+        return QDir().rename(source, destination);
+    }
 
-        // Special case for single folder RPM archives.
-        // We don't want the autodetected folder to have a meaningless "usr" name.
-        if (isSingleFolderRPM && subfolderName == QStringLiteral("usr")) {
-            qCDebug(ARK) << "Detected single folder RPM archive. Using archive basename as subfolder name";
-            subfolderName = QFileInfo(archive()->fileName()).completeBaseName();
+    if (sourceInfo.isDir() && !sourceInfo.isSymLink() && destinationInfo.isDir()) {
+        const QStringList children = QDir(source).entryList(QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot);
+        foreach (const QString &child, children) {
+            if (!mergeInto(source + QLatin1Char('/') + child, destination + QLatin1Char('/') + child)) {
+                return false;
+            }
         }
+        return true;
+    }
 
-        if (d.exists(subfolderName)) {
-            subfolderName = KIO::suggestName(QUrl::fromUserInput(m_destination, QString(), QUrl::AssumeLocalFile), subfolderName);
-        }
+    if (m_skipAll) {
+        return true;
+    }
 
-        d.mkdir(subfolderName);
+    if (!m_overwriteAll) {
+        // This job runs in the main thread, so the query can be executed directly.
+        Kerfuffle::OverwriteQuery query(destination);
+        query.execute();
+
+        if (query.responseCancelled()) {
+            setError(KJob::KilledJobError);
+            return false;
+        } else if (query.responseSkip()) {
+            return true;
+        } else if (query.responseAutoSkip()) {
+            m_skipAll = true;
+            return true;
+        } else if (query.responseRename()) {
+            return mergeInto(source, query.newFilename());
+        } else if (query.responseOverwriteAll()) {
+            m_overwriteAll = true;
+        }
+    }
 
-        m_destination += QLatin1Char( '/' ) + subfolderName;
+    // Folders are never replaced by files, or the other way around.
+    if (sourceInfo.isDir() != destinationInfo.isDir()) {
+        qCWarning(ARK) << "Cannot overwrite" << destination << "with" << source;
+        return false;
     }
+
+    return QFile::remove(destination) && QDir().rename(source, destination);
 }
 
 CreateJob::CreateJob(Archive *archive, const QVector<Archive::Entry*> &entries, const CompressionOptions &options)
@@ -512,6 +609,21 @@ void ExtractJob::doWork()
         return;
     }
 
+    // The files are going to be allocated anyway, better fail before writing any.
+    // The size of the whole archive is unknown (0) if it was not listed, as
+    // in batch extractions: then only the preallocation of each file, which
+    // fails before writing it, guards against running out of space.
+    if (m_options.preallocateFiles()) {
+        const qulonglong requiredSpace = m_entries.isEmpty() ? m_unpackedSize : extractedSize(m_entries);
+        const QStorageInfo storage(destDirInfo.isDir() ? m_destinationDir : destDirInfo.absolutePath());
+        if (storage.isValid() && static_cast<qulonglong>(storage.bytesAvailable()) < requiredSpace) {
+            qCWarning(ARK) << "Extraction needs" << requiredSpace << "bytes, only" << storage.bytesAvailable() << "are available";
+            onError(xi18n("There is not enough free space in <filename>%1</filename> to extract the archive.", m_destinationDir), QString());
+            onFinished(false);
+            return;
+        }
+    }
+
     connectToArchiveInterfaceSignals();
 
     qCDebug(ARK) << "Starting extraction with" << m_entries.count() << "selected files."
@@ -526,6 +638,20 @@ void ExtractJob::doWork()
     }
 }
 
+void ExtractJob::setUnpackedSize(qulonglong size)
+{
+    m_unpackedSize = size;
+}
+
+qulonglong ExtractJob::extractedSize(const QVector<Archive::Entry*> &entries)
+{
+    qulonglong size = 0;
+    foreach (const Archive::Entry *entry, entries) {
+        size += entry->isDir() ? extractedSize(entry->entries()) : entry->size();
+    }
+    return size;
+}
+
 QString ExtractJob::destinationDirectory() const
 {
     return m_destinationDir;
@@ -537,16 +663,36 @@ ExtractionOptions ExtractJob::extractionOptions() const
 }
 
 TempExtractJob::TempExtractJob(Archive::Entry *entry, bool passwordProtectedHint, ReadOnlyArchiveInterface *interface)
+    : TempExtractJob(QVector<Archive::Entry*> {entry}, passwordProtectedHint, interface)
+{
+}
+
+TempExtractJob::TempExtractJob(const QVector<Archive::Entry*> &entries, bool passwordProtectedHint, ReadOnlyArchiveInterface *interface)
     : Job(interface)
-    , m_entry(entry)
+    , m_entries(entries)
     , m_passwordProtectedHint(passwordProtectedHint)
 {
+    Q_ASSERT(!m_entries.isEmpty());
     m_tmpExtractDir = new QTemporaryDir();
 }
 
 QString TempExtractJob::validatedFilePath() const
 {
-    QString path = extractionDir() + QLatin1Char('/') + m_entry->fullPath();
+    return validatedFilePath(m_entries.first());
+}
+
+QStringList TempExtractJob::validatedFilePaths() const
+{
+    QStringList paths;
+    foreach (const Archive::Entry *entry, m_entries) {
+        paths << validatedFilePath(entry);
+    }
+    return paths;
+}
+
+QString TempExtractJob::validatedFilePath(const Archive::Entry *entry) const
+{
+    QString path = extractionDir() + QLatin1Char('/') + entry->fullPath();
 
     // Make sure a maliciously crafted archive with parent folders named ".." do
     // not cause the previewed file path to be located outside the temporary
@@ -572,40 +718,84 @@ QTemporaryDir *TempExtractJob::tempDir() const
     return m_tmpExtractDir;
 }
 
+void TempExtractJob::setPreviewCache(PreviewCache *cache)
+{
+    m_previewCache = cache;
+}
+
 void TempExtractJob::doWork()
 {
-    emit description(this, i18n("Extracting one file"));
+    emit description(this, i18np("Extracting one file", "Extracting %1 files", m_entries.count()));
+
+    m_uncachedEntries.clear();
+    foreach (Archive::Entry *entry, m_entries) {
+        if (!m_previewCache || !m_previewCache->restore(archiveInterface()->filename(), entry, validatedFilePath(entry))) {
+            m_uncachedEntries << entry;
+        }
+    }
+
+    if (m_uncachedEntries.isEmpty()) {
+        qCDebug(ARK) << "All entries restored from the preview cache:" << m_entries;
+        onFinished(true);
+        return;
+    }
 
     connectToArchiveInterfaceSignals();
 
-    qCDebug(ARK) << "Extracting:" << m_entry;
+    qCDebug(ARK) << "Extracting:" << m_uncachedEntries;
 
-    bool ret = archiveInterface()->extractFiles({m_entry}, extractionDir(), extractionOptions());
+    bool ret = archiveInterface()->extractFiles(m_uncachedEntries, extractionDir(), extractionOptions());
 
     if (!archiveInterface()->waitForFinishedSignal()) {
         onFinished(ret);
     }
 }
 
+void TempExtractJob::onFinished(bool result)
+{
+    if (result && m_previewCache) {
+        foreach (const Archive::Entry *entry, m_uncachedEntries) {
+            m_previewCache->insert(archiveInterface()->filename(), entry, validatedFilePath(entry));
+        }
+    }
+
+    Job::onFinished(result);
+}
+
 QString TempExtractJob::extractionDir() const
 {
     return m_tmpExtractDir->path();
 }
 
 PreviewJob::PreviewJob(Archive::Entry *entry, bool passwordProtectedHint, ReadOnlyArchiveInterface *interface)
-    : TempExtractJob(entry, passwordProtectedHint, interface)
+    : PreviewJob(QVector<Archive::Entry*> {entry}, passwordProtectedHint, interface)
+{
+}
+
+PreviewJob::PreviewJob(const QVector<Archive::Entry*> &entries, bool passwordProtectedHint, ReadOnlyArchiveInterface *interface)
+    : TempExtractJob(entries, passwordProtectedHint, interface)
 {
     qCDebug(ARK) << "PreviewJob created";
 }
 
 OpenJob::OpenJob(Archive::Entry *entry, bool passwordProtectedHint, ReadOnlyArchiveInterface *interface)
-    : TempExtractJob(entry, passwordProtectedHint, interface)
+    : OpenJob(QVector<Archive::Entry*> {entry}, passwordProtectedHint, interface)
+{
+}
+
+OpenJob::OpenJob(const QVector<Archive::Entry*> &entries, bool passwordProtectedHint, ReadOnlyArchiveInterface *interface)
+    : TempExtractJob(entries, passwordProtectedHint, interface)
 {
     qCDebug(ARK) << "OpenJob created";
 }
 
 OpenWithJob::OpenWithJob(Archive::Entry *entry, bool passwordProtectedHint, ReadOnlyArchiveInterface *interface)
-    : OpenJob(entry, passwordProtectedHint, interface)
+    : OpenWithJob(QVector<Archive::Entry*> {entry}, passwordProtectedHint, interface)
+{
+}
+
+OpenWithJob::OpenWithJob(const QVector<Archive::Entry*> &entries, bool passwordProtectedHint, ReadOnlyArchiveInterface *interface)
+    : OpenJob(entries, passwordProtectedHint, interface)
 {
     qCDebug(ARK) << "OpenWithJob created";
 }
@@ -630,26 +820,6 @@ void AddJob::doWork()
         QDir::setCurrent(globalWorkDir);
     }
 
-    // Count total number of entries to be added.
-    uint totalCount = 0;
-    QElapsedTimer timer;
-    timer.start();
-    foreach (const Archive::Entry* entry, m_entries) {
-        totalCount++;
-        if (QFileInfo(entry->fullPath()).isDir()) {
-            QDirIterator it(entry->fullPath(), QDir::AllEntries | QDir::Readable | QDir::Hidden | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
-            while (it.hasNext()) {
-                it.next();
-                totalCount++;
-            }
-        }
-    }
-
-    qCDebug(ARK) << "AddJob: going to add" << totalCount << "entries, counted in" << timer.elapsed() << "ms";
-
-    QString desc = i18np("Adding a file", "Adding %1 files", totalCount);
-    emit description(this, desc, qMakePair(i18n("Archive"), archiveInterface()->filename()));
-
     ReadWriteArchiveInterface *m_writeInterface =
         qobject_cast<ReadWriteArchiveInterface*>(archiveInterface());
 
@@ -669,7 +839,23 @@ void AddJob::doWork()
         entry->setFullPath(relativePath);
     }
 
+    // Scan the files to be added only once: the plugin writes the files
+    // listed in the manifest instead of walking the folders again.
+    QElapsedTimer timer;
+    timer.start();
+    const FileManifest manifest = FileManifest::scan(ReadOnlyArchiveInterface::entryFullPaths(m_entries));
+    const uint totalCount = manifest.count();
+
+    qCDebug(ARK) << "AddJob: going to add" << totalCount << "entries," << manifest.totalSize() << "bytes, scanned in" << timer.elapsed() << "ms";
+
+    QString desc = i18np("Adding a file", "Adding %1 files", totalCount);
+    emit description(this, desc, qMakePair(i18n("Archive"), archiveInterface()->filename()));
+    setTotalAmount(KJob::Files, totalCount);
+    setTotalAmount(KJob::Bytes, manifest.totalSize());
+
     connectToArchiveInterfaceSignals();
+    connect(m_writeInterface, &ReadWriteArchiveInterface::bytesProcessed, this, &AddJob::onBytesProcessed);
+    m_writeInterface->setFileManifest(manifest);
     bool ret = m_writeInterface->addFiles(m_entries, m_destination, m_options, totalCount);
 
     if (!archiveInterface()->waitForFinishedSignal()) {
@@ -677,12 +863,23 @@ void AddJob::doWork()
     }
 }
 
+void AddJob::onBytesProcessed(qulonglong bytes)
+{
+    setProcessedAmount(KJob::Bytes, bytes);
+}
+
 void AddJob::onFinished(bool result)
 {
     if (!m_oldWorkingDir.isEmpty()) {
         QDir::setCurrent(m_oldWorkingDir);
     }
 
+    // Don't keep the possibly huge manifest around.
+    auto writeInterface = qobject_cast<ReadWriteArchiveInterface*>(archiveInterface());
+    if (writeInterface) {
+        writeInterface->setFileManifest(FileManifest());
+    }
+
     Job::onFinished(result);
 }
 
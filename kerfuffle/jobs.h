@@ -43,6 +43,8 @@
 namespace Kerfuffle
 {
 
+class PreviewCache;
+
 class KERFUFFLE_EXPORT Job : public KJob
 {
     Q_OBJECT
@@ -149,18 +151,18 @@ private slots:
 
 /**
  * Perform a batch extraction of an existing archive.
- * Internally it runs a LoadJob before the actual extraction,
- * to figure out properties such as the subfolder name.
+ * The archive is read only once: when a subfolder might be needed, it is
+ * extracted to a staging folder inside the destination, and its top-level
+ * entries tell whether the staging folder becomes the subfolder.
  */
 class KERFUFFLE_EXPORT BatchExtractJob : public Job
 {
     Q_OBJECT
 
 public:
-    explicit BatchExtractJob(LoadJob *loadJob, const QString &destination, bool autoSubfolder, bool preservePaths);
+    explicit BatchExtractJob(Archive *archive, const QString &destination, bool autoSubfolder, bool preservePaths);
 
 signals:
-    void newEntry(Archive::Entry *entry);
     void userQuery(Query *query);
 
 public slots:
@@ -170,26 +172,34 @@ protected:
     virtual bool doKill() Q_DECL_OVERRIDE;
 
 private slots:
-    void slotLoadingProgress(double progress);
+    void slotStartExtraction();
     void slotExtractProgress(double progress);
-    void slotLoadingFinished(KJob *job);
+    void slotExtractionFinished(KJob *job);
 
 private:
 
     /**
-     * Tracks whether the job is loading or extracting the archive.
+     * Moves the contents of the staging folder to the destination, creating
+     * a subfolder unless the archive consists of a single folder.
+     * @return Whether all the contents have been moved.
      */
-    enum Step {Loading, Extracting};
+    bool moveStagedFiles();
 
-    void setupDestination();
+    /**
+     * Moves @p source to @p destination, merging folders which already exist
+     * and asking the user what to do with already existing files.
+     * @return Whether @p source has been moved, or skipped by the user.
+     */
+    bool mergeInto(const QString &source, const QString &destination);
 
-    Step m_step = Loading;
     ExtractJob *m_extractJob = Q_NULLPTR;
-    LoadJob *m_loadJob;
+    QScopedPointer<QTemporaryDir> m_stagingDir;
     QString m_destination;
     bool m_autoSubfolder;
     bool m_preservePaths;
-    unsigned long m_lastPercentage = 0;
+    bool m_overwriteAll = false;
+    bool m_skipAll = false;
+    bool m_killed = false;
 };
 
 /**
@@ -235,20 +245,35 @@ public:
     QString destinationDirectory() const;
     ExtractionOptions extractionOptions() const;
 
+    /**
+     * Sets the @p size of all the files in the archive, as found by the LoadJob.
+     * It is checked against the free space of the destination if the whole
+     * archive is extracted with preallocated files. If the archive has not
+     * been listed, e.g. by a BatchExtractJob, the size is 0 and not checked.
+     */
+    void setUnpackedSize(qulonglong size);
+
 public slots:
     virtual void doWork() Q_DECL_OVERRIDE;
 
 private:
 
+    /**
+     * @return The size of @p entries, including the contents of folders.
+     */
+    static qulonglong extractedSize(const QVector<Archive::Entry*> &entries);
+
     QVector<Archive::Entry*> m_entries;
     QString m_destinationDir;
     ExtractionOptions m_options;
+    qulonglong m_unpackedSize = 0;
 };
 
 /**
- * Abstract base class for jobs that extract a single file to a temporary dir.
+ * Abstract base class for jobs that extract files to a temporary dir.
+ * Several files are extracted together in a single pass over the archive.
  * It's not possible to pass extraction options and paths will be always preserved.
- * The only option that the job needs to know is whether the file is password protected.
+ * The only option that the job needs to know is whether the files are password protected.
  */
 class KERFUFFLE_EXPORT TempExtractJob : public Job
 {
@@ -256,13 +281,20 @@ class KERFUFFLE_EXPORT TempExtractJob : public Job
 
 public:
     TempExtractJob(Archive::Entry *entry, bool passwordProtectedHint, ReadOnlyArchiveInterface *interface);
+    TempExtractJob(const QVector<Archive::Entry*> &entries, bool passwordProtectedHint, ReadOnlyArchiveInterface *interface);
 
     /**
-     * @return The absolute path of the extracted file.
+     * @return The absolute path of the (first) extracted file.
      * The path is validated in order to prevent directory traversal attacks.
      */
     QString validatedFilePath() const;
 
+    /**
+     * @return The validated absolute paths of all the extracted files, in the
+     * order of the entries passed to the job.
+     */
+    QStringList validatedFilePaths() const;
+
     ExtractionOptions extractionOptions() const;
 
     /**
@@ -271,13 +303,25 @@ public:
      */
     QTemporaryDir *tempDir() const;
 
+    /**
+     * Entries found in @p cache are restored from it instead of being
+     * extracted, and the extracted ones are added to it.
+     */
+    void setPreviewCache(PreviewCache *cache);
+
 public slots:
     virtual void doWork() Q_DECL_OVERRIDE;
 
+protected slots:
+    virtual void onFinished(bool result) Q_DECL_OVERRIDE;
+
 private:
     QString extractionDir() const;
+    QString validatedFilePath(const Archive::Entry *entry) const;
 
-    Archive::Entry *m_entry;
+    QVector<Archive::Entry*> m_entries;
+    QVector<Archive::Entry*> m_uncachedEntries;
+    PreviewCache *m_previewCache = Q_NULLPTR;
     QTemporaryDir *m_tmpExtractDir;
     bool m_passwordProtectedHint;
 };
@@ -292,6 +336,7 @@ class KERFUFFLE_EXPORT PreviewJob : public TempExtractJob
 
 public:
     PreviewJob(Archive::Entry *entry, bool passwordProtectedHint, ReadOnlyArchiveInterface *interface);
+    PreviewJob(const QVector<Archive::Entry*> &entries, bool passwordProtectedHint, ReadOnlyArchiveInterface *interface);
 };
 
 /**
@@ -304,6 +349,7 @@ class KERFUFFLE_EXPORT OpenJob : public TempExtractJob
 
 public:
     OpenJob(Archive::Entry *entry, bool passwordProtectedHint, ReadOnlyArchiveInterface *interface);
+    OpenJob(const QVector<Archive::Entry*> &entries, bool passwordProtectedHint, ReadOnlyArchiveInterface *interface);
 };
 
 class KERFUFFLE_EXPORT OpenWithJob : public OpenJob
@@ -312,6 +358,7 @@ class KERFUFFLE_EXPORT OpenWithJob : public OpenJob
 
 public:
     OpenWithJob(Archive::Entry *entry, bool passwordProtectedHint, ReadOnlyArchiveInterface *interface);
+    OpenWithJob(const QVector<Archive::Entry*> &entries, bool passwordProtectedHint, ReadOnlyArchiveInterface *interface);
 };
 
 class KERFUFFLE_EXPORT AddJob : public Job
@@ -327,6 +374,9 @@ public slots:
 protected slots:
     virtual void onFinished(bool result) Q_DECL_OVERRIDE;
 
+private slots:
+    void onBytesProcessed(qulonglong bytes);
+
 private:
     QString m_oldWorkingDir;
     const QVector<Archive::Entry*> m_entries;
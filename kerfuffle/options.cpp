@@ -70,6 +70,26 @@ void ExtractionOptions::setAlwaysUseTempDir(bool alwaysUseTempDir)
     m_alwaysUseTempDir = alwaysUseTempDir;
 }
 
+bool ExtractionOptions::preallocateFiles() const
+{
+    return m_preallocateFiles;
+}
+
+void ExtractionOptions::setPreallocateFiles(bool preallocate)
+{
+    m_preallocateFiles = preallocate;
+}
+
+ExtractionOptions::SyncMode ExtractionOptions::syncMode() const
+{
+    return m_syncMode;
+}
+
+void ExtractionOptions::setSyncMode(SyncMode mode)
+{
+    m_syncMode = mode;
+}
+
 bool CompressionOptions::isCompressionLevelSet() const
 {
     return compressionLevel() != -1;
@@ -130,6 +150,36 @@ void CompressionOptions::setGlobalWorkDir(const QString &workDir)
     m_globalWorkDir = workDir;
 }
 
+bool CompressionOptions::storeIncompressibleFiles() const
+{
+    return m_storeIncompressibleFiles;
+}
+
+void CompressionOptions::setStoreIncompressibleFiles(bool store)
+{
+    m_storeIncompressibleFiles = store;
+}
+
+int CompressionOptions::threadCount() const
+{
+    return m_threadCount;
+}
+
+void CompressionOptions::setThreadCount(int count)
+{
+    m_threadCount = count;
+}
+
+bool CompressionOptions::isLongDistanceMatchingEnabled() const
+{
+    return m_longDistanceMatching;
+}
+
+void CompressionOptions::setLongDistanceMatchingEnabled(bool enabled)
+{
+    m_longDistanceMatching = enabled;
+}
+
 QDebug operator<<(QDebug d, const CompressionOptions &options)
 {
     d.nospace() << "(encryption hint: " << options.encryptedArchiveHint();
@@ -144,6 +194,13 @@ QDebug operator<<(QDebug d, const CompressionOptions &options)
     }
     d.nospace() << ", compression level: " << options.compressionLevel();
     d.nospace() << ", volume size: " << options.volumeSize();
+    d.nospace() << ", store incompressible files: " << options.storeIncompressibleFiles();
+    if (options.threadCount() > 0) {
+        d.nospace() << ", threads: " << options.threadCount();
+    }
+    if (options.isLongDistanceMatchingEnabled()) {
+        d.nospace() << ", long distance matching";
+    }
     d.nospace() << ")";
     return d.space();
 }
@@ -154,6 +211,8 @@ QDebug operator<<(QDebug d, const ExtractionOptions &options)
     d.nospace() << ", preserve paths: " << options.preservePaths();
     d.nospace() << ", drag and drop: " << options.isDragAndDropEnabled();
     d.nospace() << ", always temp dir: " << options.alwaysUseTempDir();
+    d.nospace() << ", preallocate files: " << options.preallocateFiles();
+    d.nospace() << ", sync mode: " << options.syncMode();
     d.nospace() << ")";
     return d.space();
 }
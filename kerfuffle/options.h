@@ -76,18 +76,54 @@ public:
     QString globalWorkDir() const;
     void setGlobalWorkDir(const QString &workDir);
 
+    /**
+     * @return Whether files which would hardly get smaller, such as JPEG
+     * images or videos, are stored instead of compressed. Only formats with
+     * a compression method per entry can do this. The default is true.
+     * @see Kerfuffle::isIncompressible()
+     */
+    bool storeIncompressibleFiles() const;
+    void setStoreIncompressibleFiles(bool store);
+
+    /**
+     * @return The number of threads the compressor may use, or 0 to use one
+     * per CPU core. Only some compression methods, e.g. zstd, use threads.
+     */
+    int threadCount() const;
+    void setThreadCount(int count);
+
+    /**
+     * @return Whether the compressor looks for matches far back in the data.
+     * This pays off for big archives with repeated content, but needs more
+     * memory both to compress and to decompress. Only zstd supports it.
+     */
+    bool isLongDistanceMatchingEnabled() const;
+    void setLongDistanceMatchingEnabled(bool enabled);
+
 private:
     int m_compressionLevel = -1;
     ulong m_volumeSize = 0;
     QString m_compressionMethod;
     QString m_encryptionMethod;
     QString m_globalWorkDir;
+    bool m_storeIncompressibleFiles = true;
+    int m_threadCount = 0;
+    bool m_longDistanceMatching = false;
 };
 
 class KERFUFFLE_EXPORT ExtractionOptions : public Options
 {
 public:
 
+    /**
+     * When the extracted files are flushed to disk.
+     */
+    enum SyncMode {
+        NoSync,       ///< The system writes them when it wants to.
+        SyncAtEnd,    ///< The destination filesystem is synced once extraction has finished.
+        SyncEachFile  ///< Each file is synced once written. Slow, but a file is complete on disk as soon as the next one is extracted.
+    };
+
     bool preservePaths() const;
     void setPreservePaths(bool preservePaths);
     bool isDragAndDropEnabled() const;
@@ -95,11 +131,28 @@ public:
     bool alwaysUseTempDir() const;
     void setAlwaysUseTempDir(bool alwaysUseTempDir);
 
+    /**
+     * @return Whether the disk space of each extracted file of known size is
+     * allocated before writing it, and the free space of the destination is
+     * checked before extracting. The files are then less fragmented and a
+     * full disk is noticed before writing gigabytes. The default is false.
+     */
+    bool preallocateFiles() const;
+    void setPreallocateFiles(bool preallocate);
+
+    /**
+     * @return When the extracted files are flushed to disk. The default is NoSync.
+     */
+    SyncMode syncMode() const;
+    void setSyncMode(SyncMode mode);
+
 private:
 
     bool m_preservePaths = true;
     bool m_dragAndDrop = false;
     bool m_alwaysUseTempDir = false;
+    bool m_preallocateFiles = false;
+    SyncMode m_syncMode = NoSync;
 };
 
 QDebug KERFUFFLE_EXPORT operator<<(QDebug d, const CompressionOptions &options);
@@ -0,0 +1,301 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "previewcache.h"
+#include "ark_debug.h"
+
+#include <QBuffer>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QProcess>
+#include <QTemporaryDir>
+
+namespace Kerfuffle
+{
+
+// Entries up to this size are kept in memory, as long as they fit into
+// s_memoryCacheSize. Bigger ones are copied into a temporary dir of at most
+// s_fileCacheSize KiB.
+static const qint64 s_maxMemoryEntrySize = 4 * 1024 * 1024;
+static const int s_memoryCacheSize = 32 * 1024 * 1024;
+static const int s_fileCacheSize = 512 * 1024;
+
+/**
+ * A copy of an entry in the cache dir, removed when it's dropped from the cache.
+ */
+class CachedFile
+{
+public:
+    explicit CachedFile(const QString &path)
+        : m_path(path)
+    {
+    }
+
+    ~CachedFile()
+    {
+        QFile::remove(m_path);
+    }
+
+    QString path() const
+    {
+        return m_path;
+    }
+
+private:
+    const QString m_path;
+};
+
+/**
+ * Passes the data of a streamed entry through, keeping a copy of it. The copy
+ * is stored in the cache when the device is deleted after all of the entry
+ * has been read.
+ */
+class CachingDevice : public QIODevice
+{
+public:
+    CachingDevice(const QSharedPointer<PreviewCache> &cache, const QString &cacheKey, QIODevice *source)
+        : m_cache(cache)
+        , m_cacheKey(cacheKey)
+        , m_source(source)
+        , m_process(qobject_cast<QProcess*>(source))
+    {
+        m_source->setParent(this);
+
+        connect(m_source, &QIODevice::readyRead, this, &QIODevice::readyRead);
+        if (m_process) {
+            // The data of a process may still be read after its output has
+            // been closed, only its exit code tells whether it's complete.
+            connect(m_process, static_cast<void (QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished),
+                    this, &QIODevice::readChannelFinished);
+        } else {
+            connect(m_source, &QIODevice::readChannelFinished, this, &QIODevice::readChannelFinished);
+        }
+
+        open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+    }
+
+    virtual ~CachingDevice()
+    {
+        if (m_isCacheable && isSourceFinished()) {
+            if (m_process && (m_process->exitStatus() != QProcess::NormalExit || m_process->exitCode() != 0)) {
+                qCWarning(ARK) << "Streaming process failed with exit code" << m_process->exitCode();
+            } else {
+                m_cache->insertData(m_cacheKey, m_data);
+            }
+        }
+    }
+
+    virtual bool isSequential() const Q_DECL_OVERRIDE
+    {
+        return true;
+    }
+
+    virtual qint64 bytesAvailable() const Q_DECL_OVERRIDE
+    {
+        return m_source->bytesAvailable() + QIODevice::bytesAvailable();
+    }
+
+    virtual bool atEnd() const Q_DECL_OVERRIDE
+    {
+        return isSourceFinished();
+    }
+
+    virtual bool waitForReadyRead(int msecs) Q_DECL_OVERRIDE
+    {
+        return m_source->waitForReadyRead(msecs);
+    }
+
+protected:
+    virtual qint64 readData(char *data, qint64 maxSize) Q_DECL_OVERRIDE
+    {
+        const qint64 readBytes = m_source->read(data, maxSize);
+        if (readBytes > 0 && m_isCacheable) {
+            if (m_data.size() + readBytes > s_maxMemoryEntrySize) {
+                m_isCacheable = false;
+                m_data.clear();
+            } else {
+                m_data.append(data, static_cast<int>(readBytes));
+            }
+        }
+        return readBytes;
+    }
+
+    virtual qint64 writeData(const char *data, qint64 maxSize) Q_DECL_OVERRIDE
+    {
+        Q_UNUSED(data)
+        Q_UNUSED(maxSize)
+        return -1;
+    }
+
+private:
+    bool isSourceFinished() const
+    {
+        return m_process ? (m_process->state() == QProcess::NotRunning && m_process->atEnd())
+                         : m_source->atEnd();
+    }
+
+    const QSharedPointer<PreviewCache> m_cache;
+    const QString m_cacheKey;
+    QIODevice *m_source;
+    QProcess *m_process;
+    QByteArray m_data;
+    bool m_isCacheable = true;
+};
+
+PreviewCache::PreviewCache()
+    : m_memoryCache(s_memoryCacheSize)
+    , m_fileCache(s_fileCacheSize)
+{
+}
+
+PreviewCache::~PreviewCache()
+{
+    // The cached files must be removed before their dir.
+    m_fileCache.clear();
+}
+
+QString PreviewCache::key(const QString &archiveFileName, const Archive::Entry *entry) const
+{
+    const QFileInfo archiveInfo(archiveFileName);
+
+    return QStringLiteral("%1:%2:%3\n%4:%5:%6:%7").arg(archiveInfo.absoluteFilePath())
+                                                  .arg(archiveInfo.size())
+                                                  .arg(archiveInfo.lastModified().toMSecsSinceEpoch())
+                                                  .arg(entry->fullPath())
+                                                  .arg(entry->size())
+                                                  .arg(entry->crc())
+                                                  .arg(entry->timestampSecs());
+}
+
+bool PreviewCache::restore(const QString &archiveFileName, const Archive::Entry *entry, const QString &filePath)
+{
+    const QString cacheKey = key(archiveFileName, entry);
+    QMutexLocker locker(&m_mutex);
+
+    const QByteArray *data = m_memoryCache.object(cacheKey);
+    const CachedFile *cachedFile = data ? Q_NULLPTR : m_fileCache.object(cacheKey);
+    if (!data && !cachedFile) {
+        return false;
+    }
+
+    QFileInfo(filePath).dir().mkpath(QStringLiteral("."));
+
+    if (data) {
+        QFile file(filePath);
+        if (!file.open(QIODevice::WriteOnly) || file.write(*data) != data->size()) {
+            qCWarning(ARK) << "Could not write cached entry to" << filePath;
+            return false;
+        }
+    } else if (!QFile::copy(cachedFile->path(), filePath)) {
+        qCWarning(ARK) << "Could not copy cached entry to" << filePath;
+        return false;
+    }
+
+    qCDebug(ARK) << "Restored" << entry->fullPath() << "from the preview cache";
+    return true;
+}
+
+QIODevice *PreviewCache::device(const QString &archiveFileName, const Archive::Entry *entry)
+{
+    const QString cacheKey = key(archiveFileName, entry);
+    QMutexLocker locker(&m_mutex);
+
+    const QByteArray *data = m_memoryCache.object(cacheKey);
+    if (data) {
+        qCDebug(ARK) << "Streaming" << entry->fullPath() << "from the preview cache";
+        QBuffer *buffer = new QBuffer;
+        buffer->setData(*data);
+        buffer->open(QIODevice::ReadOnly);
+        return buffer;
+    }
+
+    const CachedFile *cachedFile = m_fileCache.object(cacheKey);
+    if (cachedFile) {
+        QFile *file = new QFile(cachedFile->path());
+        if (file->open(QIODevice::ReadOnly)) {
+            qCDebug(ARK) << "Streaming" << entry->fullPath() << "from the preview cache";
+            return file;
+        }
+        qCWarning(ARK) << "Could not open cached entry" << cachedFile->path();
+        delete file;
+    }
+
+    return Q_NULLPTR;
+}
+
+QIODevice *PreviewCache::cachingDevice(const QSharedPointer<PreviewCache> &cache, const QString &archiveFileName, const Archive::Entry *entry, QIODevice *device)
+{
+    return new CachingDevice(cache, cache->key(archiveFileName, entry), device);
+}
+
+void PreviewCache::insertData(const QString &cacheKey, const QByteArray &data)
+{
+    QMutexLocker locker(&m_mutex);
+    m_memoryCache.insert(cacheKey, new QByteArray(data), data.size());
+}
+
+void PreviewCache::insert(const QString &archiveFileName, const Archive::Entry *entry, const QString &filePath)
+{
+    const QFileInfo fileInfo(filePath);
+    if (!fileInfo.isFile()) {
+        return;
+    }
+
+    const QString cacheKey = key(archiveFileName, entry);
+    QMutexLocker locker(&m_mutex);
+
+    if (fileInfo.size() <= s_maxMemoryEntrySize) {
+        QFile file(filePath);
+        if (file.open(QIODevice::ReadOnly)) {
+            QByteArray *data = new QByteArray(file.readAll());
+            m_memoryCache.insert(cacheKey, data, data->size());
+        }
+        return;
+    }
+
+    const qint64 cost = fileInfo.size() / 1024;
+    if (cost > s_fileCacheSize) {
+        return;
+    }
+
+    if (!m_cacheDir) {
+        m_cacheDir.reset(new QTemporaryDir);
+    }
+    if (!m_cacheDir->isValid()) {
+        return;
+    }
+
+    const QString cachedPath = m_cacheDir->path() + QLatin1Char('/') + QString::number(m_nextFileNumber++);
+    if (!QFile::copy(filePath, cachedPath)) {
+        qCWarning(ARK) << "Could not copy" << filePath << "into the preview cache";
+        return;
+    }
+    m_fileCache.insert(cacheKey, new CachedFile(cachedPath), static_cast<int>(cost));
+}
+
+}
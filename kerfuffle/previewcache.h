@@ -0,0 +1,105 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PREVIEWCACHE_H
+#define PREVIEWCACHE_H
+
+#include "archiveentry.h"
+#include "kerfuffle_export.h"
+
+#include <QCache>
+#include <QMutex>
+#include <QScopedPointer>
+#include <QSharedPointer>
+
+class QIODevice;
+class QTemporaryDir;
+
+namespace Kerfuffle
+{
+
+class CachedFile;
+class CachingDevice;
+
+/**
+ * Keeps the data of the most recently previewed entries of an archive, so
+ * that previewing them again doesn't need to extract them again.
+ *
+ * Small entries are kept in memory, bigger ones in a temporary dir. Both are
+ * bounded and the least recently used entries are dropped first. An entry is
+ * identified by its path, size, CRC and timestamp, together with the path,
+ * size and modification time of the archive file.
+ *
+ * The cache can be used from any thread.
+ */
+class KERFUFFLE_EXPORT PreviewCache
+{
+public:
+    PreviewCache();
+    ~PreviewCache();
+
+    /**
+     * Writes the cached data of @p entry of @p archiveFileName to @p filePath.
+     * @return Whether the entry was cached and has been written.
+     */
+    bool restore(const QString &archiveFileName, const Archive::Entry *entry, const QString &filePath);
+
+    /**
+     * Stores the contents of @p filePath, which has just been extracted, as
+     * the data of @p entry of @p archiveFileName.
+     */
+    void insert(const QString &archiveFileName, const Archive::Entry *entry, const QString &filePath);
+
+    /**
+     * @return A device reading the cached data of @p entry of
+     * @p archiveFileName, or Q_NULLPTR if the entry is not cached.
+     */
+    QIODevice *device(const QString &archiveFileName, const Archive::Entry *entry);
+
+    /**
+     * Wraps @p device, which streams @p entry of @p archiveFileName, so that
+     * its data is stored in @p cache once it has all been read. Entries too
+     * big to be kept in memory are not stored.
+     *
+     * @return The wrapping device, which owns @p device.
+     */
+    static QIODevice *cachingDevice(const QSharedPointer<PreviewCache> &cache, const QString &archiveFileName, const Archive::Entry *entry, QIODevice *device);
+
+private:
+    friend class CachingDevice;
+
+    QString key(const QString &archiveFileName, const Archive::Entry *entry) const;
+    void insertData(const QString &cacheKey, const QByteArray &data);
+
+    QMutex m_mutex;
+    QCache<QString, QByteArray> m_memoryCache;
+    QCache<QString, CachedFile> m_fileCache;
+    QScopedPointer<QTemporaryDir> m_cacheDir;
+    int m_nextFileNumber = 0;
+};
+
+}
+
+#endif // PREVIEWCACHE_H
@@ -86,16 +86,16 @@ QVariant ArchiveModel::data(const QModelIndex &index, int role) const
                     uint files;
                     entry->countChildren(dirs, files);
                     return KIO::itemsSummaryString(dirs + files, files, dirs, 0, false);
-                } else if (!entry->property("link").toString().isEmpty()) {
+                } else if (!entry->link().isEmpty()) {
                     return QVariant();
                 } else {
-                    return KIO::convertSize(entry->property("size").toULongLong());
+                    return KIO::convertSize(entry->size());
                 }
             case CompressedSize:
-                if (entry->isDir() || !entry->property("link").toString().isEmpty()) {
+                if (entry->isDir() || !entry->link().isEmpty()) {
                     return QVariant();
                 } else {
-                    qulonglong compressedSize = entry->property("compressedSize").toULongLong();
+                    qulonglong compressedSize = entry->compressedSize();
                     if (compressedSize != 0) {
                         return KIO::convertSize(compressedSize);
                     } else {
@@ -103,11 +103,11 @@ QVariant ArchiveModel::data(const QModelIndex &index, int role) const
                     }
                 }
             case Ratio: // TODO: Use entry->metaData()[Ratio] when available.
-                if (entry->isDir() || !entry->property("link").toString().isEmpty()) {
+                if (entry->isDir() || !entry->link().isEmpty()) {
                     return QVariant();
                 } else {
-                    qulonglong compressedSize = entry->property("compressedSize").toULongLong();
-                    qulonglong size = entry->property("size").toULongLong();
+                    qulonglong compressedSize = entry->compressedSize();
+                    qulonglong size = entry->size();
                     if (compressedSize == 0 || size == 0) {
                         return QVariant();
                     } else {
@@ -117,10 +117,23 @@ QVariant ArchiveModel::data(const QModelIndex &index, int role) const
                 }
 
             case Timestamp: {
-                const QDateTime timeStamp = entry->property("timestamp").toDateTime();
+                const QDateTime timeStamp = entry->timestamp();
                 return QLocale().toString(timeStamp, QLocale::ShortFormat);
             }
 
+            case Permissions:
+                return entry->permissions();
+            case Owner:
+                return entry->owner();
+            case Group:
+                return entry->group();
+            case CRC:
+                return entry->crc();
+            case Method:
+                return entry->method();
+            case Version:
+                return entry->version();
+
             default:
                 return entry->property(m_propertiesMap[column]);
             }
@@ -134,7 +147,7 @@ QVariant ArchiveModel::data(const QModelIndex &index, int role) const
             return QVariant();
         case Qt::FontRole: {
             QFont f;
-            f.setItalic(entry->property("isPasswordProtected").toBool());
+            f.setItalic(entry->isPasswordProtected());
             return f;
         }
         default:
@@ -204,7 +217,7 @@ QModelIndex ArchiveModel::index(int row, int column, const QModelIndex &parent)
                                             ? static_cast<Archive::Entry*>(parent.internalPointer())
                                             : m_rootEntry.data();
 
-        Q_ASSERT(parentEntry->isDir());
+        Q_ASSERT(parentEntry->isDir() || parentEntry->isNestedArchive());
 
         const Archive::Entry *item = parentEntry->entries().value(row, Q_NULLPTR);
         if (item != Q_NULLPTR) {
@@ -244,7 +257,7 @@ int ArchiveModel::rowCount(const QModelIndex &parent) const
                                             ? static_cast<Archive::Entry*>(parent.internalPointer())
                                             : m_rootEntry.data();
 
-        if (parentEntry && parentEntry->isDir()) {
+        if (parentEntry && (parentEntry->isDir() || parentEntry->isNestedArchive())) {
             return parentEntry->entries().count();
         }
     }
@@ -315,6 +328,11 @@ bool ArchiveModel::dropMimeData(const QMimeData *data, Qt::DropAction action, in
     QModelIndex droppedOnto = index(row, column, parent);
     if (droppedOnto.isValid()) {
         entry = entryForIndex(droppedOnto);
+        // Nested archives are read-only, files dropped into them are added next to them.
+        const Archive::Entry *container = nestedArchiveContainer(entry);
+        if (container) {
+            entry = container;
+        }
         if (!entry->isDir()) {
             entry = entry->getParent();
         }
@@ -345,7 +363,7 @@ QString ArchiveModel::cleanFileName(const QString& fileName)
 void ArchiveModel::initRootEntry()
 {
     m_rootEntry.reset(new Archive::Entry());
-    m_rootEntry->setProperty("isDirectory", true);
+    m_rootEntry->setIsDirectory(true);
 }
 
 Archive::Entry *ArchiveModel::parentFor(const Archive::Entry *entry, InsertBehaviour behaviour)
@@ -388,10 +406,10 @@ Archive::Entry *ArchiveModel::parentFor(const Archive::Entry *entry, InsertBehav
             // and then delete the existing one (see ArchiveModel::newEntry).
             entry = new Archive::Entry(parent);
 
-            entry->setProperty("fullPath", (parent == m_rootEntry.data())
-                                           ? piece + QLatin1Char('/')
-                                           : parent->fullPath(WithTrailingSlash) + piece + QLatin1Char('/'));
-            entry->setProperty("isDirectory", true);
+            entry->setFullPath((parent == m_rootEntry.data())
+                               ? piece + QLatin1Char('/')
+                               : parent->fullPath(WithTrailingSlash) + piece + QLatin1Char('/'));
+            entry->setIsDirectory(true);
             insertEntry(entry, behaviour);
         }
         if (!entry->isDir()) {
@@ -415,7 +433,7 @@ QModelIndex ArchiveModel::indexForEntry(Archive::Entry *entry)
     Q_ASSERT(entry);
     if (entry != m_rootEntry.data()) {
         Q_ASSERT(entry->getParent());
-        Q_ASSERT(entry->getParent()->isDir());
+        Q_ASSERT(entry->getParent()->isDir() || entry->getParent()->isNestedArchive());
         return createIndex(entry->row(), 0, entry);
     }
     return QModelIndex();
@@ -434,6 +452,10 @@ void ArchiveModel::slotEntryRemoved(const QString & path)
         QModelIndex index = indexForEntry(entry);
         Q_UNUSED(index);
 
+        if (entry->isNestedArchive()) {
+            closeNestedArchive(entry);
+        }
+
         beginRemoveRows(indexForEntry(parent), entry->row(), entry->row());
         m_entryIcons.remove(parent->entries().at(entry->row())->fullPath(NoTrailingSlash));
         parent->removeEntryAt(entry->row());
@@ -495,24 +517,24 @@ void ArchiveModel::newEntry(Archive::Entry *receivedEntry, InsertBehaviour behav
     if (entryFileName.isEmpty()) { // The entry contains only "." or "./"
         return;
     }
-    receivedEntry->setProperty("fullPath", entryFileName);
+    receivedEntry->setFullPath(entryFileName);
 
     // For some archive formats (e.g. AppImage and RPM) paths of folders do not
     // contain a trailing slash, so we append it.
-    if (receivedEntry->property("isDirectory").toBool() &&
-        !receivedEntry->property("fullPath").toString().endsWith(QLatin1Char('/'))) {
-        receivedEntry->setProperty("fullPath", receivedEntry->property("fullPath").toString() + QLatin1Char('/'));
-        qCDebug(ARK) << "Trailing slash appended to entry:" << receivedEntry->property("fullPath");
+    if (receivedEntry->isDir() &&
+        !receivedEntry->fullPath().endsWith(QLatin1Char('/'))) {
+        receivedEntry->setFullPath(receivedEntry->fullPath() + QLatin1Char('/'));
+        qCDebug(ARK) << "Trailing slash appended to entry:" << receivedEntry->fullPath();
     }
 
     // Skip already created entries.
     Archive::Entry *existing = m_rootEntry->findByPath(entryFileName.split(QLatin1Char('/')));
     if (existing) {
-        existing->setProperty("fullPath", entryFileName);
+        existing->setFullPath(entryFileName);
         // Multi-volume files are repeated at least in RAR archives.
         // In that case, we need to sum the compressed size for each volume
-        qulonglong currentCompressedSize = existing->property("compressedSize").toULongLong();
-        existing->setProperty("compressedSize", currentCompressedSize + receivedEntry->property("compressedSize").toULongLong());
+        qulonglong currentCompressedSize = existing->compressedSize();
+        existing->setCompressedSize(currentCompressedSize + receivedEntry->compressedSize());
         return;
     }
 
@@ -524,13 +546,54 @@ void ArchiveModel::newEntry(Archive::Entry *receivedEntry, InsertBehaviour behav
     Archive::Entry *entry = parent->find(path.last());
     if (entry) {
         entry->copyMetaData(receivedEntry);
-        entry->setProperty("fullPath", entryFileName);
+        entry->setFullPath(entryFileName);
     } else {
         receivedEntry->setParent(parent);
         insertEntry(receivedEntry, behaviour);
     }
 }
 
+void ArchiveModel::newNestedEntry(Archive::Entry *container, Archive::Entry *receivedEntry)
+{
+    QString entryFileName = cleanFileName(receivedEntry->fullPath());
+    if (entryFileName.isEmpty()) {
+        return;
+    }
+
+    // Find the parent within the nested archive, creating missing folders in the process.
+    QStringList pieces = entryFileName.split(QLatin1Char('/'), QString::SkipEmptyParts);
+    const QString name = pieces.takeLast();
+    Archive::Entry *parent = container;
+    foreach (const QString &piece, pieces) {
+        Archive::Entry *folder = parent->find(piece);
+        if (!folder) {
+            folder = new Archive::Entry(parent);
+            folder->setFullPath(parent->fullPath(NoTrailingSlash) + QLatin1Char('/') + piece + QLatin1Char('/'));
+            folder->setIsDirectory(true);
+            insertEntry(folder);
+        } else if (!folder->isDir()) {
+            qCDebug(ARK) << "Skipping nested entry" << entryFileName << "below a file";
+            return;
+        }
+        parent = folder;
+    }
+
+    entryFileName = parent->fullPath(NoTrailingSlash) + QLatin1Char('/') + name;
+    if (receivedEntry->isDir()) {
+        entryFileName += QLatin1Char('/');
+    }
+
+    Archive::Entry *entry = parent->find(name);
+    if (entry) {
+        entry->copyMetaData(receivedEntry);
+        entry->setFullPath(entryFileName);
+    } else {
+        receivedEntry->setFullPath(entryFileName);
+        receivedEntry->setParent(parent);
+        insertEntry(receivedEntry);
+    }
+}
+
 void ArchiveModel::slotLoadingFinished(KJob *job)
 {
     if (!job->error()) {
@@ -575,6 +638,8 @@ Kerfuffle::Archive* ArchiveModel::archive() const
 
 void ArchiveModel::reset()
 {
+    qDeleteAll(m_nestedArchives);
+    m_nestedArchives.clear();
     m_archive.reset(Q_NULLPTR);
     s_previousMatch = Q_NULLPTR;
     s_previousPieces->clear();
@@ -606,6 +671,123 @@ KJob *ArchiveModel::loadArchive(const QString &path, const QString &mimeType, QO
     return loadJob;
 }
 
+KJob *ArchiveModel::loadNestedArchive(Archive::Entry *entry)
+{
+    Q_ASSERT(m_archive);
+    Q_ASSERT(!entry->isDir());
+
+    // Only archives stored directly in the loaded one can be browsed.
+    if (entry->isNestedArchive() || nestedArchiveContainer(entry)) {
+        return Q_NULLPTR;
+    }
+
+    Archive *nestedArchive = Archive::createNested(m_archive.data(), entry, this);
+    if (!nestedArchive->isValid()) {
+        delete nestedArchive;
+        return Q_NULLPTR;
+    }
+
+    entry->setIsNestedArchive(true);
+    m_nestedArchives.insert(entry, nestedArchive);
+
+    LoadJob *loadJob = new LoadJob(nestedArchive);
+    connect(loadJob, &KJob::result, this, &ArchiveModel::slotNestedLoadingFinished);
+    connect(loadJob, &Job::newEntry, this, [=](Archive::Entry *nestedEntry) {
+        newNestedEntry(entry, nestedEntry);
+    });
+    connect(loadJob, &Job::userQuery, this, &ArchiveModel::slotUserQuery);
+
+    return loadJob;
+}
+
+void ArchiveModel::slotNestedLoadingFinished(KJob *job)
+{
+    if (!job->error()) {
+        return;
+    }
+
+    Archive::Entry *container = m_nestedArchives.key(qobject_cast<LoadJob*>(job)->archive());
+    if (container) {
+        closeNestedArchive(container);
+    }
+}
+
+void ArchiveModel::closeNestedArchive(Archive::Entry *container)
+{
+    if (!container->entries().isEmpty()) {
+        forgetNestedEntries(container);
+        beginRemoveRows(indexForEntry(container), 0, container->entries().count() - 1);
+        while (!container->entries().isEmpty()) {
+            container->removeEntryAt(0);
+        }
+        endRemoveRows();
+    }
+
+    // The only children of a file entry are the folders created by newNestedEntry().
+    qDeleteAll(container->children());
+
+    container->setIsNestedArchive(false);
+    // Also schedules the deletion of the entries listed by its plugin.
+    delete m_nestedArchives.take(container);
+}
+
+void ArchiveModel::forgetNestedEntries(Archive::Entry *entry)
+{
+    foreach (Archive::Entry *child, entry->entries()) {
+        if (m_nestedArchives.contains(child)) {
+            closeNestedArchive(child);
+        } else {
+            forgetNestedEntries(child);
+        }
+        m_entryIcons.remove(child->fullPath(NoTrailingSlash));
+    }
+}
+
+Archive::Entry *ArchiveModel::nestedArchiveContainer(const Archive::Entry *entry) const
+{
+    if (m_nestedArchives.isEmpty()) {
+        return Q_NULLPTR;
+    }
+
+    for (Archive::Entry *parent = entry->getParent(); parent; parent = parent->getParent()) {
+        if (parent->isNestedArchive()) {
+            return parent;
+        }
+    }
+
+    return Q_NULLPTR;
+}
+
+Archive *ArchiveModel::archiveForEntries(const QVector<Archive::Entry*> &entries, QVector<Archive::Entry*> &archiveEntries) const
+{
+    Archive::Entry *container = entries.isEmpty() ? Q_NULLPTR : nestedArchiveContainer(entries.first());
+    Archive *archive = container ? m_nestedArchives.value(container) : m_archive.data();
+    const QString prefix = container ? container->fullPath(NoTrailingSlash) + QLatin1Char('/') : QString();
+
+    archiveEntries.clear();
+    foreach (Archive::Entry *entry, entries) {
+        if (nestedArchiveContainer(entry) != container) {
+            qCDebug(ARK) << "Leaving out" << entry->fullPath() << "which belongs to another archive";
+            continue;
+        }
+
+        if (!container) {
+            archiveEntries << entry;
+            continue;
+        }
+
+        Archive::Entry *nestedEntry = new Archive::Entry(archive);
+        nestedEntry->copyMetaData(entry);
+        nestedEntry->setFullPath(entry->fullPath().mid(prefix.length()));
+        if (entry->rootNode.startsWith(prefix)) {
+            nestedEntry->rootNode = entry->rootNode.mid(prefix.length());
+        }
+        archiveEntries << nestedEntry;
+    }
+
+    return archive;
+}
+
 ExtractJob* ArchiveModel::extractFile(Archive::Entry *file, const QString& destinationDir, const Kerfuffle::ExtractionOptions& options) const
 {
     QVector<Archive::Entry*> files({file});
@@ -615,31 +797,39 @@ ExtractJob* ArchiveModel::extractFile(Archive::Entry *file, const QString& desti
 ExtractJob* ArchiveModel::extractFiles(const QVector<Archive::Entry*>& files, const QString& destinationDir, const Kerfuffle::ExtractionOptions& options) const
 {
     Q_ASSERT(m_archive);
-    ExtractJob *newJob = m_archive->extractFiles(files, destinationDir, options);
+    QVector<Archive::Entry*> archiveFiles;
+    Archive *archive = archiveForEntries(files, archiveFiles);
+    ExtractJob *newJob = archive->extractFiles(archiveFiles, destinationDir, options);
     connect(newJob, &ExtractJob::userQuery, this, &ArchiveModel::slotUserQuery);
     return newJob;
 }
 
-Kerfuffle::PreviewJob *ArchiveModel::preview(Archive::Entry *file) const
+Kerfuffle::PreviewJob *ArchiveModel::preview(const QVector<Archive::Entry*> &files) const
 {
     Q_ASSERT(m_archive);
-    PreviewJob *job = m_archive->preview(file);
+    QVector<Archive::Entry*> archiveFiles;
+    Archive *archive = archiveForEntries(files, archiveFiles);
+    PreviewJob *job = archive->preview(archiveFiles);
     connect(job, &Job::userQuery, this, &ArchiveModel::slotUserQuery);
     return job;
 }
 
-OpenJob *ArchiveModel::open(Archive::Entry *file) const
+OpenJob *ArchiveModel::open(const QVector<Archive::Entry*> &files) const
 {
     Q_ASSERT(m_archive);
-    OpenJob *job = m_archive->open(file);
+    QVector<Archive::Entry*> archiveFiles;
+    Archive *archive = archiveForEntries(files, archiveFiles);
+    OpenJob *job = archive->open(archiveFiles);
     connect(job, &Job::userQuery, this, &ArchiveModel::slotUserQuery);
     return job;
 }
 
-OpenWithJob *ArchiveModel::openWith(Archive::Entry *file) const
+OpenWithJob *ArchiveModel::openWith(const QVector<Archive::Entry*> &files) const
 {
     Q_ASSERT(m_archive);
-    OpenWithJob *job = m_archive->openWith(file);
+    QVector<Archive::Entry*> archiveFiles;
+    Archive *archive = archiveForEntries(files, archiveFiles);
+    OpenWithJob *job = archive->openWith(archiveFiles);
     connect(job, &Job::userQuery, this, &ArchiveModel::slotUserQuery);
     return job;
 }
@@ -870,7 +1060,7 @@ void ArchiveModel::traverseAndCountDirNode(Archive::Entry *dir)
             m_numberOfFolders++;
         } else {
             m_numberOfFiles++;
-            m_uncompressedSize += entry->property("size").toULongLong();
+            m_uncompressedSize += entry->size();
         }
     }
 }
@@ -85,6 +85,21 @@ public:
     KJob* loadArchive(const QString &path, const QString &mimeType, QObject *parent);
     Kerfuffle::Archive *archive() const;
 
+    /**
+     * Lists the archive stored as @p entry in the loaded archive, inserting
+     * its entries as children of @p entry. The nested archive is read through
+     * the loaded one instead of being extracted first.
+     *
+     * @return The load job, or Q_NULLPTR if no plugin can read the nested archive.
+     */
+    KJob* loadNestedArchive(Archive::Entry *entry);
+
+    /**
+     * @return The nested archive entry which contains @p entry, or Q_NULLPTR
+     * if @p entry belongs to the loaded archive itself.
+     */
+    Archive::Entry *nestedArchiveContainer(const Archive::Entry *entry) const;
+
     QList<int> shownColumns() const;
     QMap<int, QByteArray> propertiesMap() const;
 
@@ -93,9 +108,9 @@ public:
     Kerfuffle::ExtractJob* extractFile(Archive::Entry *file, const QString& destinationDir, const Kerfuffle::ExtractionOptions& options = Kerfuffle::ExtractionOptions()) const;
     Kerfuffle::ExtractJob* extractFiles(const QVector<Archive::Entry*>& files, const QString& destinationDir, const Kerfuffle::ExtractionOptions& options = Kerfuffle::ExtractionOptions()) const;
 
-    Kerfuffle::PreviewJob* preview(Archive::Entry *file) const;
-    Kerfuffle::OpenJob* open(Archive::Entry *file) const;
-    Kerfuffle::OpenWithJob* openWith(Archive::Entry *file) const;
+    Kerfuffle::PreviewJob* preview(const QVector<Archive::Entry*> &files) const;
+    Kerfuffle::OpenJob* open(const QVector<Archive::Entry*> &files) const;
+    Kerfuffle::OpenWithJob* openWith(const QVector<Archive::Entry*> &files) const;
 
     Kerfuffle::AddJob* addFiles(QVector<Archive::Entry*> &entries, const Archive::Entry *destination, const Kerfuffle::CompressionOptions& options = Kerfuffle::CompressionOptions());
     Kerfuffle::MoveJob* moveFiles(QVector<Archive::Entry*> &entries, Archive::Entry *destination, const Kerfuffle::CompressionOptions& options = Kerfuffle::CompressionOptions());
@@ -153,6 +168,7 @@ private slots:
     void slotEntryRemoved(const QString & path);
     void slotUserQuery(Kerfuffle::Query *query);
     void slotCleanupEmptyDirs();
+    void slotNestedLoadingFinished(KJob *job);
 
 private:
     /**
@@ -180,12 +196,35 @@ private:
 
     void insertEntry(Archive::Entry *entry, InsertBehaviour behaviour = NotifyViews);
     void newEntry(Kerfuffle::Archive::Entry *receivedEntry, InsertBehaviour behaviour);
+    void newNestedEntry(Archive::Entry *container, Archive::Entry *receivedEntry);
+
+    /**
+     * Removes the entries of the nested archive @p container from the model
+     * and closes the nested archive.
+     */
+    void closeNestedArchive(Archive::Entry *container);
+
+    /**
+     * Forgets the icons of all the entries below @p entry, at any depth, and
+     * closes the archives nested among them.
+     */
+    void forgetNestedEntries(Archive::Entry *entry);
+
+    /**
+     * @return The archive which @p entries belong to, which is either the
+     * loaded archive or one nested in it. @p archiveEntries is set to the
+     * entries as that archive knows them: for a nested archive these are
+     * copies owned by it, with paths relative to it. Entries of any other
+     * archive are left out.
+     */
+    Kerfuffle::Archive *archiveForEntries(const QVector<Archive::Entry*> &entries, QVector<Archive::Entry*> &archiveEntries) const;
 
     void traverseAndCountDirNode(Archive::Entry *dir);
 
     QList<int> m_showColumns;
     QScopedPointer<Kerfuffle::Archive> m_archive;
     QScopedPointer<Archive::Entry> m_rootEntry;
+    QHash<Archive::Entry*, Kerfuffle::Archive*> m_nestedArchives;
     QHash<QString, QIcon> m_entryIcons;
     QMap<int, QByteArray> m_propertiesMap;
 
@@ -50,9 +50,24 @@ bool ArchiveSortFilterModel::lessThan(const QModelIndex &leftIndex,
         return false;
     } else {
         switch (col) {
+        case FullPath:
+            if (left->fullPath() < right->fullPath()) {
+                return true;
+            }
+            break;
         case Size:
+            if (left->size() < right->size()) {
+                return true;
+            }
+            break;
         case CompressedSize:
-            if (left->property(property).toULongLong() < right->property(property).toULongLong()) {
+            if (left->compressedSize() < right->compressedSize()) {
+                return true;
+            }
+            break;
+        case Timestamp:
+            if (left->timestampSecs() < right->timestampSecs() ||
+                (left->timestampSecs() == right->timestampSecs() && left->timestampNsecs() < right->timestampNsecs())) {
                 return true;
             }
             break;
@@ -33,6 +33,7 @@
 #include <QDebug>
 #include <QFile>
 #include <QMimeDatabase>
+#include <QProcess>
 #include <QProgressDialog>
 #include <QPushButton>
 
@@ -54,6 +55,7 @@ ArkViewer::ArkViewer()
 
 ArkViewer::~ArkViewer()
 {
+    delete m_streamDevice.data();
 }
 
 void ArkViewer::dialogClosed()
@@ -80,7 +82,8 @@ void ArkViewer::dialogClosed()
 
         m_part.data()->closeUrl();
 
-        if (!previewedFilePath.isEmpty()) {
+        // A streamed file has never been written to disk.
+        if (!m_isStreamed && !previewedFilePath.isEmpty()) {
             QFile::remove(previewedFilePath);
         }
     }
@@ -174,7 +177,88 @@ void ArkViewer::view(const QString& fileName)
     QFile::remove(fileName);
 }
 
-bool ArkViewer::viewInInternalViewer(const QString& fileName, const QMimeType &mimeType)
+bool ArkViewer::view(QIODevice *device, const QString& fileName)
+{
+    Q_ASSERT(device);
+
+    // Only an internal viewer can read a stream. Since the file is not there
+    // yet, the MIME type can only be detected from its name.
+    const QMimeType mimeType = QMimeDatabase().mimeTypeForFile(fileName, QMimeDatabase::MatchExtension);
+    const KService::Ptr viewer = ArkViewer::getViewer(mimeType.name());
+    if (mimeType.isDefault() || !viewer || !viewer->hasServiceType(QStringLiteral("KParts/ReadOnlyPart"))) {
+        delete device;
+        return false;
+    }
+
+    ArkViewer *internalViewer = new ArkViewer();
+    internalViewer->show();
+    if (!internalViewer->viewStream(device, fileName, mimeType)) {
+        qCDebug(ARK) << "The internal viewer doesn't support streams";
+        delete internalViewer;
+        delete device;
+        return false;
+    }
+
+    return true;
+}
+
+bool ArkViewer::viewStream(QIODevice *device, const QString& fileName, const QMimeType& mimeType)
+{
+    if (!createPart(fileName, mimeType)) {
+        return false;
+    }
+
+    if (!m_part.data()->openStream(mimeType.name(), QUrl::fromLocalFile(fileName))) {
+        return false;
+    }
+
+    qCDebug(ARK) << "Streaming" << fileName << "into the internal viewer";
+    m_isStreamed = true;
+    m_streamDevice = device;
+    m_part.data()->widget()->setFocus();
+
+    // The devices decompress in the background and tell when they have
+    // something, so reading them never blocks the GUI.
+    connect(device, &QIODevice::readyRead, this, &ArkViewer::readStream);
+    QProcess *process = qobject_cast<QProcess*>(device);
+    if (process) {
+        connect(process, static_cast<void (QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished),
+                this, &ArkViewer::readStream);
+    } else {
+        connect(device, &QIODevice::readChannelFinished, this, &ArkViewer::readStream);
+    }
+    readStream();
+
+    return true;
+}
+
+void ArkViewer::readStream()
+{
+    if (!m_streamDevice || !m_part) {
+        return;
+    }
+
+    const QByteArray data = m_streamDevice->readAll();
+    if (!data.isEmpty()) {
+        m_part.data()->writeStream(data);
+    }
+
+    // A running process may still write more, even if nothing is available.
+    QProcess *process = qobject_cast<QProcess*>(m_streamDevice.data());
+    const bool isFinished = process ? (process->state() == QProcess::NotRunning && process->atEnd())
+                                    : m_streamDevice->atEnd();
+    if (isFinished) {
+        if (process && (process->exitStatus() != QProcess::NormalExit || process->exitCode() != 0)) {
+            qCWarning(ARK) << "Streaming process failed with exit code" << process->exitCode();
+        }
+        m_part.data()->closeStream();
+        m_streamDevice->disconnect(this);
+        m_streamDevice->deleteLater();
+        m_streamDevice.clear();
+    }
+}
+
+bool ArkViewer::createPart(const QString& fileName, const QMimeType &mimeType)
 {
     setWindowFilePath(fileName);
 
@@ -207,6 +291,15 @@ bool ArkViewer::viewInInternalViewer(const QString& fileName, const QMimeType &m
     // Insert the KPart into its placeholder.
     layout()->replaceWidget(m_partPlaceholder, m_part.data()->widget());
 
+    return true;
+}
+
+bool ArkViewer::viewInInternalViewer(const QString& fileName, const QMimeType &mimeType)
+{
+    if (!createPart(fileName, mimeType)) {
+        return false;
+    }
+
     m_part.data()->openUrl(QUrl::fromLocalFile(fileName));
     m_part.data()->widget()->setFocus();
 
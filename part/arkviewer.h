@@ -41,16 +41,31 @@ public:
 
     static void view(const QString& fileName);
 
+    /**
+     * Views the contents of @p device, which belong to the file @p fileName,
+     * while they are still being read. This needs an internal viewer which
+     * supports streams.
+     *
+     * @return Whether the contents are being viewed. If not, @p device has
+     * been deleted and the file must be extracted and viewed with view().
+     */
+    static bool view(QIODevice *device, const QString& fileName);
+
 private slots:
     void dialogClosed();
+    void readStream();
 
 private:
     explicit ArkViewer();
 
     static KService::Ptr getViewer(const QString& mimeType);
+    bool createPart(const QString& fileName, const QMimeType& mimeType);
     bool viewInInternalViewer(const QString& fileName, const QMimeType& mimeType);
+    bool viewStream(QIODevice *device, const QString& fileName, const QMimeType& mimeType);
 
     QPointer<KParts::ReadOnlyPart> m_part;
+    QPointer<QIODevice> m_streamDevice;
+    bool m_isStreamed = false;
 };
 
 #endif // ARKVIEWER_H
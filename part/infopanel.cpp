@@ -113,11 +113,11 @@ void InfoPanel::setIndex(const QModelIndex& index)
             uint files;
             entry->countChildren(dirs, files);
             additionalInfo->setText(KIO::itemsSummaryString(dirs + files, files, dirs, 0, false));
-        } else if (!entry->property("link").toString().isEmpty()) {
+        } else if (!entry->link().isEmpty()) {
             additionalInfo->setText(i18n("Symbolic Link"));
         } else {
-            if (entry->property("size") != 0) {
-                additionalInfo->setText(KIO::convertSize(entry->property("size").toULongLong()));
+            if (entry->size() != 0) {
+                additionalInfo->setText(KIO::convertSize(entry->size()));
             } else {
                 additionalInfo->setText(i18n("Unknown size"));
 
@@ -144,7 +144,7 @@ void InfoPanel::setIndexes(const QModelIndexList &list)
         quint64 totalSize = 0;
         foreach(const QModelIndex& index, list) {
             const Archive::Entry *entry = m_model->entryForIndex(index);
-            totalSize += entry->property("size").toULongLong();
+            totalSize += entry->size();
         }
         additionalInfo->setText(KIO::convertSize(totalSize));
         hideMetaData();
@@ -180,34 +180,34 @@ void InfoPanel::showMetaDataFor(const QModelIndex &index)
 
     m_typeValueLabel->setText(mimeType.comment());
 
-    if (!entry->property("owner").toString().isEmpty()) {
+    if (!entry->owner().isEmpty()) {
         m_ownerLabel->show();
         m_ownerValueLabel->show();
-        m_ownerValueLabel->setText(entry->property("owner").toString());
+        m_ownerValueLabel->setText(entry->owner());
     } else {
         m_ownerLabel->hide();
         m_ownerValueLabel->hide();
     }
 
-    if (!entry->property("group").toString().isEmpty()) {
+    if (!entry->group().isEmpty()) {
         m_groupLabel->show();
         m_groupValueLabel->show();
-        m_groupValueLabel->setText(entry->property("group").toString());
+        m_groupValueLabel->setText(entry->group());
     } else {
         m_groupLabel->hide();
         m_groupValueLabel->hide();
     }
 
-    if (!entry->property("link").toString().isEmpty()) {
+    if (!entry->link().isEmpty()) {
         m_targetLabel->show();
         m_targetValueLabel->show();
-        m_targetValueLabel->setText(entry->property("link").toString());
+        m_targetValueLabel->setText(entry->link());
     } else {
         m_targetLabel->hide();
         m_targetValueLabel->hide();
     }
 
-    if (entry->property("isPasswordProtected").toBool()) {
+    if (entry->isPasswordProtected()) {
         m_passwordLabel->show();
         m_passwordValueLabel->show();
     } else {
@@ -67,6 +67,7 @@
 #include <QMimeData>
 #include <QMouseEvent>
 #include <QScopedPointer>
+#include <QSet>
 #include <QStatusBar>
 #include <QPointer>
 #include <QSplitter>
@@ -296,11 +297,11 @@ void Part::extractSelectedFilesTo(const QString& localPath)
 
     qCDebug(ARK) << "Extract to" << destination;
 
-    Kerfuffle::ExtractionOptions options;
+    Kerfuffle::ExtractionOptions options = extractionOptions();
     options.setDragAndDropEnabled(true);
 
     // Create and start the ExtractJob.
-    ExtractJob *job = m_model->extractFiles(filesAndRootNodesForIndexes(addChildren(getSelectedIndexes())), destination, options);
+    ExtractJob *job = m_model->extractFiles(filesAndRootNodesForIndexes(removeDescendants(getSelectedIndexes())), destination, options);
     registerJob(job);
     connect(job, &KJob::result,
             this, &Part::slotExtractionDone);
@@ -478,6 +479,15 @@ void Part::updateActions()
     const Archive::Entry *entry = m_model->entryForIndex(m_filterModel->mapToSource(m_view->selectionModel()->currentIndex()));
     int selectedEntriesCount = m_view->selectionModel()->selectedRows().count();
 
+    // Entries of nested archives can only be read.
+    bool isNestedSelection = false;
+    foreach (const QModelIndex &index, m_view->selectionModel()->selectedRows()) {
+        if (m_model->nestedArchiveContainer(m_model->entryForIndex(m_filterModel->mapToSource(index)))) {
+            isNestedSelection = true;
+            break;
+        }
+    }
+
     // We disable adding files if the archive is encrypted but the password is
     // unknown (this happens when opening existing non-he password-protected
     // archives). If we added files they would not get encrypted resulting in an
@@ -497,16 +507,29 @@ void Part::updateActions()
         m_testArchiveAction->setToolTip(i18nc("@info:tooltip", "Click to test the archive for integrity"));
     }
 
-    // Figure out if entry size is larger than preview size limit.
+    // Figure out if entry size is larger than preview size limit. All the
+    // selected files are opened together, each of them must be small enough.
     const int maxPreviewSize = ArkSettings::previewFileSizeLimit() * 1024 * 1024;
     const bool limit = ArkSettings::limitPreviewFileSize();
-    bool isPreviewable = (!limit || (limit && entry != Q_NULLPTR && entry->property("size").toLongLong() < maxPreviewSize));
+    bool isPreviewable = (!limit || entry != Q_NULLPTR);
+    if (limit) {
+        foreach (const QModelIndex &index, getSelectedIndexes()) {
+            const Archive::Entry *selectedEntry = m_model->entryForIndex(index);
+            if (selectedEntry && !selectedEntry->isDir() && selectedEntry->size() >= static_cast<qulonglong>(maxPreviewSize)) {
+                isPreviewable = false;
+                break;
+            }
+        }
+        if (entry && entry->size() >= static_cast<qulonglong>(maxPreviewSize)) {
+            isPreviewable = false;
+        }
+    }
 
     const bool isDir = (entry == Q_NULLPTR) ? false : entry->isDir();
     m_previewAction->setEnabled(!isBusy() &&
                                 isPreviewable &&
                                 !isDir &&
-                                (selectedEntriesCount == 1));
+                                (selectedEntriesCount > 0));
     m_extractArchiveAction->setEnabled(!isBusy() &&
                                        (m_model->rowCount() > 0));
     m_extractAction->setEnabled(!isBusy() &&
@@ -518,29 +541,34 @@ void Part::updateActions()
                                  !isEncryptedButUnknownPassword);
     m_deleteFilesAction->setEnabled(!isBusy() &&
                                     isWritable &&
+                                    !isNestedSelection &&
                                     (selectedEntriesCount > 0));
     m_openFileAction->setEnabled(!isBusy() &&
                                  isPreviewable &&
                                  !isDir &&
-                                 (selectedEntriesCount == 1));
+                                 (selectedEntriesCount > 0));
     m_openFileWithAction->setEnabled(!isBusy() &&
                                      isPreviewable &&
                                      !isDir &&
-                                     (selectedEntriesCount == 1));
+                                     (selectedEntriesCount > 0));
     m_propertiesAction->setEnabled(!isBusy() &&
                                    m_model->archive());
 
     m_renameFileAction->setEnabled(!isBusy() &&
                                    isWritable &&
+                                   !isNestedSelection &&
                                    (selectedEntriesCount == 1));
     m_cutFilesAction->setEnabled(!isBusy() &&
                                  isWritable &&
+                                 !isNestedSelection &&
                                  (selectedEntriesCount > 0));
     m_copyFilesAction->setEnabled(!isBusy() &&
                                   isWritable &&
+                                  !isNestedSelection &&
                                   (selectedEntriesCount > 0));
     m_pasteFilesAction->setEnabled(!isBusy() &&
                                    isWritable &&
+                                   !isNestedSelection &&
                                    (selectedEntriesCount == 0 || (selectedEntriesCount == 1 && isDir)) &&
                                    (m_model->filesToMove.count() > 0 || m_model->filesToCopy.count() > 0));
 
@@ -733,7 +761,7 @@ void Part::slotQuickExtractFiles(QAction *triggeredAction)
 
         qCDebug(ARK) << "Extracting to:" << finalDestinationDirectory;
 
-        ExtractJob *job = m_model->extractFiles(filesAndRootNodesForIndexes(addChildren(getSelectedIndexes())), finalDestinationDirectory, ExtractionOptions());
+        ExtractJob *job = m_model->extractFiles(filesAndRootNodesForIndexes(removeDescendants(getSelectedIndexes())), finalDestinationDirectory, extractionOptions());
         registerJob(job);
 
         connect(job, &KJob::result,
@@ -975,22 +1003,61 @@ void Part::slotOpenEntry(int mode)
     }
 
     // We don't support opening symlinks.
-    if (!entry->property("link").toString().isEmpty()) {
+    if (!entry->link().isEmpty()) {
         displayMsgWidget(KMessageWidget::Information, i18n("Ark cannot open symlinks."));
         return;
     }
 
+    // Archives stored in the archive are browsed in place, like folders,
+    // instead of being extracted and opened in another window.
+    if (entry->isNestedArchive()) {
+        return;
+    }
+    if (mode == OpenFile && getSelectedIndexes().count() <= 1) {
+        KJob *job = m_model->loadNestedArchive(entry);
+        if (job) {
+            const QPersistentModelIndex nestedIndex(m_filterModel->mapFromSource(index));
+            connect(job, &KJob::result, this, [=](KJob *job) {
+                slotNestedArchiveLoaded(job, nestedIndex);
+            });
+            registerJob(job);
+            job->start();
+            return;
+        }
+    }
+
     // Extract the entry.
     if (!entry->fullPath().isEmpty()) {
 
         m_openFileMode = static_cast<OpenFileMode>(mode);
         KJob *job = Q_NULLPTR;
 
+        // The other selected files are opened too, all extracted in the
+        // same pass over the archive.
+        QVector<Archive::Entry*> entries = {entry};
+        foreach (const QModelIndex &selectedIndex, getSelectedIndexes()) {
+            Archive::Entry *selectedEntry = m_model->entryForIndex(selectedIndex);
+            if (selectedEntry != entry && !selectedEntry->isDir() && selectedEntry->link().isEmpty()) {
+                entries << selectedEntry;
+            }
+        }
+
         if (m_openFileMode == Preview) {
-            job = m_model->preview(entry);
+            // Stream a single entry into the viewer if possible, so that it
+            // doesn't have to be extracted to a temporary file first. Entries
+            // of nested archives are always extracted by their own archive.
+            // Both the streamed and the extracted entries are kept in the
+            // preview cache of the archive.
+            const bool canStream = (entries.size() == 1) && !m_model->nestedArchiveContainer(entry);
+            QIODevice *device = canStream ? m_model->archive()->entryDevice(entry) : Q_NULLPTR;
+            if (device && ArkViewer::view(device, entry->name())) {
+                return;
+            }
+
+            job = m_model->preview(entries);
             connect(job, &KJob::result, this, &Part::slotPreviewExtractedEntry);
         } else {
-            job = (m_openFileMode == OpenFile) ? m_model->open(entry) : m_model->openWith(entry);
+            job = (m_openFileMode == OpenFile) ? m_model->open(entries) : m_model->openWith(entries);
             connect(job, &KJob::result, this, &Part::slotOpenExtractedEntry);
         }
 
@@ -1010,29 +1077,36 @@ void Part::slotOpenExtractedEntry(KJob *job)
         // we'll need to manually delete the temp dir in the Part destructor.
         m_tmpExtractDirList << openJob->tempDir();
 
-        const QString fullName = openJob->validatedFilePath();
+        const QStringList fullNames = openJob->validatedFilePaths();
 
         bool isWritable = m_model->archive() && !m_model->archive()->isReadOnly();
 
         // If archive is readonly set temporarily extracted file to readonly as
         // well so user will be notified if trying to modify and save the file.
         if (!isWritable) {
-            QFile::setPermissions(fullName, QFileDevice::ReadOwner | QFileDevice::ReadGroup | QFileDevice::ReadOther);
+            foreach (const QString &fullName, fullNames) {
+                QFile::setPermissions(fullName, QFileDevice::ReadOwner | QFileDevice::ReadGroup | QFileDevice::ReadOther);
+            }
         }
 
         if (isWritable) {
             m_fileWatcher = new QFileSystemWatcher;
             connect(m_fileWatcher, &QFileSystemWatcher::fileChanged, this, &Part::slotWatchedFileModified);
-            m_fileWatcher->addPath(fullName);
+            m_fileWatcher->addPaths(fullNames);
         }
 
         if (qobject_cast<OpenWithJob*>(job)) {
-            const QList<QUrl> urls = {QUrl::fromUserInput(fullName, QString(), QUrl::AssumeLocalFile)};
+            QList<QUrl> urls;
+            foreach (const QString &fullName, fullNames) {
+                urls << QUrl::fromUserInput(fullName, QString(), QUrl::AssumeLocalFile);
+            }
             KRun::displayOpenWithDialog(urls, widget());
         } else {
-            KRun::runUrl(QUrl::fromUserInput(fullName, QString(), QUrl::AssumeLocalFile),
-                         QMimeDatabase().mimeTypeForFile(fullName).name(),
-                         widget(), false, false);
+            foreach (const QString &fullName, fullNames) {
+                KRun::runUrl(QUrl::fromUserInput(fullName, QString(), QUrl::AssumeLocalFile),
+                             QMimeDatabase().mimeTypeForFile(fullName).name(),
+                             widget(), false, false);
+            }
         }
     } else if (job->error() != KJob::KilledJobError) {
         KMessageBox::error(widget(), job->errorString());
@@ -1040,6 +1114,27 @@ void Part::slotOpenExtractedEntry(KJob *job)
     setReadyGui();
 }
 
+void Part::slotNestedArchiveLoaded(KJob *job, const QPersistentModelIndex &index)
+{
+    setReadyGui();
+
+    if (!index.isValid()) {
+        return;
+    }
+
+    if (!job->error()) {
+        m_view->expand(index);
+    } else if (job->error() != KJob::KilledJobError) {
+        // The container can't stream the nested archive, open it in another window instead.
+        qCWarning(ARK) << "Could not browse nested archive:" << job->errorString();
+        m_openFileMode = OpenFile;
+        OpenJob *openJob = m_model->open({m_model->entryForIndex(m_filterModel->mapToSource(index))});
+        connect(openJob, &KJob::result, this, &Part::slotOpenExtractedEntry);
+        registerJob(openJob);
+        openJob->start();
+    }
+}
+
 void Part::slotPreviewExtractedEntry(KJob *job)
 {
     if (!job->error()) {
@@ -1047,7 +1142,9 @@ void Part::slotPreviewExtractedEntry(KJob *job)
         Q_ASSERT(previewJob);
 
         m_tmpExtractDirList << previewJob->tempDir();
-        ArkViewer::view(previewJob->validatedFilePath());
+        foreach (const QString &fullName, previewJob->validatedFilePaths()) {
+            ArkViewer::view(fullName);
+        }
 
     } else if (job->error() != KJob::KilledJobError) {
         KMessageBox::error(widget(), job->errorString());
@@ -1158,12 +1255,12 @@ void Part::slotShowExtractionDialog()
         // If the user has chosen to extract only selected entries, fetch these
         // from the QTreeView.
         if (!dialog.data()->extractAllFiles()) {
-            files = filesAndRootNodesForIndexes(addChildren(getSelectedIndexes()));
+            files = filesAndRootNodesForIndexes(removeDescendants(getSelectedIndexes()));
         }
 
         qCDebug(ARK) << "Selected " << files;
 
-        Kerfuffle::ExtractionOptions options;
+        Kerfuffle::ExtractionOptions options = extractionOptions();
         options.setPreservePaths(dialog->preservePaths());
 
         const QString destinationDirectory = dialog.data()->destinationDirectory().toLocalFile();
@@ -1179,11 +1276,20 @@ void Part::slotShowExtractionDialog()
     delete dialog.data();
 }
 
+Kerfuffle::ExtractionOptions Part::extractionOptions() const
+{
+    Kerfuffle::ExtractionOptions options;
+    options.setPreallocateFiles(ArkSettings::preallocateExtractedFiles());
+    options.setSyncMode(static_cast<Kerfuffle::ExtractionOptions::SyncMode>(ArkSettings::syncExtractedFiles()));
+    return options;
+}
+
 QModelIndexList Part::addChildren(const QModelIndexList &list) const
 {
     Q_ASSERT(m_model);
 
     QModelIndexList ret = list;
+    QSet<QModelIndex> added = QSet<QModelIndex>::fromList(list);
 
     // Iterate over indexes in list and add all children.
     for (int i = 0; i < ret.size(); ++i) {
@@ -1191,7 +1297,8 @@ QModelIndexList Part::addChildren(const QModelIndexList &list) const
 
         for (int j = 0; j < m_model->rowCount(index); ++j) {
             QModelIndex child = m_model->index(j, 0, index);
-            if (!ret.contains(child)) {
+            if (!added.contains(child)) {
+                added.insert(child);
                 ret << child;
             }
         }
@@ -1200,6 +1307,24 @@ QModelIndexList Part::addChildren(const QModelIndexList &list) const
     return ret;
 }
 
+QModelIndexList Part::removeDescendants(const QModelIndexList &list) const
+{
+    const QSet<QModelIndex> indexes = QSet<QModelIndex>::fromList(list);
+
+    QModelIndexList ret;
+    foreach (const QModelIndex &index, list) {
+        QModelIndex parent = index.parent();
+        while (parent.isValid() && !indexes.contains(parent)) {
+            parent = parent.parent();
+        }
+        if (!parent.isValid()) {
+            ret << index;
+        }
+    }
+
+    return ret;
+}
+
 QVector<Archive::Entry*> Part::filesForIndexes(const QModelIndexList& list) const
 {
     QVector<Archive::Entry*> ret;
@@ -1214,7 +1339,8 @@ QVector<Archive::Entry*> Part::filesForIndexes(const QModelIndexList& list) cons
 QVector<Kerfuffle::Archive::Entry*> Part::filesAndRootNodesForIndexes(const QModelIndexList& list) const
 {
     QVector<Kerfuffle::Archive::Entry*> fileList;
-    QStringList fullPathsList;
+    QSet<QString> fullPathsList;
+    const QSet<QModelIndex> indexes = QSet<QModelIndex>::fromList(list);
 
     foreach (const QModelIndex& index, list) {
 
@@ -1225,7 +1351,7 @@ QVector<Kerfuffle::Archive::Entry*> Part::filesAndRootNodesForIndexes(const QMod
         // a selected parent folder.
         QModelIndex selectionRoot = index.parent();
         while (m_view->selectionModel()->isSelected(selectionRoot) ||
-               list.contains(selectionRoot)) {
+               indexes.contains(selectionRoot)) {
             selectionRoot = selectionRoot.parent();
         }
 
@@ -1242,7 +1368,7 @@ QVector<Kerfuffle::Archive::Entry*> Part::filesAndRootNodesForIndexes(const QMod
             if (!fullPathsList.contains(fullPath)) {
                 entry->rootNode = rootFileName;
                 fileList.append(entry);
-                fullPathsList.append(fullPath);
+                fullPathsList.insert(fullPath);
             }
         }
     }
@@ -1370,6 +1496,12 @@ void Part::slotAddFiles()
     if (!m_compressionOptions.isVolumeSizeSet() && arguments().metaData().contains(QStringLiteral("volumeSize"))) {
         m_compressionOptions.setVolumeSize(arguments().metaData()[QStringLiteral("volumeSize")].toULong());
     }
+    if (m_compressionOptions.threadCount() == 0 && arguments().metaData().contains(QStringLiteral("threadCount"))) {
+        m_compressionOptions.setThreadCount(arguments().metaData()[QStringLiteral("threadCount")].toInt());
+    }
+    if (arguments().metaData()[QStringLiteral("longDistanceMatching")] == QLatin1String("true")) {
+        m_compressionOptions.setLongDistanceMatchingEnabled(true);
+    }
 
     const auto compressionMethods = m_model->archive()->property("compressionMethods").toStringList();
     qCDebug(ARK) << "compmethods:" << compressionMethods;
@@ -1381,7 +1513,7 @@ void Part::slotAddFiles()
     const Archive::Entry *destination = Q_NULLPTR;
     if (m_view->selectionModel()->selectedRows().count() == 1) {
         destination = m_model->entryForIndex(m_filterModel->mapToSource(m_view->selectionModel()->currentIndex()));
-        if (destination->isDir()) {
+        if (destination->isDir() && !m_model->nestedArchiveContainer(destination)) {
             dialogTitle = i18nc("@title:window", "Add Files to %1", destination->fullPath());;
         } else {
             destination = Q_NULLPTR;
@@ -1634,7 +1766,7 @@ void Part::slotDeleteFiles()
         return;
     }
 
-    DeleteJob *job = m_model->deleteFiles(filesForIndexes(addChildren(getSelectedIndexes())));
+    DeleteJob *job = m_model->deleteFiles(filesForIndexes(removeDescendants(getSelectedIndexes())));
     connect(job, &KJob::result,
             this, &Part::slotDeleteFilesDone);
     registerJob(job);
@@ -104,6 +104,7 @@ private slots:
     void slotLoadingStarted();
     void slotLoadingFinished(KJob *job);
     void slotOpenExtractedEntry(KJob*);
+    void slotNestedArchiveLoaded(KJob *job, const QPersistentModelIndex &index);
     void slotPreviewExtractedEntry(KJob* job);
     void slotOpenEntry(int mode);
     void slotError(const QString& errorMessage, const QString& details);
@@ -180,6 +181,19 @@ private:
     QVector<Kerfuffle::Archive::Entry*> filesForIndexes(const QModelIndexList& list) const;
     QVector<Kerfuffle::Archive::Entry*> filesAndRootNodesForIndexes(const QModelIndexList& list) const;
     QModelIndexList addChildren(const QModelIndexList &list) const;
+
+    /**
+     * @return The indexes in @p list that are not descendants of other indexes
+     * in @p list. A folder among them stands for its whole contents.
+     */
+    QModelIndexList removeDescendants(const QModelIndexList &list) const;
+
+    /**
+     * @return Default extraction options, with how to write the files to
+     * disk as set by the user.
+     */
+    Kerfuffle::ExtractionOptions extractionOptions() const;
+
     void registerJob(KJob *job);
     QModelIndexList getSelectedIndexes();
 
@@ -25,17 +25,148 @@
 #include "ark_debug.h"
 #include "cliinterface.h"
 
-#include <QDateTime>
+#include <QDate>
 #include <QDir>
 #include <QRegularExpression>
 
 #include <KLocalizedString>
 #include <KPluginFactory>
 
+#include <ctime>
+
 using namespace Kerfuffle;
 
 K_PLUGIN_FACTORY_WITH_JSON(CliPluginFactory, "kerfuffle_cli7z.json", registerPlugin<CliPlugin>();)
 
+namespace {
+
+// The fields of an entry printed by 7z l -slt that we are interested in.
+enum EntryField {
+    EntryFieldUnknown = 0,
+    EntryFieldPath,
+    EntryFieldSize,
+    EntryFieldPackedSize,
+    EntryFieldModified,
+    EntryFieldAttributes,
+    EntryFieldCRC,
+    EntryFieldMethod,
+    EntryFieldEncrypted,
+    EntryFieldBlock,
+    EntryFieldVersion
+};
+
+// The (length, first character) pair of the keys is unique, so it is used as
+// a perfect hash; the key is then compared only once to exclude other fields.
+EntryField entryField(const QStringRef &key)
+{
+    static const struct {
+        QLatin1String key;
+        EntryField field;
+    } fields[] = {
+        {QLatin1String("CRC"), EntryFieldCRC},
+        {QLatin1String("Path"), EntryFieldPath},
+        {QLatin1String("Size"), EntryFieldSize},
+        {QLatin1String("Block"), EntryFieldBlock},
+        {QLatin1String("Method"), EntryFieldMethod},
+        {QLatin1String("Version"), EntryFieldVersion},
+        {QLatin1String("Modified"), EntryFieldModified},
+        {QLatin1String("Encrypted"), EntryFieldEncrypted},
+        {QLatin1String("Attributes"), EntryFieldAttributes},
+        {QLatin1String("Packed Size"), EntryFieldPackedSize}
+    };
+
+    int index;
+    switch (key.size()) {
+    case 3:
+        index = 0;
+        break;
+    case 4:
+        index = (key.at(0) == QLatin1Char('P')) ? 1 : 2;
+        break;
+    case 5:
+    case 6:
+    case 7:
+    case 8:
+    case 9:
+    case 10:
+    case 11:
+        index = key.size() - 2;
+        break;
+    default:
+        return EntryFieldUnknown;
+    }
+
+    return (key == fields[index].key) ? fields[index].field : EntryFieldUnknown;
+}
+
+// Converts @p length decimal digits of @p value starting at @p position, or returns -1.
+int parseDigits(const QStringRef &value, int position, int length)
+{
+    int number = 0;
+    for (int i = position; i < position + length; ++i) {
+        const int digit = value.at(i).unicode() - '0';
+        if (digit < 0 || digit > 9) {
+            return -1;
+        }
+        number = number * 10 + digit;
+    }
+    return number;
+}
+
+// The number of days from 1970-01-01 to the given date of the proleptic Gregorian calendar.
+qint64 daysFromCivil(int year, int month, int day)
+{
+    year -= (month <= 2) ? 1 : 0;
+    const qint64 era = (year >= 0 ? year : year - 399) / 400;
+    const int yearOfEra = static_cast<int>(year - era * 400);
+    const int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+// Parses a "yyyy-MM-dd hh:mm:ss" timestamp into @p wallSecs, the seconds
+// since the epoch it would be if it were in UTC. 7z prints local times, which
+// CliPlugin::localTimeToSecs() converts. Recent 7z versions append fractional
+// seconds, which are returned in @p nsecs.
+bool parseTimestamp(const QStringRef &value, qint64 &wallSecs, int &nsecs)
+{
+    if (value.size() < 19) {
+        return false;
+    }
+
+    static const int daysInMonth[] = { 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+    const int year = parseDigits(value, 0, 4);
+    const int month = parseDigits(value, 5, 2);
+    const int day = parseDigits(value, 8, 2);
+    const int hours = parseDigits(value, 11, 2);
+    const int minutes = parseDigits(value, 14, 2);
+    const int seconds = parseDigits(value, 17, 2);
+    if (year < 1900 || month < 1 || month > 12 || day < 1 || day > daysInMonth[month - 1] ||
+        (month == 2 && day == 29 && !QDate::isLeapYear(year)) ||
+        hours < 0 || hours > 23 || minutes < 0 || minutes > 59 || seconds < 0 || seconds > 60) {
+        return false;
+    }
+
+    wallSecs = daysFromCivil(year, month, day) * 86400 + hours * 3600 + minutes * 60 + seconds;
+
+    nsecs = 0;
+    if (value.size() > 20 && value.at(19) == QLatin1Char('.')) {
+        const int digits = qMin(value.size() - 20, 9);
+        int fraction = parseDigits(value, 20, digits);
+        if (fraction > 0) {
+            for (int i = digits; i < 9; ++i) {
+                fraction *= 10;
+            }
+            nsecs = fraction;
+        }
+    }
+
+    return true;
+}
+
+}
+
 CliPlugin::CliPlugin(QObject *parent, const QVariantList & args)
         : CliInterface(parent, args)
         , m_archiveType(ArchiveType7z)
@@ -55,10 +186,31 @@ CliPlugin::~CliPlugin()
 void CliPlugin::resetParsing()
 {
     m_parseState = ParseStateTitle;
+    m_utcOffsets.clear();
     m_comment.clear();
     m_numberOfVolumes = 0;
 }
 
+qint64 CliPlugin::localTimeToSecs(qint64 wallSecs)
+{
+    // The offset from UTC changes at most once an hour, so mktime() is
+    // called once per distinct hour of the listing instead of per entry.
+    const qint64 hour = (wallSecs >= 0 ? wallSecs : wallSecs - 3599) / 3600;
+
+    QHash<qint64, qint64>::const_iterator it = m_utcOffsets.constFind(hour);
+    if (it == m_utcOffsets.constEnd()) {
+        const time_t hourStart = static_cast<time_t>(hour * 3600);
+        struct tm localTime;
+        gmtime_r(&hourStart, &localTime);
+        localTime.tm_isdst = -1;
+
+        const time_t time = mktime(&localTime);
+        it = m_utcOffsets.insert(hour, (time == -1) ? 0 : hour * 3600 - time);
+    }
+
+    return wallSecs - it.value();
+}
+
 void CliPlugin::setupCliProperties()
 {
     qCDebug(ARK) << "Setting up parameters...";
@@ -75,6 +227,8 @@ void CliPlugin::setupCliProperties()
     m_cliProps->setProperty("extractProgram", QStringLiteral("7z"));
     m_cliProps->setProperty("extractSwitch", QStringList{QStringLiteral("x")});
     m_cliProps->setProperty("extractSwitchNoPreserve", QStringList{QStringLiteral("e")});
+    m_cliProps->setProperty("extractToStdoutSwitch", QStringList{QStringLiteral("x"),
+                                                             QStringLiteral("-so")});
 
     m_cliProps->setProperty("listProgram", QStringLiteral("7z"));
     m_cliProps->setProperty("listSwitch", QStringList{QStringLiteral("l"),
@@ -119,10 +273,8 @@ bool CliPlugin::readListLine(const QString& line)
     static const QLatin1String archiveInfoDelimiter1("--"); // 7z 9.13+
     static const QLatin1String archiveInfoDelimiter2("----"); // 7z 9.04
     static const QLatin1String entryInfoDelimiter("----------");
-    const QRegularExpression rxComment(QStringLiteral("Comment = .+$"));
 
-    const QRegularExpression rxListFailed(QStringLiteral("Open ERROR: Can not open the file as \\[7z\\] archive"));
-    if (rxListFailed.match(line).hasMatch()) {
+    if (line.contains(QLatin1String("Open ERROR: Can not open the file as [7z] archive"))) {
         emit error(i18n("Listing the archive failed."));
         return false;
     }
@@ -185,7 +337,7 @@ bool CliPlugin::readListLine(const QString& line)
             QStringList methods = line.section(QLatin1Char('='), 1).trimmed().split(QLatin1Char(' '), QString::SkipEmptyParts);
             handleMethods(methods);
 
-        } else if (rxComment.match(line).hasMatch()) {
+        } else if (line.startsWith(QLatin1String("Comment = ")) && line.size() > 10) {
             m_parseState = ParseStateComment;
             m_comment.append(line.section(QLatin1Char('='), 1) + QLatin1Char('\n'));
         }
@@ -210,54 +362,72 @@ bool CliPlugin::readListLine(const QString& line)
             m_currentArchiveEntry = new Archive::Entry(this);
             m_currentArchiveEntry->compressedSizeIsSet = false;
         }
-        if (line.startsWith(QStringLiteral("Path = "))) {
-            const QString entryFilename =
-                QDir::fromNativeSeparators(line.mid(7).trimmed());
-            m_currentArchiveEntry->setProperty("fullPath", entryFilename);
-        } else if (line.startsWith(QStringLiteral("Size = "))) {
-            m_currentArchiveEntry->setProperty("size", line.mid(7).trimmed());
-        } else if (line.startsWith(QStringLiteral("Packed Size = "))) {
+
+        // This is the hot path for big archives: avoid building temporary strings
+        // and keep the conversions to the values that are actually stored.
+        const int separatorIndex = line.indexOf(QLatin1String(" ="));
+        if (separatorIndex < 0) {
+            return true;
+        }
+        const QStringRef value = line.midRef(separatorIndex + 2).trimmed();
+
+        switch (entryField(line.leftRef(separatorIndex))) {
+        case EntryFieldPath:
+            m_currentArchiveEntry->setFullPath(QDir::fromNativeSeparators(value.toString()));
+            break;
+        case EntryFieldSize:
+            m_currentArchiveEntry->setSize(value.toULongLong());
+            break;
+        case EntryFieldPackedSize:
             // #236696: 7z files only show a single Packed Size value
             //          corresponding to the whole archive.
             if (m_archiveType != ArchiveType7z) {
                 m_currentArchiveEntry->compressedSizeIsSet = true;
-                m_currentArchiveEntry->setProperty("compressedSize", line.mid(14).trimmed());
+                m_currentArchiveEntry->setCompressedSize(value.toULongLong());
+            }
+            break;
+        case EntryFieldModified: {
+            qint64 wallSecs;
+            int nsecs;
+            if (parseTimestamp(value, wallSecs, nsecs)) {
+                m_currentArchiveEntry->setTimestamp(localTimeToSecs(wallSecs), nsecs);
             }
-        } else if (line.startsWith(QStringLiteral("Modified = "))) {
-            m_currentArchiveEntry->setProperty("timestamp", QDateTime::fromString(line.mid(11).trimmed(),
-                                                                                  QStringLiteral("yyyy-MM-dd hh:mm:ss")));
-        } else if (line.startsWith(QStringLiteral("Attributes = "))) {
-            const QString attributes = line.mid(13).trimmed();
-
-            const bool isDirectory = attributes.startsWith(QLatin1Char('D'));
-            m_currentArchiveEntry->setProperty("isDirectory", isDirectory);
+            break;
+        }
+        case EntryFieldAttributes: {
+            const bool isDirectory = value.startsWith(QLatin1Char('D'));
+            m_currentArchiveEntry->setIsDirectory(isDirectory);
             if (isDirectory) {
                 const QString directoryName =
                     m_currentArchiveEntry->fullPath();
                 if (!directoryName.endsWith(QLatin1Char('/'))) {
                     const bool isPasswordProtected = (line.at(12) == QLatin1Char('+'));
-                    m_currentArchiveEntry->setProperty("fullPath", QString(directoryName + QLatin1Char('/')));
-                    m_currentArchiveEntry->setProperty("isPasswordProtected", isPasswordProtected);
+                    m_currentArchiveEntry->setFullPath(QString(directoryName + QLatin1Char('/')));
+                    m_currentArchiveEntry->setIsPasswordProtected(isPasswordProtected);
                 }
             }
 
-            m_currentArchiveEntry->setProperty("permissions", attributes.mid(1));
-        } else if (line.startsWith(QStringLiteral("CRC = "))) {
-            m_currentArchiveEntry->setProperty("CRC", line.mid(6).trimmed());
-        } else if (line.startsWith(QStringLiteral("Method = "))) {
-            m_currentArchiveEntry->setProperty("method", line.mid(9).trimmed());
+            m_currentArchiveEntry->setPermissions(value.mid(1).toString());
+            break;
+        }
+        case EntryFieldCRC:
+            m_currentArchiveEntry->setCrc(value.toString());
+            break;
+        case EntryFieldMethod:
+            m_currentArchiveEntry->setMethod(value.toString());
 
             // For zip archives we need to check method for each entry.
             if (m_archiveType == ArchiveTypeZip) {
-                QStringList methods = line.section(QLatin1Char('='), 1).trimmed().split(QLatin1Char(' '), QString::SkipEmptyParts);
-                handleMethods(methods);
+                handleMethods(value.toString().split(QLatin1Char(' '), QString::SkipEmptyParts));
             }
-
-        } else if (line.startsWith(QStringLiteral("Encrypted = ")) &&
-                   line.size() >= 13) {
-            m_currentArchiveEntry->setProperty("isPasswordProtected", line.at(12) == QLatin1Char('+'));
-        } else if (line.startsWith(QStringLiteral("Block = ")) ||
-                   line.startsWith(QStringLiteral("Version = "))) {
+            break;
+        case EntryFieldEncrypted:
+            if (!value.isEmpty()) {
+                m_currentArchiveEntry->setIsPasswordProtected(value.at(0) == QLatin1Char('+'));
+            }
+            break;
+        case EntryFieldBlock:
+        case EntryFieldVersion:
             m_isFirstInformationEntry = true;
             if (!m_currentArchiveEntry->fullPath().isEmpty()) {
                 emit entry(m_currentArchiveEntry);
@@ -266,6 +436,9 @@ bool CliPlugin::readListLine(const QString& line)
                 delete m_currentArchiveEntry;
             }
             m_currentArchiveEntry = Q_NULLPTR;
+            break;
+        case EntryFieldUnknown:
+            break;
         }
     }
 
@@ -27,6 +27,8 @@
 
 #include "cliinterface.h"
 
+#include <QHash>
+
 class CliPlugin : public Kerfuffle::CliInterface
 {
     Q_OBJECT
@@ -61,9 +63,20 @@ private:
     void setupCliProperties();
     void handleMethods(const QStringList &methods);
 
+    /**
+     * @return The seconds since the epoch of the local time @p wallSecs,
+     * given as if it were in UTC.
+     */
+    qint64 localTimeToSecs(qint64 wallSecs);
+
     int m_linesComment;
     Kerfuffle::Archive::Entry *m_currentArchiveEntry;
     bool m_isFirstInformationEntry;
+
+    /**
+     * The offsets from UTC of the local time, by hour since the epoch.
+     */
+    QHash<qint64, qint64> m_utcOffsets;
 };
 
 #endif // CLIPLUGIN_H
@@ -128,17 +128,17 @@ bool CliPlugin::readListLine(const QString &line)
 
     qCDebug(ARK) << m_entryFilename << " : " << fileprops;
     Archive::Entry *e = new Archive::Entry();
-    e->setProperty("fullPath", m_entryFilename);
-    e->setProperty("size", fileprops[ 0 ]);
-    e->setProperty("compressedSize", fileprops[ 1 ]);
-    e->setProperty("ratio", fileprops[ 2 ]);
-    e->setProperty("timestamp", ts);
-    e->setProperty("isDirectory", isDirectory);
-    e->setProperty("permissions", fileprops[ 5 ].remove(0, 1));
-    e->setProperty("CRC", fileprops[ 6 ]);
-    e->setProperty("method", fileprops[ 7 ]);
-    e->setProperty("version", fileprops[ 8 ]);
-    e->setProperty("ssPasswordProtected", m_isPasswordProtected);
+    e->setFullPath(m_entryFilename);
+    e->setSize(fileprops[ 0 ].toULongLong());
+    e->setCompressedSize(fileprops[ 1 ].toULongLong());
+    e->setRatio(fileprops[ 2 ]);
+    e->setTimestamp(ts);
+    e->setIsDirectory(isDirectory);
+    e->setPermissions(fileprops[ 5 ].remove(0, 1));
+    e->setCrc(fileprops[ 6 ]);
+    e->setMethod(fileprops[ 7 ]);
+    e->setVersion(fileprops[ 8 ]);
+    e->setIsPasswordProtected(m_isPasswordProtected);
     qCDebug(ARK) << "Added entry: " << e;
 
     emit entry(e);
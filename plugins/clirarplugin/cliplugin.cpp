@@ -85,6 +85,11 @@ void CliPlugin::setupCliProperties()
     m_cliProps->setProperty("extractSwitchNoPreserve", QStringList{QStringLiteral("e"),
                                                                QStringLiteral("-kb"),
                                                                QStringLiteral("-p-")});
+    m_cliProps->setProperty("extractToStdoutSwitch", QStringList{QStringLiteral("p"),
+                                                             QStringLiteral("-inul")});
+
+    // Selecting a folder alone only matches the folder entry.
+    m_cliProps->setProperty("folderWildcard", QStringLiteral("*"));
 
     m_cliProps->setProperty("listProgram", QStringLiteral("unrar"));
     m_cliProps->setProperty("listSwitch", QStringList{QStringLiteral("vt"),
@@ -267,14 +272,14 @@ void CliPlugin::handleUnrar5Entry()
 
     QString compressionRatio = m_unrar5Details.value(QStringLiteral("ratio"));
     compressionRatio.chop(1); // Remove the '%'
-    e->setProperty("ratio", compressionRatio);
+    e->setRatio(compressionRatio);
 
     QString time = m_unrar5Details.value(QStringLiteral("mtime"));
     QDateTime ts = QDateTime::fromString(time, QStringLiteral("yyyy-MM-dd HH:mm:ss,zzz"));
-    e->setProperty("timestamp", ts);
+    e->setTimestamp(ts);
 
     bool isDirectory = (m_unrar5Details.value(QStringLiteral("type")) == QLatin1String("Directory"));
-    e->setProperty("isDirectory", isDirectory);
+    e->setIsDirectory(isDirectory);
 
     if (isDirectory && !m_unrar5Details.value(QStringLiteral("name")).endsWith(QLatin1Char('/'))) {
         m_unrar5Details[QStringLiteral("name")] += QLatin1Char('/');
@@ -283,28 +288,28 @@ void CliPlugin::handleUnrar5Entry()
     QString compression = m_unrar5Details.value(QStringLiteral("compression"));
     int optionPos = compression.indexOf(QLatin1Char('-'));
     if (optionPos != -1) {
-        e->setProperty("method", compression.mid(optionPos));
-        e->setProperty("version", compression.left(optionPos).trimmed());
+        e->setMethod(compression.mid(optionPos));
+        e->setVersion(compression.left(optionPos).trimmed());
     } else {
         // No method specified.
-        e->setProperty("method", QStringLiteral(""));
-        e->setProperty("version", compression);
+        e->setMethod(QStringLiteral(""));
+        e->setVersion(compression);
     }
 
     m_isPasswordProtected = m_unrar5Details.value(QStringLiteral("flags")).contains(QStringLiteral("encrypted"));
-    e->setProperty("isPasswordProtected", m_isPasswordProtected);
+    e->setIsPasswordProtected(m_isPasswordProtected);
     if (m_isPasswordProtected) {
         m_isRAR5 ? emit encryptionMethodFound(QStringLiteral("AES256")) : emit encryptionMethodFound(QStringLiteral("AES128"));
     }
 
-    e->setProperty("fullPath", m_unrar5Details.value(QStringLiteral("name")));
-    e->setProperty("size", m_unrar5Details.value(QStringLiteral("size")));
-    e->setProperty("compressedSize", m_unrar5Details.value(QStringLiteral("packed size")));
-    e->setProperty("permissions", m_unrar5Details.value(QStringLiteral("attributes")));
-    e->setProperty("CRC", m_unrar5Details.value(QStringLiteral("crc32")));
+    e->setFullPath(m_unrar5Details.value(QStringLiteral("name")));
+    e->setSize(m_unrar5Details.value(QStringLiteral("size")).toULongLong());
+    e->setCompressedSize(m_unrar5Details.value(QStringLiteral("packed size")).toULongLong());
+    e->setPermissions(m_unrar5Details.value(QStringLiteral("attributes")));
+    e->setCrc(m_unrar5Details.value(QStringLiteral("crc32")));
 
-    if (e->property("permissions").toString().startsWith(QLatin1Char('l'))) {
-        e->setProperty("link", m_unrar5Details.value(QStringLiteral("target")));
+    if (e->permissions().startsWith(QLatin1Char('l'))) {
+        e->setLink(m_unrar5Details.value(QStringLiteral("target")));
     }
 
     m_unrar5Details.clear();
@@ -508,11 +513,11 @@ void CliPlugin::handleUnrar4Entry()
     if (ts.date().year() < 1950) {
         ts = ts.addYears(100);
     }
-    e->setProperty("timestamp", ts);
+    e->setTimestamp(ts);
 
     bool isDirectory = ((m_unrar4Details.at(6).at(0) == QLatin1Char('d')) ||
                         (m_unrar4Details.at(6).at(1) == QLatin1Char('D')));
-    e->setProperty("isDirectory", isDirectory);
+    e->setIsDirectory(isDirectory);
 
     if (isDirectory && !m_unrar4Details.at(0).endsWith(QLatin1Char('/'))) {
         m_unrar4Details[0] += QLatin1Char('/');
@@ -531,22 +536,22 @@ void CliPlugin::handleUnrar4Entry()
     } else {
         compressionRatio.chop(1); // Remove the '%'
     }
-    e->setProperty("ratio", compressionRatio);
+    e->setRatio(compressionRatio);
 
     // TODO:
     // - Permissions differ depending on the system the entry was added
     //   to the archive.
-    e->setProperty("fullPath", m_unrar4Details.at(0));
-    e->setProperty("size", m_unrar4Details.at(1));
-    e->setProperty("compressedSize", m_unrar4Details.at(2));
-    e->setProperty("permissions", m_unrar4Details.at(6));
-    e->setProperty("CRC", m_unrar4Details.at(7));
-    e->setProperty("method", m_unrar4Details.at(8));
-    e->setProperty("version", m_unrar4Details.at(9));
-    e->setProperty("isPasswordProtected", m_isPasswordProtected);
-
-    if (e->property("permissions").toString().startsWith(QLatin1Char('l'))) {
-        e->setProperty("link", m_unrar4Details.at(10));
+    e->setFullPath(m_unrar4Details.at(0));
+    e->setSize(m_unrar4Details.at(1).toULongLong());
+    e->setCompressedSize(m_unrar4Details.at(2).toULongLong());
+    e->setPermissions(m_unrar4Details.at(6));
+    e->setCrc(m_unrar4Details.at(7));
+    e->setMethod(m_unrar4Details.at(8));
+    e->setVersion(m_unrar4Details.at(9));
+    e->setIsPasswordProtected(m_isPasswordProtected);
+
+    if (e->permissions().startsWith(QLatin1Char('l'))) {
+        e->setLink(m_unrar4Details.at(10));
     }
 
     m_unrar4Details.clear();
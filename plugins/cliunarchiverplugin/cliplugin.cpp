@@ -85,6 +85,9 @@ void CliPlugin::setupCliProperties()
     m_cliProps->setProperty("extractSwitch", QStringList{QStringLiteral("-D")});
     m_cliProps->setProperty("extractSwitchNoPreserve", QStringList{QStringLiteral("-D")});
 
+    // Selecting a folder alone only matches the folder entry.
+    m_cliProps->setProperty("folderWildcard", QStringLiteral("*"));
+
     m_cliProps->setProperty("listProgram", QStringLiteral("lsar"));
     m_cliProps->setProperty("listSwitch", QStringList{QStringLiteral("-json")});
 
@@ -131,7 +134,9 @@ void CliPlugin::readStdout(bool handleAll)
         return;
     }
 
-    // We are ready to read the json output.
+    // Collect the output still buffered by the process (e.g. when running without pty),
+    // then we are ready to read the json output.
+    CliInterface::readStdout(true);
     readJsonOutput();
 }
 
@@ -249,19 +254,18 @@ void CliPlugin::readJsonOutput()
 
         QString filename = currentEntryJson.value(QStringLiteral("XADFileName")).toString();
 
-        currentEntry->setProperty("isDirectory", !currentEntryJson.value(QStringLiteral("XADIsDirectory")).isUndefined());
+        currentEntry->setIsDirectory(!currentEntryJson.value(QStringLiteral("XADIsDirectory")).isUndefined());
         if (currentEntry->isDir()) {
             filename += QLatin1Char('/');
         }
 
-        currentEntry->setProperty("fullPath", filename);
+        currentEntry->setFullPath(filename);
 
         // FIXME: archives created from OSX (i.e. with the __MACOSX folder) list each entry twice, the 2nd time with size 0
-        currentEntry->setProperty("size", currentEntryJson.value(QStringLiteral("XADFileSize")));
-        currentEntry->setProperty("compressedSize", currentEntryJson.value(QStringLiteral("XADCompressedSize")));
-        currentEntry->setProperty("timestamp", currentEntryJson.value(QStringLiteral("XADLastModificationDate")).toVariant());
-        currentEntry->setProperty("size", currentEntryJson.value(QStringLiteral("XADFileSize")));
-        currentEntry->setProperty("isPasswordProtected", (currentEntryJson.value(QStringLiteral("XADIsEncrypted")).toInt() == 1));
+        currentEntry->setSize(currentEntryJson.value(QStringLiteral("XADFileSize")).toVariant().toULongLong());
+        currentEntry->setCompressedSize(currentEntryJson.value(QStringLiteral("XADCompressedSize")).toVariant().toULongLong());
+        currentEntry->setTimestamp(currentEntryJson.value(QStringLiteral("XADLastModificationDate")).toVariant().toDateTime());
+        currentEntry->setIsPasswordProtected((currentEntryJson.value(QStringLiteral("XADIsEncrypted")).toInt() == 1));
         // TODO: missing fields
 
         emit entry(currentEntry);
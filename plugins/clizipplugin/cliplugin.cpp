@@ -23,12 +23,17 @@
 #include "cliplugin.h"
 #include "ark_debug.h"
 #include "cliinterface.h"
+#include "filemanifest.h"
+#ifdef HAVE_ZLIB
+#include "zipwriter.h"
+#endif
 
 #include <KLocalizedString>
 #include <KPluginFactory>
 
 #include <QDateTime>
 #include <QDir>
+#include <QFileInfo>
 #include <QRegularExpression>
 #include <QTemporaryDir>
 
@@ -40,6 +45,7 @@ CliPlugin::CliPlugin(QObject *parent, const QVariantList & args)
     : CliInterface(parent, args)
     , m_parseState(ParseStateHeader)
     , m_linesComment(0)
+    , m_zipWriter(Q_NULLPTR)
 {
     qCDebug(ARK) << "Loaded cli_zip plugin";
     setupCliProperties();
@@ -93,6 +99,10 @@ void CliPlugin::setupCliProperties()
 
     m_cliProps->setProperty("extractProgram", QStringLiteral("unzip"));
     m_cliProps->setProperty("extractSwitchNoPreserve", QStringList{QStringLiteral("-j")});
+    m_cliProps->setProperty("extractToStdoutSwitch", QStringList{QStringLiteral("-p")});
+
+    // Selecting a folder alone only matches the folder entry.
+    m_cliProps->setProperty("folderWildcard", QStringLiteral("*"));
 
     m_cliProps->setProperty("listProgram", QStringLiteral("zipinfo"));
     m_cliProps->setProperty("listSwitch", QStringList{QStringLiteral("-l"),
@@ -157,28 +167,28 @@ bool CliPlugin::readListLine(const QString &line)
         QRegularExpressionMatch rxMatch = entryPattern.match(line);
         if (rxMatch.hasMatch()) {
             Archive::Entry *e = new Archive::Entry(this);
-            e->setProperty("permissions", rxMatch.captured(1));
+            e->setPermissions(rxMatch.captured(1));
 
             // #280354: infozip may not show the right attributes for a given directory, so an entry
             //          ending with '/' is actually more reliable than 'd' bein in the attributes.
-            e->setProperty("isDirectory", rxMatch.captured(10).endsWith(QLatin1Char('/')));
+            e->setIsDirectory(rxMatch.captured(10).endsWith(QLatin1Char('/')));
 
-            e->setProperty("size", rxMatch.captured(4));
+            e->setSize(rxMatch.captured(4).toULongLong());
             QString status = rxMatch.captured(5);
             if (status[0].isUpper()) {
-                e->setProperty("isPasswordProtected", true);
+                e->setIsPasswordProtected(true);
             }
-            e->setProperty("compressedSize", rxMatch.captured(6).toInt());
-            e->setProperty("method", rxMatch.captured(7));
+            e->setCompressedSize(rxMatch.captured(6).toULongLong());
+            e->setMethod(rxMatch.captured(7));
 
             QString method = convertCompressionMethod(rxMatch.captured(7));
             emit compressionMethodFound(method);
 
             const QDateTime ts(QDate::fromString(rxMatch.captured(8), QStringLiteral("yyyyMMdd")),
                                QTime::fromString(rxMatch.captured(9), QStringLiteral("hhmmss")));
-            e->setProperty("timestamp", ts);
+            e->setTimestamp(ts);
 
-            e->setProperty("fullPath", rxMatch.captured(10));
+            e->setFullPath(rxMatch.captured(10));
             emit entry(e);
         }
         break;
@@ -218,6 +228,9 @@ bool CliPlugin::moveFiles(const QVector<Archive::Entry*> &files, Archive::Entry
     m_passedDestination = destination;
     m_passedOptions = options;
 
+    beginSession();
+    setNewMovedFiles(files, destination, entriesWithoutChildren(files).count());
+
     m_subOperation = Extract;
     connect(this, &CliPlugin::finished, this, &CliPlugin::continueMoving);
 
@@ -228,6 +241,105 @@ int CliPlugin::moveRequiredSignals() const {
     return 4;
 }
 
+bool CliPlugin::addFiles(const QVector<Archive::Entry*> &files, const Archive::Entry *destination, const CompressionOptions &options, uint numberOfEntriesToAdd)
+{
+#ifdef HAVE_ZLIB
+    if (canUseZipWriter(options)) {
+        // The files have usually been scanned already by the AddJob.
+        const FileManifest manifest = fileManifest().isEmpty() ? FileManifest::scan(entryFullPaths(files)) : fileManifest();
+        const QVector<FileManifest::Item> items = manifest.items();
+
+        // zip follows symlinks, so leave them to it.
+        bool hasSymLinks = false;
+        foreach (const FileManifest::Item &item, items) {
+            if (item.isSymLink) {
+                hasSymLinks = true;
+                break;
+            }
+        }
+
+        if (!hasSymLinks) {
+            qCDebug(ARK) << "Creating" << filename() << "with the built-in zip writer";
+            m_operationMode = Add;
+
+            const QString destinationPath = (destination == Q_NULLPTR)
+                                            ? QString()
+                                            : destination->fullPath();
+
+            m_zipWriter = new ZipWriter(filename(), items, destinationPath, this);
+            if (options.compressionMethod() == QLatin1String("Store")) {
+                m_zipWriter->setCompressionLevel(0);
+            } else if (options.isCompressionLevelSet()) {
+                m_zipWriter->setCompressionLevel(options.compressionLevel());
+            }
+            m_zipWriter->setStoreIncompressibleFiles(options.storeIncompressibleFiles());
+
+            connect(m_zipWriter, &ZipWriter::progress, this, &CliPlugin::progress);
+            connect(m_zipWriter, &ZipWriter::finished, this, &CliPlugin::zipWriterFinished);
+            m_zipWriter->start();
+            return true;
+        }
+    }
+#endif
+
+    return CliInterface::addFiles(files, destination, options, numberOfEntriesToAdd);
+}
+
+bool CliPlugin::canUseZipWriter(const CompressionOptions &options) const
+{
+#ifdef HAVE_ZLIB
+    // Updating an archive, encryption and multi-volume archives need zip.
+    const QString method = options.compressionMethod();
+    return !QFileInfo::exists(filename()) &&
+           !m_sessionActive &&
+           password().isEmpty() &&
+           !options.encryptedArchiveHint() &&
+           !options.isVolumeSizeSet() &&
+           (method.isEmpty() || method == QLatin1String("Deflate") || method == QLatin1String("Store"));
+#else
+    Q_UNUSED(options)
+    return false;
+#endif
+}
+
+void CliPlugin::zipWriterFinished(bool result)
+{
+#ifdef HAVE_ZLIB
+    const bool isCancelled = m_zipWriter->isCancelled();
+    const QString errorString = m_zipWriter->errorString();
+
+    m_zipWriter->deleteLater();
+    m_zipWriter = Q_NULLPTR;
+
+    // Don't emit finished() if the job was killed.
+    if (isCancelled) {
+        return;
+    }
+
+    if (!result) {
+        emit error(errorString);
+        emit finished(false);
+        return;
+    }
+
+    list();
+#else
+    Q_UNUSED(result)
+#endif
+}
+
+bool CliPlugin::doKill()
+{
+#ifdef HAVE_ZLIB
+    if (m_zipWriter) {
+        m_zipWriter->cancel();
+        return true;
+    }
+#endif
+
+    return CliInterface::doKill();
+}
+
 void CliPlugin::continueMoving(bool result)
 {
     if (!result) {
@@ -286,7 +398,7 @@ bool CliPlugin::setMovingAddedFiles()
                 iteratedChar = true;
             }
         } while (destinationLength > 0 && !(iteratedChar && destinationPath.at(destinationLength) == QLatin1Char('/')));
-        m_passedDestination->setProperty("fullPath", destinationPath.left(destinationLength + 1));
+        m_passedDestination->setFullPath(destinationPath.left(destinationLength + 1));
     } else {
         // ...unless the destination path is already a single folder, e.g. "dir/", or a file, e.g. "foo.txt".
         // In this case we're going to add to the root, so we just need to set a null destination.
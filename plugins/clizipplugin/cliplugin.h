@@ -26,6 +26,8 @@
 
 using namespace Kerfuffle;
 
+class ZipWriter;
+
 class KERFUFFLE_EXPORT CliPlugin : public Kerfuffle::CliInterface
 {
     Q_OBJECT
@@ -39,11 +41,15 @@ public:
     virtual bool readListLine(const QString &line) Q_DECL_OVERRIDE;
     virtual bool readExtractLine(const QString &line) Q_DECL_OVERRIDE;
 
+    virtual bool addFiles(const QVector<Archive::Entry*> &files, const Archive::Entry *destination, const CompressionOptions& options, uint numberOfEntriesToAdd = 0) Q_DECL_OVERRIDE;
     virtual bool moveFiles(const QVector<Archive::Entry*> &files, Archive::Entry *destination, const CompressionOptions& options) Q_DECL_OVERRIDE;
     virtual int moveRequiredSignals() const Q_DECL_OVERRIDE;
 
+    bool doKill() Q_DECL_OVERRIDE;
+
 private slots:
     void continueMoving(bool result);
+    void zipWriterFinished(bool result);
 
 private:
     void setupCliProperties();
@@ -51,6 +57,13 @@ private:
     void finishMoving(bool result);
     QString convertCompressionMethod(const QString &method);
 
+    /**
+     * @return Whether the files can be added by the built-in ZipWriter
+     *         instead of the zip program, i.e. whether a new unencrypted
+     *         archive is created with the Deflate or Store method.
+     */
+    bool canUseZipWriter(const CompressionOptions &options) const;
+
     enum ParseState {
         ParseStateHeader = 0,
         ParseStateComment,
@@ -59,6 +72,8 @@ private:
 
     int m_linesComment;
     QString m_tempComment;
+
+    ZipWriter *m_zipWriter;
 };
 
 #endif // CLIPLUGIN_H
@@ -0,0 +1,675 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "zipwriter.h"
+#include "ark_debug.h"
+#include "compressibility.h"
+
+#include <KLocalizedString>
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QTemporaryFile>
+#include <QThread>
+#include <QtEndian>
+
+#include <string.h>
+#include <zlib.h>
+
+using Kerfuffle::FileManifest;
+
+// Members up to this size are compressed in memory, bigger ones into a spill file.
+static const qint64 MaxInMemorySize = 4 * 1024 * 1024;
+static const qint64 MaxBytesAhead = 64 * 1024 * 1024;
+static const int ChunkSize = 256 * 1024;
+
+static const quint32 LocalHeaderSignature = 0x04034b50;
+static const quint32 CentralHeaderSignature = 0x02014b50;
+static const quint32 EndOfCentralDirectorySignature = 0x06054b50;
+static const quint32 Zip64EndOfCentralDirectorySignature = 0x06064b50;
+static const quint32 Zip64LocatorSignature = 0x07064b50;
+
+static const quint16 MethodStore = 0;
+static const quint16 MethodDeflate = 8;
+
+// Made by a Unix host, following version 4.5 of the specification.
+static const quint16 VersionMadeBy = (3 << 8) | 45;
+static const quint16 FlagUtf8 = 1 << 11;
+static const quint16 ExtraFieldZip64 = 0x0001;
+static const quint16 ExtraFieldTimestamp = 0x5455;
+static const quint32 MaxField32 = 0xffffffff;
+static const quint16 MaxField16 = 0xffff;
+
+static void put16(QByteArray &buffer, quint16 value)
+{
+    uchar data[2];
+    qToLittleEndian(value, data);
+    buffer.append(reinterpret_cast<const char*>(data), 2);
+}
+
+static void put32(QByteArray &buffer, quint32 value)
+{
+    uchar data[4];
+    qToLittleEndian(value, data);
+    buffer.append(reinterpret_cast<const char*>(data), 4);
+}
+
+static void put64(QByteArray &buffer, quint64 value)
+{
+    uchar data[8];
+    qToLittleEndian(value, data);
+    buffer.append(reinterpret_cast<const char*>(data), 8);
+}
+
+static quint32 clamp32(qint64 value)
+{
+    return static_cast<quint32>(qMin<qint64>(value, MaxField32));
+}
+
+// MS-DOS dates start in 1980 and end in 2107, with a precision of two seconds.
+static quint32 dosDateTime(qint64 time)
+{
+    const QDateTime dateTime = QDateTime::fromMSecsSinceEpoch(time * 1000);
+    const QDate date = dateTime.date();
+    const QTime clock = dateTime.time();
+
+    if (date.year() < 1980) {
+        return (1 << 21) | (1 << 16);
+    }
+
+    const quint32 year = qMin(date.year(), 2107) - 1980;
+    return (year << 25) | (quint32(date.month()) << 21) | (quint32(date.day()) << 16) |
+           (quint32(clock.hour()) << 11) | (quint32(clock.minute()) << 5) | quint32(clock.second() / 2);
+}
+
+static bool isAscii(const QByteArray &name)
+{
+    foreach (char c, name) {
+        if (static_cast<uchar>(c) >= 0x80) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static quint16 flags(const QByteArray &name)
+{
+    return isAscii(name) ? 0 : FlagUtf8;
+}
+
+static quint16 versionNeeded(quint16 method, bool isDir, bool zip64)
+{
+    if (zip64) {
+        return 45;
+    }
+    return (method == MethodDeflate || isDir) ? 20 : 10;
+}
+
+static QByteArray timestampField(qint64 modificationTime)
+{
+    QByteArray field;
+    put16(field, ExtraFieldTimestamp);
+    put16(field, 5);
+    field.append(char(1));
+    put32(field, static_cast<quint32>(qBound<qint64>(0, modificationTime, MaxField32)));
+    return field;
+}
+
+class ZipWriter::CompressTask : public QRunnable
+{
+public:
+    CompressTask(ZipWriter *writer, int index)
+        : m_writer(writer)
+        , m_index(index)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        m_writer->compress(m_index);
+    }
+
+private:
+    ZipWriter *m_writer;
+    int m_index;
+};
+
+class ZipWriter::WriteTask : public QRunnable
+{
+public:
+    explicit WriteTask(ZipWriter *writer)
+        : m_writer(writer)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        m_writer->run();
+    }
+
+private:
+    ZipWriter *m_writer;
+};
+
+ZipWriter::Member::Member()
+    : isDir(false)
+    , externalAttributes(0)
+    , dosTime(0)
+    , modificationTime(0)
+    , method(MethodStore)
+    , crc(0)
+    , uncompressedSize(0)
+    , compressedSize(0)
+    , offset(0)
+{
+}
+
+ZipWriter::ZipWriter(const QString &fileName, const QVector<FileManifest::Item> &items, const QString &destination, QObject *parent)
+    : QObject(parent)
+    , m_fileName(fileName)
+    , m_totalSize(0)
+    , m_compressionLevel(-1)
+    , m_storeIncompressibleFiles(false)
+    , m_nextToCompress(0)
+    , m_nextToWrite(0)
+    , m_bytesAhead(0)
+{
+    const QDir currentDir = QDir::current();
+
+    foreach (const FileManifest::Item &item, items) {
+        const mode_t type = item.stat.st_mode & S_IFMT;
+        if (!item.isDir && type != S_IFREG) {
+            qCDebug(ARK) << "Skipping special file" << item.path;
+            continue;
+        }
+
+        Member member;
+        member.sourcePath = currentDir.absoluteFilePath(item.path);
+
+        QString name = destination + QDir::cleanPath(item.path);
+        while (name.startsWith(QLatin1Char('/'))) {
+            name.remove(0, 1);
+        }
+        if (item.isDir) {
+            name += QLatin1Char('/');
+        }
+
+        member.name = name.toUtf8();
+        member.isDir = item.isDir;
+        member.externalAttributes = (static_cast<quint32>(item.stat.st_mode & 0xffff) << 16) | (item.isDir ? 0x10 : 0);
+        member.modificationTime = item.stat.st_mtime;
+        member.dosTime = dosDateTime(item.stat.st_mtime);
+
+        if (!item.isDir) {
+            m_totalSize += item.stat.st_size;
+        }
+
+        m_items.append(item);
+        m_members.append(member);
+    }
+
+    m_isReady.fill(false, m_members.size());
+
+    // One thread is taken by the writer, which mostly waits for the compressors.
+    m_pool.setMaxThreadCount(QThread::idealThreadCount() + 1);
+}
+
+ZipWriter::~ZipWriter()
+{
+    cancel();
+    m_pool.waitForDone();
+}
+
+void ZipWriter::setCompressionLevel(int level)
+{
+    m_compressionLevel = level;
+}
+
+void ZipWriter::setStoreIncompressibleFiles(bool store)
+{
+    m_storeIncompressibleFiles = store;
+}
+
+void ZipWriter::start()
+{
+    m_pool.start(new WriteTask(this));
+}
+
+void ZipWriter::cancel()
+{
+    m_isCancelled.store(1);
+}
+
+bool ZipWriter::isCancelled() const
+{
+    return m_isCancelled.load() != 0;
+}
+
+QString ZipWriter::errorString() const
+{
+    return m_errorString;
+}
+
+void ZipWriter::run()
+{
+    bool result;
+
+    {
+        QSaveFile archive(m_fileName);
+        result = archive.open(QIODevice::WriteOnly);
+
+        if (!result) {
+            m_errorString = xi18nc("@info", "Could not open the archive <filename>%1</filename> for writing.", m_fileName);
+        } else {
+            result = write(&archive) && !isCancelled();
+        }
+
+        if (result) {
+            result = archive.commit();
+            if (!result) {
+                m_errorString = xi18nc("@info", "Could not write the archive <filename>%1</filename>.", m_fileName);
+            }
+        } else {
+            archive.cancelWriting();
+        }
+
+        if (!result) {
+            // Drop what has not been compressed yet.
+            QMutexLocker locker(&m_mutex);
+            m_nextToCompress = m_members.size();
+            m_pool.clear();
+        }
+    }
+
+    emit finished(result);
+}
+
+bool ZipWriter::write(QIODevice *archive)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        scheduleCompression();
+    }
+
+    qint64 offset = 0;
+    qint64 doneBytes = 0;
+
+    for (int i = 0; i < m_members.size(); ++i) {
+        {
+            QMutexLocker locker(&m_mutex);
+            while (!m_isReady.at(i)) {
+                m_memberReady.wait(&m_mutex);
+            }
+        }
+
+        if (isCancelled()) {
+            return false;
+        }
+
+        Member &member = m_members[i];
+        if (!member.error.isEmpty()) {
+            m_errorString = member.error;
+            return false;
+        }
+
+        member.offset = offset;
+        if (!writeLocalHeader(archive, member) || !writeData(archive, member)) {
+            m_errorString = xi18nc("@info", "Could not write the archive <filename>%1</filename>.", m_fileName);
+            return false;
+        }
+        offset = archive->pos();
+
+        member.data.clear();
+        member.spillFile.clear();
+
+        {
+            QMutexLocker locker(&m_mutex);
+            m_bytesAhead -= inMemorySize(i);
+            m_nextToWrite++;
+            scheduleCompression();
+        }
+
+        doneBytes += member.uncompressedSize;
+        emit progress(m_totalSize > 0 ? double(doneBytes) / double(m_totalSize) : double(i + 1) / double(m_members.size()));
+    }
+
+    if (!writeCentralDirectory(archive, offset)) {
+        m_errorString = xi18nc("@info", "Could not write the archive <filename>%1</filename>.", m_fileName);
+        return false;
+    }
+
+    return true;
+}
+
+void ZipWriter::scheduleCompression()
+{
+    const int maxMembersAhead = 4 * QThread::idealThreadCount();
+
+    while (m_nextToCompress < m_members.size() &&
+           m_nextToCompress - m_nextToWrite < maxMembersAhead &&
+           m_bytesAhead < MaxBytesAhead) {
+        // Folders have no data to be compressed.
+        if (!m_members.at(m_nextToCompress).isDir) {
+            m_bytesAhead += inMemorySize(m_nextToCompress);
+            m_pool.start(new CompressTask(this, m_nextToCompress));
+        } else {
+            m_isReady[m_nextToCompress] = true;
+        }
+
+        m_nextToCompress++;
+    }
+}
+
+void ZipWriter::compress(int index)
+{
+    if (!isCancelled()) {
+        deflateMember(m_members[index], m_items.at(index));
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_isReady[index] = true;
+    m_memberReady.wakeAll();
+}
+
+bool ZipWriter::deflateMember(Member &member, const FileManifest::Item &item)
+{
+    QFile file(member.sourcePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        member.error = xi18nc("@info", "Could not open the file <filename>%1</filename> for reading.", item.path);
+        return false;
+    }
+
+    // Small members are kept in memory, so they can still be stored as they
+    // are if deflating does not make them smaller.
+    const bool spill = item.stat.st_size > MaxInMemorySize;
+    if (spill) {
+        member.spillFile.reset(new QTemporaryFile(QDir::tempPath() + QLatin1String("/ark-zip-XXXXXX")));
+        if (!member.spillFile->open()) {
+            member.error = i18nc("@info", "Failed to create a temporary file for writing data.");
+            return false;
+        }
+    }
+
+    bool store = (m_compressionLevel == 0);
+    bool isFirstChunk = true;
+    bool isDeflating = false;
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+
+    QByteArray input(ChunkSize, Qt::Uninitialized);
+    QByteArray output(ChunkSize, Qt::Uninitialized);
+    QByteArray storedData;
+    uLong crc = crc32(0, Z_NULL, 0);
+    bool isSuccessful = true;
+
+    auto appendOutput = [&](const char *data, qint64 size) {
+        if (spill) {
+            return member.spillFile->write(data, size) == size;
+        }
+        member.data.append(data, static_cast<int>(size));
+        return true;
+    };
+
+    forever {
+        if (isCancelled()) {
+            isSuccessful = false;
+            break;
+        }
+
+        const qint64 readBytes = file.read(input.data(), ChunkSize);
+        if (readBytes < 0) {
+            member.error = xi18nc("@info", "Could not read the file <filename>%1</filename>.", item.path);
+            isSuccessful = false;
+            break;
+        }
+
+        crc = crc32(crc, reinterpret_cast<const Bytef*>(input.constData()), static_cast<uInt>(readBytes));
+        member.uncompressedSize += readBytes;
+
+        // The method is chosen once the beginning of the file is known.
+        if (isFirstChunk) {
+            isFirstChunk = false;
+
+            if (!store && m_storeIncompressibleFiles &&
+                Kerfuffle::isIncompressible(item.path, QByteArray::fromRawData(input.constData(), static_cast<int>(readBytes)))) {
+                qCDebug(ARK) << "Storing incompressible file" << item.path;
+                store = true;
+            }
+
+            if (!store) {
+                if (deflateInit2(&stream, m_compressionLevel, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+                    isSuccessful = false;
+                    break;
+                }
+                isDeflating = true;
+            }
+
+            member.method = store ? MethodStore : MethodDeflate;
+        }
+
+        if (store) {
+            if (!appendOutput(input.constData(), readBytes)) {
+                isSuccessful = false;
+                break;
+            }
+            if (readBytes == 0) {
+                break;
+            }
+            continue;
+        }
+
+        if (!spill) {
+            storedData.append(input.constData(), static_cast<int>(readBytes));
+        }
+
+        const int flush = (readBytes == 0) ? Z_FINISH : Z_NO_FLUSH;
+        stream.next_in = reinterpret_cast<Bytef*>(input.data());
+        stream.avail_in = static_cast<uInt>(readBytes);
+
+        do {
+            stream.next_out = reinterpret_cast<Bytef*>(output.data());
+            stream.avail_out = ChunkSize;
+            deflate(&stream, flush);
+
+            if (!appendOutput(output.constData(), ChunkSize - stream.avail_out)) {
+                isSuccessful = false;
+                break;
+            }
+        } while (stream.avail_out == 0);
+
+        if (!isSuccessful || flush == Z_FINISH) {
+            break;
+        }
+    }
+
+    if (isDeflating) {
+        deflateEnd(&stream);
+    }
+
+    if (!isSuccessful) {
+        if (member.error.isEmpty() && !isCancelled()) {
+            member.error = i18nc("@info", "Could not compress entry, operation aborted.");
+        }
+        return false;
+    }
+
+    member.crc = static_cast<quint32>(crc);
+
+    if (spill) {
+        member.compressedSize = member.spillFile->size();
+    } else if (!store && member.data.size() >= storedData.size()) {
+        member.method = MethodStore;
+        member.data = storedData;
+        member.compressedSize = member.data.size();
+    } else {
+        member.compressedSize = member.data.size();
+    }
+
+    return true;
+}
+
+bool ZipWriter::writeLocalHeader(QIODevice *archive, Member &member)
+{
+    // Both sizes go into the ZIP64 field of a local header, or neither.
+    const bool zip64 = member.uncompressedSize >= MaxField32 || member.compressedSize >= MaxField32;
+
+    QByteArray extra = timestampField(member.modificationTime);
+    if (zip64) {
+        put16(extra, ExtraFieldZip64);
+        put16(extra, 16);
+        put64(extra, member.uncompressedSize);
+        put64(extra, member.compressedSize);
+    }
+
+    QByteArray header;
+    header.reserve(30 + member.name.size() + extra.size());
+    put32(header, LocalHeaderSignature);
+    put16(header, versionNeeded(member.method, member.isDir, zip64));
+    put16(header, flags(member.name));
+    put16(header, member.method);
+    put32(header, member.dosTime);
+    put32(header, member.crc);
+    put32(header, zip64 ? MaxField32 : static_cast<quint32>(member.compressedSize));
+    put32(header, zip64 ? MaxField32 : static_cast<quint32>(member.uncompressedSize));
+    put16(header, static_cast<quint16>(member.name.size()));
+    put16(header, static_cast<quint16>(extra.size()));
+    header.append(member.name);
+    header.append(extra);
+
+    return archive->write(header) == header.size();
+}
+
+bool ZipWriter::writeData(QIODevice *archive, const Member &member)
+{
+    if (!member.spillFile) {
+        return archive->write(member.data) == member.data.size();
+    }
+
+    if (!member.spillFile->seek(0)) {
+        return false;
+    }
+
+    QByteArray buffer(ChunkSize, Qt::Uninitialized);
+    forever {
+        const qint64 readBytes = member.spillFile->read(buffer.data(), ChunkSize);
+        if (readBytes <= 0) {
+            return readBytes == 0;
+        }
+        if (archive->write(buffer.constData(), readBytes) != readBytes) {
+            return false;
+        }
+    }
+}
+
+bool ZipWriter::writeCentralDirectory(QIODevice *archive, qint64 offset)
+{
+    QByteArray directory;
+
+    foreach (const Member &member, m_members) {
+        QByteArray extra = timestampField(member.modificationTime);
+
+        // The ZIP64 field of the central directory only has the values that overflow.
+        QByteArray zip64Field;
+        if (member.uncompressedSize >= MaxField32) {
+            put64(zip64Field, member.uncompressedSize);
+        }
+        if (member.compressedSize >= MaxField32) {
+            put64(zip64Field, member.compressedSize);
+        }
+        if (member.offset >= MaxField32) {
+            put64(zip64Field, member.offset);
+        }
+        if (!zip64Field.isEmpty()) {
+            put16(extra, ExtraFieldZip64);
+            put16(extra, static_cast<quint16>(zip64Field.size()));
+            extra.append(zip64Field);
+        }
+
+        put32(directory, CentralHeaderSignature);
+        put16(directory, VersionMadeBy);
+        put16(directory, versionNeeded(member.method, member.isDir, !zip64Field.isEmpty()));
+        put16(directory, flags(member.name));
+        put16(directory, member.method);
+        put32(directory, member.dosTime);
+        put32(directory, member.crc);
+        put32(directory, clamp32(member.compressedSize));
+        put32(directory, clamp32(member.uncompressedSize));
+        put16(directory, static_cast<quint16>(member.name.size()));
+        put16(directory, static_cast<quint16>(extra.size()));
+        put16(directory, 0); // comment length
+        put16(directory, 0); // disk number
+        put16(directory, 0); // internal attributes
+        put32(directory, member.externalAttributes);
+        put32(directory, clamp32(member.offset));
+        directory.append(member.name);
+        directory.append(extra);
+    }
+
+    const qint64 count = m_members.size();
+    const qint64 directorySize = directory.size();
+    const qint64 directoryEnd = offset + directorySize;
+
+    if (count >= MaxField16 || directorySize >= MaxField32 || offset >= MaxField32) {
+        put32(directory, Zip64EndOfCentralDirectorySignature);
+        put64(directory, 44);
+        put16(directory, VersionMadeBy);
+        put16(directory, 45);
+        put32(directory, 0);
+        put32(directory, 0);
+        put64(directory, count);
+        put64(directory, count);
+        put64(directory, directorySize);
+        put64(directory, offset);
+
+        put32(directory, Zip64LocatorSignature);
+        put32(directory, 0);
+        put64(directory, directoryEnd);
+        put32(directory, 1);
+    }
+
+    put32(directory, EndOfCentralDirectorySignature);
+    put16(directory, 0);
+    put16(directory, 0);
+    put16(directory, static_cast<quint16>(qMin<qint64>(count, MaxField16)));
+    put16(directory, static_cast<quint16>(qMin<qint64>(count, MaxField16)));
+    put32(directory, clamp32(directorySize));
+    put32(directory, clamp32(offset));
+    put16(directory, 0);
+
+    return archive->write(directory) == directory.size();
+}
+
+qint64 ZipWriter::inMemorySize(int index) const
+{
+    if (m_members.at(index).isDir) {
+        return 0;
+    }
+    // A member kept in memory needs room for both its data and its compressed data.
+    return 2 * qMin<qint64>(m_items.at(index).stat.st_size, MaxInMemorySize);
+}
@@ -0,0 +1,169 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ZIPWRITER_H
+#define ZIPWRITER_H
+
+#include "filemanifest.h"
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QMutex>
+#include <QObject>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QVector>
+#include <QWaitCondition>
+
+class QIODevice;
+class QTemporaryFile;
+
+/**
+ * Creates a new zip archive from the files of a FileManifest.
+ *
+ * The members are deflated in parallel, each into a buffer or, if big, into
+ * a temporary spill file. The archive itself is written sequentially in the
+ * order of the manifest, so the result does not depend on the number of
+ * threads. Since the sizes and the CRC of a member are known before its
+ * local header is written, no data descriptors are needed. ZIP64 records are
+ * only added where the sizes, the offsets or the number of members require
+ * them.
+ *
+ * The writer runs in a thread of its own after start() and reports the
+ * result with finished().
+ */
+class ZipWriter : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @param fileName The archive to create.
+     * @param items The files to add, as relative paths.
+     * @param destination The folder of the archive the files are added to,
+     *        with a trailing slash, or an empty string.
+     */
+    ZipWriter(const QString &fileName, const QVector<Kerfuffle::FileManifest::Item> &items, const QString &destination, QObject *parent = Q_NULLPTR);
+    virtual ~ZipWriter();
+
+    /**
+     * Sets the zlib compression level, from 0 (store) to 9. The default is
+     * -1, i.e. zlib's default level.
+     */
+    void setCompressionLevel(int level);
+
+    /**
+     * Sets whether the files found by Kerfuffle::isIncompressible() are
+     * stored instead of deflated. The default is false.
+     */
+    void setStoreIncompressibleFiles(bool store);
+
+    void start();
+
+    /**
+     * Stops the writer as soon as possible. The archive is not created and
+     * finished() is emitted with @c false.
+     */
+    void cancel();
+
+    bool isCancelled() const;
+
+    /**
+     * @return The reason of the failure, or an empty string if it was
+     *         cancelled.
+     */
+    QString errorString() const;
+
+signals:
+    void progress(double progress);
+    void finished(bool result);
+
+private:
+    class CompressTask;
+    class WriteTask;
+
+    struct Member
+    {
+        Member();
+
+        /**
+         * The absolute path of the file to add.
+         */
+        QString sourcePath;
+
+        /**
+         * The path in the archive, UTF-8 encoded.
+         */
+        QByteArray name;
+        bool isDir;
+        quint32 externalAttributes;
+        quint32 dosTime;
+        qint64 modificationTime;
+
+        quint16 method;
+        quint32 crc;
+        qint64 uncompressedSize;
+        qint64 compressedSize;
+        qint64 offset;
+
+        /**
+         * The compressed data, unless it is in the spill file.
+         */
+        QByteArray data;
+        QSharedPointer<QTemporaryFile> spillFile;
+
+        QString error;
+    };
+
+    void run();
+    bool write(QIODevice *archive);
+    void scheduleCompression();
+    void compress(int index);
+    bool deflateMember(Member &member, const Kerfuffle::FileManifest::Item &item);
+    bool writeLocalHeader(QIODevice *archive, Member &member);
+    bool writeData(QIODevice *archive, const Member &member);
+    bool writeCentralDirectory(QIODevice *archive, qint64 offset);
+    qint64 inMemorySize(int index) const;
+
+    const QString m_fileName;
+    QVector<Kerfuffle::FileManifest::Item> m_items;
+    QVector<Member> m_members;
+    qint64 m_totalSize;
+    int m_compressionLevel;
+    bool m_storeIncompressibleFiles;
+
+    QThreadPool m_pool;
+    QMutex m_mutex;
+    QWaitCondition m_memberReady;
+    QVector<bool> m_isReady;
+    int m_nextToCompress;
+    int m_nextToWrite;
+    qint64 m_bytesAhead;
+
+    QAtomicInt m_isCancelled;
+    QString m_errorString;
+};
+
+#endif // ZIPWRITER_H
@@ -0,0 +1,204 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "fileprefetcher.h"
+#include "ark_debug.h"
+
+#include <QFile>
+#include <QRunnable>
+
+#ifdef Q_OS_UNIX
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using Kerfuffle::FileManifest;
+
+// Few threads are enough to hide the latency of opening files.
+static const int ThreadCount = 4;
+static const int MaxFilesAhead = 64;
+static const qint64 MaxBytesAhead = 32 * 1024 * 1024;
+static const qint64 MaxFileBytesAhead = 1024 * 1024;
+
+class FilePrefetcher::ReadTask : public QRunnable
+{
+public:
+    ReadTask(FilePrefetcher *prefetcher, int index)
+        : m_prefetcher(prefetcher)
+        , m_index(index)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        m_prefetcher->read(m_index);
+    }
+
+private:
+    FilePrefetcher *m_prefetcher;
+    int m_index;
+};
+
+FilePrefetcher::FilePrefetcher(const QVector<FileManifest::Item> &items)
+    : m_items(items)
+    , m_files(items.size())
+    , m_isReady(items.size(), false)
+    , m_nextToRead(0)
+    , m_nextToTake(0)
+    , m_bytesAhead(0)
+{
+    m_pool.setMaxThreadCount(ThreadCount);
+
+    QMutexLocker locker(&m_mutex);
+    scheduleReads();
+}
+
+FilePrefetcher::~FilePrefetcher()
+{
+    m_mutex.lock();
+    m_nextToRead = m_items.size();
+    m_mutex.unlock();
+
+    m_pool.clear();
+    m_pool.waitForDone();
+
+#ifdef Q_OS_UNIX
+    for (int i = m_nextToTake; i < m_files.size(); ++i) {
+        if (m_files.at(i).fd != -1) {
+            close(m_files.at(i).fd);
+        }
+    }
+#endif
+}
+
+FilePrefetcher::File FilePrefetcher::takeNext()
+{
+    QMutexLocker locker(&m_mutex);
+    Q_ASSERT(m_nextToTake < m_items.size());
+
+    const int index = m_nextToTake;
+    while (!m_isReady.at(index)) {
+        m_fileReady.wait(&m_mutex);
+    }
+
+    const File file = m_files.at(index);
+    m_files[index] = File();
+    m_bytesAhead -= readAheadSize(m_items.at(index));
+    m_nextToTake++;
+
+    scheduleReads();
+
+    return file;
+}
+
+int FilePrefetcher::openForReading(const QByteArray &path)
+{
+#ifdef Q_OS_UNIX
+    // The manifest has found a regular file: don't follow a symlink which
+    // has replaced it since.
+#ifdef O_NOATIME
+    // O_NOATIME is only allowed to the owner of the file.
+    const int fd = open(path.constData(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW | O_NOATIME);
+    if (fd != -1 || errno != EPERM) {
+        return fd;
+    }
+#endif
+
+    return open(path.constData(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+#else
+    Q_UNUSED(path)
+    return -1;
+#endif
+}
+
+void FilePrefetcher::scheduleReads()
+{
+    while (m_nextToRead < m_items.size() &&
+           m_nextToRead - m_nextToTake < MaxFilesAhead &&
+           m_bytesAhead < MaxBytesAhead) {
+        const FileManifest::Item &item = m_items.at(m_nextToRead);
+
+        // Only regular files have anything to be read ahead.
+        if ((item.stat.st_mode & S_IFMT) == S_IFREG) {
+            m_bytesAhead += readAheadSize(item);
+            m_pool.start(new ReadTask(this, m_nextToRead));
+        } else {
+            m_isReady[m_nextToRead] = true;
+        }
+
+        m_nextToRead++;
+    }
+}
+
+void FilePrefetcher::read(int index)
+{
+    File file;
+
+#ifdef Q_OS_UNIX
+    const FileManifest::Item &item = m_items.at(index);
+    file.fd = openForReading(QFile::encodeName(item.path));
+
+    if (file.fd != -1 && fstat(file.fd, &file.stat) != 0) {
+        close(file.fd);
+        file.fd = -1;
+    }
+
+    if (file.fd != -1) {
+        const qint64 size = qMin<qint64>(file.stat.st_size, MaxFileBytesAhead);
+        file.data.resize(static_cast<int>(size));
+
+        qint64 offset = 0;
+        while (offset < size) {
+            const ssize_t readBytes = pread(file.fd, file.data.data() + offset, static_cast<size_t>(size - offset), offset);
+            if (readBytes < 0 && errno == EINTR) {
+                continue;
+            }
+            if (readBytes <= 0) {
+                break;
+            }
+            offset += readBytes;
+        }
+
+        file.data.resize(static_cast<int>(offset));
+    } else {
+        qCWarning(ARK) << "Could not open" << item.path;
+    }
+#endif
+
+    QMutexLocker locker(&m_mutex);
+    m_files[index] = file;
+    m_isReady[index] = true;
+    m_fileReady.wakeAll();
+}
+
+qint64 FilePrefetcher::readAheadSize(const FileManifest::Item &item)
+{
+    if ((item.stat.st_mode & S_IFMT) != S_IFREG) {
+        return 0;
+    }
+
+    return qMin<qint64>(item.stat.st_size, MaxFileBytesAhead);
+}
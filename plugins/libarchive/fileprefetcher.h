@@ -0,0 +1,119 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FILEPREFETCHER_H
+#define FILEPREFETCHER_H
+
+#include "filemanifest.h"
+
+#include <QByteArray>
+#include <QMutex>
+#include <QThreadPool>
+#include <QVector>
+#include <QWaitCondition>
+
+/**
+ * Opens and reads ahead the files of a manifest on a small thread pool, so
+ * that the archive writer doesn't wait for every file to be opened and read,
+ * which is slow on network filesystems.
+ *
+ * The files are taken in the order of the manifest. At most a fixed number
+ * of files and bytes are read ahead of the file being taken, and only the
+ * start of big files: the writer reads the rest of them by itself.
+ */
+class FilePrefetcher
+{
+public:
+
+    struct File
+    {
+        /**
+         * The open file, or -1 if it is not a regular file or it could
+         * not be opened.
+         */
+        int fd = -1;
+
+        /**
+         * The fstat() data of the open file.
+         */
+        struct stat stat;
+
+        /**
+         * The data read ahead from the start of the file.
+         */
+        QByteArray data;
+    };
+
+    explicit FilePrefetcher(const QVector<Kerfuffle::FileManifest::Item> &items);
+
+    /**
+     * Waits for the running reads and closes the files which have not been taken.
+     */
+    ~FilePrefetcher();
+
+    /**
+     * Takes the next file, waiting until it has been read ahead. The caller
+     * becomes responsible for closing its descriptor.
+     */
+    File takeNext();
+
+    /**
+     * Opens @p path for reading, if possible without updating its access time.
+     * A symlink is not followed.
+     * @return The file descriptor, or -1 on failure.
+     */
+    static int openForReading(const QByteArray &path);
+
+private:
+    class ReadTask;
+
+    /**
+     * Starts reading ahead as many files as allowed. Must be called with
+     * m_mutex locked.
+     */
+    void scheduleReads();
+
+    /**
+     * Opens and reads ahead the file at @p index. Runs in the thread pool.
+     */
+    void read(int index);
+
+    /**
+     * @return How many bytes of @p item are read ahead.
+     */
+    static qint64 readAheadSize(const Kerfuffle::FileManifest::Item &item);
+
+    const QVector<Kerfuffle::FileManifest::Item> m_items;
+    QVector<File> m_files;
+    QVector<bool> m_isReady;
+    int m_nextToRead;
+    int m_nextToTake;
+    qint64 m_bytesAhead;
+    QMutex m_mutex;
+    QWaitCondition m_fileReady;
+    QThreadPool m_pool;
+};
+
+#endif // FILEPREFETCHER_H
@@ -28,20 +28,355 @@
 
 #include "libarchiveplugin.h"
 #include "ark_debug.h"
+#include "diskio.h"
+#include "entryselection.h"
 #include "queries.h"
+#ifdef HAVE_LIBURING
+#include "uringdiskwriter.h"
+#endif
 
 #include <KLocalizedString>
 
 #include <QDirIterator>
+#include <QMutex>
+#include <QProcess>
+#include <QSet>
 #include <QThread>
+#include <QWaitCondition>
 
 #include <archive_entry.h>
 
+#ifdef Q_OS_UNIX
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+#ifdef HAVE_COPY_FILE_RANGE
+// Smaller files are not worth the additional syscalls.
+const qint64 MinStoredDataSize = 1024 * 1024;
+// The data is copied in chunks, so that progress is reported and the job can be cancelled.
+const qint64 StoredDataChunkSize = 64 * 1024 * 1024;
+#endif
+
+#ifdef HAVE_LIBURING
+// Bigger files are written by archive_write_disk, for which the syscalls per
+// file don't matter much.
+const qint64 MaxSmallFileSize = 64 * 1024;
+#endif
+
+// Entries are written with absolute paths, which QFileInfo has already cleaned
+// up: ARCHIVE_EXTRACT_SECURE_NODOTDOT would no longer see the "..".
+bool hasParentDirComponent(const QString &path)
+{
+    return path.split(QLatin1Char('/')).contains(QStringLiteral(".."));
+}
+
+// A process may still write more even if nothing is available: the device
+// is over once the process has exited and all of its output has been read.
+bool isDeviceFinished(QIODevice *device)
+{
+    const QProcess *process = qobject_cast<QProcess*>(device);
+    if (process) {
+        return process->state() == QProcess::NotRunning && process->bytesAvailable() == 0;
+    }
+    return device->atEnd();
+}
+
+// archive_write_disk doesn't give access to the file it writes, so these
+// open it once more. Errors opening it are left to archive_write_disk.
+bool preallocate(const QString &path, qint64 size)
+{
+    const int fd = open(QFile::encodeName(path).constData(), O_WRONLY | O_CLOEXEC | O_NOFOLLOW);
+    if (fd == -1) {
+        return true;
+    }
+
+    const bool success = preallocateFile(fd, size);
+    close(fd);
+    return success;
+}
+
+bool syncFile(const QString &path)
+{
+    const int fd = open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    if (fd == -1) {
+        return true;
+    }
+
+    const bool success = (fsync(fd) == 0);
+    const int error = errno;
+    close(fd);
+    errno = error;
+    return success;
+}
+
+/**
+ * Streams the data of one archive entry. The entry is looked for and
+ * decompressed by a thread of its own, with its own archive reader, so that
+ * neither the reading thread nor the jobs running on the plugin are blocked.
+ * New data is announced with readyRead().
+ */
+class EntryDevice : public QIODevice
+{
+public:
+    EntryDevice(const QString &archiveFileName, const QString &entryPath)
+        : m_archiveFileName(archiveFileName)
+        , m_entryPath(entryPath)
+        , m_thread(this)
+    {
+        m_thread.start();
+    }
+
+    virtual ~EntryDevice()
+    {
+        {
+            QMutexLocker locker(&m_mutex);
+            m_isCancelled = true;
+            m_condition.wakeAll();
+        }
+        m_thread.wait();
+    }
+
+    virtual bool isSequential() const Q_DECL_OVERRIDE
+    {
+        return true;
+    }
+
+    virtual qint64 bytesAvailable() const Q_DECL_OVERRIDE
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_buffer.size() + QIODevice::bytesAvailable();
+    }
+
+    virtual bool atEnd() const Q_DECL_OVERRIDE
+    {
+        // QIODevice::atEnd() calls bytesAvailable(), which locks m_mutex too.
+        QMutexLocker locker(&m_mutex);
+        return m_isFinished && m_buffer.isEmpty() && QIODevice::bytesAvailable() == 0;
+    }
+
+    /**
+     * Blocks until some data has been decompressed, for readers running in
+     * a thread without event loop.
+     */
+    virtual bool waitForReadyRead(int msecs) Q_DECL_OVERRIDE
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_buffer.isEmpty() && !m_isFinished) {
+            m_condition.wait(&m_mutex, (msecs < 0) ? ULONG_MAX : static_cast<unsigned long>(msecs));
+        }
+        return !m_buffer.isEmpty();
+    }
+
+protected:
+    virtual qint64 readData(char *data, qint64 maxSize) Q_DECL_OVERRIDE
+    {
+        QMutexLocker locker(&m_mutex);
+
+        if (m_buffer.isEmpty()) {
+            if (!m_isFinished) {
+                return 0;
+            }
+            if (!m_errorString.isEmpty()) {
+                setErrorString(m_errorString);
+            }
+            return -1;
+        }
+
+        const int readBytes = static_cast<int>(qMin<qint64>(maxSize, m_buffer.size()));
+        memcpy(data, m_buffer.constData(), static_cast<size_t>(readBytes));
+        m_buffer.remove(0, readBytes);
+        m_condition.wakeAll();
+
+        return readBytes;
+    }
+
+    virtual qint64 writeData(const char *data, qint64 maxSize) Q_DECL_OVERRIDE
+    {
+        Q_UNUSED(data)
+        Q_UNUSED(maxSize)
+        return -1;
+    }
+
+private:
+    class Thread : public QThread
+    {
+    public:
+        explicit Thread(EntryDevice *device)
+            : m_device(device)
+        {
+        }
+
+    protected:
+        virtual void run() Q_DECL_OVERRIDE
+        {
+            m_device->decompress();
+        }
+
+    private:
+        EntryDevice *m_device;
+    };
+
+    // Decompressing further than this ahead of the reader is useless.
+    static const int MaxBufferSize = 1024 * 1024;
+    static const int ChunkSize = 64 * 1024;
+
+    /**
+     * Runs in m_thread: looks for the entry, then decompresses it into m_buffer.
+     */
+    void decompress()
+    {
+        struct archive *reader = archive_read_new();
+        if (!reader) {
+            finish(i18nc("@info", "The archive reader could not be initialized."));
+            return;
+        }
+
+        if (archive_read_support_filter_all(reader) != ARCHIVE_OK ||
+            archive_read_support_format_all(reader) != ARCHIVE_OK ||
+            archive_read_open_filename(reader, QFile::encodeName(m_archiveFileName).constData(), 10240) != ARCHIVE_OK) {
+            qCWarning(ARK) << "Could not open the archive:" << archive_error_string(reader);
+            archive_read_free(reader);
+            finish(i18nc("@info", "Archive corrupted or insufficient permissions."));
+            return;
+        }
+
+        bool entryFound = false;
+        struct archive_entry *entry;
+        while (!isCancelled() && archive_read_next_header(reader, &entry) == ARCHIVE_OK) {
+            QString entryName = QDir::fromNativeSeparators(QFile::decodeName(archive_entry_pathname(entry)));
+            if (entryName != m_entryPath && entryName.startsWith(QLatin1String("./"))) {
+                entryName.remove(0, 2);
+            }
+            if (entryName == m_entryPath) {
+                entryFound = true;
+                break;
+            }
+        }
+
+        if (!entryFound) {
+            if (!isCancelled()) {
+                qCWarning(ARK) << "Could not find" << m_entryPath << "in the archive:" << archive_error_string(reader);
+            }
+            archive_read_free(reader);
+            finish(i18nc("@info", "The file could not be found in the archive."));
+            return;
+        }
+
+        QByteArray chunk(ChunkSize, Qt::Uninitialized);
+        forever {
+            const la_ssize_t readBytes = archive_read_data(reader, chunk.data(), static_cast<size_t>(chunk.size()));
+            if (readBytes < 0) {
+                qCWarning(ARK) << "Could not read" << m_entryPath << "from the archive:" << archive_error_string(reader);
+                archive_read_free(reader);
+                finish(i18nc("@info", "Archive corrupted or insufficient permissions."));
+                return;
+            }
+            if (readBytes == 0) {
+                break;
+            }
+
+            QMutexLocker locker(&m_mutex);
+            while (!m_isCancelled && m_buffer.size() >= MaxBufferSize) {
+                m_condition.wait(&m_mutex);
+            }
+            if (m_isCancelled) {
+                break;
+            }
+            // The reader is told only once about data it hasn't read yet.
+            const bool wasEmpty = m_buffer.isEmpty();
+            m_buffer.append(chunk.constData(), static_cast<int>(readBytes));
+            m_condition.wakeAll();
+            locker.unlock();
+
+            if (wasEmpty) {
+                QMetaObject::invokeMethod(this, "readyRead", Qt::QueuedConnection);
+            }
+        }
+
+        archive_read_free(reader);
+        finish(QString());
+    }
+
+    void finish(const QString &errorString)
+    {
+        {
+            QMutexLocker locker(&m_mutex);
+            m_isFinished = true;
+            m_errorString = errorString;
+            m_condition.wakeAll();
+        }
+
+        QMetaObject::invokeMethod(this, "readyRead", Qt::QueuedConnection);
+        QMetaObject::invokeMethod(this, "readChannelFinished", Qt::QueuedConnection);
+    }
+
+    bool isCancelled() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_isCancelled;
+    }
+
+    const QString m_archiveFileName;
+    const QString m_entryPath;
+    Thread m_thread;
+
+    // Shared with m_thread.
+    mutable QMutex m_mutex;
+    QWaitCondition m_condition;
+    QByteArray m_buffer;
+    QString m_errorString;
+    bool m_isFinished = false;
+    bool m_isCancelled = false;
+};
+
+}
+
+/**
+ * A device streaming a nested archive, together with the buffer handed to
+ * libarchive by readDeviceSource().
+ */
+struct LibarchivePlugin::DeviceSource
+{
+    explicit DeviceSource(QIODevice *device)
+        : device(device)
+        , buffer(64 * 1024, Qt::Uninitialized)
+    {
+    }
+
+    QScopedPointer<QIODevice> device;
+    QByteArray buffer;
+};
+
+class LibarchivePlugin::ContainerReaderGuard
+{
+public:
+    explicit ContainerReaderGuard(LibarchivePlugin *plugin)
+        : m_plugin(plugin)
+    {
+    }
+
+    ~ContainerReaderGuard()
+    {
+        if (m_plugin->m_deviceSource) {
+            m_plugin->m_archiveReader.reset();
+            m_plugin->m_deviceSource.reset();
+        }
+    }
+
+private:
+    LibarchivePlugin *m_plugin;
+};
+
 LibarchivePlugin::LibarchivePlugin(QObject *parent, const QVariantList &args)
     : ReadWriteArchiveInterface(parent, args)
     , m_archiveReadDisk(archive_read_disk_new())
     , m_cachedArchiveEntryCount(0)
-    , m_emitNoEntries(false)
     , m_extractedFilesSize(0)
 {
     qCDebug(ARK) << "Initializing libarchive plugin";
@@ -59,6 +394,7 @@ LibarchivePlugin::~LibarchivePlugin()
 bool LibarchivePlugin::list()
 {
     qCDebug(ARK) << "Listing archive contents";
+    const ContainerReaderGuard containerReaderGuard(this);
 
     if (!initializeReader()) {
         return false;
@@ -73,7 +409,8 @@ bool LibarchivePlugin::list()
     m_cachedArchiveEntryCount = 0;
     m_extractedFilesSize = 0;
     m_numberOfEntries = 0;
-    auto compressedArchiveSize = QFileInfo(filename()).size();
+    auto compressedArchiveSize = containerEntry() ? static_cast<qint64>(containerEntry()->size())
+                                                  : QFileInfo(filename()).size();
 
     struct archive_entry *aentry;
     int result = ARCHIVE_RETRY;
@@ -86,9 +423,7 @@ bool LibarchivePlugin::list()
             firstEntry = false;
         }
 
-        if (!m_emitNoEntries) {
-            emitEntryFromArchiveEntry(aentry);
-        }
+        emitEntryFromArchiveEntry(aentry);
 
         m_extractedFilesSize += (qlonglong)archive_entry_size(aentry);
 
@@ -145,7 +480,83 @@ bool LibarchivePlugin::addComment(const QString &comment)
 
 bool LibarchivePlugin::testArchive()
 {
-    return false;
+    qCDebug(ARK) << "Testing archive";
+    const ContainerReaderGuard containerReaderGuard(this);
+
+    // Compression formats have their checksums at the end, e.g. after the
+    // padding of a tar archive, which a reader of the entries doesn't read.
+    // So the entries are read by another reader from the data decompressed
+    // by m_archiveReader, which is then read up to the end.
+    if (!initializeReader(true)) {
+        return false;
+    }
+
+    struct archive_entry *entry;
+    if (archive_read_next_header(m_archiveReader.data(), &entry) != ARCHIVE_OK) {
+        qCWarning(ARK) << "Could not decompress the archive:" << archive_error_string(m_archiveReader.data());
+        return true;
+    }
+
+    const bool isCompressed = archive_filter_count(m_archiveReader.data()) > 1;
+    ArchiveRead entryReader;
+    if (isCompressed) {
+        entryReader.reset(archive_read_new());
+        if (!entryReader.data()) {
+            emit error(i18n("The archive reader could not be initialized."));
+            return false;
+        }
+        if (archive_read_support_format_all(entryReader.data()) != ARCHIVE_OK ||
+            archive_read_open(entryReader.data(), m_archiveReader.data(), Q_NULLPTR, readRawData, Q_NULLPTR) != ARCHIVE_OK) {
+            qCWarning(ARK) << "Could not read the decompressed archive:" << archive_error_string(entryReader.data());
+            return true;
+        }
+    } else if (!initializeReader()) {
+        return false;
+    }
+
+    struct archive *reader = isCompressed ? entryReader.data() : m_archiveReader.data();
+    const qint64 compressedArchiveSize = containerEntry() ? static_cast<qint64>(containerEntry()->size())
+                                                          : QFileInfo(filename()).size();
+
+    // The data is thrown away once libarchive has checked it.
+    const void *block;
+    size_t blockSize;
+    la_int64_t blockOffset;
+    int result;
+    while (!QThread::currentThread()->isInterruptionRequested() && (result = archive_read_next_header(reader, &entry)) == ARCHIVE_OK) {
+        while ((result = archive_read_data_block(reader, &block, &blockSize, &blockOffset)) == ARCHIVE_OK) {
+        }
+        if (result != ARCHIVE_EOF) {
+            qCWarning(ARK) << "Could not read" << archive_entry_pathname(entry) << ":" << archive_error_string(reader);
+            return true;
+        }
+
+        if (compressedArchiveSize > 0) {
+            emit progress(float(archive_filter_bytes(m_archiveReader.data(), -1)) / float(compressedArchiveSize));
+        }
+    }
+
+    if (QThread::currentThread()->isInterruptionRequested()) {
+        return false;
+    }
+
+    if (result != ARCHIVE_EOF) {
+        qCWarning(ARK) << "Could not read until the end of the archive:" << archive_error_string(reader);
+        return true;
+    }
+
+    if (isCompressed) {
+        while ((result = archive_read_data_block(m_archiveReader.data(), &block, &blockSize, &blockOffset)) == ARCHIVE_OK) {
+        }
+        if (result != ARCHIVE_EOF) {
+            qCWarning(ARK) << "Could not decompress the archive:" << archive_error_string(m_archiveReader.data());
+            return true;
+        }
+    }
+
+    qCDebug(ARK) << "Test successful";
+    emit testSuccess();
+    return true;
 }
 
 bool LibarchivePlugin::hasBatchExtractionProgress() const
@@ -160,18 +571,22 @@ bool LibarchivePlugin::doKill()
 
 bool LibarchivePlugin::extractFiles(const QVector<Archive::Entry*> &files, const QString &destinationDirectory, const ExtractionOptions &options)
 {
-    qCDebug(ARK) << "Changing current directory to " << destinationDirectory;
-    QDir::setCurrent(destinationDirectory);
+    const ContainerReaderGuard containerReaderGuard(this);
 
+    // Entries are written below destinationDirectory instead of changing
+    // the current directory, which is shared by all jobs of the process.
+    const QDir destinationDir(destinationDirectory);
     const bool extractAll = files.isEmpty();
     const bool preservePaths = options.preservePaths();
     const bool removeRootNode = options.isDragAndDropEnabled();
 
     // To avoid traversing the entire archive when extracting a limited set of
-    // entries, we maintain a list of remaining entries and stop when it's
-    // empty.
-    QStringList fullPaths = entryFullPaths(files);
-    QStringList remainingFiles = entryFullPaths(files);
+    // entries, we maintain a set of remaining entries and stop when it's
+    // empty. This is not possible if a selected folder matches its contents.
+    const QStringList fullPaths = entryFullPaths(files);
+    const EntrySelection selection(fullPaths);
+    QSet<QString> remainingFiles = QSet<QString>::fromList(fullPaths);
+    const bool stopWhenDone = !selection.hasFolderPrefixes();
 
     if (!initializeReader()) {
         return false;
@@ -187,19 +602,22 @@ bool LibarchivePlugin::extractFiles(const QVector<Archive::Entry*> &files, const
     int entryNr = 0;
     int totalCount = 0;
 
+    // An archive which hasn't been listed (e.g. by a BatchExtractJob) is not
+    // read twice just to know its size: the progress is then based on how much
+    // of the archive has been read.
+    const bool progressFromArchiveSize = extractAll && !m_cachedArchiveEntryCount;
+    const qint64 compressedArchiveSize = containerEntry() ? static_cast<qint64>(containerEntry()->size())
+                                                          : QFileInfo(filename()).size();
+
     if (extractAll) {
-        if (!m_cachedArchiveEntryCount) {
-            emit progress(0);
-            //TODO: once information progress has been implemented, send
-            //feedback here that the archive is being read
-            qCDebug(ARK) << "For getting progress information, the archive will be listed once";
-            m_emitNoEntries = true;
-            list();
-            m_emitNoEntries = false;
-        }
+        emit progress(0);
         totalCount = m_cachedArchiveEntryCount;
-    } else {
+    } else if (stopWhenDone) {
         totalCount = files.size();
+    } else {
+        // The number of entries in the selected folders is unknown, the whole
+        // archive is an upper bound.
+        totalCount = qMax(m_cachedArchiveEntryCount, files.size());
     }
 
     qCDebug(ARK) << "Going to extract" << totalCount << "entries";
@@ -215,10 +633,21 @@ bool LibarchivePlugin::extractFiles(const QVector<Archive::Entry*> &files, const
     struct archive_entry *entry;
     QString fileBeingRenamed;
 
+#ifdef HAVE_COPY_FILE_RANGE
+    // The data of stored entries is copied straight from the archive file.
+    QFile archiveFile(filename());
+#endif
+
+#ifdef HAVE_LIBURING
+    // Small new files are written in batches, falling back to
+    // archive_write_disk if io_uring can't be used.
+    UringDiskWriter uringWriter;
+#endif
+
     // Iterate through all entries in archive.
     while (!QThread::currentThread()->isInterruptionRequested() && (archive_read_next_header(m_archiveReader.data(), &entry) == ARCHIVE_OK)) {
 
-        if (!extractAll && remainingFiles.isEmpty()) {
+        if (!extractAll && stopWhenDone && remainingFiles.isEmpty()) {
             break;
         }
 
@@ -260,23 +689,34 @@ bool LibarchivePlugin::extractFiles(const QVector<Archive::Entry*> &files, const
             return false;
         }
 
+        // Find the index of entry.
+        if (!extractAll && entryName != fileBeingRenamed) {
+            index = selection.indexOf(entryName);
+            // Only the first entry with a selected path is extracted.
+            if (index != -1 && fullPaths.at(index) == entryName && !remainingFiles.contains(entryName)) {
+                index = -1;
+            }
+        }
+
         // Should the entry be extracted?
         if (extractAll ||
-            remainingFiles.contains(entryName) ||
+            index != -1 ||
             entryName == fileBeingRenamed) {
 
-            // Find the index of entry.
-            if (entryName != fileBeingRenamed) {
-                index = fullPaths.indexOf(entryName);
-            }
-            if (!extractAll && index == -1) {
-                // If entry is not found in files, skip entry.
-                continue;
+            // The root node removal below changes entryName.
+            const QString selectedName(entryName);
+
+            const char *hardlink = archive_entry_hardlink(entry);
+            if (hasParentDirComponent(entryName) ||
+                (hardlink && hasParentDirComponent(QDir::fromNativeSeparators(QFile::decodeName(hardlink))))) {
+                qCCritical(ARK) << "Entry with '..' in its path:" << entryName;
+                emit error(xi18nc("@info", "This archive contains the entry <filename>%1</filename>, which would be extracted outside of the destination folder.", entryName));
+                return false;
             }
 
             // entryFI is the fileinfo pointing to where the file will be
             // written from the archive.
-            QFileInfo entryFI(entryName);
+            QFileInfo entryFI(destinationDir, entryName);
             //qCDebug(ARK) << "setting path to " << archive_entry_pathname( entry );
 
             const QString fileWithoutPath(entryFI.fileName());
@@ -289,7 +729,7 @@ bool LibarchivePlugin::extractFiles(const QVector<Archive::Entry*> &files, const
                 Q_ASSERT(!fileWithoutPath.isEmpty());
 
                 archive_entry_copy_pathname(entry, QFile::encodeName(fileWithoutPath).constData());
-                entryFI = QFileInfo(fileWithoutPath);
+                entryFI = QFileInfo(destinationDir, fileWithoutPath);
 
             // OR, if the file has a rootNode attached, remove it from file path.
             } else if (!extractAll && removeRootNode && entryName != fileBeingRenamed) {
@@ -298,9 +738,20 @@ bool LibarchivePlugin::extractFiles(const QVector<Archive::Entry*> &files, const
                     const QString truncatedFilename(entryName.remove(entryName.indexOf(rootNode), rootNode.size()));
 
                     archive_entry_copy_pathname(entry, QFile::encodeName(truncatedFilename).constData());
-                    entryFI = QFileInfo(truncatedFilename);
+                    entryFI = QFileInfo(destinationDir, truncatedFilename);
+                }
+            }
+
+#ifdef HAVE_LIBURING
+            // A queued file doesn't exist yet.
+            if (uringWriter.isQueued(QFile::encodeName(entryFI.absoluteFilePath()))) {
+                if (!uringWriter.flush()) {
+                    emit error(xi18nc("@info", "Could not write the extracted files to disk."));
+                    return false;
                 }
+                entryFI.refresh();
             }
+#endif
 
             // Check if the file about to be written already exists.
             if (!entryIsDir && entryFI.exists()) {
@@ -349,10 +800,67 @@ bool LibarchivePlugin::extractFiles(const QVector<Archive::Entry*> &files, const
                 }
             }
 
+            bool isQueued = false;
+#ifdef HAVE_LIBURING
+            // Syncing each file would defeat the batches.
+            const bool isSmallFile = uringWriter.isValid() && options.syncMode() != ExtractionOptions::SyncEachFile &&
+                                     !entryFI.exists() && isSmallFileEntry(entry);
+#endif
+
+            archive_entry_copy_pathname(entry, QFile::encodeName(entryFI.absoluteFilePath()).constData());
+            if (hardlink) {
+                const QString hardlinkTarget = destinationDir.absoluteFilePath(QFile::decodeName(hardlink));
+                archive_entry_copy_hardlink(entry, QFile::encodeName(hardlinkTarget).constData());
+#ifdef HAVE_LIBURING
+                // The target may be queued.
+                if (!uringWriter.flush()) {
+                    emit error(xi18nc("@info", "Could not write the extracted files to disk."));
+                    return false;
+                }
+#endif
+            }
+
+#ifdef HAVE_LIBURING
+            if (isSmallFile) {
+                queueSmallFile(entryName, entry, &uringWriter, (extractAll && m_extractedFilesSize));
+                isQueued = true;
+            }
+#endif
+
+            const bool isRegularFile = S_ISREG(archive_entry_mode(entry)) && !hardlink;
+
             // Write the entry header and check return value.
-            const int returnCode = archive_write_header(writer.data(), entry);
+            const int returnCode = isQueued ? ARCHIVE_OK : archive_write_header(writer.data(), entry);
             switch (returnCode) {
             case ARCHIVE_OK:
+                if (isQueued) {
+                    break;
+                }
+                if (options.preallocateFiles() && isRegularFile &&
+                    !preallocate(entryFI.absoluteFilePath(), archive_entry_size(entry))) {
+                    qCCritical(ARK) << "Could not allocate" << archive_entry_size(entry) << "bytes for" << entryName;
+                    emit error(xi18nc("@info", "There is not enough free space to extract <filename>%1</filename>.", entryName));
+                    return false;
+                }
+#ifdef HAVE_COPY_FILE_RANGE
+                if (isStoredEntry(entry)) {
+                    if (!archiveFile.isOpen() && !archiveFile.open(QIODevice::ReadOnly)) {
+                        qCWarning(ARK) << "Could not open" << filename() << ":" << archiveFile.errorString();
+                    }
+                    const StoredDataResult result = archiveFile.isOpen()
+                        ? copyStoredData(entryName, entry, archiveFile.handle(), writer.data(), (extractAll && m_extractedFilesSize))
+                        : StoredDataNotCopied;
+                    if (result == StoredDataCopied) {
+                        break;
+                    }
+                    if (result == StoredDataFailed) {
+                        if (!QThread::currentThread()->isInterruptionRequested()) {
+                            emit error(xi18nc("@info", "Ark could not extract <filename>%1</filename>.", entryName));
+                        }
+                        return false;
+                    }
+                }
+#endif
                 // If the whole archive is extracted and the total filesize is
                 // available, we use partial progress.
                 copyData(entryName, m_archiveReader.data(), writer.data(), (extractAll && m_extractedFilesSize));
@@ -391,16 +899,28 @@ bool LibarchivePlugin::extractFiles(const QVector<Archive::Entry*> &files, const
                 break;
             }
 
+            if (options.syncMode() == ExtractionOptions::SyncEachFile && isRegularFile && returnCode == ARCHIVE_OK) {
+                // The file is closed when finishing the entry.
+                archive_write_finish_entry(writer.data());
+                if (!syncFile(entryFI.absoluteFilePath())) {
+                    qCCritical(ARK) << "Could not sync" << entryFI.absoluteFilePath() << ":" << strerror(errno);
+                    emit error(xi18nc("@info", "Could not write <filename>%1</filename> to disk.", entryName));
+                    return false;
+                }
+            }
+
             // If we only partially extract the archive and the number of
             // archive entries is available we use a simple progress based on
             // number of items extracted.
             if (!extractAll && m_cachedArchiveEntryCount) {
                 ++entryNr;
                 emit progress(float(entryNr) / totalCount);
+            } else if (progressFromArchiveSize && compressedArchiveSize > 0) {
+                emit progress(float(archive_filter_bytes(m_archiveReader.data(), -1)) / float(compressedArchiveSize));
             }
             no_entries++;
 
-            remainingFiles.removeOne(entryName);
+            remainingFiles.remove(selectedName);
 
         } else {
 
@@ -411,12 +931,42 @@ bool LibarchivePlugin::extractFiles(const QVector<Archive::Entry*> &files, const
 
     } // While entries left to read in archive.
 
+#ifdef HAVE_LIBURING
+    // The failed writes have been logged by the writer.
+    if (!uringWriter.flush()) {
+        emit error(xi18nc("@info", "Could not write the extracted files to disk."));
+        return false;
+    }
+#endif
+
+    if (options.syncMode() == ExtractionOptions::SyncAtEnd) {
+        // The times and permissions of folders are set when closing the writer.
+        archive_write_close(writer.data());
+        if (!syncFileSystem(destinationDirectory)) {
+            qCCritical(ARK) << "Could not sync" << destinationDirectory << ":" << strerror(errno);
+            emit error(xi18nc("@info", "Could not write the extracted files to disk."));
+            return false;
+        }
+    }
+
     qCDebug(ARK) << "Extracted" << no_entries << "entries";
 
     return archive_read_close(m_archiveReader.data()) == ARCHIVE_OK;
 }
 
-bool LibarchivePlugin::initializeReader()
+QIODevice *LibarchivePlugin::entryDevice(const Archive::Entry *entry)
+{
+    // The data of a nested archive can be read only once, by m_archiveReader.
+    if (entry->isDir() || containerEntry()) {
+        return Q_NULLPTR;
+    }
+
+    EntryDevice *device = new EntryDevice(filename(), entry->fullPath());
+    device->open(QIODevice::ReadOnly);
+    return device;
+}
+
+bool LibarchivePlugin::initializeReader(bool rawFormat)
 {
     m_archiveReader.reset(archive_read_new());
 
@@ -429,11 +979,27 @@ bool LibarchivePlugin::initializeReader()
         return false;
     }
 
-    if (archive_read_support_format_all(m_archiveReader.data()) != ARCHIVE_OK) {
+    if ((rawFormat ? archive_read_support_format_raw(m_archiveReader.data())
+                   : archive_read_support_format_all(m_archiveReader.data())) != ARCHIVE_OK) {
         return false;
     }
 
-    if (archive_read_open_filename(m_archiveReader.data(), QFile::encodeName(filename()), 10240) != ARCHIVE_OK) {
+    int result;
+    if (containerEntry()) {
+        // A new device is needed for each pass over a nested archive.
+        QIODevice *device = createContainerEntryDevice();
+        if (!device) {
+            qCWarning(ARK) << "Could not read" << containerEntry()->fullPath() << "from its container";
+            emit error(i18nc("@info", "Archive corrupted or insufficient permissions."));
+            return false;
+        }
+        m_deviceSource.reset(new DeviceSource(device));
+        result = archive_read_open(m_archiveReader.data(), m_deviceSource.data(), Q_NULLPTR, readDeviceSource, Q_NULLPTR);
+    } else {
+        result = archive_read_open_filename(m_archiveReader.data(), QFile::encodeName(filename()), 10240);
+    }
+
+    if (result != ARCHIVE_OK) {
         qCWarning(ARK) << "Could not open the archive:" << archive_error_string(m_archiveReader.data());
         emit error(i18nc("@info", "Archive corrupted or insufficient permissions."));
         return false;
@@ -442,36 +1008,92 @@ bool LibarchivePlugin::initializeReader()
     return true;
 }
 
+la_ssize_t LibarchivePlugin::readRawData(struct archive *reader, void *clientData, const void **buffer)
+{
+    struct archive *rawReader = static_cast<struct archive*>(clientData);
+
+    size_t size = 0;
+    la_int64_t offset;
+    int result;
+    // An empty block would mean the end of the data.
+    while ((result = archive_read_data_block(rawReader, buffer, &size, &offset)) == ARCHIVE_OK && size == 0) {
+    }
+
+    if (result == ARCHIVE_EOF) {
+        return 0;
+    }
+    if (result != ARCHIVE_OK) {
+        archive_set_error(reader, archive_errno(rawReader), "%s", archive_error_string(rawReader));
+        return ARCHIVE_FATAL;
+    }
+
+    return static_cast<la_ssize_t>(size);
+}
+
+bool LibarchivePlugin::canReadNestedArchives() const
+{
+    return true;
+}
+
+la_ssize_t LibarchivePlugin::readDeviceSource(struct archive *reader, void *clientData, const void **buffer)
+{
+    Q_UNUSED(reader)
+
+    DeviceSource *source = static_cast<DeviceSource*>(clientData);
+    QIODevice *device = source->device.data();
+
+    forever {
+        const qint64 readBytes = device->read(source->buffer.data(), source->buffer.size());
+        if (readBytes != 0) {
+            *buffer = source->buffer.constData();
+            // Entry devices return -1 once the entry's data is over.
+            return qMax<qint64>(readBytes, 0);
+        }
+
+        if (QThread::currentThread()->isInterruptionRequested()) {
+            return ARCHIVE_FATAL;
+        }
+
+        // Either no data has arrived yet from an extraction process, or the
+        // device is still looking for the entry in its own archive. The wait
+        // is done in steps, so that the job can still be killed.
+        if (!device->waitForReadyRead(100) && isDeviceFinished(device)) {
+            return 0;
+        }
+    }
+}
+
 void LibarchivePlugin::emitEntryFromArchiveEntry(struct archive_entry *aentry)
 {
     auto e = new Archive::Entry();
 
 #ifdef Q_OS_WIN
-    e->setProperty("fullPath", QDir::fromNativeSeparators(QString::fromUtf16((ushort*)archive_entry_pathname_w(aentry))));
+    e->setFullPath(QDir::fromNativeSeparators(QString::fromUtf16((ushort*)archive_entry_pathname_w(aentry))));
 #else
-    e->setProperty("fullPath", QDir::fromNativeSeparators(QString::fromWCharArray(archive_entry_pathname_w(aentry))));
+    e->setFullPath(QDir::fromNativeSeparators(QString::fromWCharArray(archive_entry_pathname_w(aentry))));
 #endif
 
     const QString owner = QString::fromLatin1(archive_entry_uname(aentry));
     if (!owner.isEmpty()) {
-        e->setProperty("owner", owner);
+        e->setOwner(owner);
     }
 
     const QString group = QString::fromLatin1(archive_entry_gname(aentry));
     if (!group.isEmpty()) {
-        e->setProperty("group", group);
+        e->setGroup(group);
     }
 
     e->compressedSizeIsSet = false;
-    e->setProperty("size", (qlonglong)archive_entry_size(aentry));
-    e->setProperty("isDirectory", S_ISDIR(archive_entry_mode(aentry)));
+    e->setSize(archive_entry_size(aentry));
+    e->setIsDirectory(S_ISDIR(archive_entry_mode(aentry)));
 
     if (archive_entry_symlink(aentry)) {
-        e->setProperty("link", QLatin1String( archive_entry_symlink(aentry) ));
+        e->setLink(QLatin1String( archive_entry_symlink(aentry) ));
     }
 
-    auto time = static_cast<uint>(archive_entry_mtime(aentry));
-    e->setProperty("timestamp", QDateTime::fromTime_t(time));
+    if (archive_entry_mtime_is_set(aentry)) {
+        e->setTimestamp(archive_entry_mtime(aentry), archive_entry_mtime_nsec(aentry));
+    }
 
     emit entry(e);
     m_emittedEntries << e;
@@ -547,6 +1169,208 @@ void LibarchivePlugin::copyData(const QString& filename, struct archive *source,
     }
 }
 
+#ifdef Q_OS_UNIX
+void LibarchivePlugin::copyData(const QString& filename, int fd, qint64 offset, qint64 size, struct archive *dest)
+{
+    char buff[65536];
+
+    // Only bigger files are worth the additional syscall.
+    if (size - offset > qint64(sizeof(buff))) {
+        posix_fadvise(fd, offset, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    // pread() doesn't depend on the file offset, which libarchive may have
+    // moved while looking for holes. Reading no more than the size from
+    // fstat() also saves the final read() returning 0.
+    while (offset < size) {
+        const ssize_t readBytes = pread(fd, buff, static_cast<size_t>(qMin<qint64>(sizeof(buff), size - offset)), offset);
+        if (readBytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (readBytes <= 0) {
+            qCWarning(ARK) << "Could not read" << filename << "after" << offset << "bytes";
+            return;
+        }
+
+        archive_write_data(dest, buff, static_cast<size_t>(readBytes));
+        if (archive_errno(dest) != ARCHIVE_OK) {
+            qCCritical(ARK) << "Error while writing" << filename << ":" << archive_error_string(dest)
+                            << "(error no =" << archive_errno(dest) << ')';
+            return;
+        }
+
+        offset += readBytes;
+    }
+}
+#endif
+
+#ifdef HAVE_COPY_FILE_RANGE
+bool LibarchivePlugin::isStoredEntry(struct archive_entry *entry) const
+{
+    const int format = archive_format(m_archiveReader.data()) & ARCHIVE_FORMAT_BASE_MASK;
+
+    // Hard links and sparse files don't have their data in one piece.
+    return !containerEntry() &&
+           archive_filter_code(m_archiveReader.data(), 0) == ARCHIVE_FILTER_NONE &&
+           (format == ARCHIVE_FORMAT_TAR || format == ARCHIVE_FORMAT_CPIO) &&
+           S_ISREG(archive_entry_mode(entry)) &&
+           !archive_entry_hardlink(entry) &&
+           archive_entry_sparse_count(entry) == 0 &&
+           archive_entry_size_is_set(entry) &&
+           archive_entry_size(entry) >= MinStoredDataSize;
+}
+
+LibarchivePlugin::StoredDataResult LibarchivePlugin::copyStoredData(const QString& filename, struct archive_entry *entry, int archiveFd, struct archive *dest, bool partialprogress)
+{
+    const qint64 size = archive_entry_size(entry);
+    // The position of the reader in the uncompressed archive, i.e. in the file.
+    const qint64 dataOffset = archive_filter_bytes(m_archiveReader.data(), 0);
+
+    const void *block;
+    size_t blockSize;
+    la_int64_t blockOffset;
+    if (archive_read_data_block(m_archiveReader.data(), &block, &blockSize, &blockOffset) != ARCHIVE_OK ||
+        blockOffset != 0 || blockSize == 0) {
+        return StoredDataNotCopied;
+    }
+
+    archive_write_data(dest, block, blockSize);
+    if (archive_errno(dest) != ARCHIVE_OK) {
+        qCCritical(ARK) << "Error while extracting" << filename << ":" << archive_error_string(dest)
+                        << "(error no =" << archive_errno(dest) << ')';
+        unlink(archive_entry_pathname(entry));
+        return StoredDataFailed;
+    }
+
+    if (partialprogress) {
+        m_currentExtractedFilesSize += blockSize;
+    }
+
+    // libarchive doesn't tell where the data is stored: make sure it's there.
+    QByteArray head(static_cast<int>(blockSize), Qt::Uninitialized);
+    if (qint64(blockSize) >= size ||
+        pread(archiveFd, head.data(), blockSize, dataOffset) != static_cast<ssize_t>(blockSize) ||
+        memcmp(head.constData(), block, blockSize) != 0) {
+        qCDebug(ARK) << "The data of" << filename << "is not stored at" << dataOffset;
+        return StoredDataNotCopied;
+    }
+
+    // libarchive has created the file; its times are set when the entry is finished.
+    const int fd = open(archive_entry_pathname(entry), O_WRONLY | O_CLOEXEC | O_NOFOLLOW);
+    if (fd < 0) {
+        return StoredDataNotCopied;
+    }
+
+    // copy_file_range() lets the kernel copy the data, or share the extents
+    // on filesystems such as btrfs and XFS. Where it is not supported, the
+    // data is still copied without libarchive.
+    bool useCopyFileRange = true;
+    QByteArray buffer;
+    qint64 copiedBytes = blockSize;
+
+    while (copiedBytes < size && !QThread::currentThread()->isInterruptionRequested()) {
+        const size_t chunkSize = static_cast<size_t>(qMin(size - copiedBytes, StoredDataChunkSize));
+        ssize_t chunkCopiedBytes;
+
+        if (useCopyFileRange) {
+            loff_t inputOffset = dataOffset + copiedBytes;
+            loff_t outputOffset = copiedBytes;
+            chunkCopiedBytes = copy_file_range(archiveFd, &inputOffset, fd, &outputOffset, chunkSize, 0);
+            if (chunkCopiedBytes < 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP)) {
+                qCDebug(ARK) << "copy_file_range() is not supported here:" << strerror(errno);
+                useCopyFileRange = false;
+                continue;
+            }
+        } else {
+            if (buffer.isEmpty()) {
+                buffer.resize(1024 * 1024);
+            }
+            chunkCopiedBytes = pread(archiveFd, buffer.data(), qMin<size_t>(chunkSize, buffer.size()), dataOffset + copiedBytes);
+            if (chunkCopiedBytes > 0 && pwrite(fd, buffer.constData(), chunkCopiedBytes, copiedBytes) != chunkCopiedBytes) {
+                chunkCopiedBytes = -1;
+            }
+        }
+
+        if (chunkCopiedBytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (chunkCopiedBytes <= 0) {
+            qCCritical(ARK) << "Error while extracting" << filename << "after" << copiedBytes << "bytes:"
+                            << ((chunkCopiedBytes < 0) ? strerror(errno) : "unexpected end of archive");
+            break;
+        }
+
+        copiedBytes += chunkCopiedBytes;
+
+        if (partialprogress) {
+            m_currentExtractedFilesSize += chunkCopiedBytes;
+            emit progress(float(m_currentExtractedFilesSize) / m_extractedFilesSize);
+        }
+    }
+
+    close(fd);
+
+    // Don't leave a truncated file behind.
+    if (copiedBytes < size) {
+        unlink(archive_entry_pathname(entry));
+        return StoredDataFailed;
+    }
+
+    // Skip the data, which libarchive can do by seeking.
+    archive_read_data_skip(m_archiveReader.data());
+    return StoredDataCopied;
+}
+#endif
+
+#ifdef HAVE_LIBURING
+bool LibarchivePlugin::isSmallFileEntry(struct archive_entry *entry) const
+{
+    // Paths with ".." are refused by archive_write_disk, which reports the error.
+    const QByteArray pathname(archive_entry_pathname(entry));
+    return S_ISREG(archive_entry_mode(entry)) &&
+           !archive_entry_hardlink(entry) &&
+           archive_entry_sparse_count(entry) == 0 &&
+           archive_entry_size_is_set(entry) &&
+           archive_entry_size(entry) <= MaxSmallFileSize &&
+           !pathname.split('/').contains("..");
+}
+
+void LibarchivePlugin::queueSmallFile(const QString& filename, struct archive_entry *entry, UringDiskWriter *writer, bool partialprogress)
+{
+    const qint64 size = archive_entry_size(entry);
+    QByteArray data(static_cast<int>(size), Qt::Uninitialized);
+
+    qint64 readBytes = 0;
+    while (readBytes < size) {
+        const auto ret = archive_read_data(m_archiveReader.data(), data.data() + readBytes, static_cast<size_t>(size - readBytes));
+        if (ret < 0) {
+            qCCritical(ARK) << "Error while extracting" << filename << ":" << archive_error_string(m_archiveReader.data())
+                            << "(error no =" << archive_errno(m_archiveReader.data()) << ')';
+        }
+        if (ret <= 0) {
+            // Like archive_write_disk, the data read so far is written.
+            data.truncate(static_cast<int>(readBytes));
+            break;
+        }
+        readBytes += ret;
+    }
+
+    struct timespec times[2];
+    times[0].tv_sec = archive_entry_atime(entry);
+    times[0].tv_nsec = archive_entry_atime_is_set(entry) ? archive_entry_atime_nsec(entry) : UTIME_NOW;
+    times[1].tv_sec = archive_entry_mtime(entry);
+    times[1].tv_nsec = archive_entry_mtime_is_set(entry) ? archive_entry_mtime_nsec(entry) : UTIME_NOW;
+    // Like archive_write_disk without ARCHIVE_EXTRACT_PERM, only the
+    // permission bits are kept and the umask applies.
+    writer->addFile(QByteArray(archive_entry_pathname(entry)), archive_entry_perm(entry) & 0777, times, data);
+
+    if (partialprogress) {
+        m_currentExtractedFilesSize += readBytes;
+        emit progress(float(m_currentExtractedFilesSize) / m_extractedFilesSize);
+    }
+}
+#endif
+
 QString LibarchivePlugin::convertCompressionName(const QString &method)
 {
     if (method == QLatin1String("gzip")) {
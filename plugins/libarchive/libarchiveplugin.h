@@ -36,6 +36,10 @@
 
 using namespace Kerfuffle;
 
+#ifdef HAVE_LIBURING
+class UringDiskWriter;
+#endif
+
 class LibarchivePlugin : public ReadWriteArchiveInterface
 {
     Q_OBJECT
@@ -55,6 +59,8 @@ public:
     virtual bool addComment(const QString &comment) Q_DECL_OVERRIDE;
     virtual bool testArchive() Q_DECL_OVERRIDE;
     virtual bool hasBatchExtractionProgress() const Q_DECL_OVERRIDE;
+    virtual QIODevice *entryDevice(const Archive::Entry *entry) Q_DECL_OVERRIDE;
+    virtual bool canReadNestedArchives() const Q_DECL_OVERRIDE;
 
 protected:
     struct ArchiveReadCustomDeleter
@@ -80,23 +86,93 @@ protected:
     typedef QScopedPointer<struct archive, ArchiveReadCustomDeleter> ArchiveRead;
     typedef QScopedPointer<struct archive, ArchiveWriteCustomDeleter> ArchiveWrite;
 
-    bool initializeReader();
+    /**
+     * Opens the archive with m_archiveReader. If @p rawFormat is true, the
+     * archive is only decompressed: its single entry is the uncompressed archive.
+     */
+    bool initializeReader(bool rawFormat = false);
     void emitEntryFromArchiveEntry(struct archive_entry *entry);
     void copyData(const QString& filename, struct archive *dest, bool partialprogress = true);
     void copyData(const QString& filename, struct archive *source, struct archive *dest, bool partialprogress = true);
+#ifdef Q_OS_UNIX
+    /**
+     * Copies the bytes from @p offset to @p size of the file open as @p fd to @p dest.
+     */
+    void copyData(const QString& filename, int fd, qint64 offset, qint64 size, struct archive *dest);
+#endif
+
+#ifdef HAVE_COPY_FILE_RANGE
+    /**
+     * @return Whether the data of @p entry, the current entry of
+     * m_archiveReader, is probably stored uncompressed in one piece in the
+     * archive file, and big enough to be worth copyStoredData().
+     */
+    bool isStoredEntry(struct archive_entry *entry) const;
+
+    enum StoredDataResult {
+        /** The rest of the data is still to be copied from m_archiveReader. */
+        StoredDataNotCopied,
+        StoredDataCopied,
+        /** Writing failed or the extraction was cancelled; the file has been removed. */
+        StoredDataFailed
+    };
+
+    /**
+     * Copies the data of the stored @p entry from the archive file open as
+     * @p archiveFd to the file created for it by @p dest, without reading it
+     * through m_archiveReader.
+     */
+    StoredDataResult copyStoredData(const QString& filename, struct archive_entry *entry, int archiveFd, struct archive *dest, bool partialprogress);
+#endif
+
+#ifdef HAVE_LIBURING
+    /**
+     * @return Whether @p entry, the current entry of m_archiveReader, is a
+     * small regular file which can be written by a UringDiskWriter.
+     */
+    bool isSmallFileEntry(struct archive_entry *entry) const;
+
+    /**
+     * Reads the data of the small file @p entry and queues it in @p writer.
+     * The path of @p entry must be absolute.
+     */
+    void queueSmallFile(const QString& filename, struct archive_entry *entry, UringDiskWriter *writer, bool partialprogress);
+#endif
 
     ArchiveRead m_archiveReader;
     ArchiveRead m_archiveReadDisk;
 
 private:
+    struct DeviceSource;
+
+    /**
+     * Deletes the reader of a nested archive together with its device when
+     * going out of scope, so that the device, e.g. an extraction process,
+     * is deleted by the thread which created and read it.
+     */
+    class ContainerReaderGuard;
+
+    static la_ssize_t readDeviceSource(struct archive *reader, void *clientData, const void **buffer);
+
+    /**
+     * Reads the data of the current entry of the reader given as
+     * @p clientData, so that another reader can read the entries of an
+     * archive decompressed by a reader with the raw format.
+     */
+    static la_ssize_t readRawData(struct archive *reader, void *clientData, const void **buffer);
+
     int extractionFlags() const;
     QString convertCompressionName(const QString &method);
 
     int m_cachedArchiveEntryCount;
     qlonglong m_currentExtractedFilesSize;
-    bool m_emitNoEntries;
     qlonglong m_extractedFilesSize;
     QVector<Archive::Entry*> m_emittedEntries;
+
+    /**
+     * The data of a nested archive, read by m_archiveReader.
+     */
+    QScopedPointer<DeviceSource> m_deviceSource;
 };
 
 #endif // LIBARCHIVEPLUGIN_H
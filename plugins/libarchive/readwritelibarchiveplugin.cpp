@@ -28,16 +28,22 @@
 
 #include "readwritelibarchiveplugin.h"
 #include "ark_debug.h"
+#include "entryselection.h"
+#include "fileprefetcher.h"
 
 #include <KLocalizedString>
 #include <KPluginFactory>
 
-#include <QDirIterator>
 #include <QSaveFile>
+#include <QSet>
 #include <QThread>
 
 #include <archive_entry.h>
 
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
 K_PLUGIN_FACTORY_WITH_JSON(ReadWriteLibarchivePluginFactory, "kerfuffle_libarchive.json", registerPlugin<ReadWriteLibarchivePlugin>();)
 
 ReadWriteLibarchivePlugin::ReadWriteLibarchivePlugin(QObject *parent, const QVariantList &args)
@@ -55,7 +61,10 @@ bool ReadWriteLibarchivePlugin::addFiles(const QVector<Archive::Entry*> &files,
     qCDebug(ARK) << "Adding" << files.size() << "entries with CompressionOptions" << options;
 
     const bool creatingNewFile = !QFileInfo::exists(filename());
-    const uint totalCount = m_numberOfEntries + numberOfEntriesToAdd;
+
+    // The files have usually been scanned already by the AddJob.
+    const FileManifest manifest = fileManifest().isEmpty() ? FileManifest::scan(entryFullPaths(files)) : fileManifest();
+    const uint totalCount = m_numberOfEntries + (numberOfEntriesToAdd ? numberOfEntriesToAdd : manifest.count());
 
     m_writtenFiles.clear();
 
@@ -70,52 +79,30 @@ bool ReadWriteLibarchivePlugin::addFiles(const QVector<Archive::Entry*> &files,
     // First write the new files.
     qCDebug(ARK) << "Writing new entries";
     uint no_entries = 0;
+    qulonglong writtenBytes = 0;
     // Recreate destination directory structure.
     const QString destinationPath = (destination == Q_NULLPTR)
                                     ? QString()
                                     : destination->fullPath();
 
-    foreach(Archive::Entry *selectedFile, files) {
+    // The manifest lists the selected files, each folder followed by its
+    // contents. The next files are opened and read while one is compressed.
+    const QVector<FileManifest::Item> items = manifest.items();
+    FilePrefetcher prefetcher(items);
+    foreach (const FileManifest::Item &item, items) {
         if (QThread::currentThread()->isInterruptionRequested()) {
             break;
         }
 
-        if (!writeFile(selectedFile->fullPath(), destinationPath)) {
+        if (!writeFile(item, prefetcher.takeNext(), destinationPath)) {
             finish(false);
             return false;
         }
         no_entries++;
         emit progress(float(no_entries)/float(totalCount));
-
-        // For directories, write all subfiles/folders.
-        const QString &fullPath = selectedFile->fullPath();
-        if (QFileInfo(fullPath).isDir()) {
-            QDirIterator it(fullPath,
-                            QDir::AllEntries | QDir::Readable |
-                            QDir::Hidden | QDir::NoDotAndDotDot,
-                            QDirIterator::Subdirectories);
-
-            while (!QThread::currentThread()->isInterruptionRequested() && it.hasNext()) {
-                QString path = it.next();
-
-                if ((it.fileName() == QLatin1String("..")) ||
-                    (it.fileName() == QLatin1String("."))) {
-                    continue;
-                }
-
-                const bool isRealDir = it.fileInfo().isDir() && !it.fileInfo().isSymLink();
-
-                if (isRealDir) {
-                    path.append(QLatin1Char('/'));
-                }
-
-                if (!writeFile(path, destinationPath)) {
-                    finish(false);
-                    return false;
-                }
-                no_entries++;
-                emit progress(float(no_entries)/float(totalCount));
-            }
+        if ((item.stat.st_mode & S_IFMT) == S_IFREG) {
+            writtenBytes += item.stat.st_size;
+            emit bytesProcessed(writtenBytes);
         }
     }
     qCDebug(ARK) << "Added" << no_entries << "new entries to archive";
@@ -248,7 +235,7 @@ bool ReadWriteLibarchivePlugin::initializeWriter(const bool creatingNewFile, con
             return false;
         }
     } else {
-        if (!initializeWriterFilters()) {
+        if (!initializeWriterFilters(options)) {
             return false;
         }
     }
@@ -261,7 +248,7 @@ bool ReadWriteLibarchivePlugin::initializeWriter(const bool creatingNewFile, con
     return true;
 }
 
-bool ReadWriteLibarchivePlugin::initializeWriterFilters()
+bool ReadWriteLibarchivePlugin::initializeWriterFilters(const CompressionOptions &options)
 {
     int ret;
     bool requiresExecutable = false;
@@ -295,6 +282,18 @@ bool ReadWriteLibarchivePlugin::initializeWriterFilters()
     case ARCHIVE_FILTER_LZ4:
         ret = archive_write_add_filter_lz4(m_archiveWriter.data());
         break;
+#endif
+#ifdef HAVE_LIBARCHIVE_3_3_3
+    case ARCHIVE_FILTER_ZSTD:
+        ret = archive_write_add_filter_zstd(m_archiveWriter.data());
+        // Without libzstd, libarchive warns that it uses the zstd executable.
+        if (ret == ARCHIVE_WARN) {
+            ret = ARCHIVE_OK;
+        }
+        if (ret == ARCHIVE_OK) {
+            setZstdOptions(options);
+        }
+        break;
 #endif
     case ARCHIVE_FILTER_NONE:
         ret = archive_write_add_filter_none(m_archiveWriter.data());
@@ -320,6 +319,7 @@ bool ReadWriteLibarchivePlugin::initializeNewFileWriterFilters(const Compression
 {
     int ret;
     bool requiresExecutable = false;
+    bool isZstd = false;
     if (filename().right(2).toUpper() == QLatin1String("GZ")) {
         qCDebug(ARK) << "Detected gzip compression for new file";
         ret = archive_write_add_filter_gzip(m_archiveWriter.data());
@@ -349,6 +349,16 @@ bool ReadWriteLibarchivePlugin::initializeNewFileWriterFilters(const Compression
         } else if (filename().right(3).toUpper() == QLatin1String("LZ4")) {
             qCDebug(ARK) << "Detected lz4 compression for new file";
             ret = archive_write_add_filter_lz4(m_archiveWriter.data());
+#endif
+#ifdef HAVE_LIBARCHIVE_3_3_3
+    } else if (filename().right(3).toUpper() == QLatin1String("ZST")) {
+        qCDebug(ARK) << "Detected zstd compression for new file";
+        ret = archive_write_add_filter_zstd(m_archiveWriter.data());
+        // Without libzstd, libarchive warns that it uses the zstd executable.
+        if (ret == ARCHIVE_WARN) {
+            ret = ARCHIVE_OK;
+        }
+        isZstd = true;
 #endif
     } else if (filename().right(3).toUpper() == QLatin1String("TAR")) {
         qCDebug(ARK) << "Detected no compression for new file (pure tar)";
@@ -377,9 +387,29 @@ bool ReadWriteLibarchivePlugin::initializeNewFileWriterFilters(const Compression
         }
     }
 
+    if (isZstd) {
+        setZstdOptions(options);
+    }
+
     return true;
 }
 
+void ReadWriteLibarchivePlugin::setZstdOptions(const CompressionOptions &options)
+{
+    const int threadCount = (options.threadCount() > 0) ? options.threadCount() : QThread::idealThreadCount();
+    qCDebug(ARK) << "Compressing with" << threadCount << "zstd threads";
+    if (archive_write_set_filter_option(m_archiveWriter.data(), "zstd", "threads", QByteArray::number(threadCount).constData()) != ARCHIVE_OK) {
+        qCWarning(ARK) << "Could not set the number of zstd threads:" << archive_error_string(m_archiveWriter.data());
+    }
+
+    if (options.isLongDistanceMatchingEnabled()) {
+        // A window of 128 MiB, like zstd --long.
+        if (archive_write_set_filter_option(m_archiveWriter.data(), "zstd", "long", "27") != ARCHIVE_OK) {
+            qCWarning(ARK) << "Could not enable zstd long distance matching:" << archive_error_string(m_archiveWriter.data());
+        }
+    }
+}
+
 void ReadWriteLibarchivePlugin::finish(const bool isSuccessful)
 {
     if (!isSuccessful || QThread::currentThread()->isInterruptionRequested()) {
@@ -398,17 +428,23 @@ bool ReadWriteLibarchivePlugin::processOldEntries(uint &entriesCounter, Operatio
     uint iteratedEntries = 0;
 
     // Create a map that contains old path as key and new path as value.
-    QMap<QString, QString> pathMap;
+    QHash<QString, QString> pathMap;
     if (mode == Move || mode == Copy) {
         m_filesPaths.sort();
         QStringList resultList = entryPathsFromDestination(m_filesPaths, m_destination, m_entriesWithoutChildren);
         const int listSize = m_filesPaths.count();
         Q_ASSERT(listSize == resultList.count());
+        pathMap.reserve(listSize);
         for (int i = 0; i < listSize; ++i) {
             pathMap.insert(m_filesPaths.at(i), resultList.at(i));
         }
     }
 
+    // Deleting a folder also deletes its contents, while newly added files
+    // only replace the old entries with exactly the same path.
+    const EntrySelection deletedFiles(mode == Delete ? m_filesPaths : QStringList());
+    const QSet<QString> addedFiles = (mode == Add) ? QSet<QString>::fromList(m_filesPaths) : QSet<QString>();
+
     while (!QThread::currentThread()->isInterruptionRequested() && archive_read_next_header(m_archiveReader.data(), &entry) == ARCHIVE_OK) {
 
         const QString file = QFile::decodeName(archive_entry_pathname(entry));
@@ -432,7 +468,7 @@ bool ReadWriteLibarchivePlugin::processOldEntries(uint &entriesCounter, Operatio
                 archive_entry_set_pathname(entry, newPathname.toUtf8());
                 emitEntryFromArchiveEntry(entry);
             }
-        } else if (m_filesPaths.contains(file)) {
+        } else if (deletedFiles.contains(file) || addedFiles.contains(file)) {
             archive_read_data_skip(m_archiveReader.data());
             switch (mode) {
             case Delete:
@@ -497,11 +533,10 @@ bool ReadWriteLibarchivePlugin::writeEntry(struct archive_entry *entry)
     return true;
 }
 
-// TODO: if we merge this with copyData(), we can pass more data
-//       such as an fd to archive_read_disk_entry_from_file()
-bool ReadWriteLibarchivePlugin::writeFile(const QString &relativeName, const QString &destination)
+bool ReadWriteLibarchivePlugin::writeFile(const FileManifest::Item &file, const FilePrefetcher::File &prefetchedFile, const QString &destination)
 {
     int header_response;
+    const QString &relativeName = file.path;
     const QString absoluteFilename = QFileInfo(relativeName).absoluteFilePath();
     const QString destinationFilename = destination + relativeName;
 
@@ -509,20 +544,46 @@ bool ReadWriteLibarchivePlugin::writeFile(const QString &relativeName, const QSt
     //          libarchive may have been compiled without HAVE_LSTAT,
     //          or something may have caused it to follow symlinks, in
     //          which case stat() will be called. To avoid this, we
-    //          call lstat() ourselves.
-    struct stat st;
-    lstat(QFile::encodeName(absoluteFilename).constData(), &st);
+    //          pass the lstat() data from the manifest.
+    struct stat st = file.stat;
+    const QByteArray encodedFilename = QFile::encodeName(absoluteFilename);
+
+    // Regular files have been opened only once by the prefetcher: the same
+    // descriptor is used for the metadata, including xattrs and ACLs, and
+    // for the data. Its fstat() data matches the file actually read.
+    const int fd = prefetchedFile.fd;
+    if (fd != -1) {
+        st = prefetchedFile.stat;
+    }
 
     struct archive_entry *entry = archive_entry_new();
     archive_entry_set_pathname(entry, QFile::encodeName(destinationFilename).constData());
-    archive_entry_copy_sourcepath(entry, QFile::encodeName(absoluteFilename).constData());
-    archive_read_disk_entry_from_file(m_archiveReadDisk.data(), entry, -1, &st);
-
-    if ((header_response = archive_write_header(m_archiveWriter.data(), entry)) == ARCHIVE_OK) {
-        // If the whole archive is extracted and the total filesize is
-        // available, we use partial progress.
+    archive_entry_copy_sourcepath(entry, encodedFilename.constData());
+    archive_read_disk_entry_from_file(m_archiveReadDisk.data(), entry, fd, &st);
+
+    header_response = archive_write_header(m_archiveWriter.data(), entry);
+    if (header_response == ARCHIVE_OK) {
+#ifdef Q_OS_UNIX
+        if (fd != -1) {
+            // The start of the file has already been read.
+            archive_write_data(m_archiveWriter.data(), prefetchedFile.data.constData(), static_cast<size_t>(prefetchedFile.data.size()));
+            copyData(absoluteFilename, fd, prefetchedFile.data.size(), st.st_size, m_archiveWriter.data());
+        } else if (S_ISREG(st.st_mode)) {
+            // Only regular files have data, opening anything else could block.
+            copyData(absoluteFilename, m_archiveWriter.data(), false);
+        }
+#else
         copyData(absoluteFilename, m_archiveWriter.data(), false);
-    } else {
+#endif
+    }
+
+#ifdef Q_OS_UNIX
+    if (fd != -1) {
+        close(fd);
+    }
+#endif
+
+    if (header_response != ARCHIVE_OK) {
         qCCritical(ARK) << "Writing header failed with error code " << header_response;
         qCCritical(ARK) << "Error while writing..." << archive_error_string(m_archiveWriter.data()) << "(error no =" << archive_errno(m_archiveWriter.data()) << ')';
 
@@ -29,6 +29,7 @@
 #define READWRITELIBARCHIVEPLUGIN_H
 
 #include "libarchiveplugin.h"
+#include "fileprefetcher.h"
 
 #include <QDir>
 #include <QStringList>
@@ -51,8 +52,15 @@ public:
 
 protected:
     bool initializeWriter(const bool creatingNewFile = false, const CompressionOptions &options = CompressionOptions());
-    bool initializeWriterFilters();
+    bool initializeWriterFilters(const CompressionOptions &options);
     bool initializeNewFileWriterFilters(const CompressionOptions &options);
+
+    /**
+     * Passes the thread count and long distance matching of @p options to the
+     * zstd filter. These options are unknown to older versions of libarchive,
+     * which then just ignore them.
+     */
+    void setZstdOptions(const CompressionOptions &options);
     void finish(const bool isSuccessful);
 
 private:
@@ -74,11 +82,12 @@ private:
     bool writeEntry(struct archive_entry *entry);
 
     /**
-     * Writes entry from physical disk.
+     * Writes entry from physical disk, using the stat data of @p file and,
+     * if it could be opened, the descriptor and data of @p prefetchedFile.
      *
      * @return bool indicating whether the operation was successful.
      */
-    bool writeFile(const QString &relativeName, const QString &destination);
+    bool writeFile(const FileManifest::Item &file, const FilePrefetcher::File &prefetchedFile, const QString &destination);
 
     QSaveFile m_tempFile;
     ArchiveWrite m_archiveWriter;
@@ -0,0 +1,283 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "uringdiskwriter.h"
+#include "ark_debug.h"
+
+#include <QDir>
+#include <QFile>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace
+{
+// The files of a batch are submitted at once, so this is also the size of the ring.
+const int MaxBatchFiles = 64;
+const qint64 MaxBatchSize = 4 * 1024 * 1024;
+}
+
+UringDiskWriter::UringDiskWriter()
+    : m_isInitialized(false)
+    , m_isValid(false)
+    , m_queuedSize(0)
+{
+    const int ret = io_uring_queue_init(MaxBatchFiles, &m_ring, 0);
+    if (ret < 0) {
+        // E.g. an old kernel, or io_uring disabled by a seccomp filter.
+        qCDebug(ARK) << "io_uring is not available:" << strerror(-ret);
+        return;
+    }
+    m_isInitialized = true;
+
+    struct io_uring_probe *probe = io_uring_get_probe_ring(&m_ring);
+    if (probe) {
+        m_isValid = io_uring_opcode_supported(probe, IORING_OP_OPENAT) &&
+                    io_uring_opcode_supported(probe, IORING_OP_WRITE) &&
+                    io_uring_opcode_supported(probe, IORING_OP_CLOSE);
+        io_uring_free_probe(probe);
+    }
+
+    if (!m_isValid) {
+        qCDebug(ARK) << "io_uring doesn't support opening and writing files";
+    }
+}
+
+UringDiskWriter::~UringDiskWriter()
+{
+    flush();
+    if (m_isInitialized) {
+        io_uring_queue_exit(&m_ring);
+    }
+}
+
+bool UringDiskWriter::isValid() const
+{
+    return m_isValid;
+}
+
+void UringDiskWriter::addFile(const QByteArray &path, mode_t mode, const struct timespec times[2], const QByteArray &data)
+{
+    Q_ASSERT(m_isValid);
+
+    // archive_write_disk creates the missing parent directories, too. The
+    // files of a directory mostly come in a row.
+    const QByteArray directory = path.left(path.lastIndexOf('/'));
+    if (directory != m_lastDirectory) {
+        if (!QDir().mkpath(QFile::decodeName(directory))) {
+            qCWarning(ARK) << "Could not create the directory" << directory;
+        }
+        m_lastDirectory = directory;
+    }
+
+    File file;
+    file.path = path;
+    file.mode = mode;
+    file.times[0] = times[0];
+    file.times[1] = times[1];
+    file.data = data;
+    file.fd = -1;
+    file.failed = false;
+    file.result = 0;
+    m_files.append(file);
+    m_queuedPaths.insert(path);
+    m_queuedSize += data.size();
+
+    if (m_files.size() >= MaxBatchFiles || m_queuedSize >= MaxBatchSize) {
+        flush();
+    }
+}
+
+bool UringDiskWriter::isQueued(const QByteArray &path) const
+{
+    return m_queuedPaths.contains(path);
+}
+
+bool UringDiskWriter::flush()
+{
+    if (m_files.isEmpty()) {
+        return true;
+    }
+
+    // Open all the files.
+    int count = 0;
+    for (File &file : m_files) {
+        struct io_uring_sqe *sqe = prepare(&file);
+        if (sqe) {
+            io_uring_prep_openat(sqe, AT_FDCWD, file.path.constData(),
+                                 O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC | O_NOFOLLOW, file.mode);
+            ++count;
+        }
+    }
+    submitAndWait(count);
+
+    // Write the data of the open files.
+    count = 0;
+    for (File &file : m_files) {
+        if (file.result < 0) {
+            file.failed = true;
+            continue;
+        }
+        file.fd = file.result;
+        if (file.data.isEmpty()) {
+            continue;
+        }
+
+        struct io_uring_sqe *sqe = prepare(&file);
+        if (sqe) {
+            io_uring_prep_write(sqe, file.fd, file.data.constData(), static_cast<unsigned>(file.data.size()), 0);
+            ++count;
+        }
+    }
+    submitAndWait(count);
+
+    // Set the times once the data has been written, then close the files.
+    count = 0;
+    for (File &file : m_files) {
+        if (file.fd == -1) {
+            continue;
+        }
+
+        if (!file.data.isEmpty()) {
+            // The data which hasn't been written through io_uring is written here.
+            qint64 written = (file.result == -ECANCELED) ? 0 : file.result;
+            while (written >= 0 && written < file.data.size()) {
+                const ssize_t ret = pwrite(file.fd, file.data.constData() + written, file.data.size() - written, written);
+                if (ret < 0 && errno == EINTR) {
+                    continue;
+                }
+                written = ret <= 0 ? -1 : written + ret;
+            }
+            file.failed = written < 0;
+        }
+        if (!file.failed && futimens(file.fd, file.times) != 0) {
+            file.failed = true;
+        }
+
+        struct io_uring_sqe *sqe = prepare(&file);
+        if (sqe) {
+            io_uring_prep_close(sqe, file.fd);
+            ++count;
+        }
+    }
+    submitAndWait(count);
+
+    bool success = true;
+    for (File &file : m_files) {
+        if (file.fd != -1) {
+            if (file.result == -ECANCELED) {
+                ::close(file.fd);
+            } else if (file.result < 0) {
+                file.failed = true;
+            }
+        }
+
+        if (file.failed && !writeSynchronously(file)) {
+            qCCritical(ARK) << "Error while extracting" << file.path << ":" << strerror(errno);
+            success = false;
+        }
+    }
+
+    m_files.clear();
+    m_queuedPaths.clear();
+    m_queuedSize = 0;
+
+    return success;
+}
+
+struct io_uring_sqe *UringDiskWriter::prepare(File *file)
+{
+    file->result = -ECANCELED;
+    if (!m_isValid) {
+        return Q_NULLPTR;
+    }
+
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&m_ring);
+    Q_ASSERT(sqe);
+    io_uring_sqe_set_data(sqe, file);
+    return sqe;
+}
+
+void UringDiskWriter::submitAndWait(int count)
+{
+    int submitted = 0;
+    while (submitted < count) {
+        const int ret = io_uring_submit(&m_ring);
+        if (ret == -EINTR || ret == -EAGAIN) {
+            continue;
+        }
+        if (ret <= 0) {
+            // The operations left in the ring must never be submitted, they
+            // refer to the files of this batch.
+            qCWarning(ARK) << "Could not submit to io_uring:" << strerror(-ret);
+            m_isValid = false;
+            break;
+        }
+        submitted += ret;
+    }
+
+    for (int i = 0; i < submitted; ++i) {
+        struct io_uring_cqe *cqe;
+        int ret = io_uring_wait_cqe(&m_ring, &cqe);
+        while (ret == -EINTR) {
+            ret = io_uring_wait_cqe(&m_ring, &cqe);
+        }
+        if (ret < 0) {
+            qCWarning(ARK) << "Could not wait for io_uring:" << strerror(-ret);
+            m_isValid = false;
+            break;
+        }
+
+        File *file = static_cast<File*>(io_uring_cqe_get_data(cqe));
+        file->result = cqe->res;
+        io_uring_cqe_seen(&m_ring, cqe);
+    }
+}
+
+bool UringDiskWriter::writeSynchronously(const File &file)
+{
+    const int fd = open(file.path.constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | O_NOFOLLOW, file.mode);
+    if (fd == -1) {
+        return false;
+    }
+
+    qint64 written = 0;
+    while (written < file.data.size()) {
+        const ssize_t ret = write(fd, file.data.constData() + written, file.data.size() - written);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            ::close(fd);
+            return false;
+        }
+        written += ret;
+    }
+
+    const bool success = futimens(fd, file.times) == 0;
+    return (::close(fd) == 0) && success;
+}
@@ -0,0 +1,128 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef URINGDISKWRITER_H
+#define URINGDISKWRITER_H
+
+#include <QByteArray>
+#include <QSet>
+#include <QVector>
+
+#include <liburing.h>
+#include <sys/stat.h>
+
+/**
+ * Writes small regular files to disk in batches through io_uring, so that
+ * extracting an archive of many small files doesn't cost several syscalls
+ * per file.
+ *
+ * The files of a batch are opened, written and closed by one submission
+ * each. io_uring has no operations to change the mode or the times of a
+ * file: the mode is given when creating the file and the times are set
+ * with one futimens() per file.
+ *
+ * A file which could not be written through io_uring is written again with
+ * plain syscalls.
+ */
+class UringDiskWriter
+{
+public:
+    UringDiskWriter();
+
+    /**
+     * Writes the queued files.
+     */
+    ~UringDiskWriter();
+
+    /**
+     * @return Whether io_uring and the operations needed are available.
+     * Otherwise no file must be added.
+     */
+    bool isValid() const;
+
+    /**
+     * Queues the regular file @p path, which must not exist yet, with
+     * @p mode, the access and modification @p times and @p data. The parent
+     * directories are created if needed.
+     */
+    void addFile(const QByteArray &path, mode_t mode, const struct timespec times[2], const QByteArray &data);
+
+    /**
+     * @return Whether the file @p path is queued, i.e. has not been written yet.
+     */
+    bool isQueued(const QByteArray &path) const;
+
+    /**
+     * Writes the queued files.
+     * @return Whether all of them have been written.
+     */
+    bool flush();
+
+private:
+    Q_DISABLE_COPY(UringDiskWriter)
+
+    struct File
+    {
+        QByteArray path;
+        mode_t mode;
+        struct timespec times[2];
+        QByteArray data;
+        int fd;
+        bool failed;
+
+        /**
+         * The result of the last operation on the file.
+         */
+        int result;
+    };
+
+    /**
+     * Sets the result of @p file to -ECANCELED, which it keeps if the
+     * operation isn't run.
+     * @return The entry for the next operation on @p file, or null if
+     * io_uring can't be used any more.
+     */
+    struct io_uring_sqe *prepare(File *file);
+
+    /**
+     * Submits the @p count operations prepared and waits for them to complete.
+     */
+    void submitAndWait(int count);
+
+    /**
+     * Writes @p file with plain syscalls.
+     */
+    static bool writeSynchronously(const File &file);
+
+    struct io_uring m_ring;
+    bool m_isInitialized;
+    bool m_isValid;
+    QVector<File> m_files;
+    QSet<QByteArray> m_queuedPaths;
+    qint64 m_queuedSize;
+    QByteArray m_lastDirectory;
+};
+
+#endif // URINGDISKWRITER_H
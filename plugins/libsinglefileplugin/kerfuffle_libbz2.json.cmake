@@ -1,21 +1,7 @@
 {
     "KPlugin": {
-        "Description": "Open and extract single files compressed with the bzip2 algorithm", 
-        "Description[ca@valencia]": "Obri i extreu fitxers individuals comprimits amb l'algorisme «bzip2»", 
-        "Description[ca]": "Obre i extreu fitxers individuals comprimits amb l'algorisme «bzip2»", 
-        "Description[es]": "Abrir y extraer archivos individuales comprimidos con el algoritmo bzip2", 
-        "Description[it]": "Apri ed estrai singoli file compressi con l'algoritmo bzip2", 
-        "Description[nl]": "Open en pak uit losse bestanden gecomprimeerd met het bzip2-algoritme", 
-        "Description[pl]": "Otwieraj i wypakowuj pojedyncze pliki spakowane algorytmem bzip2", 
-        "Description[pt]": "Abrir e extrair ficheiros individuais comprimidos com o algoritmo Bzip2", 
-        "Description[sk]": "Otvorenie a extrahovanie jednotlivých súborov komprimovaných algoritmom bzip2", 
-        "Description[sr@ijekavian]": "Отварање и распакивање појединачних фајлова компресованих алгоритмом бзип2", 
-        "Description[sr@ijekavianlatin]": "Otvaranje i raspakivanje pojedinačnih fajlova kompresovanih algoritmom bzip2", 
-        "Description[sr@latin]": "Otvaranje i raspakivanje pojedinačnih fajlova kompresovanih algoritmom bzip2", 
-        "Description[sr]": "Отварање и распакивање појединачних фајлова компресованих алгоритмом бзип2", 
-        "Description[sv]": "Öppna och packa upp enstaka filer komprimerade med bzip2-algoritmen", 
-        "Description[uk]": "Здатен відкривати і видобувати дані із окремих файлів, стиснених за допомогою алгоритму bzip2", 
-        "Description[x-test]": "xxOpen and extract single files compressed with the bzip2 algorithmxx", 
+        "Description": "Open, extract and create single files compressed with the bzip2 algorithm", 
+        "Description[x-test]": "xxOpen, extract and create single files compressed with the bzip2 algorithmxx", 
         "Id": "kerfuffle_libbz2", 
         "MimeTypes": [
             "@SUPPORTED_MIMETYPES@"
@@ -41,5 +27,12 @@
         ], 
         "Version": "@KDE_APPLICATIONS_VERSION@"
     }, 
-    "X-KDE-Priority": 100
+    "X-KDE-Kerfuffle-ReadWrite": true, 
+    "X-KDE-Priority": 100, 
+    "application/x-bzip": {
+        "CompressionLevelDefault": 9, 
+        "CompressionLevelMax": 9, 
+        "CompressionLevelMin": 1, 
+        "SupportsTesting": true
+    }
 }
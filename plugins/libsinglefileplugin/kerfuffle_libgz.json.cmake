@@ -1,21 +1,7 @@
 {
     "KPlugin": {
-        "Description": "Open and extract single files compressed with the gzip algorithm", 
-        "Description[ca@valencia]": "Obri i extreu fitxers individuals comprimits amb l'algorisme «gzip»", 
-        "Description[ca]": "Obre i extreu fitxers individuals comprimits amb l'algorisme «gzip»", 
-        "Description[es]": "Abrir y extraer archivos individuales comprimidos con el algoritmo gzip", 
-        "Description[it]": "Apri ed estrai singoli file compressi con l'algoritmo gzip", 
-        "Description[nl]": "Open en pak uit losse bestanden gecomprimeerd met het gzip-algoritme", 
-        "Description[pl]": "Otwieraj i wypakowuj pojedyncze pliki spakowane algorytmem gzip", 
-        "Description[pt]": "Abrir e extrair ficheiros individuais comprimidos com o algoritmo Gzip", 
-        "Description[sk]": "Otvorenie a extrahovanie jednotlivých súborov komprimovaných algoritmom gzip", 
-        "Description[sr@ijekavian]": "Отварање и распакивање појединачних фајлова компресованих алгоритмом гзип", 
-        "Description[sr@ijekavianlatin]": "Otvaranje i raspakivanje pojedinačnih fajlova kompresovanih algoritmom gzip", 
-        "Description[sr@latin]": "Otvaranje i raspakivanje pojedinačnih fajlova kompresovanih algoritmom gzip", 
-        "Description[sr]": "Отварање и распакивање појединачних фајлова компресованих алгоритмом гзип", 
-        "Description[sv]": "Öppna och packa upp enstaka filer komprimerade med gzip-algoritmen", 
-        "Description[uk]": "Здатен відкривати і видобувати дані із окремих файлів, стиснених за допомогою алгоритму gzip", 
-        "Description[x-test]": "xxOpen and extract single files compressed with the gzip algorithmxx", 
+        "Description": "Open, extract and create single files compressed with the gzip algorithm", 
+        "Description[x-test]": "xxOpen, extract and create single files compressed with the gzip algorithmxx", 
         "Id": "kerfuffle_libgz", 
         "MimeTypes": [
             "@SUPPORTED_MIMETYPES@"
@@ -41,5 +27,12 @@
         ], 
         "Version": "@KDE_APPLICATIONS_VERSION@"
     }, 
-    "X-KDE-Priority": 100
+    "X-KDE-Kerfuffle-ReadWrite": true, 
+    "X-KDE-Priority": 100, 
+    "application/gzip": {
+        "CompressionLevelDefault": 6, 
+        "CompressionLevelMax": 9, 
+        "CompressionLevelMin": 1, 
+        "SupportsTesting": true
+    }
 }
@@ -1,21 +1,7 @@
 {
     "KPlugin": {
-        "Description": "Open and extract single files compressed with the lzma algorithm", 
-        "Description[ca@valencia]": "Obri i extreu fitxers individuals comprimits amb l'algorisme «lzma»", 
-        "Description[ca]": "Obre i extreu fitxers individuals comprimits amb l'algorisme «lzma»", 
-        "Description[es]": "Abrir y extraer archivos individuales comprimidos con el algoritmo lzma", 
-        "Description[it]": "Apri ed estrai singoli file compressi con l'algoritmo lzma", 
-        "Description[nl]": "Open en pak uit losse bestanden gecomprimeerd met het lzma-algoritme", 
-        "Description[pl]": "Otwieraj i wypakowuj pojedyncze pliki spakowane algorytmem lzma", 
-        "Description[pt]": "Abrir e extrair ficheiros individuais comprimidos com o algoritmo LZMA", 
-        "Description[sk]": "Otvorenie a extrahovanie jednotlivých súborov komprimovaných algoritmom lzma", 
-        "Description[sr@ijekavian]": "Отварање и распакивање појединачних фајлова компресованих алгоритмом ЛЗМА", 
-        "Description[sr@ijekavianlatin]": "Otvaranje i raspakivanje pojedinačnih fajlova kompresovanih algoritmom LZMA", 
-        "Description[sr@latin]": "Otvaranje i raspakivanje pojedinačnih fajlova kompresovanih algoritmom LZMA", 
-        "Description[sr]": "Отварање и распакивање појединачних фајлова компресованих алгоритмом ЛЗМА", 
-        "Description[sv]": "Öppna och packa upp enstaka filer komprimerade med lzma-algoritmen", 
-        "Description[uk]": "Здатен відкривати і видобувати дані із окремих файлів, стиснених за допомогою алгоритму lzma", 
-        "Description[x-test]": "xxOpen and extract single files compressed with the lzma algorithmxx", 
+        "Description": "Open, extract and create single files compressed with the lzma algorithm", 
+        "Description[x-test]": "xxOpen, extract and create single files compressed with the lzma algorithmxx", 
         "Id": "kerfuffle_libxz", 
         "MimeTypes": [
             "@SUPPORTED_MIMETYPES@"
@@ -41,5 +27,18 @@
         ], 
         "Version": "@KDE_APPLICATIONS_VERSION@"
     }, 
-    "X-KDE-Priority": 100
+    "X-KDE-Kerfuffle-ReadWrite": true, 
+    "X-KDE-Priority": 100, 
+    "application/x-lzma": {
+        "CompressionLevelDefault": 6, 
+        "CompressionLevelMax": 9, 
+        "CompressionLevelMin": 0, 
+        "SupportsTesting": true
+    }, 
+    "application/x-xz": {
+        "CompressionLevelDefault": 6, 
+        "CompressionLevelMax": 9, 
+        "CompressionLevelMin": 0, 
+        "SupportsTesting": true
+    }
 }
@@ -0,0 +1,22 @@
+{
+    "KPlugin": {
+        "Description": "Open, extract and create single files compressed with the Zstandard algorithm", 
+        "Id": "kerfuffle_libzstd", 
+        "MimeTypes": [
+            "@SUPPORTED_MIMETYPES@"
+        ], 
+        "Name": "Zstandard plugin", 
+        "ServiceTypes": [
+            "Kerfuffle/Plugin"
+        ], 
+        "Version": "@KDE_APPLICATIONS_VERSION@"
+    }, 
+    "X-KDE-Kerfuffle-ReadWrite": true, 
+    "X-KDE-Priority": 100, 
+    "application/zstd": {
+        "CompressionLevelDefault": 3, 
+        "CompressionLevelMax": 19, 
+        "CompressionLevelMin": 1, 
+        "SupportsTesting": true
+    }
+}
@@ -0,0 +1,840 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "paralleldecoder.h"
+#include "ark_debug.h"
+
+#include <QDir>
+#include <QIODevice>
+#include <QRunnable>
+#include <QScopedPointer>
+#include <QTemporaryFile>
+#include <QThread>
+
+#include <string.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_BZIP2
+#include <bzlib.h>
+#endif
+#ifdef HAVE_LIBLZMA
+#include <lzma.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+// Units are split at the first member boundary after this many compressed bytes.
+static const qint64 MinUnitSize = 4 * 1024 * 1024;
+// The decoded data of a unit is spilled to a temporary file beyond this size.
+static const qint64 MaxUnitMemory = 32 * 1024 * 1024;
+static const int ChunkSize = 256 * 1024;
+// The input given to zlib and libbz2 at once, whose counters are 32 bits wide.
+static const qint64 MaxCodecInput = 1 << 30;
+
+static const uchar Bzip2BlockMagic[] = { 0x31, 0x41, 0x59, 0x26, 0x53, 0x59 };
+static const uchar Bzip2EndMagic[] = { 0x17, 0x72, 0x45, 0x38, 0x50, 0x90 };
+static const uchar XzMagic[] = { 0xfd, '7', 'z', 'X', 'Z', 0x00 };
+static const uchar ZstdMagic[] = { 0x28, 0xb5, 0x2f, 0xfd };
+// Skippable frames start with 0x50 to 0x5f followed by these bytes.
+static const uchar ZstdSkippableMagic[] = { 0x2a, 0x4d, 0x18 };
+
+/**
+ * Decodes one member, i.e. a gzip member, a bzip2 stream or a xz stream.
+ */
+class ParallelDecoder::Codec
+{
+public:
+    enum Status {
+        Ok,
+        StreamEnd,
+        Error
+    };
+
+    virtual ~Codec()
+    {
+    }
+
+    virtual bool begin(int threadCount) = 0;
+
+    /**
+     * Decodes from @p input into @p output, advancing @p input and
+     * decreasing @p inputSize by the consumed data, and setting
+     * @p outputSize to the size of the decoded data.
+     */
+    virtual Status decode(const uchar **input, qint64 *inputSize, char *output, qint64 *outputSize) = 0;
+
+    virtual void end() = 0;
+};
+
+#ifdef HAVE_ZLIB
+class ParallelDecoder::GzipCodec : public ParallelDecoder::Codec
+{
+public:
+    bool begin(int threadCount) Q_DECL_OVERRIDE
+    {
+        Q_UNUSED(threadCount)
+        memset(&m_stream, 0, sizeof(m_stream));
+        // Only accept the gzip format.
+        return inflateInit2(&m_stream, 16 + MAX_WBITS) == Z_OK;
+    }
+
+    Status decode(const uchar **input, qint64 *inputSize, char *output, qint64 *outputSize) Q_DECL_OVERRIDE
+    {
+        m_stream.next_in = const_cast<Bytef*>(*input);
+        m_stream.avail_in = static_cast<uInt>(qMin(*inputSize, MaxCodecInput));
+        m_stream.next_out = reinterpret_cast<Bytef*>(output);
+        m_stream.avail_out = static_cast<uInt>(*outputSize);
+
+        const int ret = inflate(&m_stream, Z_NO_FLUSH);
+
+        const qint64 consumed = m_stream.next_in - *input;
+        *input += consumed;
+        *inputSize -= consumed;
+        *outputSize -= m_stream.avail_out;
+
+        if (ret == Z_STREAM_END) {
+            return StreamEnd;
+        }
+        return (ret == Z_OK || ret == Z_BUF_ERROR) ? Ok : Error;
+    }
+
+    void end() Q_DECL_OVERRIDE
+    {
+        inflateEnd(&m_stream);
+    }
+
+private:
+    z_stream m_stream;
+};
+#endif
+
+#ifdef HAVE_BZIP2
+class ParallelDecoder::Bzip2Codec : public ParallelDecoder::Codec
+{
+public:
+    bool begin(int threadCount) Q_DECL_OVERRIDE
+    {
+        Q_UNUSED(threadCount)
+        memset(&m_stream, 0, sizeof(m_stream));
+        return BZ2_bzDecompressInit(&m_stream, 0, 0) == BZ_OK;
+    }
+
+    Status decode(const uchar **input, qint64 *inputSize, char *output, qint64 *outputSize) Q_DECL_OVERRIDE
+    {
+        m_stream.next_in = reinterpret_cast<char*>(const_cast<uchar*>(*input));
+        m_stream.avail_in = static_cast<unsigned int>(qMin(*inputSize, MaxCodecInput));
+        m_stream.next_out = output;
+        m_stream.avail_out = static_cast<unsigned int>(*outputSize);
+
+        const int ret = BZ2_bzDecompress(&m_stream);
+
+        const qint64 consumed = reinterpret_cast<const uchar*>(m_stream.next_in) - *input;
+        *input += consumed;
+        *inputSize -= consumed;
+        *outputSize -= m_stream.avail_out;
+
+        if (ret == BZ_STREAM_END) {
+            return StreamEnd;
+        }
+        return (ret == BZ_OK) ? Ok : Error;
+    }
+
+    void end() Q_DECL_OVERRIDE
+    {
+        BZ2_bzDecompressEnd(&m_stream);
+    }
+
+private:
+    bz_stream m_stream;
+};
+#endif
+
+#ifdef HAVE_LIBLZMA
+class ParallelDecoder::XzCodec : public ParallelDecoder::Codec
+{
+public:
+    bool begin(int threadCount) Q_DECL_OVERRIDE
+    {
+        const lzma_stream init = LZMA_STREAM_INIT;
+        m_stream = init;
+
+#if LZMA_VERSION >= 50040002
+        // The multithreaded decoder of liblzma 5.4 decodes the blocks of a stream in parallel.
+        if (threadCount > 1) {
+            lzma_mt options;
+            memset(&options, 0, sizeof(options));
+            options.threads = static_cast<uint32_t>(threadCount);
+            options.memlimit_threading = lzma_physmem() / 4;
+            options.memlimit_stop = UINT64_MAX;
+            return lzma_stream_decoder_mt(&m_stream, &options) == LZMA_OK;
+        }
+#else
+        Q_UNUSED(threadCount)
+#endif
+
+        return lzma_stream_decoder(&m_stream, UINT64_MAX, 0) == LZMA_OK;
+    }
+
+    Status decode(const uchar **input, qint64 *inputSize, char *output, qint64 *outputSize) Q_DECL_OVERRIDE
+    {
+        m_stream.next_in = *input;
+        m_stream.avail_in = static_cast<size_t>(*inputSize);
+        m_stream.next_out = reinterpret_cast<uint8_t*>(output);
+        m_stream.avail_out = static_cast<size_t>(*outputSize);
+
+        const lzma_ret ret = lzma_code(&m_stream, LZMA_RUN);
+
+        const qint64 consumed = m_stream.next_in - *input;
+        *input += consumed;
+        *inputSize -= consumed;
+        *outputSize -= m_stream.avail_out;
+
+        if (ret == LZMA_STREAM_END) {
+            return StreamEnd;
+        }
+        return (ret == LZMA_OK || ret == LZMA_BUF_ERROR) ? Ok : Error;
+    }
+
+    void end() Q_DECL_OVERRIDE
+    {
+        lzma_end(&m_stream);
+    }
+
+private:
+    lzma_stream m_stream;
+};
+#endif
+
+#ifdef HAVE_ZSTD
+class ParallelDecoder::ZstdCodec : public ParallelDecoder::Codec
+{
+public:
+    ZstdCodec()
+        : m_context(ZSTD_createDCtx())
+    {
+    }
+
+    ~ZstdCodec()
+    {
+        ZSTD_freeDCtx(m_context);
+    }
+
+    bool begin(int threadCount) Q_DECL_OVERRIDE
+    {
+        Q_UNUSED(threadCount)
+        // Frames written with long distance matching may use windows larger than the default limit.
+        return m_context &&
+               !ZSTD_isError(ZSTD_DCtx_reset(m_context, ZSTD_reset_session_only)) &&
+               !ZSTD_isError(ZSTD_DCtx_setParameter(m_context, ZSTD_d_windowLogMax, 31));
+    }
+
+    Status decode(const uchar **input, qint64 *inputSize, char *output, qint64 *outputSize) Q_DECL_OVERRIDE
+    {
+        ZSTD_inBuffer inBuffer = { *input, static_cast<size_t>(*inputSize), 0 };
+        ZSTD_outBuffer outBuffer = { output, static_cast<size_t>(*outputSize), 0 };
+
+        // This stops at the end of the frame.
+        const size_t ret = ZSTD_decompressStream(m_context, &outBuffer, &inBuffer);
+
+        *input += inBuffer.pos;
+        *inputSize -= inBuffer.pos;
+        *outputSize = outBuffer.pos;
+
+        if (ZSTD_isError(ret)) {
+            qCWarning(ARK) << "Could not decompress:" << ZSTD_getErrorName(ret);
+            return Error;
+        }
+        return (ret == 0) ? StreamEnd : Ok;
+    }
+
+    void end() Q_DECL_OVERRIDE
+    {
+    }
+
+private:
+    ZSTD_DCtx *m_context;
+};
+#endif
+
+class ParallelDecoder::Sink
+{
+public:
+    virtual ~Sink()
+    {
+    }
+
+    virtual bool write(const char *data, qint64 size) = 0;
+};
+
+class ParallelDecoder::DeviceSink : public ParallelDecoder::Sink
+{
+public:
+    explicit DeviceSink(QIODevice *device)
+        : m_device(device)
+    {
+    }
+
+    bool write(const char *data, qint64 size) Q_DECL_OVERRIDE
+    {
+        return m_device->write(data, size) == size;
+    }
+
+private:
+    QIODevice *m_device;
+};
+
+class ParallelDecoder::DiscardSink : public ParallelDecoder::Sink
+{
+public:
+    bool write(const char *data, qint64 size) Q_DECL_OVERRIDE
+    {
+        Q_UNUSED(data)
+        Q_UNUSED(size)
+        return true;
+    }
+};
+
+class ParallelDecoder::UnitSink : public ParallelDecoder::Sink
+{
+public:
+    UnitSink(Unit *unit, const QString &spillDirectory)
+        : m_unit(unit)
+        , m_spillDirectory(spillDirectory)
+    {
+    }
+
+    bool write(const char *data, qint64 size) Q_DECL_OVERRIDE
+    {
+        if (!m_unit->spillFile && m_unit->data.size() + size > MaxUnitMemory) {
+            m_unit->spillFile.reset(new QTemporaryFile(m_spillDirectory + QLatin1String("/.ark-decode-XXXXXX")));
+            if (!m_unit->spillFile->open() || m_unit->spillFile->write(m_unit->data) != m_unit->data.size()) {
+                qCWarning(ARK) << "Could not write to a temporary file";
+                return false;
+            }
+            m_unit->data.clear();
+        }
+
+        if (m_unit->spillFile) {
+            return m_unit->spillFile->write(data, size) == size;
+        }
+
+        m_unit->data.append(data, static_cast<int>(size));
+        return true;
+    }
+
+private:
+    Unit *m_unit;
+    const QString m_spillDirectory;
+};
+
+class ParallelDecoder::DecodeTask : public QRunnable
+{
+public:
+    DecodeTask(ParallelDecoder *decoder, const QSharedPointer<Unit> &unit)
+        : m_decoder(decoder)
+        , m_unit(unit)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        m_decoder->decodeUnit(m_unit.data());
+    }
+
+private:
+    ParallelDecoder *m_decoder;
+    QSharedPointer<Unit> m_unit;
+};
+
+ParallelDecoder::ParallelDecoder(const uchar *data, qint64 size, QObject *parent)
+    : QObject(parent)
+    , m_data(data)
+    , m_size(size)
+    , m_format(Unknown)
+    , m_plannedEnd(0)
+    , m_nextToWrite(0)
+    , m_isVerifying(false)
+    , m_spillDirectory(QDir::tempPath())
+{
+    QVector<Format> formats;
+#ifdef HAVE_ZLIB
+    formats.append(Gzip);
+#endif
+#ifdef HAVE_BZIP2
+    formats.append(Bzip2);
+#endif
+#ifdef HAVE_LIBLZMA
+    formats.append(Xz);
+#endif
+#ifdef HAVE_ZSTD
+    formats.append(Zstd);
+#endif
+
+    foreach (Format format, formats) {
+        m_format = format;
+        if (isMemberStart(0)) {
+            return;
+        }
+    }
+
+    m_format = Unknown;
+}
+
+ParallelDecoder::~ParallelDecoder()
+{
+    m_isCancelled.store(1);
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+bool ParallelDecoder::isSupported() const
+{
+    return m_format != Unknown;
+}
+
+qint64 ParallelDecoder::decodedSize() const
+{
+    switch (m_format) {
+#ifdef HAVE_LIBLZMA
+    case Xz: {
+        // The index of each stream, just before its footer, has the sizes.
+        qint64 size = 0;
+        qint64 end = m_size;
+        while (end > 0) {
+            while (end >= 4 && memcmp(m_data + end - 4, "\0\0\0\0", 4) == 0) {
+                end -= 4;
+            }
+
+            lzma_stream_flags flags;
+            if (end < 2 * LZMA_STREAM_HEADER_SIZE ||
+                lzma_stream_footer_decode(&flags, m_data + end - LZMA_STREAM_HEADER_SIZE) != LZMA_OK) {
+                return -1;
+            }
+
+            const qint64 indexStart = end - LZMA_STREAM_HEADER_SIZE - static_cast<qint64>(flags.backward_size);
+            if (indexStart < LZMA_STREAM_HEADER_SIZE) {
+                return -1;
+            }
+
+            lzma_index *index = Q_NULLPTR;
+            uint64_t memoryLimit = UINT64_MAX;
+            size_t position = 0;
+            if (lzma_index_buffer_decode(&index, &memoryLimit, Q_NULLPTR, m_data + indexStart, &position, flags.backward_size) != LZMA_OK) {
+                return -1;
+            }
+            size += lzma_index_uncompressed_size(index);
+            end -= lzma_index_stream_size(index);
+            lzma_index_end(index, Q_NULLPTR);
+        }
+        return (end == 0) ? size : -1;
+    }
+#endif
+#ifdef HAVE_ZSTD
+    case Zstd: {
+        // Frames written by a stream, e.g. from a pipe, don't have their size.
+        qint64 size = 0;
+        qint64 position = 0;
+        while (position < m_size) {
+            const unsigned long long frameContentSize = ZSTD_getFrameContentSize(m_data + position, m_size - position);
+            const size_t frameSize = ZSTD_findFrameCompressedSize(m_data + position, m_size - position);
+            if (frameContentSize == ZSTD_CONTENTSIZE_UNKNOWN || frameContentSize == ZSTD_CONTENTSIZE_ERROR ||
+                ZSTD_isError(frameSize)) {
+                return -1;
+            }
+            size += frameContentSize;
+            position += frameSize;
+        }
+        return size;
+    }
+#endif
+    default:
+        // gzip only has the size modulo 4 GiB of each member, bzip2 none.
+        return -1;
+    }
+}
+
+void ParallelDecoder::setSpillDirectory(const QString &path)
+{
+    m_spillDirectory = path;
+}
+
+bool ParallelDecoder::decode(QIODevice *output)
+{
+    Q_ASSERT(output);
+    m_isVerifying = false;
+    return decodeAll(output);
+}
+
+bool ParallelDecoder::verify()
+{
+    m_isVerifying = true;
+    return decodeAll(Q_NULLPTR);
+}
+
+bool ParallelDecoder::decodeAll(QIODevice *output)
+{
+    Q_ASSERT(isSupported());
+
+    DeviceSink deviceSink(output);
+    DiscardSink discardSink;
+    Sink *sink = output ? static_cast<Sink*>(&deviceSink) : &discardSink;
+
+    // The first member is decoded sequentially: only where it really ends
+    // is a member boundary known, without searching the whole file for one.
+    qint64 firstMemberEnd = 0;
+    if (!decodeRange(0, m_size, false, QThread::idealThreadCount(), sink, true, &firstMemberEnd)) {
+        return false;
+    }
+
+    const qint64 unitsStart = skipPadding(firstMemberEnd);
+    if (unitsStart >= m_size) {
+        return true;
+    }
+    if (!isMemberStart(unitsStart)) {
+        qCWarning(ARK) << "Ignoring" << m_size - unitsStart << "bytes of trailing data";
+        return true;
+    }
+
+    // The rest is too small to be split into units.
+    if (nextUnitEnd(unitsStart) >= m_size) {
+        return decodeRange(unitsStart, m_size, false, QThread::idealThreadCount(), sink, true);
+    }
+
+    qCDebug(ARK) << "Decoding the members after" << unitsStart << "in parallel";
+    return decodeUnits(output, unitsStart);
+}
+
+bool ParallelDecoder::isMemberStart(qint64 position) const
+{
+    const qint64 available = m_size - position;
+    const uchar *data = m_data + position;
+
+    switch (m_format) {
+    case Gzip:
+        // The reserved flags must be zero, the extra flags are 0, 2 or 4 and
+        // the OS is at most 13 or 255 (unknown). This rejects most signatures
+        // which merely occur inside compressed data.
+        return available >= 10 && data[0] == 0x1f && data[1] == 0x8b && data[2] == 8 && (data[3] & 0xe0) == 0 &&
+               (data[8] == 0 || data[8] == 2 || data[8] == 4) && (data[9] <= 13 || data[9] == 255);
+    case Bzip2:
+        return available >= 10 && data[0] == 'B' && data[1] == 'Z' && data[2] == 'h' && data[3] >= '1' && data[3] <= '9' &&
+               (memcmp(data + 4, Bzip2BlockMagic, sizeof(Bzip2BlockMagic)) == 0 ||
+                memcmp(data + 4, Bzip2EndMagic, sizeof(Bzip2EndMagic)) == 0);
+    case Xz:
+#ifdef HAVE_LIBLZMA
+        {
+            // The stream header has a CRC-32 of its flags.
+            lzma_stream_flags flags;
+            return available >= LZMA_STREAM_HEADER_SIZE && lzma_stream_header_decode(&flags, data) == LZMA_OK;
+        }
+#else
+        return available >= 12 && memcmp(data, XzMagic, sizeof(XzMagic)) == 0;
+#endif
+    case Zstd:
+        // The reserved bit of the frame header descriptor must be zero.
+        return available >= 8 &&
+               ((memcmp(data, ZstdMagic, sizeof(ZstdMagic)) == 0 && (data[4] & 0x08) == 0) ||
+                ((data[0] & 0xf0) == 0x50 && memcmp(data + 1, ZstdSkippableMagic, sizeof(ZstdSkippableMagic)) == 0));
+    case Unknown:
+        break;
+    }
+
+    return false;
+}
+
+qint64 ParallelDecoder::nextMemberStart(qint64 from) const
+{
+    // Units never start with a skippable zstd frame.
+    const uchar first = (m_format == Gzip) ? 0x1f : (m_format == Bzip2) ? 'B' : (m_format == Xz) ? XzMagic[0] : ZstdMagic[0];
+
+    qint64 position = from;
+    while (position < m_size) {
+        const void *found = memchr(m_data + position, first, static_cast<size_t>(m_size - position));
+        if (!found) {
+            break;
+        }
+
+        position = static_cast<const uchar*>(found) - m_data;
+        if (isMemberStart(position)) {
+            return position;
+        }
+        position++;
+    }
+
+    return m_size;
+}
+
+qint64 ParallelDecoder::skipPadding(qint64 position) const
+{
+    // xz streams may be followed by null bytes.
+    if (m_format == Xz) {
+        while (position < m_size && m_data[position] == 0) {
+            position++;
+        }
+    }
+
+    return position;
+}
+
+qint64 ParallelDecoder::nextUnitEnd(qint64 start) const
+{
+    if (m_size - start <= MinUnitSize) {
+        return m_size;
+    }
+
+    return nextMemberStart(start + MinUnitSize);
+}
+
+bool ParallelDecoder::decodeRange(qint64 start, qint64 end, bool exact, int threadCount, Sink *sink, bool reportProgress, qint64 *firstMemberEnd)
+{
+    QScopedPointer<Codec> codec;
+    switch (m_format) {
+#ifdef HAVE_ZLIB
+    case Gzip:
+        codec.reset(new GzipCodec);
+        break;
+#endif
+#ifdef HAVE_BZIP2
+    case Bzip2:
+        codec.reset(new Bzip2Codec);
+        break;
+#endif
+#ifdef HAVE_LIBLZMA
+    case Xz:
+        codec.reset(new XzCodec);
+        break;
+#endif
+#ifdef HAVE_ZSTD
+    case Zstd:
+        codec.reset(new ZstdCodec);
+        break;
+#endif
+    default:
+        return false;
+    }
+
+    QByteArray buffer(ChunkSize, Qt::Uninitialized);
+    qint64 position = start;
+    int percent = -1;
+
+    while (position < end) {
+        if (position > start) {
+            position = skipPadding(position);
+            if (position >= end) {
+                break;
+            }
+
+            if (!isMemberStart(position)) {
+                if (exact) {
+                    return false;
+                }
+                qCWarning(ARK) << "Ignoring" << end - position << "bytes of trailing data";
+                break;
+            }
+        }
+
+        if (!codec->begin(threadCount)) {
+            return false;
+        }
+
+        Codec::Status status = Codec::Ok;
+        while (status == Codec::Ok) {
+            if (isCancelled()) {
+                status = Codec::Error;
+                break;
+            }
+
+            const uchar *input = m_data + position;
+            qint64 inputSize = end - position;
+            qint64 outputSize = buffer.size();
+
+            status = codec->decode(&input, &inputSize, buffer.data(), &outputSize);
+
+            const qint64 consumed = input - (m_data + position);
+            position += consumed;
+
+            if (outputSize > 0 && !sink->write(buffer.constData(), outputSize)) {
+                status = Codec::Error;
+                break;
+            }
+
+            // The member does not end before the end of the range.
+            if (status == Codec::Ok && consumed == 0 && outputSize == 0) {
+                status = Codec::Error;
+            }
+
+            if (reportProgress && (100 * position / m_size) != percent) {
+                percent = 100 * position / m_size;
+                emit progress(double(position) / double(m_size));
+            }
+        }
+
+        codec->end();
+
+        if (status != Codec::StreamEnd) {
+            return false;
+        }
+
+        if (firstMemberEnd) {
+            *firstMemberEnd = position;
+            return true;
+        }
+    }
+
+    if (firstMemberEnd) {
+        *firstMemberEnd = position;
+    }
+
+    return true;
+}
+
+bool ParallelDecoder::decodeUnits(QIODevice *output, qint64 start)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_plannedEnd = start;
+        scheduleUnits();
+    }
+
+    bool isSuccessful = true;
+    qint64 sequentialStart = -1;
+
+    forever {
+        QSharedPointer<Unit> unit;
+        {
+            QMutexLocker locker(&m_mutex);
+            if (m_nextToWrite >= m_units.size()) {
+                break;
+            }
+
+            unit = m_units.at(m_nextToWrite);
+            while (!unit->isReady) {
+                m_unitReady.wait(&m_mutex);
+            }
+        }
+
+        if (QThread::currentThread()->isInterruptionRequested()) {
+            isSuccessful = false;
+            break;
+        }
+
+        // A member boundary was wrong: the unit starts at a real one, though.
+        if (!unit->isValid) {
+            qCDebug(ARK) << "Could not decode the unit starting at" << unit->start << ", decoding the rest sequentially";
+            sequentialStart = unit->start;
+            break;
+        }
+
+        if (output && !writeUnit(output, unit.data())) {
+            isSuccessful = false;
+            break;
+        }
+
+        emit progress(double(unit->end) / double(m_size));
+
+        {
+            QMutexLocker locker(&m_mutex);
+            m_units[m_nextToWrite].clear();
+            m_nextToWrite++;
+            scheduleUnits();
+        }
+    }
+
+    // Stop decoding the units which won't be written.
+    m_isCancelled.store(1);
+    m_pool.clear();
+    m_pool.waitForDone();
+    m_isCancelled.store(0);
+
+    if (isSuccessful && sequentialStart >= 0) {
+        DeviceSink deviceSink(output);
+        DiscardSink discardSink;
+        Sink *sink = output ? static_cast<Sink*>(&deviceSink) : &discardSink;
+        isSuccessful = decodeRange(sequentialStart, m_size, false, QThread::idealThreadCount(), sink, true);
+    }
+
+    return isSuccessful;
+}
+
+void ParallelDecoder::decodeUnit(Unit *unit)
+{
+    // When verifying, a unit only needs to be decoded, not kept.
+    UnitSink unitSink(unit, m_spillDirectory);
+    DiscardSink discardSink;
+    Sink *sink = m_isVerifying ? static_cast<Sink*>(&discardSink) : &unitSink;
+    const bool isValid = !isCancelled() && decodeRange(unit->start, unit->end, true, 1, sink, false);
+
+    QMutexLocker locker(&m_mutex);
+    unit->isValid = isValid;
+    unit->isReady = true;
+    m_unitReady.wakeAll();
+}
+
+bool ParallelDecoder::writeUnit(QIODevice *output, const Unit *unit)
+{
+    if (!unit->spillFile) {
+        return output->write(unit->data) == unit->data.size();
+    }
+
+    if (!unit->spillFile->seek(0)) {
+        return false;
+    }
+
+    QByteArray buffer(ChunkSize, Qt::Uninitialized);
+    forever {
+        const qint64 readBytes = unit->spillFile->read(buffer.data(), buffer.size());
+        if (readBytes <= 0) {
+            return readBytes == 0;
+        }
+        if (output->write(buffer.constData(), readBytes) != readBytes) {
+            return false;
+        }
+    }
+}
+
+void ParallelDecoder::scheduleUnits()
+{
+    const int maxUnitsAhead = m_pool.maxThreadCount() + 1;
+
+    while (m_plannedEnd < m_size && m_units.size() - m_nextToWrite < maxUnitsAhead) {
+        QSharedPointer<Unit> unit(new Unit);
+        unit->start = m_plannedEnd;
+        unit->end = nextUnitEnd(m_plannedEnd);
+        unit->isReady = false;
+        unit->isValid = false;
+
+        m_plannedEnd = unit->end;
+        m_units.append(unit);
+        m_pool.start(new DecodeTask(this, unit));
+    }
+}
+
+bool ParallelDecoder::isCancelled() const
+{
+    return m_isCancelled.load() != 0 || QThread::currentThread()->isInterruptionRequested();
+}
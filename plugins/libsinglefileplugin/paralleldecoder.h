@@ -0,0 +1,190 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PARALLELDECODER_H
+#define PARALLELDECODER_H
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QObject>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QVector>
+#include <QWaitCondition>
+
+class QIODevice;
+class QTemporaryFile;
+
+/**
+ * Decompresses a gzip, bzip2, xz or zstd file, using several threads where
+ * the format allows it.
+ *
+ * Files made of several members, e.g. concatenated gzip members, zstd
+ * frames or the bzip2 streams written by pbzip2, are split at the member boundaries into
+ * units of a few MiB, which are decoded in parallel and written in order.
+ * The first member is always decoded sequentially, so that the file is only
+ * split once the start of a second member is known.
+ * Since the signature of a member may also occur inside compressed data, a
+ * unit is only accepted if its last member ends exactly where the next unit
+ * starts. Otherwise the rest of the file is decoded sequentially.
+ *
+ * A file made of a single xz stream is decoded by the multithreaded decoder
+ * of liblzma, if available, which decodes its blocks in parallel. A single
+ * gzip member, bzip2 stream or zstd frame can only be decoded by one thread.
+ *
+ * Only the formats of the libraries the plugin is built with are supported.
+ */
+class ParallelDecoder : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @param data The compressed file, usually mapped into memory. It must
+     *        stay valid as long as the decoder.
+     */
+    ParallelDecoder(const uchar *data, qint64 size, QObject *parent = Q_NULLPTR);
+    virtual ~ParallelDecoder();
+
+    /**
+     * @return Whether the data starts like a file in a supported format.
+     */
+    bool isSupported() const;
+
+    /**
+     * @return The size of the decoded data if the file records it, as xz
+     *         and most zstd files do, otherwise -1.
+     */
+    qint64 decodedSize() const;
+
+    /**
+     * Decodes the whole file into @p output.
+     *
+     * @return @c false if the data is corrupt, if @p output could not be
+     *         written or if the current thread was interrupted.
+     */
+    bool decode(QIODevice *output);
+
+    /**
+     * Decodes the whole file, dropping the decoded data, to check the CRC
+     * of every member. Nothing is buffered or written to disk.
+     *
+     * @return @c false if the data is corrupt or if the current thread was
+     *         interrupted.
+     */
+    bool verify();
+
+    /**
+     * Sets the folder in which units too large to be kept in memory are
+     * stored until they are written, by default the temporary folder.
+     * It should be on the file system of the output.
+     */
+    void setSpillDirectory(const QString &path);
+
+signals:
+    /**
+     * Emitted with the share of the compressed data decoded so far.
+     */
+    void progress(double progress);
+
+private:
+    enum Format {
+        Unknown,
+        Gzip,
+        Bzip2,
+        Xz,
+        Zstd
+    };
+
+    class Codec;
+    class GzipCodec;
+    class Bzip2Codec;
+    class XzCodec;
+    class ZstdCodec;
+    class Sink;
+    class DeviceSink;
+    class DiscardSink;
+    class UnitSink;
+    class DecodeTask;
+
+    struct Unit
+    {
+        qint64 start;
+        qint64 end;
+        bool isReady;
+        bool isValid;
+
+        /**
+         * The decoded data, unless it is in the spill file.
+         */
+        QByteArray data;
+        QSharedPointer<QTemporaryFile> spillFile;
+    };
+
+    bool isMemberStart(qint64 position) const;
+    qint64 nextMemberStart(qint64 from) const;
+    qint64 skipPadding(qint64 position) const;
+    qint64 nextUnitEnd(qint64 start) const;
+
+    /**
+     * Decodes the members found between @p start and @p end into @p sink.
+     *
+     * If @p exact is true, the last member must end at @p end. Otherwise
+     * data following the last member is ignored, as gzip and bzip2 do.
+     *
+     * If @p firstMemberEnd is not null, only the first member is decoded
+     * and the position where it ends is stored there.
+     */
+    bool decodeRange(qint64 start, qint64 end, bool exact, int threadCount, Sink *sink, bool reportProgress,
+                     qint64 *firstMemberEnd = Q_NULLPTR);
+
+    /**
+     * Decodes the whole file into @p output, or drops the decoded data if
+     * @p output is null.
+     */
+    bool decodeAll(QIODevice *output);
+    bool decodeUnits(QIODevice *output, qint64 start);
+    void decodeUnit(Unit *unit);
+    bool writeUnit(QIODevice *output, const Unit *unit);
+    void scheduleUnits();
+    bool isCancelled() const;
+
+    const uchar *m_data;
+    const qint64 m_size;
+    Format m_format;
+
+    QThreadPool m_pool;
+    QMutex m_mutex;
+    QWaitCondition m_unitReady;
+    QVector<QSharedPointer<Unit> > m_units;
+    qint64 m_plannedEnd;
+    int m_nextToWrite;
+    bool m_isVerifying;
+    QString m_spillDirectory;
+
+    QAtomicInt m_isCancelled;
+};
+
+#endif // PARALLELDECODER_H
@@ -0,0 +1,644 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "parallelencoder.h"
+#include "ark_debug.h"
+
+#include <QFile>
+#include <QIODevice>
+#include <QRunnable>
+#include <QScopedPointer>
+#include <QThread>
+
+#include <string.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_BZIP2
+#include <bzlib.h>
+#endif
+#ifdef HAVE_LIBLZMA
+#include <lzma.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+// The block size of pigz.
+static const int GzipBlockSize = 128 * 1024;
+static const int GzipDictionarySize = 32 * 1024;
+static const int ChunkSize = 1024 * 1024;
+
+#ifdef HAVE_ZLIB
+/**
+ * Deflates @p input into raw deflate blocks which do not end the stream,
+ * so that the output of several calls can be concatenated.
+ */
+static bool deflateBlock(const QByteArray &input, const QByteArray &dictionary, int level, QByteArray *output, quint32 *crc)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+
+    if (!dictionary.isEmpty() &&
+        deflateSetDictionary(&stream, reinterpret_cast<const Bytef*>(dictionary.constData()), dictionary.size()) != Z_OK) {
+        deflateEnd(&stream);
+        return false;
+    }
+
+    // The sync flush appends an empty stored block, not counted by deflateBound().
+    output->resize(static_cast<int>(deflateBound(&stream, input.size())) + 16);
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.constData()));
+    stream.avail_in = input.size();
+
+    int ret;
+    forever {
+        stream.next_out = reinterpret_cast<Bytef*>(output->data()) + stream.total_out;
+        stream.avail_out = output->size() - stream.total_out;
+
+        ret = deflate(&stream, Z_SYNC_FLUSH);
+        if (ret != Z_OK || stream.avail_out > 0) {
+            break;
+        }
+        output->resize(output->size() * 2);
+    }
+
+    output->resize(stream.total_out);
+    deflateEnd(&stream);
+
+    *crc = crc32(0L, reinterpret_cast<const Bytef*>(input.constData()), input.size());
+    return ret == Z_OK;
+}
+#endif
+
+#ifdef HAVE_BZIP2
+/**
+ * Compresses @p input into a bzip2 stream of its own.
+ */
+static bool bzip2Block(const QByteArray &input, int level, QByteArray *output)
+{
+    // The worst case documented by libbz2.
+    unsigned int size = input.size() + input.size() / 100 + 600;
+    output->resize(size);
+
+    const int ret = BZ2_bzBuffToBuffCompress(output->data(), &size, const_cast<char*>(input.constData()), input.size(), level, 0, 0);
+
+    output->resize(size);
+    return ret == BZ_OK;
+}
+#endif
+
+/**
+ * Compresses a stream with a library which does its own threading.
+ */
+class ParallelEncoder::StreamCodec
+{
+public:
+    enum Status {
+        Ok,
+        StreamEnd,
+        Error
+    };
+
+    virtual ~StreamCodec()
+    {
+    }
+
+    /**
+     * Compresses from @p input into @p output, advancing @p input and
+     * decreasing @p inputSize by the consumed data, and setting
+     * @p outputSize to the size of the compressed data. @p isInputEnd
+     * tells whether @p input holds the last of the data.
+     */
+    virtual Status encode(const char **input, qint64 *inputSize, char *output, qint64 *outputSize, bool isInputEnd) = 0;
+};
+
+#ifdef HAVE_LIBLZMA
+class ParallelEncoder::XzCodec : public ParallelEncoder::StreamCodec
+{
+public:
+    XzCodec()
+    {
+        const lzma_stream init = LZMA_STREAM_INIT;
+        m_stream = init;
+    }
+
+    ~XzCodec()
+    {
+        lzma_end(&m_stream);
+    }
+
+    bool begin(bool isLegacy, int level, int threadCount)
+    {
+        if (isLegacy) {
+            lzma_options_lzma options;
+            if (lzma_lzma_preset(&options, static_cast<uint32_t>(level))) {
+                return false;
+            }
+            return lzma_alone_encoder(&m_stream, &options) == LZMA_OK;
+        }
+
+#if LZMA_VERSION >= 50020000
+        // The multithreaded encoder compresses blocks of the stream in parallel.
+        if (threadCount > 1) {
+            lzma_mt options;
+            memset(&options, 0, sizeof(options));
+            options.threads = static_cast<uint32_t>(threadCount);
+            options.preset = static_cast<uint32_t>(level);
+            options.check = LZMA_CHECK_CRC64;
+            return lzma_stream_encoder_mt(&m_stream, &options) == LZMA_OK;
+        }
+#else
+        Q_UNUSED(threadCount)
+#endif
+
+        return lzma_easy_encoder(&m_stream, static_cast<uint32_t>(level), LZMA_CHECK_CRC64) == LZMA_OK;
+    }
+
+    Status encode(const char **input, qint64 *inputSize, char *output, qint64 *outputSize, bool isInputEnd) Q_DECL_OVERRIDE
+    {
+        m_stream.next_in = reinterpret_cast<const uint8_t*>(*input);
+        m_stream.avail_in = static_cast<size_t>(*inputSize);
+        m_stream.next_out = reinterpret_cast<uint8_t*>(output);
+        m_stream.avail_out = static_cast<size_t>(*outputSize);
+
+        const lzma_ret ret = lzma_code(&m_stream, isInputEnd ? LZMA_FINISH : LZMA_RUN);
+
+        const qint64 consumed = *inputSize - static_cast<qint64>(m_stream.avail_in);
+        *input += consumed;
+        *inputSize -= consumed;
+        *outputSize -= m_stream.avail_out;
+
+        if (ret == LZMA_STREAM_END) {
+            return StreamEnd;
+        }
+        return (ret == LZMA_OK) ? Ok : Error;
+    }
+
+private:
+    lzma_stream m_stream;
+};
+#endif
+
+#ifdef HAVE_ZSTD
+class ParallelEncoder::ZstdCodec : public ParallelEncoder::StreamCodec
+{
+public:
+    ZstdCodec()
+        : m_context(ZSTD_createCCtx())
+    {
+    }
+
+    ~ZstdCodec()
+    {
+        ZSTD_freeCCtx(m_context);
+    }
+
+    bool begin(int level, int threadCount, bool isLongDistanceMatchingEnabled)
+    {
+        if (!m_context ||
+            ZSTD_isError(ZSTD_CCtx_setParameter(m_context, ZSTD_c_compressionLevel, level)) ||
+            ZSTD_isError(ZSTD_CCtx_setParameter(m_context, ZSTD_c_checksumFlag, 1))) {
+            return false;
+        }
+
+        // The workers compress jobs of the frame in parallel.
+        if (threadCount > 1 && ZSTD_isError(ZSTD_CCtx_setParameter(m_context, ZSTD_c_nbWorkers, threadCount))) {
+            qCWarning(ARK) << "libzstd does not support multithreading, compressing with one thread";
+        }
+
+        if (isLongDistanceMatchingEnabled &&
+            ZSTD_isError(ZSTD_CCtx_setParameter(m_context, ZSTD_c_enableLongDistanceMatching, 1))) {
+            return false;
+        }
+
+        return true;
+    }
+
+    Status encode(const char **input, qint64 *inputSize, char *output, qint64 *outputSize, bool isInputEnd) Q_DECL_OVERRIDE
+    {
+        ZSTD_inBuffer inBuffer = { *input, static_cast<size_t>(*inputSize), 0 };
+        ZSTD_outBuffer outBuffer = { output, static_cast<size_t>(*outputSize), 0 };
+
+        const size_t ret = ZSTD_compressStream2(m_context, &outBuffer, &inBuffer, isInputEnd ? ZSTD_e_end : ZSTD_e_continue);
+
+        *input += inBuffer.pos;
+        *inputSize -= inBuffer.pos;
+        *outputSize = outBuffer.pos;
+
+        if (ZSTD_isError(ret)) {
+            qCWarning(ARK) << "Could not compress:" << ZSTD_getErrorName(ret);
+            return Error;
+        }
+        return (isInputEnd && ret == 0) ? StreamEnd : Ok;
+    }
+
+private:
+    ZSTD_CCtx *m_context;
+};
+#endif
+
+class ParallelEncoder::EncodeTask : public QRunnable
+{
+public:
+    EncodeTask(ParallelEncoder *encoder, const QSharedPointer<Block> &block)
+        : m_encoder(encoder)
+        , m_block(block)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        m_encoder->encodeBlock(m_block.data());
+    }
+
+private:
+    ParallelEncoder *m_encoder;
+    QSharedPointer<Block> m_block;
+};
+
+ParallelEncoder::ParallelEncoder(Format format, QObject *parent)
+    : QObject(parent)
+    , m_format(format)
+    , m_compressionLevel(-1)
+    , m_threadCount(0)
+    , m_isLongDistanceMatchingEnabled(false)
+    , m_crc(0)
+    , m_totalSize(0)
+    , m_percent(-1)
+{
+}
+
+ParallelEncoder::~ParallelEncoder()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+bool ParallelEncoder::isSupported(Format format)
+{
+    switch (format) {
+#ifdef HAVE_ZLIB
+    case Gzip:
+        return true;
+#endif
+#ifdef HAVE_BZIP2
+    case Bzip2:
+        return true;
+#endif
+#ifdef HAVE_LIBLZMA
+    case Xz:
+    case Lzma:
+        return true;
+#endif
+#ifdef HAVE_ZSTD
+    case Zstd:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+void ParallelEncoder::setCompressionLevel(int level)
+{
+    m_compressionLevel = level;
+}
+
+void ParallelEncoder::setThreadCount(int count)
+{
+    m_threadCount = count;
+}
+
+void ParallelEncoder::setLongDistanceMatchingEnabled(bool enabled)
+{
+    m_isLongDistanceMatchingEnabled = enabled;
+}
+
+void ParallelEncoder::setFileName(const QString &fileName)
+{
+    m_fileName = fileName;
+}
+
+void ParallelEncoder::setModificationTime(const QDateTime &modificationTime)
+{
+    m_modificationTime = modificationTime;
+}
+
+bool ParallelEncoder::encode(QIODevice *input, QIODevice *output)
+{
+    Q_ASSERT(isSupported(m_format));
+
+    m_crc = 0;
+    m_totalSize = 0;
+    m_percent = -1;
+
+    if (m_format == Gzip || m_format == Bzip2) {
+        return encodeBlocks(input, output);
+    }
+    return encodeStream(input, output);
+}
+
+int ParallelEncoder::compressionLevel() const
+{
+    switch (m_format) {
+    case Gzip:
+        return (m_compressionLevel < 0) ? 6 : qBound(1, m_compressionLevel, 9);
+    case Bzip2:
+        return (m_compressionLevel < 0) ? 9 : qBound(1, m_compressionLevel, 9);
+    case Xz:
+    case Lzma:
+        return (m_compressionLevel < 0) ? 6 : qBound(0, m_compressionLevel, 9);
+    case Zstd:
+        return (m_compressionLevel < 0) ? 3 : qBound(1, m_compressionLevel, 19);
+    }
+
+    return m_compressionLevel;
+}
+
+int ParallelEncoder::threadCount() const
+{
+    return (m_threadCount > 0) ? m_threadCount : qMax(1, QThread::idealThreadCount());
+}
+
+bool ParallelEncoder::encodeBlocks(QIODevice *input, QIODevice *output)
+{
+    const int threads = threadCount();
+    m_pool.setMaxThreadCount(threads);
+
+    // Keep the threads busy while the oldest block is written.
+    const int maxBlocksAhead = 2 * threads;
+    const int blockSize = (m_format == Gzip) ? GzipBlockSize : compressionLevel() * 100000;
+
+    bool isSuccessful = true;
+
+    if (m_format == Gzip) {
+        const QByteArray header = gzipHeader();
+        isSuccessful = (output->write(header) == header.size());
+    }
+
+    QByteArray previousInput;
+    bool isFirstBlock = true;
+    while (isSuccessful) {
+        if (QThread::currentThread()->isInterruptionRequested()) {
+            isSuccessful = false;
+            break;
+        }
+
+        QSharedPointer<Block> block(new Block);
+        block->input.resize(blockSize);
+        const qint64 readBytes = input->read(block->input.data(), blockSize);
+        if (readBytes < 0) {
+            qCWarning(ARK) << "Could not read the input:" << input->errorString();
+            isSuccessful = false;
+            break;
+        }
+
+        // bzip2 needs a stream even for empty data.
+        if (readBytes == 0 && (m_format != Bzip2 || !isFirstBlock)) {
+            break;
+        }
+
+        block->input.resize(static_cast<int>(readBytes));
+        if (m_format == Gzip) {
+            block->dictionary = previousInput.right(GzipDictionarySize);
+            previousInput = block->input;
+        }
+        block->crc = 0;
+        block->isReady = false;
+        block->isValid = false;
+
+        m_blocks.enqueue(block);
+        m_pool.start(new EncodeTask(this, block));
+        isFirstBlock = false;
+
+        if (m_blocks.size() >= maxBlocksAhead) {
+            isSuccessful = writeBlock(output);
+            reportProgress(input, m_totalSize);
+        }
+
+        if (readBytes == 0) {
+            break;
+        }
+    }
+
+    while (isSuccessful && !m_blocks.isEmpty()) {
+        isSuccessful = writeBlock(output);
+        reportProgress(input, m_totalSize);
+    }
+
+    if (!isSuccessful) {
+        m_pool.clear();
+        m_pool.waitForDone();
+        m_blocks.clear();
+        return false;
+    }
+
+#ifdef HAVE_ZLIB
+    if (m_format == Gzip) {
+        // An empty fixed Huffman block ends the deflate stream, as in pigz.
+        QByteArray trailer("\x03\x00", 2);
+        for (int i = 0; i < 4; ++i) {
+            trailer.append(static_cast<char>((m_crc >> (8 * i)) & 0xff));
+        }
+        for (int i = 0; i < 4; ++i) {
+            trailer.append(static_cast<char>((quint64(m_totalSize) >> (8 * i)) & 0xff));
+        }
+        return output->write(trailer) == trailer.size();
+    }
+#endif
+
+    return true;
+}
+
+void ParallelEncoder::encodeBlock(Block *block)
+{
+    bool isValid = false;
+
+    switch (m_format) {
+#ifdef HAVE_ZLIB
+    case Gzip:
+        isValid = deflateBlock(block->input, block->dictionary, compressionLevel(), &block->output, &block->crc);
+        break;
+#endif
+#ifdef HAVE_BZIP2
+    case Bzip2:
+        isValid = bzip2Block(block->input, compressionLevel(), &block->output);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    block->isValid = isValid;
+    block->isReady = true;
+    m_blockReady.wakeAll();
+}
+
+bool ParallelEncoder::writeBlock(QIODevice *output)
+{
+    const QSharedPointer<Block> block = m_blocks.dequeue();
+    {
+        QMutexLocker locker(&m_mutex);
+        while (!block->isReady) {
+            m_blockReady.wait(&m_mutex);
+        }
+    }
+
+    if (!block->isValid) {
+        qCWarning(ARK) << "Could not compress a block";
+        return false;
+    }
+
+    if (output->write(block->output) != block->output.size()) {
+        qCWarning(ARK) << "Could not write the output:" << output->errorString();
+        return false;
+    }
+
+#ifdef HAVE_ZLIB
+    if (m_format == Gzip) {
+        m_crc = crc32_combine(m_crc, block->crc, block->input.size());
+    }
+#endif
+    m_totalSize += block->input.size();
+
+    return true;
+}
+
+bool ParallelEncoder::encodeStream(QIODevice *input, QIODevice *output)
+{
+    QScopedPointer<StreamCodec> codec;
+
+    switch (m_format) {
+#ifdef HAVE_LIBLZMA
+    case Xz:
+    case Lzma: {
+        XzCodec *xzCodec = new XzCodec;
+        codec.reset(xzCodec);
+        if (!xzCodec->begin(m_format == Lzma, compressionLevel(), threadCount())) {
+            qCWarning(ARK) << "Could not initialize the lzma encoder";
+            return false;
+        }
+        break;
+    }
+#endif
+#ifdef HAVE_ZSTD
+    case Zstd: {
+        ZstdCodec *zstdCodec = new ZstdCodec;
+        codec.reset(zstdCodec);
+        if (!zstdCodec->begin(compressionLevel(), threadCount(), m_isLongDistanceMatchingEnabled)) {
+            qCWarning(ARK) << "Could not initialize the zstd encoder";
+            return false;
+        }
+        break;
+    }
+#endif
+    default:
+        return false;
+    }
+
+    QByteArray inputBuffer(ChunkSize, Qt::Uninitialized);
+    QByteArray outputBuffer(ChunkSize, Qt::Uninitialized);
+    const char *inputData = inputBuffer.constData();
+    qint64 inputSize = 0;
+    bool isInputEnd = false;
+
+    forever {
+        if (QThread::currentThread()->isInterruptionRequested()) {
+            return false;
+        }
+
+        if (inputSize == 0 && !isInputEnd) {
+            const qint64 readBytes = input->read(inputBuffer.data(), inputBuffer.size());
+            if (readBytes < 0) {
+                qCWarning(ARK) << "Could not read the input:" << input->errorString();
+                return false;
+            }
+
+            isInputEnd = (readBytes == 0);
+            inputData = inputBuffer.constData();
+            inputSize = readBytes;
+            m_totalSize += readBytes;
+            reportProgress(input, m_totalSize);
+        }
+
+        qint64 outputSize = outputBuffer.size();
+        const StreamCodec::Status status = codec->encode(&inputData, &inputSize, outputBuffer.data(), &outputSize, isInputEnd);
+
+        if (outputSize > 0 && output->write(outputBuffer.constData(), outputSize) != outputSize) {
+            qCWarning(ARK) << "Could not write the output:" << output->errorString();
+            return false;
+        }
+
+        if (status == StreamCodec::Error) {
+            return false;
+        } else if (status == StreamCodec::StreamEnd) {
+            return true;
+        }
+    }
+}
+
+QByteArray ParallelEncoder::gzipHeader() const
+{
+    const QByteArray name = QFile::encodeName(m_fileName);
+    const quint32 time = m_modificationTime.isValid() ? m_modificationTime.toTime_t() : 0;
+    const int level = compressionLevel();
+
+    QByteArray header("\x1f\x8b\x08", 3);
+    // FNAME, if the name is known.
+    header.append(static_cast<char>(name.isEmpty() ? 0 : 0x08));
+    for (int i = 0; i < 4; ++i) {
+        header.append(static_cast<char>((time >> (8 * i)) & 0xff));
+    }
+    // Maximum compression, fastest compression or neither.
+    header.append(static_cast<char>((level == 9) ? 2 : (level == 1) ? 4 : 0));
+    // Unix.
+    header.append(static_cast<char>(3));
+
+    if (!name.isEmpty()) {
+        header.append(name);
+        header.append('\0');
+    }
+
+    return header;
+}
+
+void ParallelEncoder::reportProgress(QIODevice *input, qint64 readBytes)
+{
+    const qint64 size = input->isSequential() ? 0 : input->size();
+    if (size <= 0) {
+        return;
+    }
+
+    const int percent = static_cast<int>(100 * readBytes / size);
+    if (percent != m_percent) {
+        m_percent = percent;
+        emit progress(double(readBytes) / double(size));
+    }
+}
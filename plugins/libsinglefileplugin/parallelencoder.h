@@ -0,0 +1,166 @@
+/*
+ * ark -- archiver for the KDE project
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES ( INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION ) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * ( INCLUDING NEGLIGENCE OR OTHERWISE ) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PARALLELENCODER_H
+#define PARALLELENCODER_H
+
+#include <QDateTime>
+#include <QMutex>
+#include <QObject>
+#include <QQueue>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+class QIODevice;
+
+/**
+ * Compresses a single file into the gzip, bzip2, xz, lzma or zstd format,
+ * using several threads where the format allows it.
+ *
+ * gzip data is split into blocks of 128 KiB as pigz does: each block is
+ * deflated on its own thread, using the end of the previous block as
+ * dictionary, and the blocks are joined into a single gzip member.
+ * bzip2 data is split into blocks of the chosen block size as pbzip2 does,
+ * each compressed into a bzip2 stream of its own.
+ * xz and zstd data is compressed by the multithreaded encoders of liblzma
+ * and libzstd. The legacy lzma format can only be written by one thread.
+ *
+ * Only the formats of the libraries the plugin is built with are supported.
+ */
+class ParallelEncoder : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Format {
+        Gzip,
+        Bzip2,
+        Xz,
+        Lzma,
+        Zstd
+    };
+
+    explicit ParallelEncoder(Format format, QObject *parent = Q_NULLPTR);
+    virtual ~ParallelEncoder();
+
+    /**
+     * @return Whether the plugin is built with support for writing @p format.
+     */
+    static bool isSupported(Format format);
+
+    /**
+     * Sets the compression level, or -1 for the default of the format.
+     */
+    void setCompressionLevel(int level);
+
+    /**
+     * Sets the number of threads to use, or 0 for one per core.
+     */
+    void setThreadCount(int count);
+
+    /**
+     * Enables long distance matching, only supported by zstd.
+     */
+    void setLongDistanceMatchingEnabled(bool enabled);
+
+    /**
+     * Sets the original name and modification time of the file, stored in
+     * the gzip header.
+     */
+    void setFileName(const QString &fileName);
+    void setModificationTime(const QDateTime &modificationTime);
+
+    /**
+     * Compresses all the data of @p input into @p output.
+     *
+     * @return @c false if the data could not be read, compressed or written
+     *         or if the current thread was interrupted.
+     */
+    bool encode(QIODevice *input, QIODevice *output);
+
+signals:
+    /**
+     * Emitted with the share of the input data compressed so far.
+     */
+    void progress(double progress);
+
+private:
+    class StreamCodec;
+    class XzCodec;
+    class ZstdCodec;
+    class EncodeTask;
+
+    struct Block
+    {
+        QByteArray input;
+
+        /**
+         * The end of the previous block, for gzip.
+         */
+        QByteArray dictionary;
+
+        QByteArray output;
+        quint32 crc;
+        bool isReady;
+        bool isValid;
+    };
+
+    int compressionLevel() const;
+    int threadCount() const;
+
+    /**
+     * Compresses the blocks of gzip and bzip2 data on the thread pool.
+     */
+    bool encodeBlocks(QIODevice *input, QIODevice *output);
+    void encodeBlock(Block *block);
+    bool writeBlock(QIODevice *output);
+
+    /**
+     * Compresses the data with the encoders of liblzma or libzstd.
+     */
+    bool encodeStream(QIODevice *input, QIODevice *output);
+
+    QByteArray gzipHeader() const;
+    void reportProgress(QIODevice *input, qint64 readBytes);
+
+    const Format m_format;
+    int m_compressionLevel;
+    int m_threadCount;
+    bool m_isLongDistanceMatchingEnabled;
+    QString m_fileName;
+    QDateTime m_modificationTime;
+
+    QThreadPool m_pool;
+    QMutex m_mutex;
+    QWaitCondition m_blockReady;
+    QQueue<QSharedPointer<Block> > m_blocks;
+
+    quint32 m_crc;
+    qint64 m_totalSize;
+    int m_percent;
+};
+
+#endif // PARALLELENCODER_H
@@ -25,16 +25,26 @@
 
 #include "singlefileplugin.h"
 #include "ark_debug.h"
+#include "diskio.h"
+#include "paralleldecoder.h"
+#include "parallelencoder.h"
 #include "queries.h"
 
+#include <QDateTime>
 #include <QFile>
 #include <QFileInfo>
+#include <QMimeType>
+#include <QSaveFile>
+#include <QThread>
 
 #include <KFilterDev>
 #include <KLocalizedString>
 
+#include <errno.h>
+#include <string.h>
+
 LibSingleFileInterface::LibSingleFileInterface(QObject *parent, const QVariantList & args)
-        : Kerfuffle::ReadOnlyArchiveInterface(parent, args)
+        : Kerfuffle::ReadWriteArchiveInterface(parent, args)
 {
     qCDebug(ARK) << "Loaded singlefile plugin";
 }
@@ -46,7 +56,6 @@ LibSingleFileInterface::~LibSingleFileInterface()
 bool LibSingleFileInterface::extractFiles(const QVector<Kerfuffle::Archive::Entry*> &files, const QString &destinationDirectory, const Kerfuffle::ExtractionOptions &options)
 {
     Q_UNUSED(files)
-    Q_UNUSED(options)
 
     QString outputFileName = destinationDirectory;
     if (!destinationDirectory.endsWith(QLatin1Char('/'))) {
@@ -69,7 +78,54 @@ bool LibSingleFileInterface::extractFiles(const QVector<Kerfuffle::Archive::Entr
         return false;
     }
 
-    KCompressionDevice *device = new KCompressionDevice(filename(), KFilterDev::compressionTypeForMimeType(m_mimeType));
+    QFile inputFile(filename());
+    if (!inputFile.open(QIODevice::ReadOnly)) {
+        qCCritical(ARK) << "Failed to open input file" << inputFile.errorString();
+        emit error(xi18nc("@info", "Ark could not open <filename>%1</filename> for extraction.", filename()));
+
+        return false;
+    }
+
+    const qint64 inputSize = inputFile.size();
+
+    // Decode the mapped file with several threads, if the format allows it.
+    uchar *data = (inputSize > 0) ? inputFile.map(0, inputSize) : Q_NULLPTR;
+    if (data) {
+        ParallelDecoder decoder(data, inputSize);
+        if (decoder.isSupported()) {
+            // The size is known only for some formats.
+            if (options.preallocateFiles() && !Kerfuffle::preallocateFile(outputFile.handle(), decoder.decodedSize())) {
+                qCCritical(ARK) << "Could not allocate" << decoder.decodedSize() << "bytes for" << outputFile.fileName();
+                emit error(xi18nc("@info", "There is not enough free space to extract <filename>%1</filename>.", outputFile.fileName()));
+                return false;
+            }
+
+            connect(&decoder, &ParallelDecoder::progress, this, &LibSingleFileInterface::progress);
+
+            // Keep units which don't fit in memory on the destination's file system.
+            decoder.setSpillDirectory(QFileInfo(outputFile).absolutePath());
+
+            if (!decoder.decode(&outputFile)) {
+                emit error(xi18nc("@info", "There was an error while reading <filename>%1</filename> during extraction.", filename()));
+                return false;
+            }
+
+            return syncExtractedFile(&outputFile, options);
+        }
+
+        inputFile.unmap(data);
+    }
+
+    // KCompressionDevice would copy data of unknown formats unchanged.
+    const KCompressionDevice::CompressionType compressionType = KFilterDev::compressionTypeForMimeType(m_mimeType);
+    if (compressionType == KCompressionDevice::None) {
+        qCCritical(ARK) << "No KCompressionDevice for" << m_mimeType;
+        emit error(xi18nc("@info", "Ark could not open <filename>%1</filename> for extraction.", filename()));
+
+        return false;
+    }
+
+    KCompressionDevice *device = new KCompressionDevice(&inputFile, false, compressionType);
     if (!device) {
         qCCritical(ARK) << "Could not create KCompressionDevice";
         emit error(xi18nc("@info", "Ark could not open <filename>%1</filename> for extraction.", filename()));
@@ -81,6 +137,7 @@ bool LibSingleFileInterface::extractFiles(const QVector<Kerfuffle::Archive::Entr
 
     qint64 bytesRead;
     QByteArray dataChunk(1024*16, '\0');   // 16Kb
+    int percent = -1;
 
     while (true) {
         bytesRead = device->read(dataChunk.data(), dataChunk.size());
@@ -93,11 +150,17 @@ bool LibSingleFileInterface::extractFiles(const QVector<Kerfuffle::Archive::Entr
         }
 
         outputFile.write(dataChunk.data(), bytesRead);
+
+        // Report the share of the compressed file read so far.
+        if (inputSize > 0 && (100 * inputFile.pos() / inputSize) != percent) {
+            percent = 100 * inputFile.pos() / inputSize;
+            emit progress(double(inputFile.pos()) / double(inputSize));
+        }
     }
 
     delete device;
 
-    return true;
+    return syncExtractedFile(&outputFile, options);
 }
 
 bool LibSingleFileInterface::list()
@@ -105,12 +168,28 @@ bool LibSingleFileInterface::list()
     qCDebug(ARK) << "Listing archive contents";
 
     Kerfuffle::Archive::Entry *e = new Kerfuffle::Archive::Entry(this);
-    e->setProperty("fullPath", uncompressedFileName());
+    e->setFullPath(uncompressedFileName());
     emit entry(e);
 
     return true;
 }
 
+bool LibSingleFileInterface::syncExtractedFile(QFile *file, const Kerfuffle::ExtractionOptions &options)
+{
+    // There is a single file, so syncing it is as good as syncing the filesystem.
+    if (options.syncMode() == Kerfuffle::ExtractionOptions::NoSync) {
+        return true;
+    }
+
+    if (file->flush() && Kerfuffle::syncFile(file->handle())) {
+        return true;
+    }
+
+    qCCritical(ARK) << "Could not sync" << file->fileName() << ":" << strerror(errno);
+    emit error(xi18nc("@info", "Could not write <filename>%1</filename> to disk.", file->fileName()));
+    return false;
+}
+
 QString LibSingleFileInterface::overwriteFileName(QString& filename)
 {
     QString newFileName(filename);
@@ -158,6 +237,203 @@ const QString LibSingleFileInterface::uncompressedFileName() const
 
 bool LibSingleFileInterface::testArchive()
 {
+    qCDebug(ARK) << "Testing" << filename();
+
+    QFile inputFile(filename());
+    if (!inputFile.open(QIODevice::ReadOnly)) {
+        qCCritical(ARK) << "Failed to open input file" << inputFile.errorString();
+        emit error(xi18nc("@info", "Ark could not open <filename>%1</filename>.", filename()));
+
+        return false;
+    }
+
+    const qint64 inputSize = inputFile.size();
+
+    // The decoders check the CRC of every member, stream or frame,
+    // so decoding everything is enough to test the archive.
+    uchar *data = (inputSize > 0) ? inputFile.map(0, inputSize) : Q_NULLPTR;
+    if (data) {
+        ParallelDecoder decoder(data, inputSize);
+        if (decoder.isSupported()) {
+            connect(&decoder, &ParallelDecoder::progress, this, &LibSingleFileInterface::progress);
+
+            const bool isValid = decoder.verify();
+            if (QThread::currentThread()->isInterruptionRequested()) {
+                return false;
+            }
+            if (isValid) {
+                emit testSuccess();
+            }
+
+            return true;
+        }
+
+        inputFile.unmap(data);
+    }
+
+    const KCompressionDevice::CompressionType compressionType = KFilterDev::compressionTypeForMimeType(m_mimeType);
+    if (compressionType == KCompressionDevice::None) {
+        qCCritical(ARK) << "No KCompressionDevice for" << m_mimeType;
+        emit error(xi18nc("@info", "Ark could not open <filename>%1</filename>.", filename()));
+
+        return false;
+    }
+
+    KCompressionDevice device(&inputFile, false, compressionType);
+    device.open(QIODevice::ReadOnly);
+
+    qint64 bytesRead;
+    QByteArray dataChunk(1024*16, '\0');   // 16Kb
+    int percent = -1;
+
+    while (true) {
+        if (QThread::currentThread()->isInterruptionRequested()) {
+            return false;
+        }
+
+        bytesRead = device.read(dataChunk.data(), dataChunk.size());
+
+        if (bytesRead == -1) {
+            qCWarning(ARK) << "Could not decompress" << filename() << device.errorString();
+            return true;
+        } else if (bytesRead == 0) {
+            break;
+        }
+
+        if (inputSize > 0 && (100 * inputFile.pos() / inputSize) != percent) {
+            percent = 100 * inputFile.pos() / inputSize;
+            emit progress(double(inputFile.pos()) / double(inputSize));
+        }
+    }
+
+    emit testSuccess();
+    return true;
+}
+
+bool LibSingleFileInterface::hasBatchExtractionProgress() const
+{
+    return true;
+}
+
+bool LibSingleFileInterface::doKill()
+{
+    return true;
+}
+
+bool LibSingleFileInterface::isReadOnly() const
+{
+    return QFileInfo::exists(filename()) || Kerfuffle::ReadWriteArchiveInterface::isReadOnly();
+}
+
+bool LibSingleFileInterface::addFiles(const QVector<Kerfuffle::Archive::Entry*> &files, const Kerfuffle::Archive::Entry *destination, const Kerfuffle::CompressionOptions& options, uint numberOfEntriesToAdd)
+{
+    Q_UNUSED(numberOfEntriesToAdd)
+
+    qCDebug(ARK) << "Compressing" << files.size() << "files with CompressionOptions" << options;
+
+    ParallelEncoder::Format format;
+    if (!encoderFormat(&format) || QFileInfo::exists(filename())) {
+        emit error(xi18nc("@info", "Files cannot be added to <filename>%1</filename>.", filename()));
+        return false;
+    }
+
+    const QString inputFileName = files.isEmpty() ? QString() : files.first()->fullPath(Kerfuffle::NoTrailingSlash);
+    const QFileInfo inputFileInfo(inputFileName);
+    if (destination || files.size() != 1 || !inputFileInfo.isFile()) {
+        emit error(i18nc("@info", "Only a single file can be compressed into this format."));
+        return false;
+    }
+
+    QFile inputFile(inputFileName);
+    if (!inputFile.open(QIODevice::ReadOnly)) {
+        qCCritical(ARK) << "Failed to open input file" << inputFile.errorString();
+        emit error(xi18nc("@info", "Ark could not open <filename>%1</filename> for reading.", inputFileName));
+        return false;
+    }
+
+    QSaveFile outputFile(filename());
+    if (!outputFile.open(QIODevice::WriteOnly)) {
+        qCCritical(ARK) << "Failed to open output file" << outputFile.errorString();
+        emit error(xi18nc("@info", "Ark could not create <filename>%1</filename>.", filename()));
+        return false;
+    }
+
+    ParallelEncoder encoder(format);
+    encoder.setCompressionLevel(options.compressionLevel());
+    encoder.setThreadCount(options.threadCount());
+    encoder.setLongDistanceMatchingEnabled(options.isLongDistanceMatchingEnabled());
+    encoder.setFileName(inputFileInfo.fileName());
+    encoder.setModificationTime(inputFileInfo.lastModified());
+    connect(&encoder, &ParallelEncoder::progress, this, &LibSingleFileInterface::progress);
+
+    if (!encoder.encode(&inputFile, &outputFile)) {
+        outputFile.cancelWriting();
+        if (!QThread::currentThread()->isInterruptionRequested()) {
+            emit error(xi18nc("@info", "Ark could not compress <filename>%1</filename>.", inputFileName));
+        }
+        return false;
+    }
+
+    if (!outputFile.commit()) {
+        qCCritical(ARK) << "Failed to write output file" << outputFile.errorString();
+        emit error(xi18nc("@info", "Ark could not create <filename>%1</filename>.", filename()));
+        return false;
+    }
+
+    // The new archive holds the single entry list() finds.
+    return list();
+}
+
+bool LibSingleFileInterface::moveFiles(const QVector<Kerfuffle::Archive::Entry*> &files, Kerfuffle::Archive::Entry *destination, const Kerfuffle::CompressionOptions& options)
+{
+    Q_UNUSED(files)
+    Q_UNUSED(destination)
+    Q_UNUSED(options)
+    emit error(i18nc("@info", "Moving files is not supported for this archive."));
+    return false;
+}
+
+bool LibSingleFileInterface::copyFiles(const QVector<Kerfuffle::Archive::Entry*> &files, Kerfuffle::Archive::Entry *destination, const Kerfuffle::CompressionOptions& options)
+{
+    Q_UNUSED(files)
+    Q_UNUSED(destination)
+    Q_UNUSED(options)
+    emit error(i18nc("@info", "Copying files is not supported for this archive."));
     return false;
 }
 
+bool LibSingleFileInterface::deleteFiles(const QVector<Kerfuffle::Archive::Entry*> &files)
+{
+    Q_UNUSED(files)
+    emit error(i18nc("@info", "Deleting files is not supported for this archive."));
+    return false;
+}
+
+bool LibSingleFileInterface::addComment(const QString &comment)
+{
+    Q_UNUSED(comment)
+    emit error(i18nc("@info", "Comments are not supported for this archive."));
+    return false;
+}
+
+bool LibSingleFileInterface::encoderFormat(ParallelEncoder::Format *format) const
+{
+    const QMimeType mimeType = mimetype();
+
+    if (mimeType.inherits(QStringLiteral("application/gzip"))) {
+        *format = ParallelEncoder::Gzip;
+    } else if (mimeType.inherits(QStringLiteral("application/x-bzip"))) {
+        *format = ParallelEncoder::Bzip2;
+    } else if (mimeType.inherits(QStringLiteral("application/x-xz"))) {
+        *format = ParallelEncoder::Xz;
+    } else if (mimeType.inherits(QStringLiteral("application/x-lzma"))) {
+        *format = ParallelEncoder::Lzma;
+    } else if (mimeType.inherits(QStringLiteral("application/zstd"))) {
+        *format = ParallelEncoder::Zstd;
+    } else {
+        return false;
+    }
+
+    return ParallelEncoder::isSupported(*format);
+}
+
@@ -27,8 +27,11 @@
 #define SINGLEFILEPLUGIN_H
 
 #include "archiveinterface.h"
+#include "parallelencoder.h"
 
-class LibSingleFileInterface : public Kerfuffle::ReadOnlyArchiveInterface
+class QFile;
+
+class LibSingleFileInterface : public Kerfuffle::ReadWriteArchiveInterface
 {
     Q_OBJECT
 
@@ -39,11 +42,39 @@ public:
     virtual bool list() Q_DECL_OVERRIDE;
     virtual bool testArchive() Q_DECL_OVERRIDE;
     virtual bool extractFiles(const QVector<Kerfuffle::Archive::Entry*> &files, const QString &destinationDirectory, const Kerfuffle::ExtractionOptions &options) Q_DECL_OVERRIDE;
+    virtual bool hasBatchExtractionProgress() const Q_DECL_OVERRIDE;
+    virtual bool doKill() Q_DECL_OVERRIDE;
+
+    /**
+     * Only new files can be written.
+     */
+    virtual bool isReadOnly() const Q_DECL_OVERRIDE;
+
+    /**
+     * Compresses the single file in @p files into a new file.
+     */
+    virtual bool addFiles(const QVector<Kerfuffle::Archive::Entry*> &files, const Kerfuffle::Archive::Entry *destination, const Kerfuffle::CompressionOptions& options, uint numberOfEntriesToAdd = 0) Q_DECL_OVERRIDE;
+    virtual bool moveFiles(const QVector<Kerfuffle::Archive::Entry*> &files, Kerfuffle::Archive::Entry *destination, const Kerfuffle::CompressionOptions& options) Q_DECL_OVERRIDE;
+    virtual bool copyFiles(const QVector<Kerfuffle::Archive::Entry*> &files, Kerfuffle::Archive::Entry *destination, const Kerfuffle::CompressionOptions& options) Q_DECL_OVERRIDE;
+    virtual bool deleteFiles(const QVector<Kerfuffle::Archive::Entry*> &files) Q_DECL_OVERRIDE;
+    virtual bool addComment(const QString &comment) Q_DECL_OVERRIDE;
 
 protected:
     const QString uncompressedFileName() const;
     QString overwriteFileName(QString& filename);
 
+    /**
+     * Sets @p format to the format of new files of the archive's mimetype.
+     * @return Whether files of this mimetype can be written.
+     */
+    bool encoderFormat(ParallelEncoder::Format *format) const;
+
+    /**
+     * Flushes the extracted @p file to disk if @p options ask for it.
+     * @return false if it could not be written, after emitting error().
+     */
+    bool syncExtractedFile(QFile *file, const Kerfuffle::ExtractionOptions &options);
+
     QString m_mimeType;
     QStringList m_possibleExtensions;
 };